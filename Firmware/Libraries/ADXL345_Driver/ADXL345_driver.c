@@ -12,7 +12,7 @@
 //============================================================================*/
 
 #include "i2c_mems_driver.h"
-#include "adxl345_driver.h"
+#include "ADXL345_driver.h"
 
 /*--------------------------------- Definitions ------------------------------*/
 
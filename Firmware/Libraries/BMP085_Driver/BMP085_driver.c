@@ -14,7 +14,7 @@
 #include "task.h"
 
 #include "i2c_mems_driver.h"
-#include "bmp085_driver.h"
+#include "BMP085_driver.h"
 
 /*--------------------------------- Definitions ------------------------------*/
 
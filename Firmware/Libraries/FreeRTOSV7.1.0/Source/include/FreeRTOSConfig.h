@@ -69,13 +69,25 @@
  *----------------------------------------------------------*/
 
 #define configUSE_PREEMPTION            1
+#ifdef SIL                                                               // host build, see Sil/sil.c
+#define configUSE_IDLE_HOOK             1                                // POSIX port sleeps in idle hook
+#else
 #define configUSE_IDLE_HOOK             0
+#endif
+#ifdef SIL
+#define configUSE_TICK_HOOK             1                                // peripheral emulation
+#else
 #define configUSE_TICK_HOOK             0
+#endif
 #define configCPU_CLOCK_HZ              ( ( unsigned long ) 24000000 )   // 
 #define configTICK_RATE_HZ              ( ( portTickType ) 1000 )        //
 #define configMAX_PRIORITIES            ( ( unsigned portBASE_TYPE ) 5 ) //
 #define configMINIMAL_STACK_SIZE        ( ( unsigned short ) 128 )       // original: 128
+#ifdef SIL
+#define configTOTAL_HEAP_SIZE           ( ( size_t ) ( 8 * 1024 ) )      // TCB pointers are 64 bit on host
+#else
 #define configTOTAL_HEAP_SIZE           ( ( size_t ) ( 4 * 1024 ) )      // original: 17 * 1024
+#endif
 #define configMAX_TASK_NAME_LEN         ( 16 )                           // original: 32
 #define configUSE_TRACE_FACILITY        0
 #define configUSE_16_BIT_TICKS          0
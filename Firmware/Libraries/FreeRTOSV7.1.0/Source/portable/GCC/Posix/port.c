@@ -0,0 +1,539 @@
+/*
+    FreeRTOS V7.1.0 - Copyright (C) 2011 Real Time Engineers Ltd.
+	
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS tutorial books are available in pdf and paperback.        *
+     *    Complete, revised, and edited pdf reference manuals are also       *
+     *    available.                                                         *
+     *                                                                       *
+     *    Purchasing FreeRTOS documentation will not only help you, by       *
+     *    ensuring you get running as quickly as possible and with an        *
+     *    in-depth knowledge of how to use FreeRTOS, it will also help       *
+     *    the FreeRTOS project to continue with its mission of providing     *
+     *    professional grade, cross platform, de facto standard solutions    *
+     *    for microcontrollers - completely free of charge!                  *
+     *                                                                       *
+     *    >>> See http://www.FreeRTOS.org/Documentation for details. <<<     *
+     *                                                                       *
+     *    Thank you for using FreeRTOS, and thank you for your support!      *
+     *                                                                       *
+    ***************************************************************************
+
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation AND MODIFIED BY the FreeRTOS exception.
+    >>>NOTE<<< The modification to the GPL is included to allow you to
+    distribute a combined work that includes FreeRTOS without being obliged to
+    provide the source code for proprietary components outside of the FreeRTOS
+    kernel.  FreeRTOS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+    more details. You should have received a copy of the GNU General Public
+    License and the FreeRTOS license exception along with FreeRTOS; if not it
+    can be viewed here: http://www.freertos.org/a00114.html and also obtained
+    by writing to Richard Barry, contact details for whom are available on the
+    FreeRTOS WEB site.
+
+    1 tab == 4 spaces!
+
+    http://www.FreeRTOS.org - Documentation, latest information, license and
+    contact details.
+
+    http://www.SafeRTOS.com - A version that is certified for use in safety
+    critical systems.
+
+    http://www.OpenRTOS.com - Commercial support, development, porting,
+    licensing and training services.
+*/
+
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the POSIX port,
+ * used to run the firmware on a Linux host (software in the loop).
+ *
+ * Each task is a host thread, but only the thread of pxCurrentTCB runs:
+ * the others wait on their own semaphore.  A context switch posts the
+ * semaphore of the next thread, then waits until the task is selected
+ * again.
+ *
+ * Interrupts are host threads too (the tick thread, which also runs the
+ * peripheral emulation from the tick hook).  They call handlers between
+ * vPortInterruptEnter() and vPortInterruptExit().  The interrupt mask is
+ * a mutex: masking interrupts, as critical sections do, blocks interrupt
+ * threads, and an interrupt blocks tasks entering a critical section.
+ *
+ * An interrupt requesting a switch (every tick with preemption, or a task
+ * woken from an ISR) preempts the running task as PendSV does on target:
+ * the task thread is sent SIGUSR1 and parks in the signal handler until
+ * it is selected again.  Holding the mask, the interrupt thread knows the
+ * task is outside of critical sections, so the task is stopped wherever
+ * it is, busy loops included.  Host library calls that take locks (stdio)
+ * must therefore be made in critical sections, or with the scheduler
+ * suspended.  The idle task sleeps instead of spinning: configUSE_IDLE_HOOK
+ * must be 1.
+ *
+ * Ticks follow the host clock, unless vPortSetVirtualTime() was called
+ * before the scheduler starts.  Then there is no tick thread: the idle
+ * task makes ticks, as an interrupt would, each time it runs, that is
+ * when all tasks are blocked, and only then.  Time stands still while
+ * tasks run, so a run is as fast as the host allows and is repeated
+ * identically with the same inputs.  A task polling without blocking
+ * stops time.
+ *----------------------------------------------------------*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if ( configUSE_IDLE_HOOK != 1 )
+	#error POSIX port needs configUSE_IDLE_HOOK set to 1
+#endif
+
+/* Signal preempting task threads. */
+#define portPREEMPT_SIGNAL	SIGUSR1
+
+/* Host thread of a task, stored at the top of the task stack so that it is
+found through the first member of the TCB. */
+typedef struct xTHREAD
+{
+	pthread_t xThread;
+	sem_t xRun;						/* Posted each time the task is selected. */
+	pdTASK_CODE pxCode;
+	void *pvParameters;
+} xThread;
+
+/* The interrupt mask and everything below is protected by this mutex. */
+static pthread_mutex_t xMask = PTHREAD_MUTEX_INITIALIZER;
+
+/* Posted by a preempted task thread once it is parked. */
+static sem_t xParked;
+
+/* Set when a context switch is waiting for the end of a critical section
+or of an interrupt. */
+static volatile portBASE_TYPE xSwitchPending = pdFALSE;
+
+/* Set once the first task has been started. */
+static volatile portBASE_TYPE xSchedulerRunning = pdFALSE;
+
+/* Ticks are made when the idle task runs, instead of by the host clock. */
+static portBASE_TYPE xVirtualTime = pdFALSE;
+
+/* Thread of the calling task, NULL for main and interrupt threads. */
+static __thread xThread *pxThisThread = NULL;
+
+/* The calling thread holds the interrupt mask. */
+static __thread portBASE_TYPE xMasked = pdFALSE;
+
+/* Each task maintains its own interrupt status in the critical nesting
+variable. */
+static __thread unsigned portBASE_TYPE uxCriticalNesting = 0;
+
+extern void * volatile pxCurrentTCB;
+
+/*
+ * Thread of the current task.
+ */
+static xThread *prvCurrentThread( void );
+
+/*
+ * Wait until the calling task is selected.
+ */
+static void prvWaitRun( xThread *pxThread );
+
+/*
+ * Switch to the task selected by the scheduler, called by the running task
+ * without the mask.
+ */
+static void prvSwitchContext( void );
+
+/*
+ * Switch to the task selected by the scheduler, called by an interrupt
+ * thread holding the mask.
+ */
+static void prvPreempt( void );
+
+/*
+ * Handler of portPREEMPT_SIGNAL, parks the preempted task.
+ */
+static void prvPreemptHandler( int iSignal );
+
+/*
+ * Body of task threads.
+ */
+static void *prvTaskThread( void *pvParameters );
+
+/*
+ * Make a tick.
+ */
+static void prvTick( void );
+
+/*
+ * Make a tick in virtual time, called by the idle task.
+ */
+static void prvVirtualTick( void );
+
+/*
+ * Body of the tick interrupt thread.
+ */
+static void *prvTickThread( void *pvParameters );
+
+/*-----------------------------------------------------------*/
+
+static xThread *prvCurrentThread( void )
+{
+	/* The first item in pxCurrentTCB is the task top of stack. */
+	return *( xThread ** ) pxCurrentTCB;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWaitRun( xThread *pxThread )
+{
+	while( sem_wait( &( pxThread->xRun ) ) != 0 )
+	{
+		/* Interrupted by a signal. */
+	}
+}
+/*-----------------------------------------------------------*/
+
+/* 
+ * See header file for description. 
+ */
+portSTACK_TYPE *pxPortInitialiseStack( portSTACK_TYPE *pxTopOfStack, pdTASK_CODE pxCode, void *pvParameters )
+{
+xThread *pxThread;
+
+	/* The thread descriptor takes the top of the stack, which is otherwise
+	unused as the host thread has a stack of its own. */
+	pxThread = ( xThread * ) ( ( ( uintptr_t ) ( pxTopOfStack + 1 ) - sizeof( xThread ) ) & ~( uintptr_t ) portBYTE_ALIGNMENT_MASK );
+	pxThread->pxCode = pxCode;
+	pxThread->pvParameters = pvParameters;
+	sem_init( &( pxThread->xRun ), 0, 0 );
+	if( pthread_create( &( pxThread->xThread ), NULL, prvTaskThread, pxThread ) != 0 )
+	{
+		perror( "pxPortInitialiseStack" );
+		exit( EXIT_FAILURE );
+	}
+
+	return ( portSTACK_TYPE * ) pxThread;
+}
+/*-----------------------------------------------------------*/
+
+static void *prvTaskThread( void *pvParameters )
+{
+xThread *pxThread = ( xThread * ) pvParameters;
+
+	pxThisThread = pxThread;
+
+	/* Wait to be selected the first time. */
+	prvWaitRun( pxThread );
+
+	pxThread->pxCode( pxThread->pvParameters );
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/* 
+ * See header file for description. 
+ */
+portBASE_TYPE xPortStartScheduler( void )
+{
+pthread_t xTick;
+struct sigaction xAction;
+sigset_t xSignals;
+
+	/* Called with interrupts disabled by vTaskStartScheduler(). */
+	sem_init( &xParked, 0, 0 );
+	xAction.sa_handler = prvPreemptHandler;
+	xAction.sa_flags = SA_RESTART;
+	sigemptyset( &xAction.sa_mask );
+	sigaction( portPREEMPT_SIGNAL, &xAction, NULL );
+
+	/* Interrupts are never preempted. */
+	sigemptyset( &xSignals );
+	sigaddset( &xSignals, portPREEMPT_SIGNAL );
+	pthread_sigmask( SIG_BLOCK, &xSignals, NULL );
+
+	xSchedulerRunning = pdTRUE;
+	sem_post( &( prvCurrentThread()->xRun ) );
+
+	if( ( xVirtualTime == pdFALSE ) && ( pthread_create( &xTick, NULL, prvTickThread, NULL ) != 0 ) )
+	{
+		perror( "xPortStartScheduler" );
+		exit( EXIT_FAILURE );
+	}
+
+	/* The main thread is not a task, it only waits from now on. */
+	vPortClearInterruptMaskFromISR( pdFALSE );
+	for( ;; )
+	{
+		pause();
+	}
+
+	/* Should not get here! */
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetVirtualTime( void )
+{
+	xVirtualTime = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+	/* It is unlikely that the CM3 port will require this function as there
+	is nothing to return to.  */
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+xThread *pxThread = pxThisThread;
+xThread *pxNext;
+
+	pthread_mutex_lock( &xMask );
+	xSwitchPending = pdFALSE;
+	vTaskSwitchContext();
+	pxNext = prvCurrentThread();
+	pthread_mutex_unlock( &xMask );
+
+	if( pxNext != pxThread )
+	{
+		sem_post( &( pxNext->xRun ) );
+		prvWaitRun( pxThread );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvPreempt( void )
+{
+xThread *pxThread = prvCurrentThread();
+xThread *pxNext;
+
+	xSwitchPending = pdFALSE;
+	vTaskSwitchContext();
+	pxNext = prvCurrentThread();
+
+	if( pxNext != pxThread )
+	{
+		/* The task is outside of critical sections as the mask is held
+		here, stop it before starting the next one. */
+		pthread_kill( pxThread->xThread, portPREEMPT_SIGNAL );
+		while( sem_wait( &xParked ) != 0 )
+		{
+		}
+		sem_post( &( pxNext->xRun ) );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvPreemptHandler( int iSignal )
+{
+int iErrno = errno;
+
+	( void ) iSignal;
+
+	/* A task selected again before it ran consumes that selection here, and
+	waits for the next one where it was interrupted. */
+	sem_post( &xParked );
+	prvWaitRun( pxThisThread );
+
+	errno = iErrno;
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	if( pxThisThread == NULL )
+	{
+		vPortYieldFromISR();
+	}
+	else if( ( uxCriticalNesting == 0 ) && ( xMasked == pdFALSE ) )
+	{
+		prvSwitchContext();
+	}
+	else
+	{
+		/* Made at the end of the critical section. */
+		xSwitchPending = pdTRUE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( void )
+{
+	/* Made at the end of the interrupt. */
+	xSwitchPending = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetInterruptMask( void )
+{
+	if( xMasked == pdFALSE )
+	{
+		pthread_mutex_lock( &xMask );
+		xMasked = pdTRUE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( void )
+{
+	if( xMasked != pdFALSE )
+	{
+		xMasked = pdFALSE;
+		pthread_mutex_unlock( &xMask );
+	}
+	if( ( pxThisThread != NULL ) && ( xSwitchPending != pdFALSE ) && ( uxCriticalNesting == 0 ) && ( xSchedulerRunning != pdFALSE ) )
+	{
+		prvSwitchContext();
+	}
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxPortSetInterruptMaskFromISR( void )
+{
+unsigned portBASE_TYPE uxMasked = ( unsigned portBASE_TYPE ) xMasked;
+
+	vPortSetInterruptMask();
+	return uxMasked;
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMaskFromISR( unsigned portBASE_TYPE uxMask )
+{
+	if( ( uxMask == pdFALSE ) && ( xMasked != pdFALSE ) )
+	{
+		xMasked = pdFALSE;
+		pthread_mutex_unlock( &xMask );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	vPortSetInterruptMask();
+	uxCriticalNesting++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	uxCriticalNesting--;
+	if( uxCriticalNesting == 0 )
+	{
+		vPortClearInterruptMask();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortInterruptEnter( void )
+{
+	vPortSetInterruptMask();
+}
+/*-----------------------------------------------------------*/
+
+void vPortInterruptExit( void )
+{
+	if( xSwitchPending != pdFALSE )
+	{
+		prvPreempt();
+	}
+	vPortClearInterruptMaskFromISR( pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTick( void )
+{
+	vPortInterruptEnter();
+	vTaskIncrementTick();
+	#if configUSE_PREEMPTION == 1
+		xSwitchPending = pdTRUE;
+	#endif
+	vPortInterruptExit();
+}
+/*-----------------------------------------------------------*/
+
+static void prvVirtualTick( void )
+{
+xThread *pxThread = pxThisThread;
+xThread *pxNext;
+
+	/* Handlers called from the tick hook run in interrupt context. */
+	pxThisThread = NULL;
+	vPortInterruptEnter();
+	vTaskIncrementTick();
+	xSwitchPending = pdFALSE;
+	vTaskSwitchContext();
+	pxNext = prvCurrentThread();
+	vPortClearInterruptMaskFromISR( pdFALSE );
+	pxThisThread = pxThread;
+
+	if( pxNext != pxThread )
+	{
+		sem_post( &( pxNext->xRun ) );
+		prvWaitRun( pxThread );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void *prvTickThread( void *pvParameters )
+{
+struct timespec xNext;
+
+	( void ) pvParameters;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNext );
+	for( ;; )
+	{
+		/* Periods are absolute, so ticks don't drift. */
+		xNext.tv_nsec += 1000000000L / configTICK_RATE_HZ;
+		if( xNext.tv_nsec >= 1000000000L )
+		{
+			xNext.tv_nsec -= 1000000000L;
+			xNext.tv_sec++;
+		}
+		while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &xNext, NULL ) != 0 )
+		{
+		}
+
+		prvTick();
+	}
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The idle task sleeps until it is preempted, or makes the next tick in
+ * virtual time.
+ */
+void vApplicationIdleHook( void )
+{
+	if( xVirtualTime != pdFALSE )
+	{
+		prvVirtualTick();
+	}
+	else
+	{
+		pause();
+	}
+}
+
@@ -9,7 +9,7 @@
 ///----------------------------------------------------------------------------
 
 #include "i2c_mems_driver.h"
-#include "l3g4200d_driver.h"
+#include "l3g4200D_driver.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
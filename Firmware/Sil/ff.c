@@ -0,0 +1,381 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief FatFs on a host directory, software in the loop
+///
+/// \file
+///  Replaces FatFs and SD card driver on host with the subset of FatFs used
+///  by the firmware: files are read and written in the directory given by
+///  Sil_Disk(). Names are case insensitive as on FAT, a drive number and a
+///  leading / are ignored. Mounting fails with FR_NOT_READY if the directory
+///  doesn't exist, as with no card inserted.
+///  disk_timerproc() remains a task with the period of the SD card driver.
+///  Host streams take locks, so the scheduler is suspended while they are
+///  used: a task preempted holding a lock would block the others.
+///
+//  Change
+//
+//============================================================================*/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define DIR FF_DIR                      // FatFs directory, clashes with host
+#include "ff.h"
+#include "diskio.h"
+#undef DIR
+
+#include "stm32f10x.h"
+#include "servodriver.h"
+#include "sil.h"
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+#define SIL_FILES       8           //!< max number of open files
+#define SIL_PATH        256         //!< max length of host path
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// open file
+typedef struct {
+    FIL * pxFil;                    ///< FatFs object, NULL if slot is free
+    FILE * pxFile;                  ///< host stream
+} xSil_File;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xSil_File x_Files[SIL_FILES];        //!< open files
+VAR_STATIC FATFS * px_Fs = NULL;                //!< mounted file system
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static xSil_File * Sil_File(const FIL * pxFil);
+static void Sil_Path(const XCHAR * pcName, char * pcPath);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   finds open file of a FatFs object
+/// \param   pxFil = pointer to FatFs object, NULL for a free slot
+/// \return  pointer to slot, NULL if not found
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static xSil_File * Sil_File(const FIL * pxFil)
+{
+    uint8_t j;
+
+    for (j = 0; j < SIL_FILES; j++) {
+        if (x_Files[j].pxFil == pxFil) {
+            return &x_Files[j];
+        }
+    }
+    return NULL;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   host path of a file
+/// \param   pcName = FatFs file name
+/// \param   pcPath = pointer to host path, SIL_PATH bytes
+/// \return  -
+/// \remarks an existing file whose name differs only by case is used
+///
+///----------------------------------------------------------------------------
+static void Sil_Path(const XCHAR * pcName, char * pcPath)
+{
+    DIR * p_dir;
+    struct dirent * p_entry;
+
+    if ((pcName[0] != 0) && (pcName[1] == ':')) {
+        pcName += 2;                            // drive number
+    }
+    while (*pcName == '/') {
+        pcName++;
+    }
+    snprintf(pcPath, SIL_PATH, "%s/%s", Sil_Disk(), pcName);
+    p_dir = opendir(Sil_Disk());
+    if (p_dir != NULL) {
+        while ((p_entry = readdir(p_dir)) != NULL) {
+            if (strcasecmp(p_entry->d_name, pcName) == 0) {
+                snprintf(pcPath, SIL_PATH, "%s/%s", Sil_Disk(), p_entry->d_name);
+                break;
+            }
+        }
+        closedir(p_dir);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   mounts or unmounts the host directory
+/// \param   drv = logical drive, 0 only
+/// \param   fs = pointer to file system object, NULL to unmount
+/// \return  FR_OK, FR_INVALID_DRIVE, FR_NOT_READY if directory doesn't exist
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_mount(BYTE drv, FATFS * fs)
+{
+    struct stat x_stat;
+
+    if (drv != 0) {
+        return FR_INVALID_DRIVE;
+    }
+    px_Fs = fs;
+    if ((fs != NULL) && ((stat(Sil_Disk(), &x_stat) != 0) || !S_ISDIR(x_stat.st_mode))) {
+        return FR_NOT_READY;
+    }
+    return FR_OK;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   opens or creates a file
+/// \param   fp = pointer to file object
+/// \param   path = file name
+/// \param   mode = FA_READ, FA_WRITE, FA_CREATE_ALWAYS, FA_CREATE_NEW, FA_OPEN_ALWAYS
+/// \return  FR_OK, FR_NO_FILE, FR_EXIST, FR_NOT_ENABLED, FR_DENIED also if too many files
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_open(FIL * fp, const XCHAR * path, BYTE mode)
+{
+    xSil_File * p_slot = Sil_File(NULL);
+    char c_path[SIL_PATH];
+    struct stat x_stat;
+    bool b_exists;
+    FILE * p_file;
+    FRESULT e_result;
+
+    if (px_Fs == NULL) {
+        return FR_NOT_ENABLED;
+    }
+    if (p_slot == NULL) {
+        return FR_DENIED;
+    }
+    vTaskSuspendAll();
+    Sil_Path(path, c_path);
+    b_exists = (stat(c_path, &x_stat) == 0);
+    p_file = NULL;
+    if (b_exists && ((mode & FA_CREATE_NEW) != 0)) {
+        e_result = FR_EXIST;
+    } else if (!b_exists && ((mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS)) == 0)) {
+        e_result = FR_NO_FILE;
+    } else {
+        if ((mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS)) != 0) {
+            p_file = fopen(c_path, "w+b");
+        } else if ((mode & FA_WRITE) != 0) {
+            p_file = fopen(c_path, b_exists ? "r+b" : "w+b");
+        } else {
+            p_file = fopen(c_path, "rb");
+        }
+        e_result = (p_file == NULL) ? FR_DENIED : FR_OK;
+    }
+    if (p_file != NULL) {
+        memset(fp, 0, sizeof(FIL));
+        fp->fs = px_Fs;
+        fp->flag = mode;
+        fseek(p_file, 0, SEEK_END);
+        fp->fsize = (DWORD)ftell(p_file);
+        rewind(p_file);
+        p_slot->pxFil = fp;
+        p_slot->pxFile = p_file;
+    }
+    xTaskResumeAll();
+    return e_result;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads from a file
+/// \param   fp = pointer to file object
+/// \param   buff = pointer to data
+/// \param   btr = number of bytes to read
+/// \param   br = pointer to number of bytes read
+/// \return  FR_OK, FR_INVALID_OBJECT, FR_DISK_ERR
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_read(FIL * fp, void * buff, UINT btr, UINT * br)
+{
+    xSil_File * p_slot = Sil_File(fp);
+    bool b_error;
+
+    *br = 0;
+    if (p_slot == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    vTaskSuspendAll();
+    *br = (UINT)fread(buff, 1, btr, p_slot->pxFile);
+    b_error = (ferror(p_slot->pxFile) != 0);
+    xTaskResumeAll();
+    fp->fptr += *br;
+    return b_error ? FR_DISK_ERR : FR_OK;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes to a file
+/// \param   fp = pointer to file object
+/// \param   buff = pointer to data
+/// \param   btw = number of bytes to write
+/// \param   bw = pointer to number of bytes written
+/// \return  FR_OK, FR_INVALID_OBJECT, FR_DENIED, FR_DISK_ERR
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_write(FIL * fp, const void * buff, UINT btw, UINT * bw)
+{
+    xSil_File * p_slot = Sil_File(fp);
+
+    *bw = 0;
+    if (p_slot == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    if ((fp->flag & (FA_WRITE | FA_CREATE_ALWAYS | FA_CREATE_NEW | FA_OPEN_ALWAYS)) == 0) {
+        return FR_DENIED;
+    }
+    vTaskSuspendAll();
+    *bw = (UINT)fwrite(buff, 1, btw, p_slot->pxFile);
+    xTaskResumeAll();
+    fp->fptr += *bw;
+    if (fp->fptr > fp->fsize) {
+        fp->fsize = fp->fptr;
+    }
+    return (*bw == btw) ? FR_OK : FR_DISK_ERR;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   moves file pointer
+/// \param   fp = pointer to file object
+/// \param   ofs = offset from start of file
+/// \return  FR_OK, FR_INVALID_OBJECT, FR_DISK_ERR
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_lseek(FIL * fp, DWORD ofs)
+{
+    xSil_File * p_slot = Sil_File(fp);
+    int i_result;
+
+    if (p_slot == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    vTaskSuspendAll();
+    i_result = fseek(p_slot->pxFile, (long)ofs, SEEK_SET);
+    xTaskResumeAll();
+    if (i_result != 0) {
+        return FR_DISK_ERR;
+    }
+    fp->fptr = ofs;
+    return FR_OK;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   flushes a file
+/// \param   fp = pointer to file object
+/// \return  FR_OK, FR_INVALID_OBJECT, FR_DISK_ERR
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_sync(FIL * fp)
+{
+    xSil_File * p_slot = Sil_File(fp);
+    int i_result;
+
+    if (p_slot == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    vTaskSuspendAll();
+    i_result = fflush(p_slot->pxFile);
+    xTaskResumeAll();
+    return (i_result == 0) ? FR_OK : FR_DISK_ERR;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   closes a file
+/// \param   fp = pointer to file object
+/// \return  FR_OK, FR_INVALID_OBJECT, FR_DISK_ERR
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FRESULT f_close(FIL * fp)
+{
+    xSil_File * p_slot = Sil_File(fp);
+    int i_result;
+
+    if (p_slot == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    vTaskSuspendAll();
+    i_result = fclose(p_slot->pxFile);
+    xTaskResumeAll();
+    p_slot->pxFil = NULL;
+    p_slot->pxFile = NULL;
+    fp->fs = NULL;
+    return (i_result == 0) ? FR_OK : FR_DISK_ERR;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   SD card timer task, nothing to time on host
+/// \param   pvParameters = not used
+/// \return  -
+/// \remarks same period as on target, 10 ms
+///
+///----------------------------------------------------------------------------
+void disk_timerproc(void *pvParameters)
+{
+    portTickType Last_Wake_Time;
+
+    (void)pvParameters;
+    Last_Wake_Time = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&Last_Wake_Time, configTICK_RATE_HZ / 100);
+    }
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,392 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief I2C driver for MEMS sensors, software in the loop
+///
+/// \file
+///  Replaces Libraries/I2C_MEMS_Driver on host: the bus reaches register
+///  files of L3G4200D, ADXL345 and BMP085 emulated after their datasheets,
+///  so that the chip drivers run unchanged. Output registers are sampled
+///  from Sil_Sensors() when read, with the range set by the driver, and
+///  the mounting of chips given by SENSOR_SIGN:
+///  - L3G4200D: WHO_AM_I, CTRL_REG4 full scale, OUT_X_L..OUT_Z_H little
+///    endian, auto increment when bit 7 of register address is set
+///  - ADXL345: DEVID, DATA_FORMAT range and full resolution, DATAX0..DATAZ1
+///  - BMP085: chip id, calibration PROM with datasheet example values,
+///    temperature and pressure conversions started by control register;
+///    uncompensated values are found by bisection through the datasheet
+///    compensation, so the driver computes sensed temperature and the
+///    pressure of standard atmosphere at sensed altitude
+///  Transfers to other slaves are not acknowledged.
+///
+//  Change
+//
+//============================================================================*/
+
+#include <math.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+#include "i2c_mems_driver.h"
+#include "l3g4200D_driver.h"
+#include "ADXL345_driver.h"
+#include "BMP085_driver.h"
+
+#include "config.h"
+#include "servodriver.h"
+#include "sil.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define SIL_PI              3.14159265f
+#define SIL_SEA_LEVEL       101325.0f   //!< standard pressure at sea level [Pa]
+#define BMP085_ID           0x55        //!< chip id
+#define BMP085_VERSION      0x02        //!< ML and AL versions
+#define ADXL345_FULL_RES    0x08        //!< DATA_FORMAT full resolution bit
+#define L3G4200_FS_MASK     0x30        //!< CTRL_REG4 full scale bits
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// emulated chip on the bus
+typedef struct {
+    uint8_t ucSlave;                    ///< bus address
+    uint8_t ucIncrement;                ///< register address bit enabling auto increment, 0 = always
+    uint8_t ucReg[256];                 ///< register file
+} xSil_Chip;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// BMP085 calibration, example of datasheet
+VAR_STATIC const int16_t iBmp_Prom[11] = {
+    408, -72, -14383, (int16_t)32741, (int16_t)32757, 23153, 6190, 4, -32768, -8711, 2868
+};
+
+/// sign of sensor data, see SENSOR_SIGN
+VAR_STATIC const int16_t iSil_Sign[6] = SENSOR_SIGN;
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xSil_Chip x_Gyro = { L3G4200_SLAVE_ADDR, AUTO_INCR, { 0 } };
+VAR_STATIC xSil_Chip x_Accel = { ADXL345_SLAVE_ADDR, 0, { 0 } };
+VAR_STATIC xSil_Chip x_Baro = { BMP085_SLAVE_ADDR, 0, { 0 } };
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static xSil_Chip * Sil_Chip(uint8_t slave);
+static int16_t Sil_Saturate(float fValue, float fLimit);
+static void Sil_Sample(xSil_Chip * pxChip, uint8_t reg);
+static int32_t Bmp_B5(int32_t lUt);
+static int32_t Bmp_Pressure(int32_t lUp, int32_t lB5, uint8_t ucOss);
+static void Bmp_Convert(uint8_t ucControl);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   finds chip at a bus address
+/// \return  pointer to chip, NULL if none
+/// \param   slave, address of slave device
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static xSil_Chip * Sil_Chip(uint8_t slave)
+{
+    if (slave == x_Gyro.ucSlave) {
+        return &x_Gyro;
+    } else if (slave == x_Accel.ucSlave) {
+        return &x_Accel;
+    } else if (slave == x_Baro.ucSlave) {
+        return &x_Baro;
+    }
+    return NULL;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   rounds and saturates a sample as ADC does
+/// \return  sample
+/// \param   fValue, sample [LSB]
+/// \param   fLimit, full scale [LSB]
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int16_t Sil_Saturate(float fValue, float fLimit)
+{
+    if (fValue > fLimit - 1.0f) {
+        fValue = fLimit - 1.0f;
+    } else if (fValue < -fLimit) {
+        fValue = -fLimit;
+    }
+    return (int16_t)floorf(fValue + 0.5f);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   updates output registers of a chip about to be read
+/// \return  -
+/// \param   pxChip, pointer to chip
+/// \param   reg, first register read, without auto increment bit
+/// \remarks Chip axes are body axes times SENSOR_SIGN. Acceleration is the
+///          opposite of specific force, +1 g on z when level.
+///
+///----------------------------------------------------------------------------
+static void Sil_Sample(xSil_Chip * pxChip, uint8_t reg)
+{
+    const xSil_Sensors * p_sensors = Sil_Sensors();
+    uint8_t * p_out;
+    float f_lsb, f_limit;
+    int16_t i_sample;
+    uint8_t j;
+
+    if ((pxChip == &x_Accel) && (reg >= DATAX0)) {
+        if ((x_Accel.ucReg[DATA_FORMAT] & ADXL345_FULL_RES) != 0) {
+            f_lsb = 256.0f;                             // 3.9 mg / LSB at any range
+            f_limit = 512.0f * (1 << (x_Accel.ucReg[DATA_FORMAT] & 0x03));
+        } else {
+            f_lsb = (float)(256 >> (x_Accel.ucReg[DATA_FORMAT] & 0x03)); // 10 bit
+            f_limit = 512.0f;
+        }
+        p_out = &x_Accel.ucReg[DATAX0];
+        for (j = 0; j < 3; j++) {
+            i_sample = Sil_Saturate(-p_sensors->fAccel[j] * (f_lsb / SIL_GRAVITY) * iSil_Sign[j], f_limit);
+            *p_out++ = (uint8_t)i_sample;
+            *p_out++ = (uint8_t)(i_sample >> 8);
+        }
+    } else if ((pxChip == &x_Gyro) && (reg >= OUT_X_L) && (reg <= OUT_X_L + 5)) {
+        switch ((x_Gyro.ucReg[CTRL_REG4] & L3G4200_FS_MASK) >> 4) {
+            case FULLSCALE_250:
+                f_lsb = 0.00875f;                       // dps / LSB
+                break;
+            case FULLSCALE_500:
+                f_lsb = 0.0175f;
+                break;
+            default:
+                f_lsb = 0.070f;
+                break;
+        }
+        p_out = &x_Gyro.ucReg[OUT_X_L];
+        for (j = 0; j < 3; j++) {
+            i_sample = Sil_Saturate(p_sensors->fGyro[j] * (180.0f / SIL_PI) / f_lsb * iSil_Sign[j + 3],
+                                    32768.0f);
+            *p_out++ = (uint8_t)i_sample;
+            *p_out++ = (uint8_t)(i_sample >> 8);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   BMP085 temperature compensation, as in datasheet
+/// \return  B5
+/// \param   lUt, uncompensated temperature
+/// \remarks temperature is (B5 + 8) >> 4 [0.1 deg C]
+///
+///----------------------------------------------------------------------------
+static int32_t Bmp_B5(int32_t lUt)
+{
+    int32_t x1, x2;
+
+    x1 = ((lUt - (int32_t)(uint16_t)iBmp_Prom[5]) * (int32_t)(uint16_t)iBmp_Prom[4]) >> 15;
+    x2 = ((int32_t)iBmp_Prom[9] << 11) / (x1 + iBmp_Prom[10]);
+    return x1 + x2;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   BMP085 pressure compensation, as in datasheet
+/// \return  pressure [Pa]
+/// \param   lUp, uncompensated pressure
+/// \param   lB5, from temperature compensation
+/// \param   ucOss, oversampling setting
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int32_t Bmp_Pressure(int32_t lUp, int32_t lB5, uint8_t ucOss)
+{
+    int32_t x1, x2, x3, b3, b6, p;
+    uint32_t b4, b7;
+
+    b6 = lB5 - 4000;
+    x1 = (iBmp_Prom[7] * ((b6 * b6) >> 12)) >> 11;
+    x2 = (iBmp_Prom[1] * b6) >> 11;
+    x3 = x1 + x2;
+    b3 = ((((int32_t)iBmp_Prom[0] * 4 + x3) << ucOss) + 2) >> 2;
+    x1 = (iBmp_Prom[2] * b6) >> 13;
+    x2 = (iBmp_Prom[6] * ((b6 * b6) >> 12)) >> 16;
+    x3 = ((x1 + x2) + 2) >> 2;
+    b4 = ((uint32_t)(uint16_t)iBmp_Prom[3] * (uint32_t)(x3 + 32768)) >> 15;
+    b7 = (uint32_t)(lUp - b3) * (50000 >> ucOss);
+    if (b7 < 0x80000000) {
+        p = (b7 << 1) / b4;
+    } else {
+        p = (b7 / b4) << 1;
+    }
+    x1 = (p >> 8) * (p >> 8);
+    x1 = (x1 * SMD500_PARAM_MG) >> 16;
+    x2 = (p * SMD500_PARAM_MH) >> 16;
+    return p + ((x1 + x2 + SMD500_PARAM_MI) >> 4);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   BMP085 conversion, result is ready at once
+/// \return  -
+/// \param   ucControl, value written to control register
+/// \remarks Compensation is monotonic in uncompensated value: bisection
+///          finds the smallest value giving at least the sensed quantity.
+///          Temperature search starts where B5 denominator is positive.
+///
+///----------------------------------------------------------------------------
+static void Bmp_Convert(uint8_t ucControl)
+{
+    const xSil_Sensors * p_sensors = Sil_Sensors();
+    int32_t l_low, l_high, l_mid, l_target, l_b5;
+    uint8_t uc_oss;
+
+    l_target = (int32_t)floorf(p_sensors->fTemperature * 10.0f + 0.5f);
+    l_low = (uint16_t)iBmp_Prom[5];
+    l_high = 0xFFFF;
+    while (l_low < l_high) {
+        l_mid = (l_low + l_high) / 2;
+        if (((Bmp_B5(l_mid) + 8) >> 4) < l_target) {
+            l_low = l_mid + 1;
+        } else {
+            l_high = l_mid;
+        }
+    }
+    if (ucControl == BMP085_T_MEASURE) {
+        x_Baro.ucReg[BMP085_ADC_OUT_MSB_REG] = (uint8_t)(l_low >> 8);
+        x_Baro.ucReg[BMP085_ADC_OUT_LSB_REG] = (uint8_t)l_low;
+        return;
+    }
+    l_b5 = Bmp_B5(l_low);
+    uc_oss = (ucControl >> 6) & 0x03;
+    l_target = (int32_t)(SIL_SEA_LEVEL * powf(1.0f - 2.25577e-5f * p_sensors->fAltitude, 5.25588f));
+    l_low = 0;
+    l_high = (1L << (16 + uc_oss)) - 1;
+    while (l_low < l_high) {
+        l_mid = (l_low + l_high) / 2;
+        if (Bmp_Pressure(l_mid, l_b5, uc_oss) < l_target) {
+            l_low = l_mid + 1;
+        } else {
+            l_high = l_mid;
+        }
+    }
+    l_low <<= (8 - uc_oss);
+    x_Baro.ucReg[BMP085_ADC_OUT_MSB_REG] = (uint8_t)(l_low >> 16);
+    x_Baro.ucReg[BMP085_ADC_OUT_LSB_REG] = (uint8_t)(l_low >> 8);
+    x_Baro.ucReg[BMP085_ADC_OUT_LSB_REG + 1] = (uint8_t)l_low;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Reads a register
+/// \return  1 if acknowledged, 0 otherwise
+/// \param   slave, address of slave device
+/// \param   reg, register address
+/// \param   *data, pointer to destination data
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint8_t I2C_MEMS_Read_Reg(uint8_t slave, uint8_t reg, uint8_t* data)
+{
+    return I2C_MEMS_Read_Buff(slave, reg, data, 1);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Reads a buffer
+/// \return  1 if acknowledged, 0 otherwise
+/// \param   slave, address of slave device
+/// \param   reg, address of first register
+/// \param   *data, pointer to destination data
+/// \param   length, number of registers
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint8_t I2C_MEMS_Read_Buff(uint8_t slave, uint8_t reg, uint8_t* data, uint8_t length)
+{
+    xSil_Chip * p_chip = Sil_Chip(slave);
+    uint8_t uc_step = 1;
+
+    if (p_chip == NULL) {
+        return 0;
+    }
+    if (p_chip->ucIncrement != 0) {
+        uc_step = ((reg & p_chip->ucIncrement) != 0) ? 1 : 0;
+        reg &= ~p_chip->ucIncrement;
+    }
+    Sil_Sample(p_chip, reg);
+    while (length-- != 0) {
+        *data++ = p_chip->ucReg[reg];
+        reg += uc_step;
+    }
+    return 1;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Writes a register
+/// \return  1 if acknowledged, 0 otherwise
+/// \param   slave, address of slave device
+/// \param   reg, register address
+/// \param   data, data to write
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint8_t I2C_MEMS_Write_Reg(uint8_t slave, uint8_t reg, uint8_t data)
+{
+    xSil_Chip * p_chip = Sil_Chip(slave);
+
+    if (p_chip == NULL) {
+        return 0;
+    }
+    if (p_chip->ucIncrement != 0) {
+        reg &= ~p_chip->ucIncrement;
+    }
+    p_chip->ucReg[reg] = data;
+    if ((p_chip == &x_Baro) && (reg == BMP085_CTRL_MEAS_REG)) {
+        Bmp_Convert(data);
+    }
+    return 1;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Initializes chips at power on
+/// \return  -
+/// \remarks identification registers and BMP085 PROM, big endian
+///
+///----------------------------------------------------------------------------
+void I2C_MEMS_Init( void )
+{
+    uint8_t j;
+
+    x_Gyro.ucReg[WHO_AM_I] = I_AM_L3G4200D;
+    x_Accel.ucReg[DEVID] = I_AM_ADXL345;
+    x_Baro.ucReg[BMP085_CHIP_ID_REG] = BMP085_ID;
+    x_Baro.ucReg[BMP085_VERSION_REG] = BMP085_VERSION;
+    for (j = 0; j < 11; j++) {
+        x_Baro.ucReg[BMP085_PROM_START_ADDR + 2 * j] = (uint8_t)((uint16_t)iBmp_Prom[j] >> 8);
+        x_Baro.ucReg[BMP085_PROM_START_ADDR + 2 * j + 1] = (uint8_t)iBmp_Prom[j];
+    }
+}
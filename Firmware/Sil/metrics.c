@@ -0,0 +1,251 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief flight metrics, software in the loop
+///
+/// \file
+///  Scores a flight with the flight model against the mission flown by the
+///  firmware, from true position, not from what the firmware estimates:
+///  - cross track error, distance from the leg between previous and current
+///    destination of navigation, the first leg starting at launch position
+///  - altitude error, from altitude of current destination
+///  - time with aileron or elevator at the limit of its PID
+///  Errors are taken while flying, from METRICS_SETTLE after launch, so the
+///  climb out doesn't count. Report is a line of name=value pairs:
+/// \code
+///   time=600.0 flight=570.0 xtrack_rms=8.21 xtrack_max=31.70 alt_rms=6.40
+///   alt_max=18.20 sat_ail=2.1 sat_ele=0.0 wpts=9 landed=0
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "nav.h"
+#include "mission.h"
+#include "servodriver.h"
+#include "sil.h"
+#include "model.h"
+#include "metrics.h"
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+#define METRICS_EARTH       6371000.0f  //!< earth radius, as in model.c [m]
+#define METRICS_SETTLE      10.0f       //!< time from launch not scored [s]
+#define METRICS_SAT_THROW   495         //!< pulse offset of a saturated PID [us]
+#define METRICS_NO_WPT      0xFFFF      //!< no destination seen yet
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC float f_Lat0;                        //!< latitude of model origin [deg]
+VAR_STATIC float f_Lon0;                        //!< longitude of model origin [deg]
+VAR_STATIC float f_Alt0;                        //!< ground altitude of model origin [m]
+VAR_STATIC uint16_t ui_From;                    //!< start waypoint of current leg
+VAR_STATIC uint16_t ui_Dest = METRICS_NO_WPT;   //!< destination waypoint of current leg
+VAR_STATIC uint16_t ui_Wpts = 0;                //!< destinations reached
+VAR_STATIC float f_Launch = -1.0f;              //!< time of launch, < 0 before [s]
+VAR_STATIC double d_Scored = 0.0;               //!< scored time [s]
+VAR_STATIC double d_Xtrack_Sum = 0.0;           //!< integral of squared cross track error
+VAR_STATIC double d_Alt_Sum = 0.0;              //!< integral of squared altitude error
+VAR_STATIC float f_Xtrack_Max = 0.0f;           //!< max cross track error [m]
+VAR_STATIC float f_Alt_Max = 0.0f;              //!< max altitude error [m]
+VAR_STATIC double d_Sat_Ail = 0.0;              //!< time with aileron saturated [s]
+VAR_STATIC double d_Sat_Ele = 0.0;              //!< time with elevator saturated [s]
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static void Metrics_Position(uint16_t uiIndex, float * pfNorth, float * pfEast, float * pfAlt);
+static float Metrics_Leg(float fNorth, float fEast);
+static bool Metrics_Saturated(SERVO_TYPE eServo);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   position of a waypoint of the active mission
+/// \param   uiIndex = waypoint, 0 = launch position
+/// \param   pfNorth, pfEast = pointers to position from model origin [m]
+/// \param   pfAlt = pointer to altitude, NULL if not needed [m]
+/// \return  -
+/// \remarks flat earth, as model.c
+///
+///----------------------------------------------------------------------------
+static void Metrics_Position(uint16_t uiIndex, float * pfNorth, float * pfEast, float * pfAlt)
+{
+    STRUCT_WPT x_wpt;
+
+    Mission_Get(uiIndex, &x_wpt);
+    *pfNorth = ToRad(x_wpt.Lat - f_Lat0) * METRICS_EARTH;
+    *pfEast = ToRad(x_wpt.Lon - f_Lon0) * METRICS_EARTH * cosf(ToRad(f_Lat0));
+    if (pfAlt != NULL) {
+        *pfAlt = x_wpt.Alt;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   distance from current leg
+/// \param   fNorth, fEast = position from model origin [m]
+/// \return  distance from segment between leg ends [m]
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static float Metrics_Leg(float fNorth, float fEast)
+{
+    float f_n0, f_e0, f_n1, f_e1, f_dn, f_de, f_length, f_along;
+
+    Metrics_Position(ui_From, &f_n0, &f_e0, NULL);
+    Metrics_Position(ui_Dest, &f_n1, &f_e1, NULL);
+    f_dn = f_n1 - f_n0;
+    f_de = f_e1 - f_e0;
+    f_length = (f_dn * f_dn) + (f_de * f_de);
+    f_along = 0.0f;
+    if (f_length > 0.0f) {
+        f_along = (((fNorth - f_n0) * f_dn) + ((fEast - f_e0) * f_de)) / f_length;
+        f_along = fmaxf(0.0f, fminf(1.0f, f_along));
+    }
+    return hypotf(fNorth - (f_n0 + f_along * f_dn), fEast - (f_e0 + f_along * f_de));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks if a control is at the limit of its PID
+/// \param   eServo = SERVO_AILERON or SERVO_ELEVATOR
+/// \return  TRUE if saturated
+/// \remarks PID output is limited to +-500 us, see attitude.c
+///
+///----------------------------------------------------------------------------
+static bool Metrics_Saturated(SERVO_TYPE eServo)
+{
+    int16_t i_throw = (int16_t)Sil_Servo(eServo) - SERVO_NEUTRAL;
+
+    return (bool)((i_throw >= METRICS_SAT_THROW) || (i_throw <= -METRICS_SAT_THROW));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts scoring
+/// \param   fLat, fLon = origin of model [deg]
+/// \param   fAlt = ground altitude of model origin above sea level [m]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void Metrics_Init(float fLat, float fLon, float fAlt)
+{
+    f_Lat0 = fLat;
+    f_Lon0 = fLon;
+    f_Alt0 = fAlt;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   scores a time step of the flight model
+/// \param   fDt = time step [s]
+/// \return  -
+/// \remarks called after Model_Step()
+///
+///----------------------------------------------------------------------------
+void Metrics_Step(float fDt)
+{
+    const xModel_State * p_state = Model_State();
+    uint16_t ui_index = Nav_Wpt_Index();
+    float f_xtrack, f_alt;
+
+    if (ui_index != ui_Dest) {                      // new leg
+        if (ui_Dest == METRICS_NO_WPT) {
+            ui_From = 0;                            // from launch position
+        } else {
+            ui_From = ui_Dest;
+            ui_Wpts++;
+        }
+        ui_Dest = ui_index;
+    }
+    if (!p_state->bFlying) {
+        return;
+    }
+    if (f_Launch < 0.0f) {
+        f_Launch = p_state->fTime;
+    }
+    if (p_state->fTime - f_Launch < METRICS_SETTLE) {
+        return;
+    }
+
+    f_xtrack = Metrics_Leg(p_state->fPos[0], p_state->fPos[1]);
+    Metrics_Position(ui_Dest, &f_alt, &f_alt, &f_alt);
+    f_alt = fabsf((f_Alt0 - p_state->fPos[2]) - f_alt);     // destination is above sea level
+    d_Scored += fDt;
+    d_Xtrack_Sum += (double)(f_xtrack * f_xtrack) * fDt;
+    d_Alt_Sum += (double)(f_alt * f_alt) * fDt;
+    f_Xtrack_Max = fmaxf(f_Xtrack_Max, f_xtrack);
+    f_Alt_Max = fmaxf(f_Alt_Max, f_alt);
+    if (Metrics_Saturated(SERVO_AILERON)) {
+        d_Sat_Ail += fDt;
+    }
+    if (Metrics_Saturated(SERVO_ELEVATOR)) {
+        d_Sat_Ele += fDt;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes report
+/// \param   pxFile = stream
+/// \return  -
+/// \remarks errors are 0 if nothing was scored
+///
+///----------------------------------------------------------------------------
+void Metrics_Report(FILE * pxFile)
+{
+    const xModel_State * p_state = Model_State();
+    double d_time = (d_Scored > 0.0) ? d_Scored : 1.0;
+
+    fprintf(pxFile, "time=%.1f flight=%.1f xtrack_rms=%.2f xtrack_max=%.2f alt_rms=%.2f "
+            "alt_max=%.2f sat_ail=%.1f sat_ele=%.1f wpts=%u landed=%u\n",
+            (double)p_state->fTime, d_Scored, sqrt(d_Xtrack_Sum / d_time),
+            (double)f_Xtrack_Max, sqrt(d_Alt_Sum / d_time), (double)f_Alt_Max,
+            d_Sat_Ail, d_Sat_Ele, ui_Wpts, p_state->bLanded ? 1U : 0U);
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -5,11 +5,11 @@
 // $Date:  $
 // $Author: $
 //
-/// \brief global variables
+/// \brief flight metrics header file
 ///
 /// \file
 ///
-// Changes
+//  Change
 //
 //============================================================================*/
 
@@ -24,12 +24,14 @@
 
 /*-------------------------------- Enumerations ------------------------------*/
 
-/*------------------------------------ Types ---------------------------------*/
+/*----------------------------------- Types ----------------------------------*/
 
 /*---------------------------------- Constants -------------------------------*/
 
 /*----------------------------------- Globals --------------------------------*/
 
-VAR_GLOBAL FATFS st_Fat;    //!< FAT object
-VAR_GLOBAL FIL st_File;     //!< file object
-VAR_GLOBAL bool b_FS_Ok;    //!< file system status
+/*---------------------------------- Interface -------------------------------*/
+
+void Metrics_Init(float fLat, float fLon, float fAlt);
+void Metrics_Step(float fDt);
+void Metrics_Report(FILE * pxFile);
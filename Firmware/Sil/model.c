@@ -0,0 +1,749 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief fixed wing flight dynamics model, software in the loop
+///
+/// \file
+///  Six degrees of freedom rigid body in body axes, attitude as quaternion,
+///  flat earth, standard air at sea level. Aerodynamics are linear
+///  stability and control derivatives, with lift and drag blended into
+///  flat plate values past the stall angle. Propeller thrust goes with the
+///  square of throttle and fades to zero at the pitch speed of propeller.
+///  Control surfaces follow commands with a first order servo lag.
+///  Coefficients of airframes of config.h are estimates from size and
+///  weight, with typical derivatives of small model aircraft: the model is
+///  meant for closed loop testing of firmware, not for handling qualities.
+///  - EASYSTAR: 3 axis
+///  - TYCHO: aileron command drives the rudder, roll comes from dihedral
+///  - LEUKO: flying wing, elevons mixed from aileron and elevator commands
+///  - EPPFPV: 3 axis
+///  The aircraft is held still at launch height until launch time, then
+///  thrown level along launch heading. It stays where it touches ground.
+///  Wind is steady plus Gauss-Markov turbulence. Sensors add white noise,
+///  a constant gyro bias, and a slowly wandering GPS position error. Noise
+///  and turbulence come from a seeded generator, so runs are repeatable.
+///  Integration is semi-implicit Euler, at the tick period of 1 ms.
+///
+//  Change
+//
+//============================================================================*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "model.h"
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+#define MODEL_GRAVITY       9.80665f    //!< standard gravity [m/s^2]
+#define MODEL_RHO           1.225f      //!< air density at sea level [kg/m^3]
+#define MODEL_EARTH         6371000.0f  //!< earth radius [m]
+#define MODEL_KNOTS         1.943844f   //!< knots per m/s
+#define MODEL_DEFLECTION    0.35f       //!< surface deflection at full command [rad]
+#define MODEL_SERVO_TAU     0.05f       //!< servo time constant [s]
+#define MODEL_STALL_RATE    50.0f       //!< sharpness of stall transition [1/rad]
+#define MODEL_THROW_PITCH   0.087f      //!< pitch at launch [rad]
+#define MODEL_MIN_AIRSPEED  1.0f        //!< below, no angle of attack nor sideslip [m/s]
+#define MODEL_GUST_TAU      2.0f        //!< correlation time of turbulence [s]
+#define MODEL_ACCEL_NOISE   0.08f       //!< accelerometer noise [m/s^2]
+#define MODEL_GYRO_NOISE    0.003f      //!< gyro noise [rad/s]
+#define MODEL_GYRO_BIAS     0.01f       //!< gyro bias standard deviation [rad/s]
+#define MODEL_BARO_NOISE    0.25f       //!< barometric altitude noise [m]
+#define MODEL_GPS_ERROR     1.5f        //!< GPS position error [m]
+#define MODEL_GPS_TAU       30.0f       //!< correlation time of GPS position error [s]
+#define MODEL_GPS_SPEED     0.1f        //!< GPS speed noise [m/s]
+#define MODEL_UTC           43200.0f    //!< UTC at start, noon [s]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define SQR(x)  ((x) * (x))
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// airframe, coefficients referred to wing area, span and chord
+typedef struct {
+    const char * pcName;            ///< name for messages
+    float fMass;                    ///< take off weight [kg]
+    float fSpan;                    ///< wing span [m]
+    float fChord;                   ///< mean chord [m]
+    float fArea;                    ///< wing area [m^2]
+    float fInertia[3];              ///< moments of inertia about x, y, z [kg m^2]
+    float fThrust;                  ///< static thrust at full throttle [N]
+    float fPitch_Speed;             ///< speed of zero thrust [m/s]
+    float fLaunch;                  ///< launch speed [m/s]
+    float fAlpha_Stall;             ///< stall angle [rad]
+    float fOswald;                  ///< span efficiency
+    float fCL0, fCL_alpha, fCL_q, fCL_de;
+    float fCD0;
+    float fCY_beta, fCY_da, fCY_dr;
+    float fCl_beta, fCl_p, fCl_r, fCl_da, fCl_dr;
+    float fCm0, fCm_alpha, fCm_q, fCm_de;
+    float fCn_beta, fCn_p, fCn_r, fCn_da, fCn_dr;
+} xModel_Airframe;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// airframes, indexed by model number of config.h
+VAR_STATIC const xModel_Airframe x_Airframes[] = {
+    [EASYSTAR] = {
+        .pcName = "EASYSTAR", .fMass = 0.70f, .fSpan = 1.37f, .fChord = 0.18f, .fArea = 0.24f,
+        .fInertia = { 0.045f, 0.035f, 0.075f },
+        .fThrust = 5.0f, .fPitch_Speed = 22.0f, .fLaunch = 9.0f, .fAlpha_Stall = 0.26f, .fOswald = 0.75f,
+        .fCL0 = 0.28f, .fCL_alpha = 4.8f, .fCL_q = 5.0f, .fCL_de = -0.15f,
+        .fCD0 = 0.035f,
+        .fCY_beta = -0.5f, .fCY_da = 0.0f, .fCY_dr = -0.12f,
+        .fCl_beta = -0.08f, .fCl_p = -0.45f, .fCl_r = 0.12f, .fCl_da = 0.14f, .fCl_dr = -0.005f,
+        .fCm0 = 0.02f, .fCm_alpha = -0.55f, .fCm_q = -11.0f, .fCm_de = 0.7f,
+        .fCn_beta = 0.07f, .fCn_p = -0.04f, .fCn_r = -0.10f, .fCn_da = -0.01f, .fCn_dr = 0.05f
+    },
+    [TYCHO] = {
+        .pcName = "TYCHO", .fMass = 0.90f, .fSpan = 1.60f, .fChord = 0.20f, .fArea = 0.32f,
+        .fInertia = { 0.070f, 0.040f, 0.100f },
+        .fThrust = 6.0f, .fPitch_Speed = 24.0f, .fLaunch = 9.5f, .fAlpha_Stall = 0.24f, .fOswald = 0.80f,
+        .fCL0 = 0.30f, .fCL_alpha = 5.0f, .fCL_q = 5.5f, .fCL_de = -0.14f,
+        .fCD0 = 0.030f,
+        .fCY_beta = -0.55f, .fCY_da = -0.12f, .fCY_dr = 0.0f,
+        .fCl_beta = -0.14f, .fCl_p = -0.50f, .fCl_r = 0.14f, .fCl_da = -0.005f, .fCl_dr = 0.0f,
+        .fCm0 = 0.02f, .fCm_alpha = -0.6f, .fCm_q = -12.0f, .fCm_de = 0.7f,
+        .fCn_beta = 0.08f, .fCn_p = -0.05f, .fCn_r = -0.11f, .fCn_da = 0.06f, .fCn_dr = 0.0f
+    },
+    [LEUKO] = {
+        .pcName = "LEUKO", .fMass = 0.60f, .fSpan = 1.20f, .fChord = 0.22f, .fArea = 0.26f,
+        .fInertia = { 0.030f, 0.020f, 0.050f },
+        .fThrust = 5.5f, .fPitch_Speed = 28.0f, .fLaunch = 10.0f, .fAlpha_Stall = 0.22f, .fOswald = 0.85f,
+        .fCL0 = 0.05f, .fCL_alpha = 4.2f, .fCL_q = 2.5f, .fCL_de = -0.25f,
+        .fCD0 = 0.025f,
+        .fCY_beta = -0.3f, .fCY_da = 0.0f, .fCY_dr = 0.0f,
+        .fCl_beta = -0.06f, .fCl_p = -0.40f, .fCl_r = 0.10f, .fCl_da = 0.20f, .fCl_dr = 0.0f,
+        .fCm0 = 0.01f, .fCm_alpha = -0.25f, .fCm_q = -3.0f, .fCm_de = 0.45f,
+        .fCn_beta = 0.03f, .fCn_p = -0.02f, .fCn_r = -0.04f, .fCn_da = -0.005f, .fCn_dr = 0.0f
+    },
+    [EPPFPV] = {
+        .pcName = "EPPFPV", .fMass = 1.00f, .fSpan = 1.80f, .fChord = 0.24f, .fArea = 0.42f,
+        .fInertia = { 0.090f, 0.050f, 0.130f },
+        .fThrust = 8.0f, .fPitch_Speed = 24.0f, .fLaunch = 9.0f, .fAlpha_Stall = 0.26f, .fOswald = 0.75f,
+        .fCL0 = 0.30f, .fCL_alpha = 5.0f, .fCL_q = 5.5f, .fCL_de = -0.14f,
+        .fCD0 = 0.040f,
+        .fCY_beta = -0.5f, .fCY_da = 0.0f, .fCY_dr = -0.12f,
+        .fCl_beta = -0.07f, .fCl_p = -0.48f, .fCl_r = 0.12f, .fCl_da = 0.15f, .fCl_dr = -0.005f,
+        .fCm0 = 0.02f, .fCm_alpha = -0.55f, .fCm_q = -11.0f, .fCm_de = 0.7f,
+        .fCn_beta = 0.07f, .fCn_p = -0.04f, .fCn_r = -0.10f, .fCn_da = -0.01f, .fCn_dr = 0.05f
+    }
+};
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC const xModel_Airframe * px_Air = &x_Airframes[MODEL];    //!< current airframe
+VAR_STATIC xModel_Options x_Options;            //!< flight conditions
+VAR_STATIC xModel_State x_State;                //!< true state
+VAR_STATIC double d_Time;                       //!< time since start, exact over hours [s]
+VAR_STATIC float f_Quat[4];                     //!< attitude, body to north-east-down
+VAR_STATIC float f_Dcm[3][3];                   //!< rotation matrix of attitude
+VAR_STATIC float f_Body_Vel[3];                 //!< ground speed in body axes [m/s]
+VAR_STATIC float f_Surface[MODEL_CONTROLS];     //!< control positions
+VAR_STATIC float f_Gust[3];                     //!< turbulence north, east, down [m/s]
+VAR_STATIC float f_Gyro_Bias[3];                //!< gyro bias [rad/s]
+VAR_STATIC float f_Gps_Error[2];                //!< GPS error north, east [m]
+VAR_STATIC uint64_t ull_Random;                 //!< state of random generator
+VAR_STATIC float f_Spare;                       //!< second normal deviate
+VAR_STATIC bool b_Spare;                        //!< second normal deviate available
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static float Model_Uniform(void);
+static float Model_Gauss(void);
+static void Model_Rotation(void);
+static void Model_Euler(float fRoll, float fPitch, float fYaw);
+static void Model_Hold(void);
+static void Model_Launch(void);
+static void Model_Wind(float fDt, float * pfWind);
+static float Model_Blend(float fAlpha);
+static void Model_Aero(const float * pfAir, float * pfForce, float * pfMoment);
+static void Model_Ground(void);
+static uint8_t Model_Checksum(const char * pcSentence);
+static void Model_Coord(char * pcField, float fDeg, uint8_t ucDigits);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   uniform random number
+/// \return  number in [0, 1)
+/// \remarks xorshift64*, 24 bit mantissa
+///
+///----------------------------------------------------------------------------
+static float Model_Uniform(void)
+{
+    ull_Random ^= ull_Random >> 12;
+    ull_Random ^= ull_Random << 25;
+    ull_Random ^= ull_Random >> 27;
+    return (float)((ull_Random * 2685821657736338717ULL) >> 40) / 16777216.0f;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   normal random number
+/// \return  number with zero mean and unit standard deviation
+/// \remarks Box-Muller, deviates are generated in pairs
+///
+///----------------------------------------------------------------------------
+static float Model_Gauss(void)
+{
+    float f_radius, f_angle;
+
+    if (b_Spare) {
+        b_Spare = FALSE;
+        return f_Spare;
+    }
+    f_radius = sqrtf(-2.0f * logf(1.0f - Model_Uniform()));
+    f_angle = 2.0f * PI * Model_Uniform();
+    f_Spare = f_radius * sinf(f_angle);
+    b_Spare = TRUE;
+    return f_radius * cosf(f_angle);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   updates rotation matrix and Euler angles from quaternion
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Model_Rotation(void)
+{
+    float w = f_Quat[0], x = f_Quat[1], y = f_Quat[2], z = f_Quat[3];
+
+    f_Dcm[0][0] = 1.0f - 2.0f * (y * y + z * z);
+    f_Dcm[0][1] = 2.0f * (x * y - w * z);
+    f_Dcm[0][2] = 2.0f * (x * z + w * y);
+    f_Dcm[1][0] = 2.0f * (x * y + w * z);
+    f_Dcm[1][1] = 1.0f - 2.0f * (x * x + z * z);
+    f_Dcm[1][2] = 2.0f * (y * z - w * x);
+    f_Dcm[2][0] = 2.0f * (x * z - w * y);
+    f_Dcm[2][1] = 2.0f * (y * z + w * x);
+    f_Dcm[2][2] = 1.0f - 2.0f * (x * x + y * y);
+
+    x_State.fEuler[0] = atan2f(f_Dcm[2][1], f_Dcm[2][2]);
+    x_State.fEuler[1] = -asinf(fmaxf(-1.0f, fminf(1.0f, f_Dcm[2][0])));
+    x_State.fEuler[2] = atan2f(f_Dcm[1][0], f_Dcm[0][0]);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets attitude
+/// \param   fRoll, fPitch, fYaw = Euler angles [rad]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Model_Euler(float fRoll, float fPitch, float fYaw)
+{
+    float cr = cosf(fRoll / 2.0f), sr = sinf(fRoll / 2.0f);
+    float cp = cosf(fPitch / 2.0f), sp = sinf(fPitch / 2.0f);
+    float cy = cosf(fYaw / 2.0f), sy = sinf(fYaw / 2.0f);
+
+    f_Quat[0] = cr * cp * cy + sr * sp * sy;
+    f_Quat[1] = sr * cp * cy - cr * sp * sy;
+    f_Quat[2] = cr * sp * cy + sr * cp * sy;
+    f_Quat[3] = cr * cp * sy - sr * sp * cy;
+    Model_Rotation();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   holds aircraft still
+/// \return  -
+/// \remarks accelerometers sense the reaction to gravity only
+///
+///----------------------------------------------------------------------------
+static void Model_Hold(void)
+{
+    uint8_t j;
+
+    for (j = 0; j < 3; j++) {
+        f_Body_Vel[j] = 0.0f;
+        x_State.fVel[j] = 0.0f;
+        x_State.fRate[j] = 0.0f;
+        x_State.fAccel[j] = -MODEL_GRAVITY * f_Dcm[2][j];
+    }
+    x_State.fAirspeed = 0.0f;
+    x_State.fAlpha = 0.0f;
+    x_State.fBeta = 0.0f;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   throws aircraft
+/// \return  -
+/// \remarks slightly nose up, at launch speed relative to ground
+///
+///----------------------------------------------------------------------------
+static void Model_Launch(void)
+{
+    Model_Euler(0.0f, MODEL_THROW_PITCH, ToRad(x_Options.fHeading));
+    f_Body_Vel[0] = px_Air->fLaunch;
+    f_Body_Vel[1] = 0.0f;
+    f_Body_Vel[2] = 0.0f;
+    x_State.bFlying = TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   wind
+/// \param   fDt = time step [s]
+/// \param   pfWind = pointer to wind velocity north, east, down [m/s]
+/// \return  -
+/// \remarks first order Gauss-Markov turbulence on each axis
+///
+///----------------------------------------------------------------------------
+static void Model_Wind(float fDt, float * pfWind)
+{
+    float f_from = ToRad(x_Options.fWind_Dir);
+    float f_drive = x_Options.fGust * sqrtf(2.0f * fDt / MODEL_GUST_TAU);
+    uint8_t j;
+
+    for (j = 0; j < 3; j++) {
+        f_Gust[j] += (-f_Gust[j] * fDt / MODEL_GUST_TAU) + (f_drive * Model_Gauss());
+    }
+    pfWind[0] = -x_Options.fWind * cosf(f_from) + f_Gust[0];
+    pfWind[1] = -x_Options.fWind * sinf(f_from) + f_Gust[1];
+    pfWind[2] = f_Gust[2];
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   weight of flat plate aerodynamics
+/// \param   fAlpha = angle of attack [rad]
+/// \return  0 below stall, 1 well past stall, both ways
+/// \remarks sigmoid of Beard and McLain, "Small Unmanned Aircraft"
+///
+///----------------------------------------------------------------------------
+static float Model_Blend(float fAlpha)
+{
+    float f_minus = expf(fminf(-MODEL_STALL_RATE * (fAlpha - px_Air->fAlpha_Stall), 50.0f));
+    float f_plus = expf(fminf(MODEL_STALL_RATE * (fAlpha + px_Air->fAlpha_Stall), 50.0f));
+
+    return (1.0f + f_minus + f_plus) / ((1.0f + f_minus) * (1.0f + f_plus));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   aerodynamic and propeller forces and moments
+/// \param   pfAir = pointer to air speed in body axes [m/s]
+/// \param   pfForce = pointer to force in body axes [N]
+/// \param   pfMoment = pointer to moment about body axes [N m]
+/// \return  -
+/// \remarks also updates airspeed, angle of attack and sideslip of state
+///
+///----------------------------------------------------------------------------
+static void Model_Aero(const float * pfAir, float * pfForce, float * pfMoment)
+{
+    const xModel_Airframe * p_air = px_Air;
+    float f_speed, f_alpha, f_beta, f_qs, f_sigma, f_cl_lin, f_cl, f_cd, f_cy;
+    float f_p, f_q, f_r, f_thrust;
+    float f_da = f_Surface[MODEL_AILERON] * MODEL_DEFLECTION;
+    float f_de = f_Surface[MODEL_ELEVATOR] * MODEL_DEFLECTION;
+    float f_dr = f_Surface[MODEL_RUDDER] * MODEL_DEFLECTION;
+
+    f_speed = sqrtf(SQR(pfAir[0]) + SQR(pfAir[1]) + SQR(pfAir[2]));
+    if (f_speed > MODEL_MIN_AIRSPEED) {
+        f_alpha = atan2f(pfAir[2], pfAir[0]);
+        f_beta = asinf(pfAir[1] / f_speed);
+        f_p = x_State.fRate[0] * p_air->fSpan / (2.0f * f_speed);   // normalized rates
+        f_q = x_State.fRate[1] * p_air->fChord / (2.0f * f_speed);
+        f_r = x_State.fRate[2] * p_air->fSpan / (2.0f * f_speed);
+    } else {
+        f_alpha = f_beta = f_p = f_q = f_r = 0.0f;
+    }
+    x_State.fAirspeed = f_speed;
+    x_State.fAlpha = f_alpha;
+    x_State.fBeta = f_beta;
+
+    /* lift and drag, blended into flat plate past stall */
+    f_sigma = Model_Blend(f_alpha);
+    f_cl_lin = p_air->fCL0 + p_air->fCL_alpha * f_alpha;
+    f_cl = ((1.0f - f_sigma) * f_cl_lin) +
+           (f_sigma * 2.0f * copysignf(1.0f, f_alpha) * SQR(sinf(f_alpha)) * cosf(f_alpha)) +
+           (p_air->fCL_q * f_q) + (p_air->fCL_de * f_de);
+    f_cd = ((1.0f - f_sigma) * (p_air->fCD0 + (SQR(f_cl_lin) * p_air->fArea) /
+                               (PI * p_air->fOswald * SQR(p_air->fSpan)))) +
+           (f_sigma * 2.0f * SQR(sinf(f_alpha)));
+    f_cy = (p_air->fCY_beta * f_beta) + (p_air->fCY_da * f_da) + (p_air->fCY_dr * f_dr);
+
+    f_qs = 0.5f * MODEL_RHO * SQR(f_speed) * p_air->fArea;
+    pfForce[0] = f_qs * ((-f_cd * cosf(f_alpha)) + (f_cl * sinf(f_alpha)));
+    pfForce[1] = f_qs * f_cy;
+    pfForce[2] = f_qs * ((-f_cd * sinf(f_alpha)) - (f_cl * cosf(f_alpha)));
+
+    pfMoment[0] = f_qs * p_air->fSpan * ((p_air->fCl_beta * f_beta) + (p_air->fCl_p * f_p) +
+                  (p_air->fCl_r * f_r) + (p_air->fCl_da * f_da) + (p_air->fCl_dr * f_dr));
+    pfMoment[1] = f_qs * p_air->fChord * (p_air->fCm0 + (p_air->fCm_alpha * f_alpha) +
+                  (p_air->fCm_q * f_q) + (p_air->fCm_de * f_de));
+    pfMoment[2] = f_qs * p_air->fSpan * ((p_air->fCn_beta * f_beta) + (p_air->fCn_p * f_p) +
+                  (p_air->fCn_r * f_r) + (p_air->fCn_da * f_da) + (p_air->fCn_dr * f_dr));
+
+    /* propeller along x axis */
+    f_thrust = p_air->fThrust * SQR(f_Surface[MODEL_THROTTLE]) *
+               (1.0f - (pfAir[0] / p_air->fPitch_Speed));
+    pfForce[0] += fmaxf(f_thrust, 0.0f);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   stops aircraft on ground
+/// \return  -
+/// \remarks wings levelled, heading kept
+///
+///----------------------------------------------------------------------------
+static void Model_Ground(void)
+{
+    x_State.fPos[2] = 0.0f;
+    x_State.bFlying = FALSE;
+    x_State.bLanded = TRUE;
+    Model_Euler(0.0f, 0.0f, x_State.fEuler[2]);
+    Model_Hold();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   default flight conditions
+/// \param   pxOptions = pointer to conditions
+/// \return  -
+/// \remarks airframe of config.h, calm air, nominal sensors, hand launch
+///          after 20 s, time enough for sensor calibration
+///
+///----------------------------------------------------------------------------
+void Model_Defaults(xModel_Options * pxOptions)
+{
+    memset(pxOptions, 0, sizeof(xModel_Options));
+    pxOptions->ucAirframe = MODEL;
+    pxOptions->ulSeed = 1;
+    pxOptions->fNoise = 1.0f;
+    pxOptions->fLat = 45.4642f;
+    pxOptions->fLon = 9.1900f;
+    pxOptions->fAlt = 120.0f;
+    pxOptions->fHeight = 1.5f;
+    pxOptions->fLaunch = 20.0f;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts model
+/// \param   pxOptions = pointer to flight conditions
+/// \return  -
+/// \remarks unknown airframe is replaced by the one of config.h
+///
+///----------------------------------------------------------------------------
+void Model_Init(const xModel_Options * pxOptions)
+{
+    uint8_t j;
+
+    x_Options = *pxOptions;
+    if ((x_Options.ucAirframe >= (sizeof(x_Airframes) / sizeof(x_Airframes[0]))) ||
+        (x_Airframes[x_Options.ucAirframe].pcName == NULL)) {
+        x_Options.ucAirframe = MODEL;
+    }
+    px_Air = &x_Airframes[x_Options.ucAirframe];
+
+    ull_Random = ((uint64_t)x_Options.ulSeed * 0x9E3779B97F4A7C15ULL) | 1ULL;
+    b_Spare = FALSE;
+
+    memset(&x_State, 0, sizeof(x_State));
+    d_Time = 0.0;
+    x_State.fPos[2] = -x_Options.fHeight;
+    Model_Euler(0.0f, 0.0f, ToRad(x_Options.fHeading));
+    Model_Hold();
+    for (j = 0; j < MODEL_CONTROLS; j++) {
+        f_Surface[j] = 0.0f;
+    }
+    for (j = 0; j < 3; j++) {
+        f_Gust[j] = 0.0f;
+        f_Gyro_Bias[j] = x_Options.fNoise * MODEL_GYRO_BIAS * Model_Gauss();
+    }
+    for (j = 0; j < 2; j++) {
+        f_Gps_Error[j] = x_Options.fNoise * MODEL_GPS_ERROR * Model_Gauss();
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   advances model by a time step
+/// \param   pfControl = pointer to MODEL_CONTROLS commands
+/// \param   fDt = time step [s]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void Model_Step(const float * pfControl, float fDt)
+{
+    float f_wind[3], f_air[3], f_force[3], f_moment[3], f_accel[3];
+    float f_rate[3], f_dq[4];
+    const float * p_inertia = px_Air->fInertia;
+    float f_lag = fDt / (MODEL_SERVO_TAU + fDt);
+    float f_norm, f_drive;
+    uint8_t j;
+
+    d_Time += fDt;
+    x_State.fTime = (float)d_Time;
+
+    /* servos */
+    for (j = 0; j < MODEL_CONTROLS; j++) {
+        f_Surface[j] += (fmaxf(-1.0f, fminf(1.0f, pfControl[j])) - f_Surface[j]) * f_lag;
+    }
+    f_Surface[MODEL_THROTTLE] = fmaxf(f_Surface[MODEL_THROTTLE], 0.0f);
+
+    /* GPS error wanders */
+    f_drive = x_Options.fNoise * MODEL_GPS_ERROR * sqrtf(2.0f * fDt / MODEL_GPS_TAU);
+    for (j = 0; j < 2; j++) {
+        f_Gps_Error[j] += (-f_Gps_Error[j] * fDt / MODEL_GPS_TAU) + (f_drive * Model_Gauss());
+    }
+
+    /* held in hand or stopped on ground */
+    if (!x_State.bFlying) {
+        if (x_State.bLanded || (x_State.fTime < x_Options.fLaunch)) {
+            return;
+        }
+        Model_Launch();
+    }
+
+    /* air speed in body axes */
+    Model_Wind(fDt, f_wind);
+    for (j = 0; j < 3; j++) {
+        f_air[j] = f_Body_Vel[j] - (f_Dcm[0][j] * f_wind[0] + f_Dcm[1][j] * f_wind[1] +
+                                    f_Dcm[2][j] * f_wind[2]);
+    }
+    Model_Aero(f_air, f_force, f_moment);
+
+    /* rates: Euler equations, principal axes */
+    f_rate[0] = x_State.fRate[0];
+    f_rate[1] = x_State.fRate[1];
+    f_rate[2] = x_State.fRate[2];
+    x_State.fRate[0] += fDt * (f_moment[0] - (p_inertia[2] - p_inertia[1]) * f_rate[1] * f_rate[2]) / p_inertia[0];
+    x_State.fRate[1] += fDt * (f_moment[1] - (p_inertia[0] - p_inertia[2]) * f_rate[2] * f_rate[0]) / p_inertia[1];
+    x_State.fRate[2] += fDt * (f_moment[2] - (p_inertia[1] - p_inertia[0]) * f_rate[0] * f_rate[1]) / p_inertia[2];
+
+    /* speed: specific force, gravity and transport */
+    for (j = 0; j < 3; j++) {
+        f_accel[j] = f_force[j] / px_Air->fMass;
+        x_State.fAccel[j] = f_accel[j];
+        f_accel[j] += MODEL_GRAVITY * f_Dcm[2][j];
+    }
+    f_accel[0] -= (f_rate[1] * f_Body_Vel[2]) - (f_rate[2] * f_Body_Vel[1]);
+    f_accel[1] -= (f_rate[2] * f_Body_Vel[0]) - (f_rate[0] * f_Body_Vel[2]);
+    f_accel[2] -= (f_rate[0] * f_Body_Vel[1]) - (f_rate[1] * f_Body_Vel[0]);
+    for (j = 0; j < 3; j++) {
+        f_Body_Vel[j] += f_accel[j] * fDt;
+    }
+
+    /* attitude, with updated rates */
+    f_rate[0] = x_State.fRate[0] * fDt / 2.0f;
+    f_rate[1] = x_State.fRate[1] * fDt / 2.0f;
+    f_rate[2] = x_State.fRate[2] * fDt / 2.0f;
+    f_dq[0] = -f_Quat[1] * f_rate[0] - f_Quat[2] * f_rate[1] - f_Quat[3] * f_rate[2];
+    f_dq[1] =  f_Quat[0] * f_rate[0] + f_Quat[2] * f_rate[2] - f_Quat[3] * f_rate[1];
+    f_dq[2] =  f_Quat[0] * f_rate[1] - f_Quat[1] * f_rate[2] + f_Quat[3] * f_rate[0];
+    f_dq[3] =  f_Quat[0] * f_rate[2] + f_Quat[1] * f_rate[1] - f_Quat[2] * f_rate[0];
+    f_norm = 0.0f;
+    for (j = 0; j < 4; j++) {
+        f_Quat[j] += f_dq[j];
+        f_norm += SQR(f_Quat[j]);
+    }
+    f_norm = 1.0f / sqrtf(f_norm);
+    for (j = 0; j < 4; j++) {
+        f_Quat[j] *= f_norm;
+    }
+    Model_Rotation();
+
+    /* position */
+    for (j = 0; j < 3; j++) {
+        x_State.fVel[j] = f_Dcm[j][0] * f_Body_Vel[0] + f_Dcm[j][1] * f_Body_Vel[1] +
+                          f_Dcm[j][2] * f_Body_Vel[2];
+        x_State.fPos[j] += x_State.fVel[j] * fDt;
+    }
+    if (x_State.fPos[2] > 0.0f) {
+        Model_Ground();
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   true state
+/// \return  pointer to state
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const xModel_State * Model_State(void)
+{
+    return &x_State;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   name of airframe
+/// \return  name
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const char * Model_Airframe(void)
+{
+    return px_Air->pcName;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   inertial sensor sample
+/// \param   pfAccel = pointer to specific force x, y, z in body axes [m/s^2]
+/// \param   pfGyro = pointer to rates x, y, z in body axes [rad/s]
+/// \return  -
+/// \remarks same convention as Sil_Set_Imu()
+///
+///----------------------------------------------------------------------------
+void Model_Imu(float * pfAccel, float * pfGyro)
+{
+    uint8_t j;
+
+    for (j = 0; j < 3; j++) {
+        pfAccel[j] = x_State.fAccel[j] + (x_Options.fNoise * MODEL_ACCEL_NOISE * Model_Gauss());
+        pfGyro[j] = x_State.fRate[j] + f_Gyro_Bias[j] +
+                    (x_Options.fNoise * MODEL_GYRO_NOISE * Model_Gauss());
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   barometric altitude sample
+/// \return  altitude above sea level [m]
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+float Model_Baro(void)
+{
+    return x_Options.fAlt - x_State.fPos[2] + (x_Options.fNoise * MODEL_BARO_NOISE * Model_Gauss());
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   NMEA checksum
+/// \param   pcSentence = sentence from $ to *
+/// \return  exclusive or of characters between $ and *
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint8_t Model_Checksum(const char * pcSentence)
+{
+    uint8_t uc_sum = 0;
+
+    for (pcSentence++; (*pcSentence != '*') && (*pcSentence != 0); pcSentence++) {
+        uc_sum ^= (uint8_t)*pcSentence;
+    }
+    return uc_sum;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   NMEA coordinate
+/// \param   pcField = pointer to field, 16 characters
+/// \param   fDeg = coordinate [deg]
+/// \param   ucDigits = digits of degrees, 2 for latitude, 3 for longitude
+/// \return  -
+/// \remarks degrees and minutes with 5 decimals, without sign
+///
+///----------------------------------------------------------------------------
+static void Model_Coord(char * pcField, float fDeg, uint8_t ucDigits)
+{
+    uint32_t ul_minutes = (uint32_t)lround(fabs((double)fDeg) * 60.0 * 100000.0);
+
+    snprintf(pcField, 16, "%0*u%02u.%05u", ucDigits, (unsigned)(ul_minutes / 6000000UL),
+             (unsigned)((ul_minutes / 100000UL) % 60UL), (unsigned)(ul_minutes % 100000UL));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   GPS fix
+/// \param   pcBuffer = pointer to buffer, MODEL_NMEA_SIZE characters
+/// \return  length of GPGGA and GPRMC sentences
+/// \remarks GPGGA first, so altitude is updated when the firmware completes
+///          the fix with GPRMC. Coordinates have 5 decimals of minutes,
+///          speed and course 1 decimal, as expected by the parser of nav.c.
+///
+///----------------------------------------------------------------------------
+uint16_t Model_Nmea(char * pcBuffer)
+{
+    char c_lat[16], c_lon[16], c_time[16];
+    double d_lat, d_lon;
+    float f_north, f_east, f_speed, f_course;
+    uint32_t ul_time;
+    int i_length, i_rmc;
+
+    d_lat = (double)x_Options.fLat +
+            ((double)(x_State.fPos[0] + f_Gps_Error[0]) / MODEL_EARTH) * (180.0 / PI);
+    d_lon = (double)x_Options.fLon +
+            ((double)(x_State.fPos[1] + f_Gps_Error[1]) / (MODEL_EARTH * cos(ToRad(x_Options.fLat)))) * (180.0 / PI);
+    Model_Coord(c_lat, (float)d_lat, 2);
+    Model_Coord(c_lon, (float)d_lon, 3);
+
+    f_north = x_State.fVel[0] + (x_Options.fNoise * MODEL_GPS_SPEED * Model_Gauss());
+    f_east = x_State.fVel[1] + (x_Options.fNoise * MODEL_GPS_SPEED * Model_Gauss());
+    f_speed = sqrtf(SQR(f_north) + SQR(f_east)) * MODEL_KNOTS;
+    f_course = ToDeg(atan2f(f_east, f_north));
+    if (f_course < 0.0f) {
+        f_course += 360.0f;
+    }
+    if (f_course >= 359.95f) {
+        f_course = 0.0f;
+    }
+
+    ul_time = (uint32_t)lround((MODEL_UTC + d_Time) * 100.0) % 8640000UL;
+    snprintf(c_time, sizeof(c_time), "%02u%02u%02u.%02u", (unsigned)(ul_time / 360000UL),
+             (unsigned)((ul_time / 6000UL) % 60UL), (unsigned)((ul_time / 100UL) % 60UL),
+             (unsigned)(ul_time % 100UL));
+
+    i_length = snprintf(pcBuffer, MODEL_NMEA_SIZE, "$GPGGA,%s,%s,%c,%s,%c,1,08,1.0,%.1f,M,0.0,M,,*",
+                        c_time, c_lat, (d_lat < 0.0) ? 'S' : 'N', c_lon, (d_lon < 0.0) ? 'W' : 'E',
+                        (double)(x_Options.fAlt - x_State.fPos[2]));
+    i_length += snprintf(&pcBuffer[i_length], MODEL_NMEA_SIZE - i_length, "%02X\r\n",
+                         Model_Checksum(pcBuffer));
+    i_rmc = i_length;
+    i_length += snprintf(&pcBuffer[i_length], MODEL_NMEA_SIZE - i_length,
+                         "$GPRMC,%s,A,%s,%c,%s,%c,%.1f,%.1f,010112,,,A*",
+                         c_time, c_lat, (d_lat < 0.0) ? 'S' : 'N', c_lon, (d_lon < 0.0) ? 'W' : 'E',
+                         (double)f_speed, (double)f_course);
+    i_length += snprintf(&pcBuffer[i_length], MODEL_NMEA_SIZE - i_length, "%02X\r\n",
+                         Model_Checksum(&pcBuffer[i_rmc]));
+    return (uint16_t)i_length;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,84 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief flight dynamics model header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define MODEL_NMEA_SIZE 192         //!< max length of the NMEA sentences of a fix
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/// control inputs
+typedef enum {
+    MODEL_AILERON,                  ///< roll right when positive [-1, 1]
+    MODEL_ELEVATOR,                 ///< pitch up when positive [-1, 1]
+    MODEL_RUDDER,                   ///< yaw right when positive [-1, 1]
+    MODEL_THROTTLE,                 ///< motor [0, 1]
+    MODEL_CONTROLS
+} modelEnum_Control;
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// flight conditions
+typedef struct {
+    uint8_t ucAirframe;             ///< EASYSTAR, TYCHO, LEUKO or EPPFPV
+    uint32_t ulSeed;                ///< seed of noise and turbulence
+    float fNoise;                   ///< sensor noise scale, 0 = ideal sensors
+    float fWind;                    ///< mean wind speed [m/s]
+    float fWind_Dir;                ///< direction wind blows from [deg]
+    float fGust;                    ///< turbulence standard deviation [m/s]
+    float fLat;                     ///< launch latitude [deg]
+    float fLon;                     ///< launch longitude [deg]
+    float fAlt;                     ///< ground altitude above sea level [m]
+    float fHeading;                 ///< launch heading [deg]
+    float fHeight;                  ///< launch height above ground [m]
+    float fLaunch;                  ///< time of launch, held still until then [s]
+} xModel_Options;
+
+/// true state
+typedef struct {
+    float fTime;                    ///< time since start [s]
+    float fPos[3];                  ///< north, east, down from launch point on ground [m]
+    float fVel[3];                  ///< north, east, down speed [m/s]
+    float fEuler[3];                ///< roll, pitch, yaw [rad]
+    float fRate[3];                 ///< roll, pitch, yaw rates in body axes [rad/s]
+    float fAccel[3];                ///< specific force in body axes [m/s^2]
+    float fAirspeed;                ///< true airspeed [m/s]
+    float fAlpha;                   ///< angle of attack [rad]
+    float fBeta;                    ///< sideslip [rad]
+    bool bFlying;                   ///< launched and not landed
+    bool bLanded;                   ///< touched ground after launch
+} xModel_State;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Model_Defaults(xModel_Options * pxOptions);
+void Model_Init(const xModel_Options * pxOptions);
+void Model_Step(const float * pfControl, float fDt);
+const xModel_State * Model_State(void);
+const char * Model_Airframe(void);
+void Model_Imu(float * pfAccel, float * pfGyro);
+float Model_Baro(void);
+uint16_t Model_Nmea(char * pcBuffer);
@@ -0,0 +1,324 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief sensor log replay, software in the loop
+///
+/// \file
+///  Records the sensor input of a flight to a text file, and plays it back
+///  in place of the flight model, so that estimator and controller changes
+///  are compared on the same data. Played back samples go through emulated
+///  chips, drivers, calibration, DCM and attitude control, as in flight.
+///  A line holds a time stamp [ms] and either the inputs of the emulated
+///  sensors, set from then on, or a NMEA sentence sent to GPS port then:
+/// \code
+///   # time, accel x y z [m/s^2], gyro x y z [rad/s], altitude [m], temperature [C]
+///   21000 -0.0812 0.0396 -9.7734 0.0131 0.0072 0.0094 121.62 20
+///   21000 $GPGGA,120021.00,4527.8520,N,00911.4000,E,1,08,1.0,121.5,M,0.0,M,,*6A
+/// \endcode
+///  Estimated attitude and servo pulses are written at AHRS rate:
+/// \code
+///   # time [ms], roll, pitch, yaw [deg], aileron, elevator, throttle [us]
+///   21020 1.82 -0.44 91.07 1512 1468 1900
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "servodriver.h"
+#include "attitude.h"
+#include "sil.h"
+#include "replay.h"
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC FILE * px_Input = NULL;              //!< log played back
+VAR_STATIC FILE * px_Record = NULL;             //!< log recorded
+VAR_STATIC FILE * px_Output = NULL;             //!< attitude and servos
+VAR_STATIC char c_Line[REPLAY_LINE_SIZE];       //!< next line of log played back
+VAR_STATIC uint32_t ul_Line_Time;               //!< time of next line [ms]
+VAR_STATIC bool b_Pending = FALSE;              //!< next line read, not used yet
+VAR_STATIC bool b_End = FALSE;                  //!< log played back to the end
+VAR_STATIC uint32_t ul_Records = 0;             //!< sensor lines played back
+VAR_STATIC uint32_t ul_Samples = 0;             //!< attitude samples written
+VAR_STATIC struct timespec x_Start;             //!< host time at start
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static bool Replay_Read(void);
+static FILE * Replay_Create(const char * pcFile, const char * pcHeader);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads next line of log played back
+/// \return  FALSE at end of log
+/// \remarks skips comments and empty lines, exits on a line without time
+///
+///----------------------------------------------------------------------------
+static bool Replay_Read(void)
+{
+    char * p_end;
+
+    while (fgets(c_Line, sizeof(c_Line), px_Input) != NULL) {
+        if ((c_Line[0] == '#') || (c_Line[0] == '\n') || (c_Line[0] == '\r')) {
+            continue;
+        }
+        ul_Line_Time = (uint32_t)strtoul(c_Line, &p_end, 10);
+        if (p_end == c_Line) {
+            fprintf(stderr, "replay: bad line %s", c_Line);
+            exit(EXIT_FAILURE);
+        }
+        memmove(c_Line, p_end, strlen(p_end) + 1);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   creates an output file with a header line
+/// \param   pcFile = file name
+/// \param   pcHeader = comment describing columns
+/// \return  file, exits on error
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static FILE * Replay_Create(const char * pcFile, const char * pcHeader)
+{
+    FILE * p_file = fopen(pcFile, "w");
+
+    if (p_file == NULL) {
+        perror(pcFile);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(p_file, "# %s\n", pcHeader);
+    return p_file;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   opens log to play back
+/// \param   pcFile = file name
+/// \return  -
+/// \remarks exits on error
+///
+///----------------------------------------------------------------------------
+void Replay_Open(const char * pcFile)
+{
+    px_Input = fopen(pcFile, "r");
+    if (px_Input == NULL) {
+        perror(pcFile);
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &x_Start);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   plays back log up to a time
+/// \param   ulTime = current time [ms]
+/// \param   pcNmea = buffer for a NMEA sentence, REPLAY_LINE_SIZE bytes
+/// \return  length of a NMEA sentence due, with CR LF, 0 if no more
+/// \remarks Sensor lines due are set as sensor input. Called until it
+///          returns 0, once per tick.
+///
+///----------------------------------------------------------------------------
+uint16_t Replay_Step(uint32_t ulTime, char * pcNmea)
+{
+    float f_value[8];
+    char * p_text;
+
+    while (!b_End) {
+        if (!b_Pending) {
+            b_Pending = Replay_Read();
+            b_End = !b_Pending;
+            continue;
+        }
+        if (ul_Line_Time > ulTime) {
+            break;
+        }
+        b_Pending = FALSE;
+        p_text = c_Line + strspn(c_Line, " \t");
+        if (*p_text == '$') {                           // NMEA sentence
+            p_text[strcspn(p_text, "\r\n")] = 0;
+            return (uint16_t)snprintf(pcNmea, REPLAY_LINE_SIZE, "%.*s\r\n",
+                                      REPLAY_LINE_SIZE - 3, p_text);
+        }
+        if (sscanf(p_text, "%f %f %f %f %f %f %f %f", &f_value[0], &f_value[1],
+                   &f_value[2], &f_value[3], &f_value[4], &f_value[5],
+                   &f_value[6], &f_value[7]) != 8) {
+            fprintf(stderr, "replay: bad line %lu%s", (unsigned long)ul_Line_Time, c_Line);
+            exit(EXIT_FAILURE);
+        }
+        Sil_Set_Imu(&f_value[0], &f_value[3]);
+        Sil_Set_Baro(f_value[6], f_value[7]);
+        ul_Records++;
+    }
+    return 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks end of log played back
+/// \return  TRUE when all lines have been played back
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Replay_End(void)
+{
+    return b_End;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts recording sensor input
+/// \param   pcFile = file name
+/// \return  -
+/// \remarks exits on error
+///
+///----------------------------------------------------------------------------
+void Replay_Record(const char * pcFile)
+{
+    px_Record = Replay_Create(pcFile, "time, accel x y z [m/s^2], gyro x y z [rad/s], "
+                              "altitude [m], temperature [C]");
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   records sensor input
+/// \param   ulTime = current time [ms]
+/// \param   pcNmea = NMEA sentences sent to GPS port, NULL if none
+/// \return  -
+/// \remarks Values are written with 9 digits, as many as a float needs to
+///          be read back unchanged, so that playing back a flight of the
+///          model gives the same attitude and servos.
+///
+///----------------------------------------------------------------------------
+void Replay_Write(uint32_t ulTime, const char * pcNmea)
+{
+    const xSil_Sensors * p_sensors = Sil_Sensors();
+    size_t ul_length;
+
+    if (px_Record == NULL) {
+        return;
+    }
+    fprintf(px_Record, "%lu %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+            (unsigned long)ulTime,
+            (double)p_sensors->fAccel[0], (double)p_sensors->fAccel[1],
+            (double)p_sensors->fAccel[2], (double)p_sensors->fGyro[0],
+            (double)p_sensors->fGyro[1], (double)p_sensors->fGyro[2],
+            (double)p_sensors->fAltitude, (double)p_sensors->fTemperature);
+    while ((pcNmea != NULL) && (*pcNmea == '$')) {  // a line per sentence
+        ul_length = strcspn(pcNmea, "\r\n");
+        fprintf(px_Record, "%lu %.*s\n", (unsigned long)ulTime, (int)ul_length, pcNmea);
+        pcNmea += ul_length;
+        pcNmea += strspn(pcNmea, "\r\n");
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts writing attitude and servos
+/// \param   pcFile = file name
+/// \return  -
+/// \remarks exits on error
+///
+///----------------------------------------------------------------------------
+void Replay_Output(const char * pcFile)
+{
+    px_Output = Replay_Create(pcFile, "time [ms], roll, pitch, yaw [deg], "
+                              "aileron, elevator, throttle [us]");
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes estimated attitude and servo pulses
+/// \param   ulTime = current time [ms]
+/// \return  -
+/// \remarks called at AHRS rate
+///
+///----------------------------------------------------------------------------
+void Replay_Attitude(uint32_t ulTime)
+{
+    ul_Samples++;
+    if (px_Output == NULL) {
+        return;
+    }
+    fprintf(px_Output, "%lu %.2f %.2f %.2f %u %u %u\n", (unsigned long)ulTime,
+            (double)Attitude_Roll_Deg(), (double)Attitude_Pitch_Deg(),
+            (double)Attitude_Yaw_Deg(), Sil_Servo(SERVO_AILERON),
+            Sil_Servo(SERVO_ELEVATOR), Sil_Servo(SERVO_THROTTLE));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes throughput of play back
+/// \param   pxFile = stream
+/// \return  -
+/// \remarks AHRS samples per second of host time, whole firmware included
+///
+///----------------------------------------------------------------------------
+void Replay_Report(FILE * pxFile)
+{
+    struct timespec x_now;
+    double d_seconds;
+
+    if (px_Input == NULL) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &x_now);
+    d_seconds = (double)(x_now.tv_sec - x_Start.tv_sec) +
+                ((double)(x_now.tv_nsec - x_Start.tv_nsec) * 1e-9);
+    fprintf(pxFile, "replay: %lu records, %lu samples in %.3f s, %.0f samples/s\n",
+            (unsigned long)ul_Records, (unsigned long)ul_Samples, d_seconds,
+            (d_seconds > 0.0) ? ul_Samples / d_seconds : 0.0);
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,44 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief sensor log replay header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define REPLAY_LINE_SIZE 256        //!< max length of a log line
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Replay_Open(const char * pcFile);
+uint16_t Replay_Step(uint32_t ulTime, char * pcNmea);
+bool Replay_End(void);
+void Replay_Record(const char * pcFile);
+void Replay_Write(uint32_t ulTime, const char * pcNmea);
+void Replay_Output(const char * pcFile);
+void Replay_Attitude(uint32_t ulTime);
+void Replay_Report(FILE * pxFile);
@@ -0,0 +1,1237 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief software in the loop
+///
+/// \file
+///  Runs the complete firmware on a Linux host, on the FreeRTOS POSIX port.
+///  main.c, tasks, drivers and StdPeriph library are compiled unchanged:
+///  peripheral registers are host memory mapped at their target address, so
+///  drivers configure them as usual, and this module plays the part of the
+///  hardware once per tick, in the tick hook, with interrupts masked as in
+///  an ISR:
+///  - DMA1 channel 4 sends USART1 downlink, channels 5 and 6 receive USART1
+///    uplink and USART2 GPS data at the configured baud rate, with half and
+///    full transfer interrupts; USART1 idle interrupt ends each burst
+///  - TIM2 captures PPM frames played from a script, no signal without one
+///  - TIM3 compare registers are servo pulse lengths, see Sil_Servo()
+///  Sensors are emulated at register level behind the I2C driver (see
+///  i2c_mems_driver.c), SD card is a host directory (see ff.c), flash pages
+///  of parameter store and calibration are simulated by Test/Host/flash.c.
+///  A serial port is a pseudo terminal, whose name is printed at start up,
+///  or a UDP socket on localhost, optionally sending to a fixed peer port,
+///  otherwise to the last sender, or a file recording what is sent:
+/// \code
+///   ./cortex-ap [-1 port] [-2 port] [-p ppm_script] [-d sd_directory]
+///               [-t seconds] [-v] [-m on | -m option=value,...]
+///               [-g PARAM=value,...] [-r log | -w log] [-a attitude_file]
+///               [-k restart_file]
+///   port = pty | udp:port[:peer] | file:name | none
+/// \endcode
+///  With -m the aircraft is flown by the flight model of model.c: each tick
+///  it steps with the servo pulses and gives accelerometers, gyroscopes and
+///  barometer their input; every 200 ms it sends a GPS fix on USART2, in
+///  place of option -2. Options are seed, noise, wind, wind_dir, gust, lat,
+///  lon, alt, heading, height and launch, see xModel_Options, defaults in
+///  Model_Defaults(). The flight is scored by metrics.c, whose report is
+///  printed on stdout at exit; with a time limit, a run also ends when the
+///  model lands. Option -g sets parameters by name at the first tick, after
+///  tasks registered their callbacks, as a ground station would.
+///  With -w the sensor input of a flight with the model is recorded, with -r
+///  a recorded log is played back in place of the model, in virtual time,
+///  until its end; -a writes estimated attitude and servo pulses, see
+///  replay.c. Play back prints its throughput at exit.
+///  With -k the no init RAM region of restart.c is kept in a file: it's
+///  written at exit, and a run finding the file starts as after a watchdog
+///  reset with that region preserved, i.e. warm if the state is valid (see
+///  restart.c). A flight cut by -t and run again with the same file thus
+///  tests warm restart. Control resumes after RESTART_HOLD cycles in saved
+///  manual mode, at once in navigation, against ~1.5 s of a cold boot:
+/// \code
+///   ./cortex-ap -t 5 -k state
+///   ./cortex-ap -t 5 -k state
+///   restart: warm=1 count=1
+///   boot: fs=0 mission=0 gps=0 calibrated=0 log=0 control=120
+/// \endcode
+///  Count goes up to RESTART_MAX with runs shorter than RESTART_STABLE
+///  cycles, next run is then cold.
+///  Every run prints the time of each start up event at exit, see boot.c,
+///  control being the time to first valid control output [ms]:
+/// \code
+///   boot: fs=0 mission=0 gps=0 calibrated=1530 log=0 control=1550
+/// \endcode
+///  Defaults are USART1 on a pseudo terminal, USART2 not connected, SD card
+///  in directory sd, no time limit, real time. With -v time is virtual:
+///  ticks are made whenever all tasks are blocked (see port.c), so a run
+///  takes as long as the host needs to compute it. Everything emulated here
+///  is stepped by ticks, so with inputs from files only (PPM script, SD
+///  card, files as ports) a run gives the same outputs each time. A PPM script has a line per change,
+///  time [ms] followed by up to RC_CHANNELS pulse lengths [us], missing
+///  ones are neutral; a line with time only stops the signal:
+/// \code
+///   0     1500 1500 1100 1500 1100 1500 1500
+///   20000
+/// \endcode
+///  switches to manual mode for 20 s; a mode pulse of 2000 us selects
+///  navigation, as for a flight with the model:
+/// \code
+///   0     1500 1500 1100 1500 2000
+/// \endcode
+///  Build from Firmware directory (gcc, Linux):
+/// \code
+///   L=Libraries; R=$L/FreeRTOSV7.1.0/Source; P=$L/STM32F10x_StdPeriph_Driver
+///   gcc -std=gnu99 -DSIL -DUSE_STDPERIPH_DRIVER -DSTM32F10X_MD_VL -no-pie
+///       -ISil -ISource -IUtilities -I$L/CMSIS/CM3/CoreSupport
+///       -I$L/CMSIS/CM3/DeviceSupport/ST/STM32F10x -I$P/inc -I$L/fat_sd
+///       -I$L/I2C_MEMS_Driver -I$L/L3G4200_Driver -I$L/ADXL345_Driver
+///       -I$L/BMP085_Driver -I$R/include -I$R/portable/GCC/Posix
+///       -I$L/Mavlink/matrixpilot
+///       Sil/*.c Test/Host/flash.c Utilities/stm32f10x_it.c
+///       Source/{main,attitude,DCM,PID,nav,mission,mav_telemetry,simulator,
+///       log,blackbox,filesystem,boot,calibration,restart,param,store,ring,
+///       stream,profile,crc,vmath,led,servodriver,ppmdriver,usart1driver}.c
+///       $L/L3G4200_Driver/l3g4200d_driver.c $L/ADXL345_Driver/ADXL345_driver.c
+///       $L/BMP085_Driver/BMP085_driver.c $L/fat_sd/fattime.c
+///       $R/{list,queue,tasks,timers}.c $R/portable/MemMang/heap_1.c
+///       $R/portable/GCC/Posix/port.c
+///       $P/src/{misc,stm32f10x_rcc,stm32f10x_gpio,stm32f10x_usart,
+///       stm32f10x_dma,stm32f10x_tim,stm32f10x_wwdg}.c
+///       -o cortex-ap -lpthread -lm
+/// \endcode
+///  -no-pie keeps static buffers below 4 GB, as drivers give their address
+///  to DMA as 32 bit values.
+///
+//  Change
+//
+//============================================================================*/
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#undef CR1                              // termios output flags, register names here
+#undef CR2
+#undef CR3
+
+#include "stm32f10x.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "config.h"
+#include "servodriver.h"
+#include "store.h"
+#include "param.h"
+#include "boot.h"
+#include "restart.h"
+#include "sil.h"
+#include "model.h"
+#include "metrics.h"
+#include "replay.h"
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+#define SIL_PERIPH_SIZE 0x30000                         //!< APB1, APB2 and AHB peripherals
+#define SIL_SCS_BASE    0xE0000000                      //!< core peripherals
+#define SIL_SCS_SIZE    0x100000                        //!< up to DBGMCU
+#define SIL_FIFO_SIZE   1024                            //!< bytes received from host, not yet on the line
+#define SIL_PACKET_SIZE 2048                            //!< max UDP datagram
+#define SIL_TICK_US     (1000000UL / configTICK_RATE_HZ)//!< tick period [us]
+#define SIL_BIT_TICKS   (10UL * configTICK_RATE_HZ)     //!< bits per byte times ticks per second
+#define SIL_TIM_CLOCK   configCPU_CLOCK_HZ              //!< TIM2 and TIM3 clock [Hz]
+#define SIL_PPM_FRAME   22500                           //!< PPM frame period [us]
+#define SIL_NO_EDGE     UINT64_MAX                      //!< no PPM signal
+#define SIL_FLASH_PAGES (STORE_PAGES + 1)               //!< store pages and calibration page
+#define SIL_GPS_TICKS   (configTICK_RATE_HZ / 5)        //!< period of GPS fixes of flight model
+#define SIL_PULSE_MIN   800                             //!< shorter servo pulse is no signal [us]
+#define SIL_PULSE_MAX   2200                            //!< longer servo pulse is no signal [us]
+#define SIL_AHRS_TICKS  (configTICK_RATE_HZ / SAMPLES_PER_SECOND) //!< period of attitude output
+#define SIL_MS(t)       ((t) * 1000UL / configTICK_RATE_HZ)//!< ticks to milliseconds
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// serial port and its host end
+typedef struct {
+    USART_TypeDef * pxUsart;                            ///< emulated USART
+    const char * pcName;                                ///< name for messages
+    IRQn_Type eIrq;                                     ///< USART interrupt
+    void (*pfHandler)(void);                            ///< USART handler, NULL if none
+    int iFd;                                            ///< host descriptor, -1 if not connected
+    bool bUdp;                                          ///< descriptor is a UDP socket
+    bool bFile;                                         ///< descriptor is an output file
+    bool bPeer;                                         ///< UDP peer address known
+    bool bFixed;                                        ///< UDP peer given by option
+    struct sockaddr_in xPeer;                           ///< UDP peer address
+    uint8_t ucFifo[SIL_FIFO_SIZE];                      ///< received bytes
+    uint16_t uiHead;                                    ///< index of oldest received byte
+    uint16_t uiCount;                                   ///< number of received bytes
+    uint32_t ulRx_Credit;                               ///< line time left for reception [bits * ticks/s]
+    uint32_t ulTx_Credit;                               ///< line time left for transmission
+} xSil_Usart;
+
+/// DMA channel serving a USART
+typedef struct {
+    DMA_Channel_TypeDef * pxChannel;                    ///< channel registers
+    uint8_t ucShift;                                    ///< position of channel flags in ISR
+    IRQn_Type eIrq;                                     ///< channel interrupt
+    void (*pfHandler)(void);                            ///< channel handler
+    uint16_t uiSize;                                    ///< transfer count at enable, 0 if idle
+} xSil_Dma;
+
+/// line of PPM script
+typedef struct {
+    uint32_t ulTime;                                    ///< time of change [ms]
+    uint8_t ucChannels;                                 ///< number of pulses, 0 = no signal
+    uint16_t uiPulse[RC_CHANNELS];                      ///< pulse lengths [us]
+} xSil_Ppm;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xSil_Usart x_Usart1;                         //!< telemetry
+VAR_STATIC xSil_Usart x_Usart2;                         //!< GPS
+VAR_STATIC xSil_Dma x_Dma_Tx1;                          //!< USART1 TX
+VAR_STATIC xSil_Dma x_Dma_Rx1;                          //!< USART1 RX
+VAR_STATIC xSil_Dma x_Dma_Rx2;                          //!< USART2 RX
+
+VAR_STATIC xSil_Ppm * px_Ppm = NULL;                    //!< PPM script
+VAR_STATIC uint16_t ui_Ppm_Lines = 0;                   //!< number of lines in PPM script
+VAR_STATIC uint16_t ui_Ppm_Line = 0;                    //!< current line of PPM script
+VAR_STATIC uint16_t ui_Frame[RC_CHANNELS];              //!< pulses of current PPM frame [us]
+VAR_STATIC uint64_t ull_Frame = 0;                      //!< start of current PPM frame [us]
+VAR_STATIC uint64_t ull_Edge = SIL_NO_EDGE;             //!< next PPM rising edge [us]
+VAR_STATIC uint8_t uc_Edge = 0;                         //!< index of next edge in frame
+VAR_STATIC uint64_t ull_Update = 0;                     //!< next TIM2 overflow [us]
+VAR_STATIC bool b_Counting = FALSE;                     //!< TIM2 counter enabled
+
+VAR_STATIC uint64_t ull_Time = 0;                       //!< emulated time [us]
+VAR_STATIC uint32_t ul_Ticks = 0;                       //!< ticks since scheduler start
+VAR_STATIC uint32_t ul_Limit = 0;                       //!< ticks to run, 0 = forever
+VAR_STATIC const char * pc_Disk = "sd";                 //!< directory holding SD card files
+VAR_STATIC bool b_Model = FALSE;                        //!< flown by flight model
+VAR_STATIC xModel_Options x_Model;                      //!< flight conditions of model
+VAR_STATIC char * pc_Params = NULL;                     //!< parameters to set, -g option
+VAR_STATIC bool b_Replay = FALSE;                       //!< sensors played back from a log
+VAR_STATIC const char * pc_Restart = NULL;              //!< file keeping no init RAM, -k option
+
+/// sensed quantities, level and still at sea level
+VAR_STATIC xSil_Sensors x_Sensors = {
+    { 0.0f, 0.0f, -SIL_GRAVITY }, { 0.0f, 0.0f, 0.0f }, 0.0f, 20.0f
+};
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+void DMA1_Channel4_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void DMA1_Channel6_IRQHandler(void);
+void USART1_IRQHandler(void);
+void TIM2_IRQHandler(void);
+void Flash_Sim_Init(uint32_t ulAddress, uint16_t uiPages);
+
+static void Sil_Usage(const char * pcProgram);
+static void *Sil_Map(uintptr_t ulAddress, size_t ulSize);
+static void Sil_Open(xSil_Usart * pxUsart, const char * pcSpec);
+static void Sil_Load_Ppm(const char * pcFile);
+static void Sil_Model_Options(char * pcOptions, const char * pcProgram);
+static void Sil_Params(void);
+static void Sil_Restart_Load(void);
+static void Sil_Report(void);
+static void Sil_Irq(IRQn_Type eIrq, void (*pfHandler)(void));
+static void Sil_Put(xSil_Usart * pxUsart, const uint8_t * pucData, uint16_t uiLength);
+static void Sil_Receive(xSil_Usart * pxUsart);
+static void Sil_Send(xSil_Usart * pxUsart, const uint8_t * pucData, uint16_t uiLength);
+static uint32_t Sil_Baud(const xSil_Usart * pxUsart);
+static void Sil_Dma_Event(const xSil_Dma * pxDma, uint32_t ulFlag, uint32_t ulEnable);
+static void Sil_Dma_Tx(xSil_Dma * pxDma, xSil_Usart * pxUsart);
+static void Sil_Dma_Rx(xSil_Dma * pxDma, xSil_Usart * pxUsart);
+static void Sil_Tim_Event(uint16_t uiIt);
+static void Sil_Ppm_Frame(uint64_t ullTime);
+static void Sil_Ppm(void);
+static float Sil_Control(SERVO_TYPE eServo, int16_t iSign);
+static void Sil_Model(void);
+static void Sil_Replay(void);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   prints command line help and exits
+/// \param   pcProgram = program name
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Sil_Usage(const char * pcProgram)
+{
+    fprintf(stderr,
+            "usage: %s [-1 port] [-2 port] [-p ppm_script] [-d sd_directory] [-t seconds] [-v]\n"
+            "          [-m on | -m option=value,...] [-g PARAM=value,...]\n"
+            "          [-r log | -w log] [-a attitude_file] [-k restart_file]\n"
+            "  -1  USART1 (telemetry), default pty\n"
+            "  -2  USART2 (GPS), default none\n"
+            "  -v  virtual time, as fast as possible and repeatable\n"
+            "  -m  flight model, GPS on USART2, options seed, noise, wind, wind_dir,\n"
+            "      gust, lat, lon, alt, heading, height, launch\n"
+            "  -g  parameters set at start, e.g. ROL_ANG_P=1.2,AHRS_YAW_P=0.4\n"
+            "  -w  records sensor input of flight model to a log\n"
+            "  -r  plays back a sensor log in place of flight model, as fast as possible\n"
+            "  -a  writes attitude and servo pulses at AHRS rate\n"
+            "  -k  keeps no init RAM in a file, start is a watchdog reset if it exists\n"
+            "  port = pty | udp:port[:peer] | file:name | none, UDP on 127.0.0.1\n",
+            pcProgram);
+    exit(EXIT_FAILURE);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   maps host memory at target address
+/// \param   ulAddress = target address, multiple of host page size
+/// \param   ulSize = number of bytes
+/// \return  pointer to mapped memory, zeroed
+/// \remarks exits if memory can't be mapped at requested address
+///
+///----------------------------------------------------------------------------
+static void *Sil_Map(uintptr_t ulAddress, size_t ulSize)
+{
+    void * p_map = mmap((void *)ulAddress, ulSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (p_map != (void *)ulAddress) {
+        fprintf(stderr, "can't map 0x%08X\n", (unsigned)ulAddress);
+        exit(EXIT_FAILURE);
+    }
+    return p_map;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   connects a serial port to the host
+/// \param   pxUsart = pointer to port
+/// \param   pcSpec = pty, udp:port[:peer], file:name or none
+/// \return  -
+/// \remarks The slave side of a pseudo terminal is kept open, so that data
+///          sent while no program is attached don't make writes fail.
+///
+///----------------------------------------------------------------------------
+static void Sil_Open(xSil_Usart * pxUsart, const char * pcSpec)
+{
+    struct sockaddr_in x_local;
+    struct termios x_termios;
+    unsigned u_port, u_peer;
+    int i_slave, i_fields;
+
+    pxUsart->iFd = -1;
+    if (strcmp(pcSpec, "none") == 0) {
+        return;
+    }
+    if (strcmp(pcSpec, "pty") == 0) {
+        pxUsart->iFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if ((pxUsart->iFd < 0) || (grantpt(pxUsart->iFd) != 0) || (unlockpt(pxUsart->iFd) != 0) ||
+            ((i_slave = open(ptsname(pxUsart->iFd), O_RDWR | O_NOCTTY)) < 0)) {
+            perror(pxUsart->pcName);
+            exit(EXIT_FAILURE);
+        }
+        (void)tcgetattr(i_slave, &x_termios);
+        cfmakeraw(&x_termios);                          // binary data, no echo
+        (void)tcsetattr(i_slave, TCSANOW, &x_termios);
+        fprintf(stderr, "%s: %s\n", pxUsart->pcName, ptsname(pxUsart->iFd));
+        return;
+    }
+    if (strncmp(pcSpec, "file:", 5) == 0) {
+        pxUsart->iFd = open(pcSpec + 5, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (pxUsart->iFd < 0) {
+            perror(pcSpec + 5);
+            exit(EXIT_FAILURE);
+        }
+        pxUsart->bFile = TRUE;
+        return;
+    }
+    i_fields = sscanf(pcSpec, "udp:%u:%u", &u_port, &u_peer);
+    if (i_fields < 1) {
+        fprintf(stderr, "%s: bad port %s\n", pxUsart->pcName, pcSpec);
+        exit(EXIT_FAILURE);
+    }
+    memset(&x_local, 0, sizeof(x_local));
+    x_local.sin_family = AF_INET;
+    x_local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    x_local.sin_port = htons((uint16_t)u_port);
+    pxUsart->iFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if ((pxUsart->iFd < 0) ||
+        (bind(pxUsart->iFd, (struct sockaddr *)&x_local, sizeof(x_local)) != 0) ||
+        (fcntl(pxUsart->iFd, F_SETFL, O_NONBLOCK) != 0)) {
+        perror(pxUsart->pcName);
+        exit(EXIT_FAILURE);
+    }
+    pxUsart->bUdp = TRUE;
+    if (i_fields == 2) {
+        pxUsart->xPeer = x_local;
+        pxUsart->xPeer.sin_port = htons((uint16_t)u_peer);
+        pxUsart->bPeer = TRUE;
+        pxUsart->bFixed = TRUE;
+    }
+    fprintf(stderr, "%s: udp 127.0.0.1:%u\n", pxUsart->pcName, u_port);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads PPM script
+/// \param   pcFile = script file name
+/// \return  -
+/// \remarks lines must be in time order, empty lines and lines beginning
+///          with # are skipped
+///
+///----------------------------------------------------------------------------
+static void Sil_Load_Ppm(const char * pcFile)
+{
+    FILE * p_file = fopen(pcFile, "r");
+    char c_line[256];
+    char * p_next;
+    char * p_end;
+    xSil_Ppm x_line;
+    uint8_t j;
+
+    if (p_file == NULL) {
+        perror(pcFile);
+        exit(EXIT_FAILURE);
+    }
+    while (fgets(c_line, sizeof(c_line), p_file) != NULL) {
+        x_line.ulTime = (uint32_t)strtoul(c_line, &p_end, 10);
+        if ((p_end == c_line) || (c_line[0] == '#')) {
+            continue;
+        }
+        for (j = 0; j < RC_CHANNELS; j++) {
+            x_line.uiPulse[j] = (uint16_t)strtoul(p_end, &p_next, 10);
+            if (p_next == p_end) {
+                break;
+            }
+            p_end = p_next;
+        }
+        x_line.ucChannels = j;
+        for (; j < RC_CHANNELS; j++) {
+            x_line.uiPulse[j] = SERVO_NEUTRAL;
+        }
+        px_Ppm = realloc(px_Ppm, (ui_Ppm_Lines + 1) * sizeof(xSil_Ppm));
+        px_Ppm[ui_Ppm_Lines++] = x_line;
+    }
+    fclose(p_file);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads flight model options
+/// \param   pcOptions = on, or comma separated option=value list
+/// \param   pcProgram = program name
+/// \return  -
+/// \remarks exits with usage on unknown option
+///
+///----------------------------------------------------------------------------
+static void Sil_Model_Options(char * pcOptions, const char * pcProgram)
+{
+    char * const c_keys[] = {
+        "on", "seed", "noise", "wind", "wind_dir", "gust", "lat", "lon", "alt", "heading",
+        "height", "launch", NULL
+    };
+    float * const p_values[] = {
+        NULL, NULL, &x_Model.fNoise, &x_Model.fWind, &x_Model.fWind_Dir, &x_Model.fGust,
+        &x_Model.fLat, &x_Model.fLon, &x_Model.fAlt, &x_Model.fHeading, &x_Model.fHeight,
+        &x_Model.fLaunch
+    };
+    char * p_value;
+    int i_key;
+
+    if (!b_Model) {
+        Model_Defaults(&x_Model);
+        b_Model = TRUE;
+    }
+    while (*pcOptions != 0) {
+        i_key = getsubopt(&pcOptions, c_keys, &p_value);
+        if ((i_key < 0) || ((i_key > 0) && (p_value == NULL))) {
+            Sil_Usage(pcProgram);
+        } else if (i_key == 1) {
+            x_Model.ulSeed = (uint32_t)strtoul(p_value, NULL, 0);
+        } else if (i_key > 1) {
+            *p_values[i_key] = strtof(p_value, NULL);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets parameters of -g option
+/// \return  -
+/// \remarks exits on unknown name or value out of range, so a sweep never
+///          runs with default gains by mistake
+///
+///----------------------------------------------------------------------------
+static void Sil_Params(void)
+{
+    char * p_save;
+    char * p_name;
+    char * p_value;
+    paramEnum_Id e_id;
+
+    for (p_name = strtok_r(pc_Params, ",", &p_save); p_name != NULL;
+         p_name = strtok_r(NULL, ",", &p_save)) {
+        p_value = strchr(p_name, '=');
+        if (p_value == NULL) {
+            fprintf(stderr, "param: missing value of %s\n", p_name);
+            exit(EXIT_FAILURE);
+        }
+        *p_value++ = 0;
+        e_id = Param_Find((const uint8_t *)p_name);
+        if ((e_id == PARAM_NUMBER) || !Param_Set(e_id, strtof(p_value, NULL))) {
+            fprintf(stderr, "param: cannot set %s to %s\n", p_name, p_value);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   loads no init RAM region kept by a previous run, -k option
+/// \return  -
+/// \remarks Start up is then a watchdog reset. Without the file it's a power
+///          up, region is as the C library leaves it.
+///
+///----------------------------------------------------------------------------
+static void Sil_Restart_Load(void)
+{
+    FILE * p_file = fopen(pc_Restart, "rb");
+
+    if (p_file == NULL) {
+        return;
+    }
+    if (fread((xRestart_State *)Restart_Get(), sizeof(xRestart_State), 1, p_file) == 1) {
+        RCC->CSR |= RCC_CSR_WWDGRSTF;                   // reset by window watchdog
+    }
+    fclose(p_file);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   prints flight metrics or play back throughput, and start up
+///          times at exit
+/// \return  -
+/// \remarks Events not signaled are printed as -. With -k, no init RAM
+///          region is written for next run.
+///
+///----------------------------------------------------------------------------
+static void Sil_Report(void)
+{
+    static const char * const pc_event[BOOT_EVENTS] = {
+        "fs", "mission", "gps", "calibrated", "log", "control"
+    };
+    FILE * p_file;
+    uint8_t j;
+
+    if (b_Model) {
+        Metrics_Report(stdout);
+    }
+    Replay_Report(stdout);
+    if (pc_Restart != NULL) {
+        p_file = fopen(pc_Restart, "wb");
+        if ((p_file == NULL) ||
+            (fwrite(Restart_Get(), sizeof(xRestart_State), 1, p_file) != 1)) {
+            perror(pc_Restart);
+        }
+        if (p_file != NULL) {
+            fclose(p_file);
+        }
+        printf("restart: warm=%u count=%u\n", Restart_Warm() ? 1 : 0,
+               Restart_Warm() ? Restart_Get()->ucCount : 0);
+    }
+    printf("boot:");
+    for (j = 0; j < BOOT_EVENTS; j++) {
+        if (Boot_Done((uint8_t)(1 << j))) {
+            printf(" %s=%lu", pc_event[j],
+                   (unsigned long)(Boot_Time((bootEnum_Event)(1 << j)) * portTICK_RATE_MS));
+        } else {
+            printf(" %s=-", pc_event[j]);
+        }
+    }
+    printf("\n");
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets up emulated hardware before firmware main() starts
+/// \param   argc, argv = command line, passed by glibc to constructors
+/// \return  -
+/// \remarks Peripherals are mapped before any driver touches them, flash
+///          pages are erased as on a new board.
+///
+///----------------------------------------------------------------------------
+__attribute__((constructor)) static void Sil_Init(int argc, char ** argv)
+{
+    const char * pc_usart1 = "pty";
+    const char * pc_usart2 = "none";
+    int i_option;
+
+    (void)Sil_Map(PERIPH_BASE, SIL_PERIPH_SIZE);
+    (void)Sil_Map(SIL_SCS_BASE, SIL_SCS_SIZE);
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, SIL_FLASH_PAGES);
+
+    while ((i_option = getopt(argc, argv, "1:2:p:d:t:vm:g:r:w:a:k:h")) != -1) {
+        switch (i_option) {
+            case '1':
+                pc_usart1 = optarg;
+                break;
+            case '2':
+                pc_usart2 = optarg;
+                break;
+            case 'p':
+                Sil_Load_Ppm(optarg);
+                break;
+            case 'd':
+                pc_Disk = optarg;
+                break;
+            case 't':
+                ul_Limit = (uint32_t)(atof(optarg) * configTICK_RATE_HZ);
+                break;
+            case 'v':
+                vPortSetVirtualTime();
+                break;
+            case 'm':
+                Sil_Model_Options(optarg, argv[0]);
+                break;
+            case 'g':
+                pc_Params = optarg;
+                break;
+            case 'r':
+                Replay_Open(optarg);
+                vPortSetVirtualTime();
+                b_Replay = TRUE;
+                break;
+            case 'w':
+                Replay_Record(optarg);
+                break;
+            case 'a':
+                Replay_Output(optarg);
+                break;
+            case 'k':
+                pc_Restart = optarg;
+                Sil_Restart_Load();
+                break;
+            default:
+                Sil_Usage(argv[0]);
+                break;
+        }
+    }
+
+    USART1->SR = USART_FLAG_TXE | USART_FLAG_TC;        // reset values
+    USART2->SR = USART_FLAG_TXE | USART_FLAG_TC;
+
+    x_Usart1.pxUsart = USART1;
+    x_Usart1.pcName = "usart1";
+    x_Usart1.eIrq = USART1_IRQn;
+    x_Usart1.pfHandler = USART1_IRQHandler;
+    Sil_Open(&x_Usart1, pc_usart1);
+    x_Usart2.pxUsart = USART2;
+    x_Usart2.pcName = "usart2";
+    x_Usart2.eIrq = USART2_IRQn;
+    x_Usart2.pfHandler = NULL;                          // GPS is read by polling DMA
+    if (b_Model && b_Replay) {
+        Sil_Usage(argv[0]);
+    }
+    if (b_Model) {
+        pc_usart2 = "none";                             // model is the GPS
+        Model_Init(&x_Model);
+        fprintf(stderr, "model: %s\n", Model_Airframe());
+        Metrics_Init(x_Model.fLat, x_Model.fLon, x_Model.fAlt);
+    }
+    if (b_Replay) {
+        pc_usart2 = "none";                             // log is the GPS
+    }
+    atexit(Sil_Report);
+    Sil_Open(&x_Usart2, pc_usart2);
+
+    x_Dma_Tx1.pxChannel = DMA1_Channel4;
+    x_Dma_Tx1.ucShift = 12;
+    x_Dma_Tx1.eIrq = DMA1_Channel4_IRQn;
+    x_Dma_Tx1.pfHandler = DMA1_Channel4_IRQHandler;
+    x_Dma_Rx1.pxChannel = DMA1_Channel5;
+    x_Dma_Rx1.ucShift = 16;
+    x_Dma_Rx1.eIrq = DMA1_Channel5_IRQn;
+    x_Dma_Rx1.pfHandler = DMA1_Channel5_IRQHandler;
+    x_Dma_Rx2.pxChannel = DMA1_Channel6;
+    x_Dma_Rx2.ucShift = 20;
+    x_Dma_Rx2.eIrq = DMA1_Channel6_IRQn;
+    x_Dma_Rx2.pfHandler = DMA1_Channel6_IRQHandler;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   calls an interrupt handler
+/// \param   eIrq = interrupt number
+/// \param   pfHandler = handler, NULL if none
+/// \return  -
+/// \remarks NVIC enable registers are written with one bit set, so plain
+///          memory keeps only the last one: peripheral enables decide.
+///
+///----------------------------------------------------------------------------
+static void Sil_Irq(IRQn_Type eIrq, void (*pfHandler)(void))
+{
+    (void)eIrq;
+    if (pfHandler != NULL) {
+        pfHandler();
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   puts data received from host into port FIFO
+/// \param   pxUsart = pointer to port
+/// \param   pucData = pointer to data
+/// \param   uiLength = number of bytes
+/// \return  -
+/// \remarks bytes which don't fit are lost, as in a receiver overrun
+///
+///----------------------------------------------------------------------------
+static void Sil_Put(xSil_Usart * pxUsart, const uint8_t * pucData, uint16_t uiLength)
+{
+    uint16_t ui_tail;
+
+    if (uiLength > SIL_FIFO_SIZE - pxUsart->uiCount) {
+        uiLength = SIL_FIFO_SIZE - pxUsart->uiCount;
+    }
+    for (uint16_t j = 0; j < uiLength; j++) {
+        ui_tail = (pxUsart->uiHead + pxUsart->uiCount) % SIL_FIFO_SIZE;
+        pxUsart->ucFifo[ui_tail] = pucData[j];
+        pxUsart->uiCount++;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads data sent by host into port FIFO
+/// \param   pxUsart = pointer to port
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Sil_Receive(xSil_Usart * pxUsart)
+{
+    uint8_t uc_data[SIL_PACKET_SIZE];
+    struct sockaddr_in x_from;
+    socklen_t x_length = sizeof(x_from);
+    ssize_t l_read;
+
+    if ((pxUsart->iFd < 0) || pxUsart->bFile) {
+        return;
+    }
+    for (;;) {
+        if (pxUsart->bUdp) {
+            l_read = recvfrom(pxUsart->iFd, uc_data, sizeof(uc_data), 0,
+                              (struct sockaddr *)&x_from, &x_length);
+            if ((l_read > 0) && (!pxUsart->bFixed)) {
+                pxUsart->xPeer = x_from;                // answer last sender
+                pxUsart->bPeer = TRUE;
+            }
+        } else {
+            l_read = read(pxUsart->iFd, uc_data, SIL_FIFO_SIZE - pxUsart->uiCount);
+        }
+        if (l_read <= 0) {
+            return;
+        }
+        Sil_Put(pxUsart, uc_data, (uint16_t)l_read);
+        if (pxUsart->uiCount == SIL_FIFO_SIZE) {
+            return;
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends data to host
+/// \param   pxUsart = pointer to port
+/// \param   pucData = pointer to data
+/// \param   uiLength = number of bytes
+/// \return  -
+/// \remarks data are lost if nobody listens, as on an unconnected line
+///
+///----------------------------------------------------------------------------
+static void Sil_Send(xSil_Usart * pxUsart, const uint8_t * pucData, uint16_t uiLength)
+{
+    if ((pxUsart->iFd < 0) || (uiLength == 0)) {
+        return;
+    }
+    if (pxUsart->bUdp) {
+        if (pxUsart->bPeer) {
+            (void)sendto(pxUsart->iFd, pucData, uiLength, 0,
+                         (struct sockaddr *)&pxUsart->xPeer, sizeof(pxUsart->xPeer));
+        }
+    } else {
+        (void)write(pxUsart->iFd, pucData, uiLength);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   baud rate of a port
+/// \param   pxUsart = pointer to port
+/// \return  baud rate, 0 if port is disabled
+/// \remarks BRR holds bus clock / baud rate, with 16x oversampling
+///
+///----------------------------------------------------------------------------
+static uint32_t Sil_Baud(const xSil_Usart * pxUsart)
+{
+    RCC_ClocksTypeDef x_clocks;
+    uint32_t ul_clock;
+
+    if (((pxUsart->pxUsart->CR1 & USART_CR1_UE) == 0) || (pxUsart->pxUsart->BRR == 0)) {
+        return 0;
+    }
+    RCC_GetClocksFreq(&x_clocks);
+    ul_clock = (pxUsart->pxUsart == USART1) ? x_clocks.PCLK2_Frequency : x_clocks.PCLK1_Frequency;
+    return ul_clock / pxUsart->pxUsart->BRR;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   raises a DMA channel interrupt
+/// \param   pxDma = pointer to channel
+/// \param   ulFlag = DMA_ISR_TCIF1 or DMA_ISR_HTIF1
+/// \param   ulEnable = DMA_CCR1_TCIE or DMA_CCR1_HTIE
+/// \return  -
+/// \remarks flags are cleared after the handler, as plain memory ignores
+///          writes to IFCR
+///
+///----------------------------------------------------------------------------
+static void Sil_Dma_Event(const xSil_Dma * pxDma, uint32_t ulFlag, uint32_t ulEnable)
+{
+    if ((pxDma->pxChannel->CCR & ulEnable) != 0) {
+        DMA1->ISR |= (DMA_ISR_GIF1 | ulFlag) << pxDma->ucShift;
+        Sil_Irq(pxDma->eIrq, pxDma->pfHandler);
+        DMA1->ISR &= ~(0x0FUL << pxDma->ucShift);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   transmits bytes read by DMA from memory during one tick
+/// \param   pxDma = pointer to channel
+/// \param   pxUsart = pointer to port
+/// \return  -
+/// \remarks A transfer starts when the channel is seen enabled with a count.
+///          When complete, the handler may start next one at once, which
+///          is carried on in the same tick if line time is left.
+///
+///----------------------------------------------------------------------------
+static void Sil_Dma_Tx(xSil_Dma * pxDma, xSil_Usart * pxUsart)
+{
+    DMA_Channel_TypeDef * p_channel = pxDma->pxChannel;
+    uint8_t uc_data[SIL_FIFO_SIZE];
+    uint16_t ui_length = 0;
+    const uint8_t * p_memory;
+
+    pxUsart->ulTx_Credit += Sil_Baud(pxUsart);
+    while ((pxUsart->ulTx_Credit >= SIL_BIT_TICKS) && (ui_length < SIL_FIFO_SIZE) &&
+           ((pxUsart->pxUsart->CR3 & USART_CR3_DMAT) != 0)) {
+        if ((p_channel->CCR & DMA_CCR1_EN) == 0) {
+            pxDma->uiSize = 0;
+        } else if (pxDma->uiSize == 0) {
+            pxDma->uiSize = (uint16_t)p_channel->CNDTR; // new transfer
+        }
+        if ((pxDma->uiSize == 0) || (p_channel->CNDTR == 0)) {
+            break;                                      // nothing to send
+        }
+        p_memory = (const uint8_t *)(uintptr_t)p_channel->CMAR;
+        uc_data[ui_length++] = p_memory[pxDma->uiSize - p_channel->CNDTR];
+        pxUsart->ulTx_Credit -= SIL_BIT_TICKS;
+        if (--p_channel->CNDTR == 0) {
+            pxDma->uiSize = 0;                          // done, enabled or not
+            Sil_Dma_Event(pxDma, DMA_ISR_TCIF1, DMA_CCR1_TCIE);
+        }
+    }
+    if (pxUsart->ulTx_Credit >= SIL_BIT_TICKS) {        // line is idle
+        pxUsart->ulTx_Credit %= SIL_BIT_TICKS;
+    }
+    Sil_Send(pxUsart, uc_data, ui_length);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes bytes received during one tick to memory by DMA
+/// \param   pxDma = pointer to channel
+/// \param   pxUsart = pointer to port
+/// \return  -
+/// \remarks Circular mode reloads the count at the end of each lap. Idle
+///          interrupt is raised when the last received byte has been
+///          transferred.
+///
+///----------------------------------------------------------------------------
+static void Sil_Dma_Rx(xSil_Dma * pxDma, xSil_Usart * pxUsart)
+{
+    DMA_Channel_TypeDef * p_channel = pxDma->pxChannel;
+    uint8_t * p_memory;
+    bool b_received = FALSE;
+
+    Sil_Receive(pxUsart);
+    pxUsart->ulRx_Credit += Sil_Baud(pxUsart);
+    while ((pxUsart->ulRx_Credit >= SIL_BIT_TICKS) && (pxUsart->uiCount != 0) &&
+           ((pxUsart->pxUsart->CR3 & USART_CR3_DMAR) != 0)) {
+        if ((p_channel->CCR & DMA_CCR1_EN) == 0) {
+            pxDma->uiSize = 0;
+        } else if (pxDma->uiSize == 0) {
+            pxDma->uiSize = (uint16_t)p_channel->CNDTR;
+        }
+        if ((pxDma->uiSize == 0) || (p_channel->CNDTR == 0)) {
+            break;                                      // held by USART
+        }
+        p_memory = (uint8_t *)(uintptr_t)p_channel->CMAR;
+        p_memory[pxDma->uiSize - p_channel->CNDTR] = pxUsart->ucFifo[pxUsart->uiHead];
+        pxUsart->uiHead = (pxUsart->uiHead + 1) % SIL_FIFO_SIZE;
+        pxUsart->uiCount--;
+        pxUsart->ulRx_Credit -= SIL_BIT_TICKS;
+        b_received = TRUE;
+        p_channel->CNDTR--;
+        if (p_channel->CNDTR == pxDma->uiSize / 2) {
+            Sil_Dma_Event(pxDma, DMA_ISR_HTIF1, DMA_CCR1_HTIE);
+        }
+        if (p_channel->CNDTR == 0) {
+            if ((p_channel->CCR & DMA_CCR1_CIRC) != 0) {
+                p_channel->CNDTR = pxDma->uiSize;       // next lap
+            } else {
+                pxDma->uiSize = 0;
+            }
+            Sil_Dma_Event(pxDma, DMA_ISR_TCIF1, DMA_CCR1_TCIE);
+        }
+    }
+    if (pxUsart->uiCount == 0) {                        // line is idle
+        pxUsart->ulRx_Credit %= SIL_BIT_TICKS;
+        if (b_received && ((pxUsart->pxUsart->CR1 & USART_CR1_IDLEIE) != 0)) {
+            pxUsart->pxUsart->SR |= USART_FLAG_IDLE;
+            Sil_Irq(pxUsart->eIrq, pxUsart->pfHandler);
+            pxUsart->pxUsart->SR &= ~USART_FLAG_IDLE;
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   raises a TIM2 interrupt
+/// \param   uiIt = TIM_IT_Update or TIM_IT_CC2
+/// \return  -
+/// \remarks Handlers clear a flag by writing 0 to it and 1 to the others,
+///          which sets them in plain memory: only the raised source is left
+///          enabled while the handler runs.
+///
+///----------------------------------------------------------------------------
+static void Sil_Tim_Event(uint16_t uiIt)
+{
+    uint16_t ui_enable = TIM2->DIER;
+
+    if ((ui_enable & uiIt) != 0) {
+        TIM2->DIER = uiIt;
+        TIM2->SR = uiIt;
+        Sil_Irq(TIM2_IRQn, TIM2_IRQHandler);
+        TIM2->SR = 0;
+        TIM2->DIER = ui_enable;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts a PPM frame with pulses of script line in effect
+/// \param   ullTime = start time [us]
+/// \return  -
+/// \remarks no edge is scheduled while the script says no signal
+///
+///----------------------------------------------------------------------------
+static void Sil_Ppm_Frame(uint64_t ullTime)
+{
+    while ((ui_Ppm_Line + 1 < ui_Ppm_Lines) &&
+           ((uint64_t)px_Ppm[ui_Ppm_Line + 1].ulTime * 1000 <= ullTime)) {
+        ui_Ppm_Line++;
+    }
+    if ((ui_Ppm_Lines == 0) || ((uint64_t)px_Ppm[ui_Ppm_Line].ulTime * 1000 > ullTime) ||
+        (px_Ppm[ui_Ppm_Line].ucChannels == 0)) {
+        ull_Edge = SIL_NO_EDGE;
+        return;
+    }
+    memcpy(ui_Frame, px_Ppm[ui_Ppm_Line].uiPulse, sizeof(ui_Frame));
+    ull_Frame = ullTime;
+    ull_Edge = ullTime;
+    uc_Edge = 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   captures PPM edges and timer overflows of one tick
+/// \return  -
+/// \remarks A frame has a rising edge before each channel pulse and one
+///          after the last, the sync pulse fills up the frame period.
+///          Events are raised in time order, capture register holds the
+///          timer count at the edge.
+///
+///----------------------------------------------------------------------------
+static void Sil_Ppm(void)
+{
+    uint64_t ull_end = ull_Time + SIL_TICK_US;
+    uint64_t ull_count;
+    uint32_t ul_period = TIM2->ARR + 1;
+    uint32_t ul_rate = SIL_TIM_CLOCK / (TIM2->PSC + 1);     // counts per second
+
+    if ((TIM2->CR1 & TIM_CR1_CEN) == 0) {
+        b_Counting = FALSE;
+        ull_Time = ull_end;
+        return;
+    }
+    if (!b_Counting) {                                      // timer just started
+        b_Counting = TRUE;
+        ull_Update = ull_Time + (uint64_t)ul_period * 1000000 / ul_rate;
+    }
+    if (ull_Edge == SIL_NO_EDGE) {
+        Sil_Ppm_Frame(ull_Time);                            // signal may resume
+    }
+    for (;;) {
+        if ((ull_Update <= ull_Edge) && (ull_Update < ull_end)) {
+            Sil_Tim_Event(TIM_IT_Update);
+            ull_Update += (uint64_t)ul_period * 1000000 / ul_rate;
+        } else if (ull_Edge < ull_end) {
+            ull_count = ull_Edge * ul_rate / 1000000;
+            TIM2->CCR2 = (uint16_t)(ull_count % ul_period);
+            Sil_Tim_Event(TIM_IT_CC2);
+            if (uc_Edge < RC_CHANNELS) {
+                ull_Edge += ui_Frame[uc_Edge++];
+            } else {
+                Sil_Ppm_Frame(ull_Frame + SIL_PPM_FRAME);
+            }
+        } else {
+            break;
+        }
+    }
+    ull_Time = ull_end;
+    TIM2->CNT = (uint16_t)((ull_Time * ul_rate / 1000000) % ul_period);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   flight model command of a servo
+/// \param   eServo = servo
+/// \param   iSign = 1 if a longer pulse gives a positive command, else -1
+/// \return  command [-1, 1], 0 without signal
+/// \remarks Signs are those of a correctly set up aircraft, with which the
+///          attitude loops of attitude.c are stable: with servo signs of
+///          Servo_Set(), a longer aileron pulse rolls right, a longer
+///          elevator pulse pitches down.
+///
+///----------------------------------------------------------------------------
+static float Sil_Control(SERVO_TYPE eServo, int16_t iSign)
+{
+    uint16_t ui_pulse = Sil_Servo(eServo);
+
+    if ((ui_pulse < SIL_PULSE_MIN) || (ui_pulse > SIL_PULSE_MAX)) {
+        return 0.0f;
+    }
+    return (float)(iSign * ((int16_t)ui_pulse - SERVO_NEUTRAL)) / 500.0f;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   steps flight model by one tick
+/// \return  -
+/// \remarks throttle pulse goes from 1000 us, stop, to 2000 us, full power
+///
+///----------------------------------------------------------------------------
+static void Sil_Model(void)
+{
+    float f_control[MODEL_CONTROLS];
+    float f_accel[3], f_gyro[3];
+    char c_nmea[MODEL_NMEA_SIZE];
+
+    f_control[MODEL_AILERON] = Sil_Control(SERVO_AILERON, 1);
+    f_control[MODEL_ELEVATOR] = Sil_Control(SERVO_ELEVATOR, -1);
+    f_control[MODEL_RUDDER] = Sil_Control(SERVO_RUDDER, 1);
+    f_control[MODEL_THROTTLE] = (Sil_Control(SERVO_THROTTLE, 1) + 1.0f) / 2.0f;
+    if (Sil_Servo(SERVO_THROTTLE) < SIL_PULSE_MIN) {
+        f_control[MODEL_THROTTLE] = 0.0f;               // no signal, motor stopped
+    }
+    Model_Step(f_control, 1.0f / configTICK_RATE_HZ);
+    Metrics_Step(1.0f / configTICK_RATE_HZ);
+    Model_Imu(f_accel, f_gyro);
+    Sil_Set_Imu(f_accel, f_gyro);
+    Sil_Set_Baro(Model_Baro(), 20.0f);
+    if ((ul_Ticks % SIL_GPS_TICKS) == 0) {
+        Sil_Put(&x_Usart2, (const uint8_t *)c_nmea, Model_Nmea(c_nmea));
+        Replay_Write(SIL_MS(ul_Ticks), c_nmea);
+    } else {
+        Replay_Write(SIL_MS(ul_Ticks), NULL);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   plays back sensor log up to current tick
+/// \return  -
+/// \remarks exits at end of log
+///
+///----------------------------------------------------------------------------
+static void Sil_Replay(void)
+{
+    char c_nmea[REPLAY_LINE_SIZE];
+    uint16_t ui_length;
+
+    while ((ui_length = Replay_Step(SIL_MS(ul_Ticks), c_nmea)) != 0) {
+        Sil_Put(&x_Usart2, (const uint8_t *)c_nmea, ui_length);
+    }
+    if (Replay_End()) {
+        exit(EXIT_SUCCESS);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   emulates peripherals, called by FreeRTOS every tick
+/// \return  -
+/// \remarks runs in the tick interrupt, exits when time limit is reached,
+///          or with a limit, when the flight model has landed, or at end of
+///          log played back
+///
+///----------------------------------------------------------------------------
+void vApplicationTickHook(void)
+{
+    if ((ul_Ticks == 0) && (pc_Params != NULL)) {
+        Sil_Params();
+    }
+    if (b_Model) {
+        Sil_Model();
+        if (Model_State()->bLanded && (ul_Limit != 0)) {
+            exit(EXIT_SUCCESS);
+        }
+    }
+    if (b_Replay) {
+        Sil_Replay();
+    }
+    if ((ul_Ticks % SIL_AHRS_TICKS) == 0) {
+        Replay_Attitude(SIL_MS(ul_Ticks));
+    }
+    Sil_Dma_Tx(&x_Dma_Tx1, &x_Usart1);
+    Sil_Dma_Rx(&x_Dma_Rx1, &x_Usart1);
+    Sil_Dma_Rx(&x_Dma_Rx2, &x_Usart2);
+    Sil_Ppm();
+    if ((++ul_Ticks == ul_Limit) && (ul_Limit != 0)) {
+        exit(EXIT_SUCCESS);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets inertial sensor input
+/// \param   pfAccel = pointer to specific force x, y, z in body axes [m/s^2]
+/// \param   pfGyro = pointer to rates x, y, z in body axes [rad/s]
+/// \return  -
+/// \remarks same convention as MAVLink HIL_SENSOR, z = -1 g when level
+///
+///----------------------------------------------------------------------------
+void Sil_Set_Imu(const float * pfAccel, const float * pfGyro)
+{
+    memcpy(x_Sensors.fAccel, pfAccel, sizeof(x_Sensors.fAccel));
+    memcpy(x_Sensors.fGyro, pfGyro, sizeof(x_Sensors.fGyro));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets barometer input
+/// \param   fAltitude = altitude above sea level [m]
+/// \param   fTemperature = temperature [deg C]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void Sil_Set_Baro(float fAltitude, float fTemperature)
+{
+    x_Sensors.fAltitude = fAltitude;
+    x_Sensors.fTemperature = fTemperature;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sensor input
+/// \return  pointer to sensed quantities
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const xSil_Sensors * Sil_Sensors(void)
+{
+    return &x_Sensors;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   servo output
+/// \param   eServo = servo
+/// \return  pulse length [us]
+/// \remarks TIM3 counts microseconds, see Servo_Init()
+///
+///----------------------------------------------------------------------------
+uint16_t Sil_Servo(SERVO_TYPE eServo)
+{
+    switch (eServo) {
+        case SERVO_AILERON:
+            return TIM3->CCR1;
+        case SERVO_ELEVATOR:
+            return TIM3->CCR2;
+        case SERVO_RUDDER:
+            return TIM3->CCR3;
+        case SERVO_THROTTLE:
+            return TIM3->CCR4;
+        default:
+            return 0;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   directory holding SD card files
+/// \return  directory name
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const char * Sil_Disk(void)
+{
+    return pc_Disk;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
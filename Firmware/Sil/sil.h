@@ -0,0 +1,49 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief software in the loop header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define SIL_GRAVITY     9.80665f    //!< standard gravity [m/s^2]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// physical quantities sensed by emulated chips
+typedef struct {
+    float fAccel[3];                    ///< specific force x, y, z in body axes, z = -1 g when level [m/s^2]
+    float fGyro[3];                     ///< rates x, y, z in body axes [rad/s]
+    float fAltitude;                    ///< altitude above sea level, standard atmosphere [m]
+    float fTemperature;                 ///< air temperature [deg C]
+} xSil_Sensors;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Sil_Set_Imu(const float * pfAccel, const float * pfGyro);
+void Sil_Set_Baro(float fAltitude, float fTemperature);
+const xSil_Sensors * Sil_Sensors(void);
+uint16_t Sil_Servo(SERVO_TYPE eServo);
+const char * Sil_Disk(void);
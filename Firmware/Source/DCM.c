@@ -101,18 +101,6 @@
 #endif
 #define VAR_GLOBAL
 
-/// Initial P gain for roll/pitch compensation
-#define PITCHROLL_KP    0.03f       // Typical values 0.1f, 0.015f, 0.01f, 0.0013f
-
-/// Initial I gain for roll/pitch compensation
-#define PITCHROLL_KI    0.000005f   // Typical values 0.000005f, 0.000002f
-
-/// Initial P gain for yaw compensation
-#define YAW_KP          0.5f        // Typical values 0.5f, 0.27f
-
-/// Initial P gain for yaw compensation
-#define YAW_KI          0.0005f     // Typical values 0.0005f
-
 /*----------------------------------- Macros ---------------------------------*/
 
 /*-------------------------------- Enumerations ------------------------------*/
@@ -294,7 +282,7 @@ Normalize(void)
 void
 AccelAdjust(void)
 {
-#if (SIMULATOR == SIM_NONE)
+#if (SIMULATOR == SIM_NONE) || (SIMULATOR == HIL_MAVLINK)
     fGround_Speed = ((float)Gps_Speed_Kt());
     fGround_Speed = (fGround_Speed * 1852.0f) / 36000.0f; // convert [kt] to [m/s]
 #else
@@ -456,3 +444,33 @@ MatrixUpdate(const int16_t *sensor)
         }
     }
 }
+
+///----------------------------------------------------------------------------
+///
+/// Get gyro bias estimate
+/// \return      -
+/// \remarks     bias is the integral term of drift compensation
+///
+///----------------------------------------------------------------------------
+void
+GetGyroBias(float *bias)
+{
+    bias[0] = Omega_I[0];
+    bias[1] = Omega_I[1];
+    bias[2] = Omega_I[2];
+}
+
+///----------------------------------------------------------------------------
+///
+/// Set gyro bias estimate
+/// \return      -
+/// \remarks     used to restore state after a warm restart
+///
+///----------------------------------------------------------------------------
+void
+SetGyroBias(const float *bias)
+{
+    Omega_I[0] = bias[0];
+    Omega_I[1] = bias[1];
+    Omega_I[2] = bias[2];
+}
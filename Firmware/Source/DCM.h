@@ -47,4 +47,6 @@ void Normalize( void );
 void CompensateDrift( void );
 void AccelAdjust( void );
 void MatrixUpdate( const int16_t * sensor );
+void GetGyroBias( float * bias );
+void SetGyroBias( const float * bias );
 
@@ -14,7 +14,7 @@
 //============================================================================*/
 
 #include "config.h"
-#include "pid.h"
+#include "PID.h"
 
 /*--------------------------------- Definitions ------------------------------*/
 
@@ -16,7 +16,9 @@
 ///  roll and pitch angles, without need to either subtract PI/2 from reference
 ///  point or to add PI/2 to the set point.
 ///
-// Change: restored sensor calibration
+// Change: AHRS samples queued for RAW_IMU telemetry
+//         PID gains updated by parameter registry when they change
+//         sensors from MAVLink HIL messages
 //
 //============================================================================*/
 
@@ -29,21 +31,27 @@
 #include "stm32f10x_wwdg.h"
 
 #include "i2c_mems_driver.h"
-#include "l3g4200d_driver.h"
-#include "adxl345_driver.h"
-#include "bmp085_driver.h"
+#include "l3g4200D_driver.h"
+#include "ADXL345_driver.h"
+#include "BMP085_driver.h"
 #include "servodriver.h"
 #include "ppmdriver.h"
 
 #include "config.h"
-#include "dcm.h"
+#include "DCM.h"
 #include "simulator.h"
 #include "mav_telemetry.h"
 #include "log.h"
 #include "led.h"
 #include "nav.h"
-#include "pid.h"
+#include "PID.h"
+#include "blackbox.h"
+#include "boot.h"
+#include "calibration.h"
+#include "restart.h"
+#include "param.h"
 #include "attitude.h"
+#include "profile.h"
 
 /** @addtogroup cortex_ap
   * @{
@@ -62,6 +70,20 @@
 /* delay for attitude task */
 #define AHRS_DELAY      (configTICK_RATE_HZ / SAMPLES_PER_SECOND)
 
+/* sensor calibration */
+#define SENSOR_STARTUP  (configTICK_RATE_HZ / 4) //!< sensor power up time
+#define CAL_SAMPLES     64      //!< number of samples averaged for offsets
+#define CAL_MAX_SPREAD  16      //!< max gyro spread while aircraft is still
+#define CAL_ATTEMPTS    8       //!< max number of calibration attempts
+#define CHECK_SAMPLES   16      //!< number of samples for stored calibration check
+#define CHECK_MAX_ERROR 24      //!< max difference of gyro average from stored offset
+#define GROUND_THROTTLE 1100    //!< max throttle pulse on ground [us]
+#define GROUND_SPEED    10      //!< max GPS speed on ground [kt/10]
+
+/* number of channels in black box records */
+#define LOG_CHANNELS    ((6 * LOG_SENSORS) + (9 * LOG_DCM) + \
+                         (RC_CHANNELS * LOG_PPM) + (3 * LOG_SERVO))
+
 /*----------------------------------- Macros ---------------------------------*/
 
 /*-------------------------------- Enumerations ------------------------------*/
@@ -70,15 +92,8 @@
 
 /*---------------------------------- Constants -------------------------------*/
 
-/// sign of sensor data
-VAR_STATIC const int16_t iSensor_Sign[6] = {
-    -1,     // acceleration X, must be positive forward
-     1,     // acceleration Y, must be positive rightward
-     1,     // acceleration Z, must be positive downward
-     1,	    // roll rate, must be positive when right wing lowers
-    -1,     // pitch rate, must be positive when tail lowers
-    -1      // yaw rate, must be positive when turning right
-};
+/// sign of sensor data, see SENSOR_SIGN
+VAR_STATIC const int16_t iSensor_Sign[6] = SENSOR_SIGN;
 
 VAR_STATIC const uint8_t uc_Blink[MODE_NUM][100] = {
 { 0,0,0,0,0,0,0,0,0,0,
@@ -152,6 +167,8 @@ VAR_STATIC int16_t i_Aileron;            //!< aileron servo position
 VAR_STATIC int16_t i_Elevator;           //!< elevator servo position
 VAR_STATIC int16_t i_Throttle;           //!< throttle servo position
 VAR_STATIC uint8_t uc_Counter = 0;       //!< blue LED blinking counter
+VAR_STATIC uint8_t uc_Mode;              //!< control mode
+VAR_STATIC uint8_t uc_Hold = 0;          //!< AHRS cycles left with saved mode
 VAR_STATIC xPID Roll_Pid;                //!< roll PID
 VAR_STATIC xPID Pitch_Pid;               //!< pitch PID
 VAR_STATIC xPID Nav_Pid;                 //!< navigation PID
@@ -164,12 +181,29 @@ VAR_STATIC float f_Throttle = MINIMUMTHROTTLE;           //!< commanded throttle
 VAR_STATIC float f_Throttle_Min = ALT_HOLD_THROTTLE_MIN; //!< altitude hold min throttle
 VAR_STATIC float f_Throttle_Max = ALT_HOLD_THROTTLE_MAX; //!< altitude hold max throttle
 VAR_STATIC uint8_t uc_Sensor_Data[12];   //!< raw sensor data
-VAR_STATIC int16_t i_Sensor_Offset[6] =  //!< sensors offset
-{ 0x02, 0x00, 0x3F, 0x02, 0x05, 0x06 };
+VAR_STATIC int16_t i_Sensor_Offset[6];   //!< sensors offset
+VAR_STATIC int16_t i_Sensor_Scale[6];    //!< sensors scale factor, Q12
+VAR_STATIC int16_t i_Gyro_Min[3];        //!< min raw gyro in current window
+VAR_STATIC int16_t i_Gyro_Max[3];        //!< max raw gyro in current window
+VAR_STATIC uint8_t uc_Still_Samples = 0; //!< samples in current window
+VAR_STATIC volatile bool b_Still = FALSE; //!< gyro spread within CAL_MAX_SPREAD in last window
+#if (LOG_BLACKBOX == 1)
+VAR_STATIC int16_t i_Log_Data[LOG_CHANNELS]; //!< black box record
+#endif
 
 /*--------------------------------- Prototypes -------------------------------*/
 
 static __inline void Attitude_Control(void);
+static __inline bool Attitude_Sample(portTickType * pLast_Wake_Time, uint8_t uc_Samples, int16_t * pi_Average);
+static __inline bool Attitude_Check(portTickType * pLast_Wake_Time);
+static __inline bool Attitude_Calibrate(portTickType * pLast_Wake_Time, int16_t * pi_Offset);
+static __inline void Attitude_Recalibrate(portTickType * pLast_Wake_Time);
+static __inline void Attitude_Restore(void);
+static __inline void Attitude_Still(const int16_t * piGyro);
+static void Attitude_Gain(paramEnum_Id eId, float fValue);
+#if (LOG_BLACKBOX == 1)
+static __inline void Attitude_Log(void);
+#endif
 
 /*--------------------------------- Functions --------------------------------*/
 
@@ -183,8 +217,10 @@ static __inline void Attitude_Control(void);
 ///----------------------------------------------------------------------------
 void Attitude_Task(void *pvParameters)
 {
-    uint8_t i, j;
+    uint8_t j;
     int16_t * p_sensor;
+    int16_t i_servo[3];
+    bool b_hold;
     portTickType Last_Wake_Time;
 
     (void)pvParameters;
@@ -219,35 +255,49 @@ void Attitude_Task(void *pvParameters)
     PID_Init(&Roll_Pid);                            // initialize PID
     PID_Init(&Pitch_Pid);
     PID_Init(&Nav_Pid);
+#if (SIMULATOR == SIM_NONE) || (SIMULATOR == HIL_MAVLINK)
+    for (j = 0; j < (uint8_t)PARAM_NUMBER; j++) {   // gains from parameters
+        Param_Notify((paramEnum_Id)j, Attitude_Gain);
+    }
+#endif
 
-    /* Wait until aircraft settles */
-    LEDOn(BLUE);
-    vTaskDelayUntil(&Last_Wake_Time, configTICK_RATE_HZ * 5);
-    LEDOff(BLUE);
-
-    /* Compute sensor offsets */
-    for (i = 0; i < 64; i++) {
-        vTaskDelayUntil(&Last_Wake_Time, AHRS_DELAY);
-  #if (SIMULATOR == SIM_NONE)                               // normal mode
-        (void)GetAccelRaw(uc_Sensor_Data);                  // acceleration
-        (void)GetAngRateRaw((uint8_t *)&uc_Sensor_Data[6]); // rotation
-  #else                                                     // simulation mode
-        Simulator_Get_Raw_IMU((int16_t *)uc_Sensor_Data);   // get simulator sensors
-  #endif
-        p_sensor = (int16_t *)uc_Sensor_Data;
-        for (j = 0; j < 6; j++) {                           // accumulate
-            i_Sensor_Offset[j] += *p_sensor++;
+    /* Get sensor calibration */
+    if (Restart_Warm()) {                                   // watchdog reset in flight
+        Attitude_Restore();                                 // restore preserved state
+    } else {
+        LEDOn(BLUE);
+        vTaskDelayUntil(&Last_Wake_Time, SENSOR_STARTUP);   // sensors power up
+        if (!Attitude_Check(&Last_Wake_Time)) {             // stored calibration not usable
+            Attitude_Recalibrate(&Last_Wake_Time);          // full calibration
         }
+        LEDOff(BLUE);
     }
-    for (j = 0; j < 6; j++) {                               // average
-        i_Sensor_Offset[j] = i_Sensor_Offset[j] / 64;
-    }
+    Boot_Signal(BOOT_SENSORS_CALIBRATED);
+
+#if (LOG_BLACKBOX == 1)
+    Blackbox_Init(LOG_CHANNELS);                            // init black box
+#endif
 
     for (;;) {                                              // endless loop
         vTaskDelayUntil(&Last_Wake_Time, AHRS_DELAY);       // update @ 50 Hz
         WWDG_SetCounter(127);                               // update WWDG counter
+        b_hold = (uc_Hold != 0);
+        if (b_hold) {                                       // warm restart, radio not trusted yet
+            uc_Hold--;
+            uc_Mode = Restart_Get()->ucMode;                // keep mode before reset
+        } else {
+            uc_Mode = PPMGetMode();
+        }
+        if (Calibration_Requested() &&                      // recalibration requested
+            (!b_hold) && Attitude_On_Ground()) {            // and still on ground
+            LEDOn(BLUE);
+            Attitude_Recalibrate(&Last_Wake_Time);
+        }
         uc_Counter = (uc_Counter + 1) % 100;                // blink blue LED
-        if (uc_Blink[PPMGetMode()][uc_Counter] == 1) {      //
+        if (uc_Counter == 0) {                              // temperature compensation
+            Calibration_Get(i_Sensor_Offset, i_Sensor_Scale, BMP085_Get_Temperature());
+        }
+        if (uc_Blink[uc_Mode][uc_Counter] == 1) {           //
             LEDOn(BLUE);
         } else {
             LEDOff(BLUE);
@@ -258,13 +308,17 @@ void Attitude_Task(void *pvParameters)
         (void)GetAccelRaw(uc_Sensor_Data);                  // acceleration
         (void)GetAngRateRaw((uint8_t *)&uc_Sensor_Data[6]); // rotation
         BMP085_Handler();
+#elif (SIMULATOR == HIL_MAVLINK)                           // hardware in the loop
+        Telemetry_Get_Sensors((int16_t *)uc_Sensor_Data);   // get HIL_SENSOR data
 #else                                                       // simulation mode
         Simulator_Get_Raw_IMU((int16_t *)uc_Sensor_Data);   // get simulator sensors
 #endif
-        /* Offset and sign correction */
+        Attitude_Still((int16_t *)&uc_Sensor_Data[6]);      // raw gyro spread
+        /* Offset, scale and sign correction */
         p_sensor = (int16_t *)uc_Sensor_Data;
         for (j = 0; j < 6; j++) {
-            *p_sensor -= i_Sensor_Offset[j];                // strip offset
+            *p_sensor = (int16_t)(((int32_t)(*p_sensor - i_Sensor_Offset[j]) *
+                        i_Sensor_Scale[j]) >> CAL_SCALE_SHIFT); // strip offset, scale
             *p_sensor *= iSensor_Sign[j];                   // correct sign
             if (j == 2) {                                   // z acceleration
                *p_sensor += (int16_t)GRAVITY;               // add gravity
@@ -273,13 +327,307 @@ void Attitude_Task(void *pvParameters)
         }
 
         /* AHRS and control */
+        PROFILE_BEGIN(PROFILE_MATRIX_UPDATE);
         MatrixUpdate((int16_t *)uc_Sensor_Data);        // compute DCM
+        PROFILE_END(PROFILE_MATRIX_UPDATE);
+        PROFILE_BEGIN(PROFILE_COMPENSATE_DRIFT);
         CompensateDrift();                              // compensate
+        PROFILE_END(PROFILE_COMPENSATE_DRIFT);
+        PROFILE_BEGIN(PROFILE_NORMALIZE);
         Normalize();                                    // normalize DCM
-        Attitude_Control();                             // attitude control loop
+        PROFILE_END(PROFILE_NORMALIZE);
+        if ((!b_hold) || (uc_Mode == MODE_NAV)) {       // servos held during
+            PROFILE_BEGIN(PROFILE_ATTITUDE_CONTROL);
+            Attitude_Control();                         // attitude control loop
+            PROFILE_END(PROFILE_ATTITUDE_CONTROL);
+            Boot_Signal(BOOT_CONTROL_ACTIVE);           // first control output
+        }                                               // warm restart otherwise
+        i_servo[0] = i_Aileron;                         // preserve flight state
+        i_servo[1] = i_Elevator;
+        i_servo[2] = i_Throttle;
+        Restart_Save(i_Sensor_Offset, i_servo, uc_Mode);
+        Telemetry_Put_Sample((int16_t *)uc_Sensor_Data); // RAW_IMU stream
+#if (LOG_BLACKBOX == 1)
+        Attitude_Log();                                 // black box record
+#endif
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Sensor sampling for calibration.
+/// \param   pLast_Wake_Time = pointer to last wake time of attitude task
+/// \param   uc_Samples = number of samples to average
+/// \param   pi_Average = pointer to average of each sensor
+/// \return  TRUE if aircraft was still, i.e. spread of each gyro is within
+///          CAL_MAX_SPREAD
+/// \remarks BMP085 is sampled as well, so that temperature is available.
+///
+///----------------------------------------------------------------------------
+static __inline bool Attitude_Sample(portTickType * pLast_Wake_Time, uint8_t uc_Samples, int16_t * pi_Average)
+{
+    uint8_t i, j;
+    int16_t * p_sensor;
+    int16_t i_min[3], i_max[3];
+    int32_t l_sum[6];
+    bool b_still = TRUE;
+
+    for (j = 0; j < 6; j++) {                                   // reset
+        l_sum[j] = 0;
+    }
+    for (j = 0; j < 3; j++) {
+        i_min[j] = 32767;
+        i_max[j] = -32768;
+    }
+    for (i = 0; i < uc_Samples; i++) {
+        vTaskDelayUntil(pLast_Wake_Time, AHRS_DELAY);
+        WWDG_SetCounter(127);                                   // update WWDG counter
+#if (SIMULATOR == SIM_NONE)                                     // normal mode
+        (void)GetAccelRaw(uc_Sensor_Data);                      // acceleration
+        (void)GetAngRateRaw((uint8_t *)&uc_Sensor_Data[6]);     // rotation
+        BMP085_Handler();                                       // temperature
+#elif (SIMULATOR == HIL_MAVLINK)                               // hardware in the loop
+        Telemetry_Get_Sensors((int16_t *)uc_Sensor_Data);       // get HIL_SENSOR data
+#else                                                           // simulation mode
+        Simulator_Get_Raw_IMU((int16_t *)uc_Sensor_Data);       // get simulator sensors
+#endif
+        p_sensor = (int16_t *)uc_Sensor_Data;
+        for (j = 0; j < 6; j++) {                               // accumulate
+            l_sum[j] += p_sensor[j];
+        }
+        for (j = 0; j < 3; j++) {                               // gyro spread
+            if (p_sensor[j + 3] < i_min[j]) {
+                i_min[j] = p_sensor[j + 3];
+            }
+            if (p_sensor[j + 3] > i_max[j]) {
+                i_max[j] = p_sensor[j + 3];
+            }
+        }
+    }
+    for (j = 0; j < 3; j++) {
+        if ((i_max[j] - i_min[j]) > CAL_MAX_SPREAD) {           // aircraft moving
+            b_still = FALSE;
+        }
+    }
+    for (j = 0; j < 6; j++) {                                   // average
+        pi_Average[j] = (int16_t)(l_sum[j] / uc_Samples);
+    }
+    return b_still;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Checks that aircraft is still.
+/// \param   piGyro = pointer to raw gyro data
+/// \return  -
+/// \remarks Spread of each gyro is checked over windows of CHECK_SAMPLES
+///          samples, as Attitude_Sample() does during calibration. Result is
+///          kept until the end of next window.
+///
+///----------------------------------------------------------------------------
+static __inline void Attitude_Still(const int16_t * piGyro)
+{
+    uint8_t j;
+    bool b_still = TRUE;
+
+    if (uc_Still_Samples == 0) {                                // new window
+        for (j = 0; j < 3; j++) {
+            i_Gyro_Min[j] = 32767;
+            i_Gyro_Max[j] = -32768;
+        }
+    }
+    for (j = 0; j < 3; j++) {                                   // gyro spread
+        if (piGyro[j] < i_Gyro_Min[j]) {
+            i_Gyro_Min[j] = piGyro[j];
+        }
+        if (piGyro[j] > i_Gyro_Max[j]) {
+            i_Gyro_Max[j] = piGyro[j];
+        }
+    }
+    if (++uc_Still_Samples == CHECK_SAMPLES) {                  // end of window
+        uc_Still_Samples = 0;
+        for (j = 0; j < 3; j++) {
+            if ((i_Gyro_Max[j] - i_Gyro_Min[j]) > CAL_MAX_SPREAD) { // aircraft moving
+                b_still = FALSE;
+            }
+        }
+        b_Still = b_still;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Check of stored calibration.
+/// \param   pLast_Wake_Time = pointer to last wake time of attitude task
+/// \return  TRUE if stored calibration is usable
+/// \remarks Loads calibration from flash, then averages CHECK_SAMPLES samples.
+///          Stored calibration is used if aircraft is still and gyro averages
+///          are within CHECK_MAX_ERROR of the temperature compensated offsets.
+///          Accelerometers aren't checked, aircraft may not be level.
+///
+///----------------------------------------------------------------------------
+static __inline bool Attitude_Check(portTickType * pLast_Wake_Time)
+{
+    uint8_t j;
+    int16_t i_average[6];
+    int16_t i_error;
+    bool b_ok;
+
+    if (!Calibration_Load()) {                                  // nothing stored
+        return FALSE;
+    }
+    b_ok = Attitude_Sample(pLast_Wake_Time, CHECK_SAMPLES, i_average);
+    Calibration_Get(i_Sensor_Offset, i_Sensor_Scale, BMP085_Get_Temperature());
+    for (j = 3; j < 6; j++) {                                   // gyro offsets
+        i_error = i_average[j] - i_Sensor_Offset[j];
+        if ((i_error > CHECK_MAX_ERROR) || (i_error < -CHECK_MAX_ERROR)) {
+            b_ok = FALSE;
+        }
     }
+    return b_ok;
 }
 
+///----------------------------------------------------------------------------
+///
+/// \brief   Sensor calibration.
+/// \param   pLast_Wake_Time = pointer to last wake time of attitude task
+/// \param   pi_Offset = pointer to sensor offsets
+/// \return  TRUE if aircraft was still
+/// \remarks Averages CAL_SAMPLES samples as soon as aircraft is still. After
+///          CAL_ATTEMPTS the last average is returned anyway.
+///
+///----------------------------------------------------------------------------
+static __inline bool Attitude_Calibrate(portTickType * pLast_Wake_Time, int16_t * pi_Offset)
+{
+    uint8_t uc_attempts = 0;
+    bool b_still;
+
+    do {
+        b_still = Attitude_Sample(pLast_Wake_Time, CAL_SAMPLES, pi_Offset);
+    } while ((!b_still) && (++uc_attempts < CAL_ATTEMPTS));
+    return b_still;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Sensor calibration update.
+/// \param   pLast_Wake_Time = pointer to last wake time of attitude task
+/// \return  -
+/// \remarks New offsets are saved to flash only if aircraft was still.
+///          If aircraft was moving, they are used only when there isn't any
+///          previous calibration.
+///
+///----------------------------------------------------------------------------
+static __inline void Attitude_Recalibrate(portTickType * pLast_Wake_Time)
+{
+    int16_t i_offset[6];
+    bool b_still;
+
+    b_still = Attitude_Calibrate(pLast_Wake_Time, i_offset);
+    if (b_still || !Calibration_Valid()) {
+        Calibration_Update(i_offset, BMP085_Get_Temperature());
+    }
+    if (b_still) {
+        (void)Calibration_Save();                               // stalls CPU ~20 ms
+    }
+    Calibration_Get(i_Sensor_Offset, i_Sensor_Scale, BMP085_Get_Temperature());
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   State restore after a watchdog reset.
+/// \return  -
+/// \remarks Offsets, DCM, gyro bias and servo positions are restored, so that
+///          AHRS resumes at once. Saved mode is used for RESTART_HOLD cycles,
+///          until radio signal is valid again.
+///
+///----------------------------------------------------------------------------
+static __inline void Attitude_Restore(void)
+{
+    uint8_t j;
+    const xRestart_State * p_state = Restart_Get();
+
+    if (!Calibration_Load()) {                                  // no stored calibration
+        Calibration_Update(p_state->iOffset, BMP085_Get_Temperature());
+    }
+    Calibration_Get(i_Sensor_Offset, i_Sensor_Scale, BMP085_Get_Temperature());
+    for (j = 0; j < 6; j++) {                                   // offsets before reset
+        i_Sensor_Offset[j] = p_state->iOffset[j];
+    }
+    for (j = 0; j < 9; j++) {
+        DCM_Matrix[j / 3][j % 3] = p_state->fDCM[j / 3][j % 3];
+    }
+    SetGyroBias(p_state->fBias);
+    i_Aileron = p_state->iServo[0];
+    i_Elevator = p_state->iServo[1];
+    i_Throttle = p_state->iServo[2];
+    uc_Hold = RESTART_HOLD;
+}
+
+#if (LOG_BLACKBOX == 1)
+///----------------------------------------------------------------------------
+///
+/// \brief   Black box record.
+/// \return  -
+/// \remarks content is selected by LOG_SENSORS, LOG_DCM, LOG_PPM, LOG_SERVO.
+///          DCM elements are scaled by 16384.
+///
+///----------------------------------------------------------------------------
+static __inline void Attitude_Log(void)
+{
+    uint8_t j, k = 0;
+
+#if (LOG_SENSORS == 1)
+    for (j = 0; j < 6; j++) {                                       // sensors
+        i_Log_Data[k++] = ((int16_t *)uc_Sensor_Data)[j];
+    }
+#endif
+#if (LOG_DCM == 1)
+    for (j = 0; j < 9; j++) {                                       // DCM
+        i_Log_Data[k++] = (int16_t)(DCM_Matrix[j / 3][j % 3] * 16384.0f);
+    }
+#endif
+#if (LOG_PPM == 1)
+    for (j = 0; j < RC_CHANNELS; j++) {                             // RC channels
+        i_Log_Data[k++] = PPMGetChannel(j);
+    }
+#endif
+#if (LOG_SERVO == 1)
+    i_Log_Data[k++] = i_Aileron;                                    // servos
+    i_Log_Data[k++] = i_Elevator;
+    i_Log_Data[k++] = i_Throttle;
+#endif
+    Blackbox_Record(i_Log_Data);
+}
+#endif
+
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Updates a PID or DCM gain.
+/// \param   eId = parameter
+/// \param   fValue = new value
+/// \return  -
+/// \remarks parameter change callback, called by the task that changed the
+///          value. Each gain is a single store, so attitude task never sees
+///          a partial update.
+///
+///----------------------------------------------------------------------------
+static void Attitude_Gain(paramEnum_Id eId, float fValue)
+{
+    switch (eId) {
+        case PARAM_ROLL_KP: Roll_Pid.fKp = fValue; break;
+        case PARAM_ROLL_KI: Roll_Pid.fKi = fValue; break;
+        case PARAM_PITCH_KP: Pitch_Pid.fKp = fValue; break;
+        case PARAM_PITCH_KI: Pitch_Pid.fKi = fValue; break;
+        case PARAM_NAV_KP: Nav_Pid.fKp = fValue; break;
+        case PARAM_NAV_KI: Nav_Pid.fKi = fValue; break;
+        case PARAM_NAV_BANK: Nav_Pid.fGain = ToRad(fValue); break;
+        case PARAM_PITCHROLL_KP: PitchRoll_Kp = fValue; break;
+        case PARAM_YAW_KP: Yaw_Kp = fValue; break;
+        default: break;
+    }
+}
 
 ///----------------------------------------------------------------------------
 ///
@@ -291,16 +639,8 @@ void Attitude_Task(void *pvParameters)
 static __inline void Attitude_Control(void)
 {
     float f_temp;
-    /* update PID gains */
-#if (SIMULATOR == SIM_NONE)
-    Pitch_Pid.fKp = Telemetry_Get_Gain(TEL_PITCH_KP);
-    Pitch_Pid.fKi = Telemetry_Get_Gain(TEL_PITCH_KI);
-    Roll_Pid.fKp = Telemetry_Get_Gain(TEL_ROLL_KP);
-    Roll_Pid.fKi = Telemetry_Get_Gain(TEL_ROLL_KI);
-    Nav_Pid.fKp = Telemetry_Get_Gain(TEL_NAV_KP);
-    Nav_Pid.fKi = Telemetry_Get_Gain(TEL_NAV_KI);
-    Nav_Pid.fGain = Telemetry_Get_Gain(TEL_NAV_BANK);
-#else
+    /* update PID gains, from parameters only when changed */
+#if (SIMULATOR == XPLANE) || (SIMULATOR == FLIGHTGEAR)
     Pitch_Pid.fKp = Simulator_Get_Gain(SIM_PITCH_KP);
     Pitch_Pid.fKi = Simulator_Get_Gain(SIM_PITCH_KI);
     Roll_Pid.fKp = Simulator_Get_Gain(SIM_ROLL_KP);
@@ -309,7 +649,7 @@ static __inline void Attitude_Control(void)
     Nav_Pid.fKi = Simulator_Get_Gain(SIM_NAV_KI);
 #endif
 
-    switch (PPMGetMode()) {
+    switch (uc_Mode) {
 
         case MODE_STAB:                                                 // STABILIZED MODE
             i_Aileron = PPMGetChannel(AILERON_CHANNEL) - SERVO_NEUTRAL;
@@ -469,6 +809,32 @@ float Attitude_Yaw_Rad(void)
     return atan2f(DCM_Matrix[1][0], DCM_Matrix[0][0]);
 }
 
+///----------------------------------------------------------------------------
+///
+/// \brief   Checks that aircraft is on ground.
+/// \return  TRUE in manual mode, with throttle below GROUND_THROTTLE and
+///          either a GPS fix with speed up to GROUND_SPEED, or no fix and
+///          gyro spread within CAL_MAX_SPREAD
+/// \remarks Recalibration stops attitude control and servo update for
+///          seconds, so it's allowed only when this holds. Manual mode alone
+///          is a flight mode. Without a fix, e.g. on the bench or indoors,
+///          speed is unknown and a still aircraft is taken as stopped: even
+///          a glide at idle throttle moves the gyros more than that.
+///
+///----------------------------------------------------------------------------
+bool Attitude_On_Ground(void)
+{
+    if ((PPMGetMode() != MODE_MANUAL) ||
+        (PPMGetChannel(THROTTLE_CHANNEL) >= GROUND_THROTTLE)) {
+        return FALSE;
+    }
+    if (Gps_Fix() == GPS_FIX) {                     // stopped
+        return (bool)(Gps_Speed_Kt() <= GROUND_SPEED);
+    } else {                                        // still
+        return b_Still;
+    }
+}
+
 
 /**
   * @}
@@ -47,3 +47,5 @@ float Attitude_Yaw_Deg(void);
 float Attitude_Pitch_Rad(void);
 float Attitude_Roll_Rad(void);
 float Attitude_Yaw_Rad(void);
+
+bool Attitude_On_Ground(void);
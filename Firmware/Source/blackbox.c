@@ -0,0 +1,379 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief black box recorder
+///
+/// \file
+///  Records are arrays of 16 bit channels (sensors, DCM, servos ...) taken
+///  at the attitude loop rate. Each record is stored as the difference from
+///  the previous one, zig-zag mapped so that small negative values stay small,
+///  and written as a varint (7 bits per byte, MSB set if more bytes follow).
+///  Every BBOX_KEY_PERIOD records, or after a record has been dropped, a key
+///  frame with absolute values is written so that a decoder can resynchronize.
+/// - Record format:
+/// \code
+///   byte | meaning
+/// -------+-----------------------------------------------------------
+///    1   | BBOX_KEY_FRAME or BBOX_DELTA_FRAME
+///    1   | number of channels (key frame only)
+///   1..5 | record counter, varint (key frame only)
+///   ...  | one zig-zag varint per channel, absolute or difference
+/// -------+-----------------------------------------------------------
+/// \endcode
+///  Encoded records are packed in two buffers: the attitude task fills one
+///  while the log task writes the other to SD card.
+///  Log task writes a drop count between two buffers at each file sync, so
+///  that a log with gaps is told from a complete one. It's not a record and
+///  doesn't change the state of the decoder:
+/// \code
+///   byte | meaning
+/// -------+-----------------------------------------------------------
+///    1   | BBOX_DROP_FRAME
+///   1..3 | records dropped since start, varint
+/// -------+-----------------------------------------------------------
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+
+#include "blackbox.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/// zig-zag mapping of a signed difference to an unsigned value
+#define ZIGZAG_ENCODE(x)    ((uint32_t)(((x) << 1) ^ ((x) >> 31)))
+
+/// inverse zig-zag mapping
+#define ZIGZAG_DECODE(x)    ((int32_t)((x) >> 1) ^ -(int32_t)((x) & 1))
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xBBox_Codec x_Encoder;                          //!< encoder state
+VAR_STATIC uint8_t uc_Buffer[2][BBOX_BUFFER_SIZE];         //!< write buffers
+VAR_STATIC uint16_t ui_Length[2];                          //!< bytes in each buffer
+VAR_STATIC volatile bool b_Full[2] = {FALSE, FALSE};       //!< buffer ready to be written
+VAR_STATIC uint8_t uc_Active = 0;                          //!< buffer being filled
+VAR_STATIC uint8_t uc_Pending = 0;                         //!< next buffer to be written
+VAR_STATIC uint8_t uc_Record[BBOX_MAX_RECORD];             //!< encoded record
+VAR_STATIC uint16_t ui_Dropped = 0;                        //!< number of dropped records
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static uint8_t put_varint(uint8_t * pucOut, uint32_t ulValue);
+static uint8_t get_varint(const uint8_t * pucIn, uint32_t * pulValue);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes a varint
+/// \param   pucOut = pointer to destination
+/// \param   ulValue = value to be written
+/// \return  number of bytes written
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint8_t put_varint(uint8_t * pucOut, uint32_t ulValue)
+{
+    uint8_t j = 0;
+
+    while (ulValue >= 0x80) {                   // more than 7 bits left
+        pucOut[j++] = (uint8_t)(ulValue | 0x80);// write 7 bits and continuation
+        ulValue >>= 7;
+    }
+    pucOut[j++] = (uint8_t)ulValue;             // write last 7 bits
+    return j;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads a varint
+/// \param   pucIn = pointer to source
+/// \param   pulValue = pointer to value read
+/// \return  number of bytes read, 0 if varint is longer than 5 bytes
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint8_t get_varint(const uint8_t * pucIn, uint32_t * pulValue)
+{
+    uint8_t j = 0;
+    uint32_t ul_value = 0;
+
+    do {
+        if (j == 5) {                           // too long
+            return 0;
+        }
+        ul_value |= (uint32_t)(pucIn[j] & 0x7F) << (7 * j);
+    } while ((pucIn[j++] & 0x80) != 0);         // continuation bit set
+    *pulValue = ul_value;
+    return j;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   initializes codec state
+/// \param   pxCodec = pointer to codec state
+/// \param   ucChannels = number of channels per record
+/// \return  -
+/// \remarks first record encoded after initialization is a key frame
+///
+///----------------------------------------------------------------------------
+void Blackbox_Codec_Init(xBBox_Codec * pxCodec, uint8_t ucChannels)
+{
+    uint8_t j;
+
+    for (j = 0; j < BBOX_MAX_CHANNELS; j++) {
+        pxCodec->iLast[j] = 0;
+    }
+    pxCodec->ulCount = 0;
+    pxCodec->ucChannels = (ucChannels > BBOX_MAX_CHANNELS) ? BBOX_MAX_CHANNELS : ucChannels;
+    pxCodec->ucKey = 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   encodes a record
+/// \param   pxCodec = pointer to encoder state
+/// \param   piData = pointer to channel values
+/// \param   pucOut = pointer to destination, at least BBOX_MAX_RECORD bytes
+/// \return  length of encoded record
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint8_t Blackbox_Encode(xBBox_Codec * pxCodec, const int16_t * piData, uint8_t * pucOut)
+{
+    uint8_t j, uc_length = 0;
+    int32_t l_delta;
+
+    if (pxCodec->ucKey == 0) {                                  // key frame
+        pxCodec->ucKey = BBOX_KEY_PERIOD;
+        pucOut[uc_length++] = BBOX_KEY_FRAME;
+        pucOut[uc_length++] = pxCodec->ucChannels;
+        uc_length += put_varint(&pucOut[uc_length], pxCodec->ulCount);
+        for (j = 0; j < pxCodec->ucChannels; j++) {
+            pxCodec->iLast[j] = 0;                              // reset predictor
+        }
+    } else {                                                    // delta frame
+        pucOut[uc_length++] = BBOX_DELTA_FRAME;
+    }
+    pxCodec->ucKey--;
+    pxCodec->ulCount++;
+
+    for (j = 0; j < pxCodec->ucChannels; j++) {
+        l_delta = (int32_t)piData[j] - (int32_t)pxCodec->iLast[j];
+        pxCodec->iLast[j] = piData[j];
+        uc_length += put_varint(&pucOut[uc_length], ZIGZAG_ENCODE(l_delta));
+    }
+    return uc_length;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   decodes a record
+/// \param   pxCodec = pointer to decoder state
+/// \param   pucIn = pointer to encoded record
+/// \param   piData = pointer to channel values
+/// \return  length of decoded record, 0 if record is not valid
+/// \remarks decoder state must have been initialized with Blackbox_Codec_Init.
+///          Delta frames are rejected until the first key frame is found.
+///
+///----------------------------------------------------------------------------
+uint8_t Blackbox_Decode(xBBox_Codec * pxCodec, const uint8_t * pucIn, int16_t * piData)
+{
+    uint8_t j, uc_num, uc_length = 0;
+    uint32_t ul_value;
+
+    if (pucIn[uc_length] == BBOX_KEY_FRAME) {                   // key frame
+        uc_length++;
+        if (pucIn[uc_length] > BBOX_MAX_CHANNELS) {             // corrupted
+            return 0;
+        }
+        pxCodec->ucChannels = pucIn[uc_length++];
+        uc_num = get_varint(&pucIn[uc_length], &ul_value);
+        if (uc_num == 0) {
+            return 0;
+        }
+        uc_length += uc_num;
+        pxCodec->ulCount = ul_value;
+        for (j = 0; j < pxCodec->ucChannels; j++) {
+            pxCodec->iLast[j] = 0;                              // reset predictor
+        }
+        pxCodec->ucKey = 1;                                     // synchronized
+    } else if ((pucIn[uc_length] == BBOX_DELTA_FRAME) &&        // delta frame
+               (pxCodec->ucKey != 0)) {                         // after a key frame
+        uc_length++;
+    } else {                                                    // not synchronized
+        return 0;
+    }
+    pxCodec->ulCount++;
+
+    for (j = 0; j < pxCodec->ucChannels; j++) {
+        uc_num = get_varint(&pucIn[uc_length], &ul_value);
+        if (uc_num == 0) {
+            return 0;
+        }
+        uc_length += uc_num;
+        pxCodec->iLast[j] = (int16_t)((int32_t)pxCodec->iLast[j] + ZIGZAG_DECODE(ul_value));
+        piData[j] = pxCodec->iLast[j];
+    }
+    return uc_length;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   encodes a drop count
+/// \param   uiDropped = number of records dropped since start
+/// \param   pucOut = pointer to destination, at least BBOX_MAX_DROP bytes
+/// \return  length of encoded drop count
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint8_t Blackbox_Encode_Dropped(uint16_t uiDropped, uint8_t * pucOut)
+{
+    pucOut[0] = BBOX_DROP_FRAME;
+    return (uint8_t)(1 + put_varint(&pucOut[1], uiDropped));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   decodes a drop count
+/// \param   pucIn = pointer to encoded drop count
+/// \param   puiDropped = pointer to number of records dropped since start
+/// \return  length of drop count, 0 if it's not a valid drop count
+/// \remarks to be tried before Blackbox_Decode, which rejects drop counts
+///
+///----------------------------------------------------------------------------
+uint8_t Blackbox_Decode_Dropped(const uint8_t * pucIn, uint16_t * puiDropped)
+{
+    uint8_t uc_num;
+    uint32_t ul_value;
+
+    if (pucIn[0] != BBOX_DROP_FRAME) {
+        return 0;
+    }
+    uc_num = get_varint(&pucIn[1], &ul_value);
+    if ((uc_num == 0) || (ul_value > 0xFFFF)) {                 // corrupted
+        return 0;
+    }
+    *puiDropped = (uint16_t)ul_value;
+    return (uint8_t)(1 + uc_num);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   initializes black box recorder
+/// \param   ucChannels = number of channels per record
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void Blackbox_Init(uint8_t ucChannels)
+{
+    Blackbox_Codec_Init(&x_Encoder, ucChannels);
+    ui_Length[0] = 0;
+    ui_Length[1] = 0;
+    b_Full[0] = FALSE;
+    b_Full[1] = FALSE;
+    uc_Active = 0;
+    uc_Pending = 0;
+    ui_Dropped = 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   records a sample
+/// \param   piData = pointer to channel values
+/// \return  -
+/// \remarks called by attitude task at each loop. If the active buffer is
+///          full it is handed over to the log task; if the log task has not
+///          written the other buffer yet, the record is dropped and next one
+///          is a key frame. Buffer isn't switched again while dropping, so
+///          buffers are filled in the order log task writes them.
+///
+///----------------------------------------------------------------------------
+void Blackbox_Record(const int16_t * piData)
+{
+    uint8_t j, uc_length;
+
+    uc_length = Blackbox_Encode(&x_Encoder, piData, uc_Record);
+
+    if ((!b_Full[uc_Active]) &&                                 // not handed over yet
+        (ui_Length[uc_Active] + uc_length > BBOX_BUFFER_SIZE)) {// and no room left
+        b_Full[uc_Active] = TRUE;                               // hand over to log task
+        uc_Active ^= 1;                                         // switch buffer
+    }
+    if (b_Full[uc_Active]) {                                    // not written yet
+        ui_Dropped++;                                           // drop record
+        x_Encoder.ucKey = 0;                                    // force key frame
+    } else {
+        for (j = 0; j < uc_length; j++) {
+            uc_Buffer[uc_Active][ui_Length[uc_Active]++] = uc_Record[j];
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets next buffer to be written
+/// \param   puiLength = pointer to buffer length
+/// \return  pointer to buffer, 0 if no buffer is ready
+/// \remarks called by log task, buffer must be released after writing
+///
+///----------------------------------------------------------------------------
+uint8_t * Blackbox_Get_Buffer(uint16_t * puiLength)
+{
+    if (b_Full[uc_Pending]) {
+        *puiLength = ui_Length[uc_Pending];
+        return uc_Buffer[uc_Pending];
+    } else {
+        *puiLength = 0;
+        return 0;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   releases buffer after writing
+/// \return  -
+/// \remarks buffer can be filled again by attitude task
+///
+///----------------------------------------------------------------------------
+void Blackbox_Release_Buffer(void)
+{
+    ui_Length[uc_Pending] = 0;
+    b_Full[uc_Pending] = FALSE;
+    uc_Pending ^= 1;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets number of dropped records
+/// \return  number of records dropped because log task was late
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Blackbox_Dropped(void)
+{
+    return ui_Dropped;
+}
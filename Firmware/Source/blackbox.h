@@ -0,0 +1,63 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief black box recorder header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define BBOX_MAX_CHANNELS   32      //!< max number of channels per record
+#define BBOX_MAX_RECORD     (2 + 5 + (3 * BBOX_MAX_CHANNELS)) //!< max encoded record size
+#define BBOX_MAX_DROP       (1 + 3) //!< max encoded drop count size
+#define BBOX_BUFFER_SIZE    256     //!< size of each of the two write buffers
+#define BBOX_KEY_PERIOD     50      //!< records between two key frames
+
+#define BBOX_KEY_FRAME      0xA5    //!< key frame marker, absolute values follow
+#define BBOX_DELTA_FRAME    0x5A    //!< delta frame marker, differences follow
+#define BBOX_DROP_FRAME     0xD2    //!< drop count marker, records dropped so far follow
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// black box codec state, one for encoder and one for decoder
+typedef struct {
+    int16_t iLast[BBOX_MAX_CHANNELS]; ///< last value of each channel
+    uint32_t ulCount;                 ///< record counter
+    uint8_t ucChannels;               ///< number of channels per record
+    uint8_t ucKey;                    ///< records left until next key frame
+} xBBox_Codec;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Blackbox_Codec_Init(xBBox_Codec * pxCodec, uint8_t ucChannels);
+uint8_t Blackbox_Encode(xBBox_Codec * pxCodec, const int16_t * piData, uint8_t * pucOut);
+uint8_t Blackbox_Decode(xBBox_Codec * pxCodec, const uint8_t * pucIn, int16_t * piData);
+uint8_t Blackbox_Encode_Dropped(uint16_t uiDropped, uint8_t * pucOut);
+uint8_t Blackbox_Decode_Dropped(const uint8_t * pucIn, uint16_t * puiDropped);
+
+void Blackbox_Init(uint8_t ucChannels);
+void Blackbox_Record(const int16_t * piData);
+uint8_t * Blackbox_Get_Buffer(uint16_t * puiLength);
+void Blackbox_Release_Buffer(void);
+uint16_t Blackbox_Dropped(void);
@@ -0,0 +1,146 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief start up sequence
+///
+/// \file
+///  Start up steps run concurrently in their own tasks and signal completion
+///  with event flags. A step waits only for the steps it depends on:
+/// \code
+///   step                | task        | waits for
+/// ----------------------+-------------+-----------------------------------
+///   BOOT_FS_MOUNTED     | main        | -
+///   BOOT_MISSION_LOADED | navigation  | BOOT_FS_MOUNTED
+///   BOOT_GPS_CONFIGURED | navigation  | BOOT_MISSION_LOADED (shared buffer)
+///   BOOT_LOG_OPEN       | log         | BOOT_FS_MOUNTED
+///   BOOT_SENSORS_CALIB. | attitude    | -
+///   BOOT_CONTROL_ACTIVE | attitude    | BOOT_SENSORS_CALIBRATED
+/// ----------------------+-------------+-----------------------------------
+/// \endcode
+///  Tick count of each event is saved, so that time to first valid control
+///  output can be reported.
+///  FreeRTOS V7.1.0 has no event groups: a waiting task checks flags once
+///  per tick.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "stm32f10x.h"
+#include "boot.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC volatile uint8_t uc_Flags = 0;           //!< start up events
+VAR_STATIC portTickType Event_Time[BOOT_EVENTS];    //!< tick count of events
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   signals a start up event
+/// \param   event = start up event
+/// \return  -
+/// \remarks can be called before starting scheduler, event time is then 0.
+///          Only first call has effect.
+///
+///----------------------------------------------------------------------------
+void Boot_Signal(bootEnum_Event event)
+{
+    uint8_t j;
+
+    if ((uc_Flags & (uint8_t)event) != 0) {         // already signaled
+        return;
+    }
+    for (j = 0; j < BOOT_EVENTS; j++) {             // save event time
+        if ((uint8_t)event == (1 << j)) {
+            Event_Time[j] = xTaskGetTickCount();
+        }
+    }
+    taskENTER_CRITICAL();
+    uc_Flags |= (uint8_t)event;                     // set flag
+    taskEXIT_CRITICAL();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   waits for start up events
+/// \param   uc_Events = combination of events to wait for
+/// \param   Timeout = max waiting time [ticks], portMAX_DELAY to wait forever
+/// \return  TRUE if all events have been signaled
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Boot_Wait(uint8_t uc_Events, portTickType Timeout)
+{
+    while ((uc_Flags & uc_Events) != uc_Events) {   // not all events signaled
+        if (Timeout == 0) {
+            return FALSE;
+        }
+        if (Timeout != portMAX_DELAY) {
+            Timeout--;
+        }
+        vTaskDelay(1);                              // check again next tick
+    }
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks start up events
+/// \param   uc_Events = combination of events
+/// \return  TRUE if all events have been signaled
+/// \remarks doesn't wait
+///
+///----------------------------------------------------------------------------
+bool Boot_Done(uint8_t uc_Events)
+{
+    return ((uc_Flags & uc_Events) == uc_Events);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   time of a start up event
+/// \param   event = start up event
+/// \return  tick count when event was signaled, 0 if not signaled yet
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+portTickType Boot_Time(bootEnum_Event event)
+{
+    uint8_t j;
+
+    if ((uc_Flags & (uint8_t)event) != 0) {
+        for (j = 0; j < BOOT_EVENTS; j++) {
+            if ((uint8_t)event == (1 << j)) {
+                return Event_Time[j];
+            }
+        }
+    }
+    return 0;
+}
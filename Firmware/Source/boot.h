@@ -0,0 +1,50 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief start up sequence header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define BOOT_EVENTS     6       //!< number of start up events
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/// start up events, each one is a flag
+typedef enum E_BOOT {
+    BOOT_FS_MOUNTED         = 0x01, //!< file system mount attempted
+    BOOT_MISSION_LOADED     = 0x02, //!< mission file read, SD released by navigation
+    BOOT_GPS_CONFIGURED     = 0x04, //!< GPS USART and DMA configured
+    BOOT_SENSORS_CALIBRATED = 0x08, //!< sensor offsets computed
+    BOOT_LOG_OPEN           = 0x10, //!< log file open attempted
+    BOOT_CONTROL_ACTIVE     = 0x20  //!< first valid control output
+} bootEnum_Event;
+
+/*------------------------------------ Types ---------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Boot_Signal(bootEnum_Event event);
+bool Boot_Wait(uint8_t uc_Events, portTickType Timeout);
+bool Boot_Done(uint8_t uc_Events);
+portTickType Boot_Time(bootEnum_Event event);
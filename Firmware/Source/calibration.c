@@ -0,0 +1,263 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief sensor calibration
+///
+/// \file
+///  Sensor offsets, scale factors and a linear model of gyro offset versus
+///  BMP085 temperature are kept in the last page of internal flash, so that
+///  they are available at power up without averaging sensor samples.
+///  Gyro offset at temperature T is
+/// \code
+///   offset(T) = iOffset + iSlope * (T - iTemperature) / 1000
+/// \endcode
+///  The slope is learned each time a new calibration is made at a temperature
+///  differing by at least CAL_MIN_DELTA_T from the reference temperature.
+///  Scale factors can't be observed by a calibration in one orientation, they
+///  are left to nominal value unless the record is written by other means.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "stm32f10x.h"
+#include "stm32f10x_flash.h"
+#include "calibration.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/* size of calibration record in half words */
+#define CAL_HALF_WORDS  (sizeof(xCalibration) / 2)
+
+/* max gyro offset drift [LSB / 100 deg C] */
+#define CAL_MAX_SLOPE   3200
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xCalibration x_Cal;                  //!< working copy of calibration
+VAR_STATIC bool b_Valid = FALSE;                //!< working copy holds a calibration
+VAR_STATIC volatile bool b_Request = FALSE;     //!< recalibration requested
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static uint16_t Calibration_Checksum(const xCalibration * pxCal);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   computes checksum of a calibration record
+/// \param   pxCal = pointer to record
+/// \return  ones' complement of the sum of all half words but the checksum
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint16_t Calibration_Checksum(const xCalibration * pxCal)
+{
+    uint8_t j;
+    uint16_t ui_sum = 0;
+    const uint16_t * p_data = (const uint16_t *)pxCal;
+
+    for (j = 0; j < CAL_HALF_WORDS - 1; j++) {
+        ui_sum += p_data[j];
+    }
+    return (uint16_t)~ui_sum;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   loads calibration from flash
+/// \return  TRUE if flash holds a valid calibration
+/// \remarks working copy is left unchanged if flash record is not valid
+///
+///----------------------------------------------------------------------------
+bool Calibration_Load(void)
+{
+    const xCalibration * p_flash = (const xCalibration *)CAL_PAGE_ADDRESS;
+
+    if ((p_flash->ulMagic != CAL_MAGIC) ||                  // erased or other version
+        (p_flash->uiChecksum != Calibration_Checksum(p_flash))) {
+        return FALSE;
+    }
+    x_Cal = *p_flash;
+    b_Valid = TRUE;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   saves calibration to flash
+/// \return  TRUE if calibration has been written
+/// \remarks Page erase stalls the CPU for about 20 ms, call only on ground.
+///          Flash isn't written if it already holds the same record.
+///
+///----------------------------------------------------------------------------
+bool Calibration_Save(void)
+{
+    uint8_t j;
+    uint32_t ul_address = CAL_PAGE_ADDRESS;
+    const uint16_t * p_data = (const uint16_t *)&x_Cal;
+    const uint16_t * p_flash = (const uint16_t *)CAL_PAGE_ADDRESS;
+    FLASH_Status status;
+
+    if (!b_Valid) {                                         // nothing to save
+        return FALSE;
+    }
+    x_Cal.ulMagic = CAL_MAGIC;
+    x_Cal.iReserved = 0;
+    x_Cal.uiChecksum = Calibration_Checksum(&x_Cal);
+
+    for (j = 0; (j < CAL_HALF_WORDS) && (p_data[j] == p_flash[j]); j++) {
+    }
+    if (j == CAL_HALF_WORDS) {                              // no changes
+        return TRUE;
+    }
+
+    FLASH_Unlock();
+    FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPRTERR);
+    status = FLASH_ErasePage(CAL_PAGE_ADDRESS);
+    for (j = 0; (j < CAL_HALF_WORDS) && (status == FLASH_COMPLETE); j++) {
+        status = FLASH_ProgramHalfWord(ul_address, p_data[j]);
+        ul_address += 2;
+    }
+    FLASH_Lock();
+
+    return (status == FLASH_COMPLETE);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   calibration status
+/// \return  TRUE if a calibration has been loaded or computed
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Calibration_Valid(void)
+{
+    return b_Valid;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   updates calibration with new sensor offsets
+/// \param   piOffset = pointer to sensor offsets
+/// \param   iTemperature = temperature during calibration [0.1 deg C]
+/// \return  -
+/// \remarks Gyro slope is computed from previous and new offsets if the
+///          temperature changed enough, otherwise previous slope is kept.
+///          Working copy only, call Calibration_Save to write flash.
+///
+///----------------------------------------------------------------------------
+void Calibration_Update(const int16_t * piOffset, int16_t iTemperature)
+{
+    uint8_t j;
+    int32_t l_slope;
+    int32_t l_delta = (int32_t)iTemperature - x_Cal.iTemperature;
+
+    if (!b_Valid) {                                         // first calibration
+        for (j = 0; j < CAL_SENSORS; j++) {
+            x_Cal.iScale[j] = CAL_SCALE_ONE;
+        }
+        for (j = 0; j < 3; j++) {
+            x_Cal.iSlope[j] = 0;
+        }
+    } else if ((l_delta >= CAL_MIN_DELTA_T) || (l_delta <= -CAL_MIN_DELTA_T)) {
+        for (j = 0; j < 3; j++) {                           // two point slope
+            l_slope = ((int32_t)piOffset[j + 3] - x_Cal.iOffset[j + 3]) * 1000L;
+            l_slope /= l_delta;
+            if (l_slope > CAL_MAX_SLOPE) {
+                l_slope = CAL_MAX_SLOPE;
+            } else if (l_slope < -CAL_MAX_SLOPE) {
+                l_slope = -CAL_MAX_SLOPE;
+            }
+            x_Cal.iSlope[j] = (int16_t)l_slope;
+        }
+    }
+    for (j = 0; j < CAL_SENSORS; j++) {
+        x_Cal.iOffset[j] = piOffset[j];
+    }
+    x_Cal.iTemperature = iTemperature;
+    b_Valid = TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets temperature compensated offsets and scale factors
+/// \param   piOffset = pointer to sensor offsets
+/// \param   piScale = pointer to sensor scale factors, Q12
+/// \param   iTemperature = current temperature [0.1 deg C]
+/// \return  -
+/// \remarks offsets are 0 and scale factors nominal if there's no calibration
+///
+///----------------------------------------------------------------------------
+void Calibration_Get(int16_t * piOffset, int16_t * piScale, int16_t iTemperature)
+{
+    uint8_t j;
+    int32_t l_delta = (int32_t)iTemperature - x_Cal.iTemperature;
+
+    for (j = 0; j < CAL_SENSORS; j++) {
+        if (b_Valid) {
+            piOffset[j] = x_Cal.iOffset[j];
+            piScale[j] = x_Cal.iScale[j];
+        } else {
+            piOffset[j] = 0;
+            piScale[j] = CAL_SCALE_ONE;
+        }
+    }
+    if (b_Valid) {
+        for (j = 0; j < 3; j++) {                           // gyro drift
+            piOffset[j + 3] += (int16_t)((x_Cal.iSlope[j] * l_delta) / 1000L);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   requests a new calibration
+/// \return  -
+/// \remarks called by telemetry, calibration is made by attitude task
+///
+///----------------------------------------------------------------------------
+void Calibration_Request(void)
+{
+    b_Request = TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks and clears calibration request
+/// \return  TRUE if a new calibration has been requested
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Calibration_Requested(void)
+{
+    bool b_request;
+
+    taskENTER_CRITICAL();
+    b_request = b_Request;
+    b_Request = FALSE;
+    taskEXIT_CRITICAL();
+    return b_request;
+}
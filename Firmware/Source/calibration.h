@@ -0,0 +1,59 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief sensor calibration header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define CAL_PAGE_ADDRESS    0x0801FC00  //!< last 1 KB page of flash, excluded from IROM
+#define CAL_MAGIC           0xCA1B0001  //!< record signature and version
+#define CAL_SENSORS         6           //!< acceleration X, Y, Z, rotation X, Y, Z
+#define CAL_SCALE_SHIFT     12          //!< scale factors are Q12
+#define CAL_SCALE_ONE       (1 << CAL_SCALE_SHIFT)  //!< nominal scale factor
+#define CAL_MIN_DELTA_T     50          //!< min temperature change for gyro slope [0.1 deg C]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// calibration record, stored in flash
+typedef struct {
+    uint32_t ulMagic;                   ///< signature and version
+    int16_t iOffset[CAL_SENSORS];       ///< sensor offsets at reference temperature
+    int16_t iScale[CAL_SENSORS];        ///< sensor scale factors, Q12
+    int16_t iTemperature;               ///< reference temperature [0.1 deg C]
+    int16_t iSlope[3];                  ///< gyro offset drift [LSB / 100 deg C]
+    int16_t iReserved;                  ///< padding to a whole number of words
+    uint16_t uiChecksum;                ///< ones' complement of halfword sum
+} xCalibration;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+bool Calibration_Load(void);
+bool Calibration_Save(void);
+bool Calibration_Valid(void);
+void Calibration_Update(const int16_t * piOffset, int16_t iTemperature);
+void Calibration_Get(int16_t * piOffset, int16_t * piScale, int16_t iTemperature);
+void Calibration_Request(void);
+bool Calibration_Requested(void);
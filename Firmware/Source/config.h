@@ -10,6 +10,7 @@
 /// \file
 ///
 // Change: restored sensor calibration, removed option
+//         MAVLink hardware in the loop simulator option
 //
 //============================================================================*/
 
@@ -51,6 +52,11 @@
 // +/-2000 dps |       0.07000      |      0.001221730
 #define GYRO_GAIN       0.001221730f    // full scale = 2000 dps
 
+/// Sign of sensor data, so that acceleration x is positive forward, y
+/// rightward, z downward, roll rate positive when right wing lowers, pitch
+/// rate when tail lowers, yaw rate when turning right
+#define SENSOR_SIGN     { -1, 1, 1, 1, -1, -1 }
+
 /* Navigation PID initial gains */
 #define NAV_KP          5.0f            //!< Navigation P gain
 #define NAV_KI          0.05f           //!< Navigation I gain
@@ -77,6 +83,12 @@
 #define PITCH_KI        0.1f            //!< Pitch P gain
 #define PITCH_KD        0.0f            //!< Pitch D gain
 
+/* DCM drift correction initial gains */
+#define PITCHROLL_KP    0.03f           //!< Roll/pitch P gain, typical 0.1, 0.015, 0.01, 0.0013
+#define PITCHROLL_KI    0.000005f       //!< Roll/pitch I gain, typical 0.000005, 0.000002
+#define YAW_KP          0.5f            //!< Yaw P gain, typical 0.5, 0.27
+#define YAW_KI          0.0005f         //!< Yaw I gain, typical 0.0005
+
 /* Angle that the nose of the plane will pitch downward during
    a return to launch, used to increase speed (and wind penetration).
    Set it to zero to disable this feature. */
@@ -111,6 +123,7 @@
 #define SIM_NONE    0                   //!< No simulator
 #define XPLANE      1                   //!< Simulator X-Plane
 #define FLIGHTGEAR  2                   //!< Simulator Flightgear
+#define HIL_MAVLINK 3                   //!< Simulator with MAVLink HIL messages
 #define SIMULATOR   SIM_NONE            //!< Current simulator option
 
 /* Sensor type definitions for multiwii protocol */
@@ -131,11 +144,21 @@
 #define LOG_DCM     0                   //!< enable log of DCM matrix
 #define LOG_PPM     0                   //!< enable log of RC channels
 #define LOG_SERVO   0                   //!< enable log of servo positions
+#define LOG_BLACKBOX 0                  //!< enable binary log of above data at loop rate
+
+/* Profile definitions */
+#ifndef PROFILE
+#define PROFILE     0                   //!< enable execution time of profile zones, see profile.h
+#endif
 
 /*! Telemetry type definition */
 //#define TELEMETRY_MULTIWII
 #define TELEMETRY_MAVLINK
 
+#if (SIMULATOR == HIL_MAVLINK) && !defined(TELEMETRY_MAVLINK)
+#error MAVLink HIL simulator requires MAVLink telemetry !
+#endif
+
  /*! Type of aircraft */
 //#define GIMBAL
 //#define BI
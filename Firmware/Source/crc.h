@@ -0,0 +1,43 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief X25 CRC header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define CRC_X25_INIT        0xFFFF      //!< initial value of X25 CRC
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/// accumulates one byte into a X25 CRC
+#define Crc_X25_Byte(uiCrc, ucData) \
+    ((uint16_t)(((uiCrc) >> 8) ^ Crc_X25_Table[((uiCrc) ^ (ucData)) & 0xFF]))
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+VAR_GLOBAL const uint16_t Crc_X25_Table[256];   //!< CRC of each byte value
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+uint16_t Crc_X25(uint16_t uiCrc, const uint8_t * pucData, uint16_t uiLength);
@@ -0,0 +1,197 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief file system
+///
+/// \file
+///  Pool of file objects for tasks accessing SD card (mission, log).
+///  FatFs is configured with _FS_TINY, so all files share the sector window
+///  of the file system object instead of having one 512 byte buffer each,
+///  and with _FS_REENTRANT, so that each file function locks the volume with
+///  a FreeRTOS mutex. Tasks can then open files at the same time without any
+///  other synchronization.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "stm32f10x.h"
+#include "ff.h"
+#include "filesystem.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC FATFS st_Fat;                            //!< FAT object
+VAR_STATIC FIL st_File[FILE_POOL_SIZE];             //!< file objects
+VAR_STATIC bool b_Used[FILE_POOL_SIZE];             //!< file object in use
+VAR_STATIC bool b_FS_Ok = FALSE;                    //!< file system status
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   mounts file system
+/// \return  TRUE if file system has been mounted
+/// \remarks called by main before starting scheduler
+///
+///----------------------------------------------------------------------------
+bool File_Init(void)
+{
+    uint8_t j;
+
+    for (j = 0; j < FILE_POOL_SIZE; j++) {
+        b_Used[j] = FALSE;
+    }
+    b_FS_Ok = (FR_OK == f_mount(0, &st_Fat)) ? TRUE : FALSE;
+    return b_FS_Ok;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   file system status
+/// \return  TRUE if file system is mounted
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool File_Ready(void)
+{
+    return b_FS_Ok;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   opens a file
+/// \param   psz_Name = file name
+/// \param   uc_Mode = FatFs access mode (FA_READ, FA_WRITE ...)
+/// \return  pointer to file object, 0 if no file object is available or
+///          file could not be opened
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+FIL * File_Open(const uint8_t * psz_Name, uint8_t uc_Mode)
+{
+    uint8_t j;
+    FIL * p_file = 0;
+
+    if (!b_FS_Ok) {                                     // file system not mounted
+        return 0;
+    }
+
+    taskENTER_CRITICAL();                               // get a free file object
+    for (j = 0; (j < FILE_POOL_SIZE) && (p_file == 0); j++) {
+        if (!b_Used[j]) {
+            b_Used[j] = TRUE;
+            p_file = &st_File[j];
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if ((p_file != 0) &&                                // got a file object but
+        (FR_OK != f_open(p_file, (const XCHAR *)psz_Name, uc_Mode))) {
+        File_Close(p_file);                             // couldn't open file
+        p_file = 0;
+    }
+    return p_file;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   closes a file
+/// \param   p_File = pointer to file object
+/// \return  -
+/// \remarks file object is returned to the pool
+///
+///----------------------------------------------------------------------------
+void File_Close(FIL * p_File)
+{
+    uint8_t j;
+
+    ( void )f_close(p_File);                            // no effect if not open
+    for (j = 0; j < FILE_POOL_SIZE; j++) {
+        if (p_File == &st_File[j]) {
+            b_Used[j] = FALSE;                          // release file object
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   creates the mutex of a volume
+/// \param   vol = volume number
+/// \param   sobj = pointer to mutex handle
+/// \return  TRUE if mutex has been created
+/// \remarks called by f_mount
+///
+///----------------------------------------------------------------------------
+BOOL ff_cre_syncobj(BYTE vol, _SYNC_t * sobj)
+{
+    (void)vol;
+    *sobj = xSemaphoreCreateMutex();
+    return (*sobj != NULL);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   deletes the mutex of a volume
+/// \param   sobj = mutex handle
+/// \return  TRUE
+/// \remarks mutex is kept, memory can't be freed with heap_1
+///
+///----------------------------------------------------------------------------
+BOOL ff_del_syncobj(_SYNC_t sobj)
+{
+    (void)sobj;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   locks a volume
+/// \param   sobj = mutex handle
+/// \return  TRUE if volume has been locked within _FS_TIMEOUT ticks
+/// \remarks called on entering each file function
+///
+///----------------------------------------------------------------------------
+BOOL ff_req_grant(_SYNC_t sobj)
+{
+    return (xSemaphoreTake((xSemaphoreHandle)sobj, _FS_TIMEOUT) == pdTRUE);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   unlocks a volume
+/// \param   sobj = mutex handle
+/// \return  -
+/// \remarks called on leaving each file function
+///
+///----------------------------------------------------------------------------
+void ff_rel_grant(_SYNC_t sobj)
+{
+    (void)xSemaphoreGive((xSemaphoreHandle)sobj);
+}
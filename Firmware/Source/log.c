@@ -19,10 +19,13 @@
 
 #include "stm32f10x.h"
 #include "ff.h"
-#include "bmp085_driver.h"
+#include "config.h"
+#include "BMP085_driver.h"
 #include "ppmdriver.h"
 #include "nav.h"
-#include "globals.h"
+#include "filesystem.h"
+#include "boot.h"
+#include "blackbox.h"
 #include "log.h"
 
 /*--------------------------------- Definitions ------------------------------*/
@@ -32,6 +35,8 @@
 #endif
 
 #define MAX_SAMPLES 2000    //!< Max number of samples that can be written
+#define BBOX_DELAY  (configTICK_RATE_HZ / 20) //!< black box polling period
+#define BBOX_SYNC   4       //!< black box buffers written between file syncs
 
 /*----------------------------------- Macros ---------------------------------*/
 
@@ -49,19 +54,27 @@
 
 VAR_STATIC uint8_t uc_Index = 0;
 VAR_STATIC bool b_File_Ok = FALSE;
+VAR_STATIC FIL * p_File;                        //!< log file
 VAR_STATIC UINT wWritten;
 VAR_STATIC uint8_t * p_Data;
 VAR_STATIC portTickType Last_Wake_Time;
 VAR_STATIC int32_t l_Value[8];                  //!< sample values
 VAR_STATIC uint16_t ui_Samples = 0;             //!< sample counter
 VAR_STATIC uint8_t sz_String[48];               //!< generic string
+#if (LOG_BLACKBOX == 1)
+VAR_STATIC uint8_t sz_File[16] = "log0.bin";    //!< file name
+#else
 VAR_STATIC uint8_t sz_File[16] = "log0.txt";    //!< file name
+#endif
 
 /*--------------------------------- Prototypes -------------------------------*/
 
 static void log_write(int32_t *data, uint8_t num);
 static __inline void log_raw_gps(void);
 static __inline void log_position(void);
+#if (LOG_BLACKBOX == 1)
+static __inline void log_blackbox(void);
+#endif
 
 /*--------------------------------- Functions --------------------------------*/
 
@@ -69,10 +82,9 @@ static __inline void log_position(void);
 ///
 /// \brief   log task
 /// \return  -
-/// \remarks task initially waits 20 sec to avoid contention between log file
-///          and path file, read by navigation task.
-/// \todo    replace delay with another synchonization system between log task
-///          and nav task
+/// \remarks log file and path file, read by navigation task, can be open at
+///          the same time: accesses are serialized by file system mutex.
+///          Log file is opened as soon as file system has been mounted.
 ///
 ///----------------------------------------------------------------------------
 void Log_Task( void *pvParameters ) {
@@ -85,19 +97,16 @@ void Log_Task( void *pvParameters ) {
 
     Last_Wake_Time = xTaskGetTickCount();
 
-    // wait 10 sec for navigation task to complete reading waypoint file
-    vTaskDelayUntil(&Last_Wake_Time, configTICK_RATE_HZ * 10);
-
-    // halt if file system not mounted
-    while (!b_FS_Ok) {
-    }
+    // wait file system mount
+    (void)Boot_Wait(BOOT_FS_MOUNTED, portMAX_DELAY);
 
     // Search last log file
     for (j = 0; (j < 10) && b_found; j++) {     //
         sz_File[3] = '0' + j;                   // Append file number
-        if (FR_OK == f_open(&st_File, (const XCHAR *)sz_File, FA_WRITE)) {
+        p_File = File_Open(sz_File, FA_WRITE);  //
+        if (p_File != 0) {                      //
             b_found = TRUE;                     // File exist
-            ( void )f_close(&st_File);          // Close file
+            File_Close(p_File);                 // Close file
         } else {                                //
             b_found = FALSE;                    // File doesn't exist
         }
@@ -105,13 +114,19 @@ void Log_Task( void *pvParameters ) {
 
     // Open new log file
     if (!b_found) {                             // File doesn't exist
-        if (FR_OK == f_open(&st_File, (const XCHAR *)sz_File, FA_WRITE|FA_CREATE_ALWAYS)) {
+        p_File = File_Open(sz_File, FA_WRITE|FA_CREATE_ALWAYS);
+        if (p_File != 0) {                      //
             b_File_Ok = TRUE;                   // File succesfully open
         }
     }
+    Boot_Signal(BOOT_LOG_OPEN);                 // log ready, or failed
 
+#if (LOG_BLACKBOX == 1)
+    log_blackbox();                     // log black box records
+#else
     // wait until RC is turned on
     while (PPMGetMode() == MODE_RTL) {
+        vTaskDelay(1);                  // check again next tick
     }
 
     if (PPMGetMode() == MODE_MANUAL) {  // mode manual
@@ -119,6 +134,7 @@ void Log_Task( void *pvParameters ) {
     } else {                            // mode stab or nav
         log_position();                 // log position
     }
+#endif
 /*
     while ( xLog_Queue != 0 ) {
         while (xQueueReceive( xLog_Queue, &message, portMAX_DELAY ) != pdPASS) {
@@ -159,10 +175,10 @@ static void log_write(int32_t *data, uint8_t num)
     }
     sz_String[j++] = '\n';                                  // terminate line
     if (b_File_Ok) {                                        // file is open
-        ( void )f_write(&st_File, sz_String, j, &wWritten); // write line
+        ( void )f_write(p_File, sz_String, j, &wWritten);   // write line
         if ((j != wWritten) ||                              // no file space
             (ui_Samples >= MAX_SAMPLES)) {                  // too many samples
-            ( void )f_close(&st_File);                      // close file
+            File_Close(p_File);                             // close file
             b_File_Ok = FALSE;                              // halt logging
         } else {                                            // write successfull
             ui_Samples++;                                   // update sample counter
@@ -187,20 +203,21 @@ static __inline void log_raw_gps(void) {
         while ((!b_File_Ok) || 
                (Gps_Fix() != GPS_FIX) ||
                (Gps_Buffer_Index() == uc_Index)) {
+            vTaskDelay(1);              // check again next tick
         }
 
         // get GPS buffer pointer
         p_Data = Gps_Buffer_Pointer();
 
         // log raw GPS buffer
-        (void)f_write(&st_File, p_Data, (BUFFER_LENGTH / 2), &wWritten);
+        (void)f_write(p_File, p_Data, (BUFFER_LENGTH / 2), &wWritten);
 
         // update index
         uc_Index = (uc_Index + (BUFFER_LENGTH / 2)) % BUFFER_LENGTH;
 
         if (((BUFFER_LENGTH / 2) != wWritten) || // no file space
              (++ui_Samples >= MAX_SAMPLES)) {    // too many samples
-            ( void )f_close(&st_File);           // close file
+            File_Close(p_File);                  // close file
             b_File_Ok = FALSE;                   // halt GPS logging
         }
     }
@@ -225,6 +242,7 @@ static __inline void log_position(void) {
 
         // halt if file not open
         while (!b_File_Ok) {
+            vTaskDelay(1);              // check again next tick
         }
 
         l_Value [0] = Gps_Latitude();           // get latitude
@@ -236,6 +254,50 @@ static __inline void log_position(void) {
     }
 }
 
+#if (LOG_BLACKBOX == 1)
+///----------------------------------------------------------------------------
+///
+/// \brief   writes black box buffers to SD card
+/// \param   -
+/// \return  -
+/// \remarks buffers are filled by attitude task at loop rate. File is synced
+///          every BBOX_SYNC buffers, so that data is not lost at power off.
+///          The number of records dropped so far is written before each
+///          sync, so gaps in the log are known. Buffers are discarded if
+///          file is not open.
+///
+///----------------------------------------------------------------------------
+static __inline void log_blackbox(void) {
+
+    uint16_t ui_length;
+    uint8_t uc_buffers = 0;
+    uint8_t uc_drop[BBOX_MAX_DROP];
+
+    while (1) {
+
+        // wake up 20 times per second
+        vTaskDelayUntil(&Last_Wake_Time, BBOX_DELAY);
+
+        // write all full buffers
+        while ((p_Data = Blackbox_Get_Buffer(&ui_length)) != 0) {
+            if (b_File_Ok) {                                        // file is open
+                ( void )f_write(p_File, p_Data, ui_length, &wWritten);
+                if (ui_length != wWritten) {                        // no file space
+                    File_Close(p_File);                             // close file
+                    b_File_Ok = FALSE;                              // halt logging
+                } else if (++uc_buffers >= BBOX_SYNC) {             // time to sync
+                    uc_buffers = 0;
+                    ui_length = Blackbox_Encode_Dropped(Blackbox_Dropped(), uc_drop);
+                    ( void )f_write(p_File, uc_drop, ui_length, &wWritten); // drop count
+                    ( void )f_sync(p_File);                         // flush file
+                }
+            }
+            Blackbox_Release_Buffer();                              // refill buffer
+        }
+    }
+}
+#endif
+
 ///----------------------------------------------------------------------------
 ///
 /// \brief   float to ASCII conversion
@@ -14,11 +14,8 @@
 /// from specific modules and call them from inside task, this should improve
 /// testability.
 ///
-/// \todo
-/// 2) Use only one data structure for SD file read/write, add a semaphore
-/// to manage multiple accesses, this will reduce RAM usage by 512 bytes.
-///
-// Change: increased stack sizes to 128 bytes
+// Change: MAVLink streams scheduled within link budget
+//         MAVLink hardware in the loop runs the MAVLink telemetry task
 //
 //============================================================================*/
 
@@ -31,22 +28,28 @@
 #include "misc.h"
 
 #include "i2c_mems_driver.h"
-#include "l3g4200d_driver.h"
-#include "adxl345_driver.h"
+#include "l3g4200D_driver.h"
+#include "ADXL345_driver.h"
 #include "servodriver.h"
 #include "ppmdriver.h"
+#include "ring.h"
 #include "usart1driver.h"
 #include "diskio.h"
 #include "ff.h"
 
 #include "config.h"
+#include "filesystem.h"
+#include "boot.h"
+#include "restart.h"
+#include "param.h"
+#include "store.h"
 #include "simulator.h"
 #include "mav_telemetry.h"
 #include "attitude.h"
 #include "log.h"
 #include "led.h"
 #include "nav.h"
-#include "globals.h"
+#include "profile.h"
 
 /** @addtogroup cortex_ap
   * @{
@@ -89,10 +92,6 @@
 
 /*---------------------------------- Globals ---------------------------------*/
 
-VAR_GLOBAL FATFS st_Fat;    //!< FAT object
-VAR_GLOBAL FIL st_File;     //!< file object
-VAR_GLOBAL bool b_FS_Ok;    //!< file status
-
 /*----------------------------------- Locals ---------------------------------*/
 
 VAR_STATIC bool b_watchdog_reset;
@@ -130,7 +129,7 @@ void vApplicationStackOverflowHook( xTaskHandle *pxTask, int8_t *pcTaskName ) {
 ///----------------------------------------------------------------------------
 void Telemetry_Task( void *pvParameters ) {
 
-#if (SIMULATOR != SIM_NONE)
+#if (SIMULATOR == XPLANE) || (SIMULATOR == FLIGHTGEAR)
 
     uint8_t ucCycles = 0;
     portTickType Last_Wake_Time;                //
@@ -148,6 +147,10 @@ void Telemetry_Task( void *pvParameters ) {
                 Simulator_Send_DCM();           // send attitude
                 break;
 
+            case 20:
+                Simulator_Send_Link();          // send uplink lost and discarded frames
+                break;
+
             case 40:
                 ucCycles = 0;                   // reset cycle counter
                 Simulator_Send_Waypoint();      // send waypoint information
@@ -157,26 +160,26 @@ void Telemetry_Task( void *pvParameters ) {
 
 #elif defined TELEMETRY_MAVLINK
 
-    uint8_t ucCycles = 0;
     portTickType Last_Wake_Time;                //
     Last_Wake_Time = xTaskGetTickCount();       //
 //    global_data_reset_param_defaults();         // Load default parameters as fallback
 
     (void)pvParameters;
 
+    Mavlink_Init();                             // Set up stream scheduler
+
     for (;;)  {
         vTaskDelayUntil(&Last_Wake_Time, TELEMETRY_DELAY);  // Use any wait function, better not use sleep
         Mavlink_Receive();                      // Process parameter request, if occured
-        Mavlink_Stream_Send();                  // Send data streams
-        Mavlink_Queued_Send(ucCycles);          // Send parameters at 10 Hz, if previously requested
-        if (++ucCycles > 200) {
-            ucCycles = 0;
-        }
+        PROFILE_BEGIN(PROFILE_STREAM_SEND);
+        Mavlink_Stream_Send();                  // Send data streams and parameters
+        PROFILE_END(PROFILE_STREAM_SEND);
     }
 
 #elif defined TELEMETRY_MULTIWII
 
     for (;;) {
+        (void)USART1_Rx_Wait(TELEMETRY_DELAY);  // sleep until end of a request
         MWI_Receive();          				//
     }
 
@@ -213,8 +216,18 @@ int32_t main(void) {
 
   USART1_Init();              						// Initialize USART1 for telemetry
   Servo_Init();                                     // Initialize PWM timers as servo outputs
+  if (Restart_Init(b_watchdog_reset)) {             // Flight state preserved
+    Servo_Set(SERVO_AILERON, Restart_Get()->iServo[0]);   // Restore servos
+    Servo_Set(SERVO_ELEVATOR, Restart_Get()->iServo[1]);
+    Servo_Set(SERVO_THROTTLE, Restart_Get()->iServo[2]);
+  }
   PPM_Init();                                       // Initialize capture timers as RRC input
+  Param_Init();                                     // Initialize parameters with defaults
+  Store_Init();                                     // Load parameters saved in flash
   I2C_MEMS_Init();                                  // Initialize I2C peripheral
+#if (PROFILE == 1)
+  Profile_Init();                                   // Start cycle counter
+#endif
 
 /*
   xTelemetry_Queue = xQueueCreate( 3, sizeof( telStruct_Message ) );
@@ -225,11 +238,8 @@ int32_t main(void) {
   while ( xLog_Queue == 0 ) {                       // Halt if queue wasn't created
   }
 */
-  if (FR_OK == f_mount(0, &st_Fat)) {               // Mount file system
-    b_FS_Ok = TRUE;                                 //
-  } else {
-    b_FS_Ok = FALSE;                                //
-  }
+  (void)File_Init();                                // Mount file system
+  Boot_Signal(BOOT_FS_MOUNTED);                     // Mission load and log can start
 
   if (b_watchdog_reset) {
      LEDOn(RED);
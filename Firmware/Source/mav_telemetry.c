@@ -23,6 +23,24 @@
 ///   7 + len    CRC 1
 ///   8 + len    CRC 2
 /// \endcode
+/// MAVLink 2 frames are used once the GCS has sent one. Trailing zero bytes
+/// of payload are truncated (first byte is always sent), receiver pads them
+/// back. Signed frames are not supported.
+/// \code
+///  Byte        Name        Content              Value
+/// ------------------------------------------------------
+///   0          MAVLINK_STX_V2 Start Transmission 0xFD
+///   1          len         Length               1 - 255
+///   2          incompat    Incompatibility flags 0
+///   3          compat      Compatibility flags  0
+///   4          seq         Sequence             0 - 255
+///   5          SYSID       System identifier    0 - 255
+///   6          COMPID      Component identifier 0 - 255
+///   7 - 9      MSGID       Message identifier   0 - 255 (24 bit)
+///  10          Payload     Payload
+///  10 + len    CRC 1
+///  11 + len    CRC 2
+/// \endcode
 /// ------------- Mavlink identifiers and message lengths -------------
 ///
 /// All identifiers are prefixed with MAVLINK_MSG_ID_ in the code, e.g.
@@ -32,24 +50,36 @@
 /// Identifier (MSGID)    Value  Length Status
 /// ---------------------------------------------------
 /// HEARTBEAT                0      9   Verified
-/// SYS_STATUS               1     31
+/// SYS_STATUS               1     31   Implemented
+/// PARAM_REQUEST_READ      20     20   Implemented
 /// PARAM_REQUEST_LIST      21      2   Implemented
 /// PARAM_VALUE             22     25   Verified
 /// PARAM_SET               23     23   Verified
 /// GPS_RAW_INT             24     30   Verified
+/// RAW_IMU                 27     26   Implemented
 /// ATTITUDE                30     28   Verified
 /// GLOBAL_POSITION_INT     33     28   Verified
 /// RC_CHANNELS_RAW         35     22
+/// SERVO_OUTPUT_RAW        36     21   Implemented
+/// MISSION_ITEM            39     37   Implemented
+/// MISSION_REQUEST         40      4   Implemented
 /// MISSION_CURRENT         42      2
 /// MISSION_REQUEST_LIST    43      2   Verified
 /// MISSION_COUNT           44      4   Verified
 /// MISSION_CLEAR_ALL       45      2
+/// MISSION_ACK             47      3   Implemented
 /// NAV_CONTROLLER_OUTPUT   62     26
 /// REQUEST_DATA_STREAM     66      6
+/// DATA_STREAM             67      4   Implemented
 /// VFR_HUD                 74     20   Verified
-/// COMMAND_LONG            76     21?
-/// HIL_STATE               90     56
+/// COMMAND_LONG            76     33   Implemented
+/// COMMAND_ACK             77      3   Implemented
+/// HIL_STATE               90     56   Implemented
+/// HIL_CONTROLS            91     42   Implemented
+/// HIL_SENSOR             107     64   Implemented
+/// HIL_GPS                113     36   Implemented
 /// WIND                   168     12
+/// NAMED_VALUE_INT        252     18   Implemented
 /// \endcode
 ///
 /// --------------------- Mavlink message contents --------------------
@@ -62,10 +92,18 @@
 /// -----------------------------------------------------------------------
 /// HEARTBEAT             see code
 ///
-/// SYS_STATUS            Battery voltage     14   uint16_t
+/// SYS_STATUS            Load                12   uint16_t  downlink load
+///                       Battery voltage     14   uint16_t
 ///                       Battery current     16   int16_t
+///                       Drop rate comm      18   uint16_t  delayed messages
+///                       Comm errors         20   uint16_t  parser resyncs
+///                       Errors count 1      22   uint16_t  uplink overruns
+///                       Errors count 2      24   uint16_t  framing errors
+///                       Errors count 3      26   uint16_t  downlink drops
 ///                       Battery remaining   30   int8_t
 ///
+/// PARAM_REQUEST_READ    see code
+///
 /// PARAM_REQUEST_LIST    see code
 ///
 /// PARAM_SET             see code
@@ -74,12 +112,18 @@
 ///
 /// GPS_RAW_INT           see code
 ///
+/// RAW_IMU               see code
+///
+/// SERVO_OUTPUT_RAW      see code
+///
 /// VFR_HUD               see code
 ///
 /// ATTITUDE              see code
 ///
 /// REQUEST_DATA_STREAM   see code
 ///
+/// DATA_STREAM           see code
+///
 /// NAV_CONTROLLER_OUTPUT Nav roll             0   float
 ///                       Nav pitch            4   float
 ///                       Altitude error       8   float
@@ -147,6 +191,12 @@
 ///                       yacc                52   int16_t  Y acceleration [mg]
 ///                       zacc                54   int16_t  Z acceleration [mg]
 ///
+/// HIL_CONTROLS          see code
+///
+/// HIL_SENSOR            see code
+///
+/// HIL_GPS               see code
+///
 /// \endcode
 ///
 ///--------------------- AqGCS messages taxonomy ------------------------
@@ -228,6 +278,53 @@
 ///          "                    5    14   C8    10    start   extra 1 (attiude)
 ///          "                    2    14   C8    11    start   extra 2 (VFR HUD)
 ///
+/// -------------------------- Mission upload --------------------------
+///
+/// GCS                              MAV
+/// ----------------------------------------------------------
+/// MISSION_COUNT n          ->
+///                          <-      MISSION_REQUEST 0
+/// MISSION_ITEM 0           ->                              launch position, ignored
+///                          <-      MISSION_REQUEST 1
+/// ...
+/// MISSION_ITEM n - 1       ->      shadow table validated, swapped by navigation
+///                          <-      MISSION_ACK
+///
+/// Items are written into the shadow waypoint table while navigation keeps
+/// flying the active one. A request without answer is repeated after
+/// MISSION_TIMEOUT ticks, upload is aborted after MISSION_RETRIES. Items
+/// out of sequence are answered with a request of the expected one.
+///
+/// ------------------------ Parameter download ------------------------
+///
+/// GCS                              MAV
+/// ----------------------------------------------------------
+/// PARAM_REQUEST_LIST       ->      all parameters pending
+///                          <-      PARAM_VALUE 0, 1, 2 ...   as many per tick as fit
+/// PARAM_REQUEST_READ i     ->      parameter i pending again (missing index)
+///                          <-      PARAM_VALUE i
+///
+/// Pending parameters are sent right after heartbeat, as long as link credit
+/// exceeds PARAM_RESERVE and the transmit ring has room, so the list is
+/// transferred at link rate while other streams are throttled, not stopped.
+///
+/// -------------------- Hardware in the loop (HIL) --------------------
+///
+/// Simulator                        MAV
+/// ----------------------------------------------------------
+///                          <-      HEARTBEAT, base mode HIL enabled and armed
+/// HIL_SENSOR               ->      AHRS sensors and altitude
+/// HIL_GPS                  ->      navigation fix
+/// HIL_STATE                ->      both of above, from simulated state
+///                          <-      HIL_CONTROLS, each tick while HIL input arrives
+///
+/// With SIMULATOR == HIL_MAVLINK, attitude task takes its sensors from
+/// Telemetry_Get_Sensors() and navigation its fix from Telemetry_Get_Gps().
+/// Sensors are converted back to raw ADC counts, so that they go through
+/// the same offset, scale and sign correction as real sensors. HIL_CONTROLS
+/// is sent at STREAM_TICK_HZ, the rate servo positions are updated, as long
+/// as sensor data arrived within HIL_TIMEOUT ticks.
+///
 /// ------------------------------ Links ------------------------------
 ///
 /// ArduPilot Mega parameters modifiable by MAVLink
@@ -246,17 +343,31 @@
 ///
 /// Change: function Mavlink_Param_Set(): corrected index of system ID and
 ///         component ID positions in the received data buffer.
+///         Mission upload into shadow waypoint table.
+///         Parameters taken from parameter registry.
+///         Parameter list sent in bursts limited by link credit.
+///         Hardware in the loop with HIL_SENSOR, HIL_GPS and HIL_CONTROLS.
 ///
 //============================================================================*/
 
 #include "stm32f10x.h"
+#include "crc.h"
+#include "stream.h"
+#include "ring.h"
 #include "usart1driver.h"
 #include "math.h"
+#include "stddef.h"
 
 #include "config.h"
 #include "nav.h"
+#include "mission.h"
+#include "param.h"
+#include "store.h"
 #include "servodriver.h"
+#include "ppmdriver.h"
+#include "calibration.h"
 #include "attitude.h"
+#include "profile.h"
 #include "mav_telemetry.h"
 
 /*--------------------------------- Definitions ------------------------------*/
@@ -265,36 +376,54 @@
 #define VAR_STATIC static
 #endif
 
-#define MAX_STREAM_RATE             50
+#define LINK_BUDGET     ((USART1_BAUDRATE / 10) * 9 / 10 / STREAM_TICK_HZ) //!< 90 % of link, bytes per tick
+#define PARAM_RESERVE   (LINK_BUDGET / 4) //!< link credit left to other streams during parameter download [bytes]
+#define SAMPLE_QUEUE    4               //!< AHRS samples waiting for RAW_IMU stream
+#define SAMPLE_PERIOD   (1000000UL / SAMPLES_PER_SECOND) //!< AHRS period [us]
+#define MISSION_TIMEOUT 25              //!< mission item wait before request is repeated [ticks]
+#define MISSION_RETRIES 5               //!< repeated requests before upload is aborted
+#define HIL_TIMEOUT     25              //!< ticks without HIL input before HIL_CONTROLS stops
+#define HIL_GRAVITY     9.80665f        //!< standard gravity [m/s^2]
+#define HIL_MODE        (MAV_MODE_FLAG_SAFETY_ARMED | MAV_MODE_FLAG_HIL_ENABLED) //!< base mode in HIL
 
-#define ONBOARD_PARAM_COUNT         ((uint16_t)TEL_GAIN_NUMBER)
-#define ONBOARD_PARAM_NAME_LENGTH   16
+#define ONBOARD_PARAM_COUNT         ((uint16_t)PARAM_NUMBER)
 
-//#define PACKET_LEN                MAVLINK_MAX_PACKET_LEN  // original length
-#define PACKET_LEN                  64                      // reduced because of RAM constraints
-#define PAYLOAD_LEN                 64
+#define PAYLOAD_LEN                 68  // HIL_SENSOR with extension and CRC
 
                                                 // Origin
 #define MAVLINK_MSG_ID_HEARTBEAT            0   // mavlink\common\mavlink_msg_heartbeat.h
+#define MAVLINK_MSG_ID_SYS_STATUS           1   // mavlink\common\mavlink_msg_sys_status.h
 #define MAVLINK_MSG_ID_VFR_HUD              74  // mavlink\common\mavlink_msg_vfr_hud.h
 #define MAVLINK_MSG_ID_ATTITUDE             30  // mavlink\common\mavlink_msg_attitude.h
 #define MAVLINK_MSG_ID_GPS_RAW_INT          24  // mavlink\common\mavlink_msg_gps_raw_int.h
+#define MAVLINK_MSG_ID_RAW_IMU              27  // mavlink\common\mavlink_msg_raw_imu.h
+#define MAVLINK_MSG_ID_SERVO_OUTPUT_RAW     36  // mavlink\common\mavlink_msg_servo_output_raw.h
 #define MAVLINK_MSG_ID_GLOBAL_POSITION_INT  33  // mavlink\common\mavlink_msg_global_position_int.h
 #define MAVLINK_MSG_ID_PARAM_VALUE          22  // mavlink\common\mavlink_msg_param_value.h
 #define MAVLINK_MSG_ID_MISSION_COUNT        44  // mavlink\common\mavlink_msg_mission_count.h
 #define MAVLINK_MSG_ID_MISSION_ITEM         39  // mavlink\common\mavlink_msg_mission_item.h
 #define MAVLINK_MSG_ID_REQUEST_DATA_STREAM  66  // mavlink\common\mavlink_msg_request_data_stream.h
+#define MAVLINK_MSG_ID_DATA_STREAM          67  // mavlink\common\mavlink_msg_data_stream.h
 #define MAVLINK_MSG_ID_COMMAND_LONG         76  // mavlink\common\mavlink_msg_command_long.h
+#define MAVLINK_MSG_ID_COMMAND_ACK          77  // mavlink\common\mavlink_msg_command_ack.h
+#define MAVLINK_MSG_ID_PARAM_REQUEST_READ   20  // mavlink\common\mavlink_msg_param_request_read.h
 #define MAVLINK_MSG_ID_PARAM_REQUEST_LIST   21  // mavlink\common\mavlink_msg_param_request_list.h
 #define MAVLINK_MSG_ID_PARAM_SET            23  // mavlink\common\mavlink_msg_param_set.h
 #define MAVLINK_MSG_ID_HIL_STATE            90  // mavlink\common\mavlink_msg_hil_state.h
+#define MAVLINK_MSG_ID_HIL_CONTROLS         91  // mavlink\common\mavlink_msg_hil_controls.h
+#define MAVLINK_MSG_ID_HIL_SENSOR          107  // mavlink\common\mavlink_msg_hil_sensor.h
+#define MAVLINK_MSG_ID_HIL_GPS             113  // mavlink\common\mavlink_msg_hil_gps.h
 #define MAVLINK_MSG_ID_MISSION_REQUEST_LIST 43  // mavlink\common\mavlink_msg_mission_request_list.h
 #define MAVLINK_MSG_ID_MISSION_REQUEST      40  // mavlink\common\mavlink_msg_mission_request.h
+#define MAVLINK_MSG_ID_MISSION_ACK          47  // mavlink\common\mavlink_msg_mission_ack.h
+#define MAVLINK_MSG_ID_NAMED_VALUE_INT     252  // mavlink\common\mavlink_msg_named_value_int.h
 
-#define X25_INIT_CRC        0xFFFF              // mavlink\checksum.h
 //#define X25_VALIDATE_CRC  0xF0B8              // mavlink\matrixpilot\mavlink.h
 
 #define MAVLINK_STX         0xFE                // mavlink\matrixpilot\mavlink.h
+#define MAVLINK_STX_V2      0xFD                // MAVLink 2
+#define HEADER_LEN          6                   // header length, including STX
+#define HEADER_LEN_V2       10                  // MAVLink 2 header length, including STX
                                                 // mavlink\matrixpilot\matrixpilot.h
 #define MAVLINK_MESSAGE_CRCS {          \
  50, 124, 137,   0, 237, 217, 104, 119, \
@@ -310,8 +439,8 @@
   0,   0,   0,   0,   0,   0,   0,   0, \
   0, 231, 183,  63,  54,   0,   0,   0, \
   0,   0,   0,   0, 175, 102, 158, 208, \
- 56,   0,   0,   0,   0,   0,   0,   0, \
-  0,   0,   0,   0,   0,   0,   0,   0, \
+ 56,   0,   0, 108,   0,   0,   0,   0, \
+  0, 124,   0,   0,   0,   0,   0,   0, \
   0,   0,   0,   0,   0,   0,   0,   0, \
   0,   0,   0,   0,   0,   0,   0,   0, \
   0,   0,   0,   0,   0,   0,   0,   0, \
@@ -334,6 +463,23 @@
 
 /*-------------------------------- Enumerations ------------------------------*/
 
+/// periodic messages, by decreasing priority
+typedef enum {
+    STREAM_HEARTBEAT = 0,   ///< HEARTBEAT
+    STREAM_HIL,             ///< HIL_CONTROLS, while HIL input arrives
+    STREAM_PARAMS,          ///< PARAM_VALUE burst, while parameters are pending
+    STREAM_RAW,             ///< RAW_IMU and SERVO_OUTPUT_RAW, data stream RAW_SENSORS
+    STREAM_ATTITUDE,        ///< ATTITUDE, data stream EXTRA1
+    STREAM_POSITION,        ///< GLOBAL_POSITION_INT, data stream POSITION
+    STREAM_HUD,             ///< VFR_HUD, data stream EXTRA2
+    STREAM_STATUS,          ///< SYS_STATUS
+    STREAM_RATES,           ///< DATA_STREAM, achieved rates
+#if (PROFILE == 1)
+    STREAM_PROFILE,         ///< NAMED_VALUE_INT, execution times of a profile zone
+#endif
+    STREAM_NUMBER
+} telEnum_Stream;
+
 /*lint -e753 -e749 -e751 */
 enum MAV_AUTOPILOT {
 	MAV_AUTOPILOT_GENERIC=0,        /* Generic autopilot, full support for everything */
@@ -406,6 +552,18 @@ enum MAV_COMPONENT {
 	MAV_COMPONENT_ENUM_END=251      /*  */
 };
 
+/// Mode flags of heartbeat base mode.
+enum MAV_MODE_FLAG {                    // Origin: mavlink\common\common.h
+	MAV_MODE_FLAG_CUSTOM_MODE_ENABLED=1,    /* custom mode in custom_mode field */
+	MAV_MODE_FLAG_TEST_ENABLED=2,           /* system has a test mode enabled */
+	MAV_MODE_FLAG_AUTO_ENABLED=4,           /* autonomous mode enabled */
+	MAV_MODE_FLAG_GUIDED_ENABLED=8,         /* guided mode enabled */
+	MAV_MODE_FLAG_STABILIZE_ENABLED=16,     /* system stabilizes attitude */
+	MAV_MODE_FLAG_HIL_ENABLED=32,           /* hardware in the loop simulation */
+	MAV_MODE_FLAG_MANUAL_INPUT_ENABLED=64,  /* remote control input enabled */
+	MAV_MODE_FLAG_SAFETY_ARMED=128          /* motors armed */
+};
+
 /// Data stream IDs.
 /// A data stream is not a fixed set of messages, but rather a recommendation to the autopilot software.
 /// Individual autopilots may or may not obey the recommended messages.
@@ -482,8 +640,34 @@ enum MAV_CMD {                      // Origin: mavlink\common\common.h
 	MAV_CMD_ENUM_END=401            /*  */
 };
 
+enum MAV_RESULT {                   // Origin: mavlink\common\common.h
+	MAV_RESULT_ACCEPTED=0,          /* Command ACCEPTED and EXECUTED | */
+	MAV_RESULT_TEMPORARILY_REJECTED=1, /* Command TEMPORARY REJECTED/DENIED | */
+	MAV_RESULT_DENIED=2,            /* Command PERMANENTLY DENIED | */
+	MAV_RESULT_UNSUPPORTED=3,       /* Command UNKNOWN/UNSUPPORTED | */
+	MAV_RESULT_FAILED=4,            /* Command executed, but failed | */
+	MAV_RESULT_ENUM_END=5           /*  */
+};
+
+enum MAV_MISSION_RESULT {           // Origin: mavlink\common\common.h
+	MAV_MISSION_ACCEPTED=0,         /* mission accepted OK | */
+	MAV_MISSION_ERROR=1,            /* generic error / not accepting mission commands at all right now | */
+	MAV_MISSION_UNSUPPORTED_FRAME=2,/* coordinate frame is not supported | */
+	MAV_MISSION_UNSUPPORTED=3,      /* command is not supported | */
+	MAV_MISSION_NO_SPACE=4,         /* mission item exceeds storage space | */
+	MAV_MISSION_INVALID=5,          /* one of the parameters has an invalid value | */
+	MAV_MISSION_INVALID_SEQUENCE=13 /* received waypoint out of sequence | */
+};
+
 /*----------------------------------- Types ----------------------------------*/
 
+/// AHRS sample for RAW_IMU and SERVO_OUTPUT_RAW
+typedef struct {
+    uint32_t ulNumber;                  ///< sample number since start up
+    int16_t iSensor[6];                 ///< acceleration x, y, z, rate x, y, z
+    int16_t iServo[SERVO_NUMBER];       ///< servo pulse length [us]
+} telStruct_Sample;
+
 typedef enum {                  // Origin: mavlink\mavlink_types.h
    MAVLINK_TYPE_CHAR     = 0,
    MAVLINK_TYPE_UINT8_T  = 1,
@@ -508,57 +692,18 @@ typedef enum {                  // Origin: mavlink\mavlink_types.h
     MAVLINK_PARSE_STATE_GOT_COMPID,
     MAVLINK_PARSE_STATE_GOT_MSGID,
     MAVLINK_PARSE_STATE_GOT_PAYLOAD,
-    MAVLINK_PARSE_STATE_GOT_CRC1
+    MAVLINK_PARSE_STATE_GOT_CRC1,
+    MAVLINK_PARSE_STATE_GOT_INCOMPAT_FLAGS,     // MAVLink 2 only
+    MAVLINK_PARSE_STATE_GOT_COMPAT_FLAGS,
+    MAVLINK_PARSE_STATE_GOT_MSGID1,
+    MAVLINK_PARSE_STATE_GOT_MSGID2
 } mavlink_parse_state_t;        ///< The state machine for the comm parser
 
 /*---------------------------------- Constants -------------------------------*/
 
 VAR_STATIC const uint8_t Mavlink_Crc[] = MAVLINK_MESSAGE_CRCS ;
+VAR_STATIC const int16_t Hil_Sign[6] = SENSOR_SIGN;                 // sign of raw sensor data
 
-/// Names of parameters
-VAR_STATIC const uint8_t sParameter_Name[ONBOARD_PARAM_COUNT][ONBOARD_PARAM_NAME_LENGTH] = {
-/*
-    "RLL2SRV_P\0",     // Roll Kp
-    "RLL2SRV_I\0",     // Roll Ki
-//  "RLL2SRV_D\0",     // Roll Kd
-    "PTCH2SRV_P\0",    // Pitch Kp
-    "PTCH2SRV_I\0",    // Pitch Ki
-//  "PTCH2SRV_D\0",    // Pitch Kd
-    "ENRGY2THR_P\0",   // Altitude Kp (via throttle)
-    "ENRGY2THR_I\0",   // Altitude Ki (via throttle)
-//  "ENRGY2THR_D\0",   // Altitude Kd (via throttle)
-    "HDNG2RLL_P\0",    // Navigation Kp (via roll)
-    "HDNG2RLL_I\0"     // Navigation Ki (via roll)
-//  "HDNG2RLL_D\0"     // Navigation Kd (via roll)
-
-    "CTRL_ROL_ANG_P\0", // Roll Kp
-    "CTRL_ROL_ANG_I\0", // Roll Ki
-//  "CTRL_ROL_ANG_D\0", // Roll Kd
-    "CTRL_PCH_ANG_P\0", // Pitch Kp
-    "CTRL_PCH_ANG_I\0", // Pitch Ki
-//  "CTRL_PCH_ANG_D\0", // Pitch Kd
-    "NAV_ALT_POS_P\0",  // Altitude Kp (via throttle)
-    "NAV_ALT_POS_I\0",  // Altitude Ki (via throttle)
- //  NAV_ALT_POS_D"\0", // Altitude Kd (via throttle)
-    "NAV_ROL_ANG_P\0",  // Navigation Kp (via roll)
-    "NAV_ROL_ANG_I\0"   // Navigation Ki (via roll)
-//  "NAV_ROL_ANG_D\0"   // Navigation Kd (via roll)
-*/
-    // Copter GCS standard: GROUP_SUBGROUP_P / _I / _D / _IMAX
-    "ROL_ANG_P\0",  // Roll Kp
-    "ROL_ANG_I\0",  // Roll Ki
-//  "ROL_ANG_D\0",  // Roll Kd
-    "PCH_ANG_P\0",  // Pitch Kp
-    "PCH_ANG_I\0",  // Pitch Ki
-//  "PCH_ANG_D\0",  // Pitch Kd
-    "ALT_POS_P\0",  // Altitude Kp (via throttle)
-    "ALT_POS_I\0",  // Altitude Ki (via throttle)
-//  "ALT_POS_D"\0", // Altitude Kd (via throttle)
-    "NAV_ANG_P\0",  // Navigation Kp (via roll)
-    "NAV_ANG_I\0",  // Navigation Ki (via roll)
-//  "NAV_ANG_D\0",  // Navigation Kd (via roll)
-    "NAV_BANK\0"    // Max bank angle during navigation [deg]
-};
 
 //VAR_STATIC const uint8_t Autopilot_Type = MAV_AUTOPILOT_GENERIC;  // Autopilot capabilities
 //VAR_STATIC const uint8_t System_Type = MAV_TYPE_FIXED_WING;       // Aircraft type
@@ -586,30 +731,42 @@ VAR_STATIC mavlink_message_t msg;
 */
 
 VAR_STATIC uint8_t current_tx_seq = 0;
+VAR_STATIC uint16_t rx_resync = 0;                      // frames discarded by parser
 //VAR_STATIC uint16_t packet_drops = 0;
 //VAR_STATIC uint8_t packet_rx_drop_count;
-VAR_STATIC uint16_t m_parameter_i = ONBOARD_PARAM_COUNT;
+VAR_STATIC uint8_t uc_Param_Pending[(ONBOARD_PARAM_COUNT + 7) / 8]; // parameters to be sent, one bit each
+VAR_STATIC uint16_t ui_Param_Count = 0;                 // number of parameters pending
+VAR_STATIC uint16_t ui_Param_Index = 0;                 // next parameter checked for sending
 VAR_STATIC uint8_t msgid;
-VAR_STATIC uint16_t Crc;
+VAR_STATIC uint16_t rx_crc;                             // CRC of packet being received
 VAR_STATIC STRUCT_WPT wpt;
 
 VAR_STATIC uint8_t Rx_Msg[PAYLOAD_LEN];                 // buffer for incoming messages
-VAR_STATIC uint8_t Tx_Msg[PACKET_LEN];                  // buffer for outgoing messages
-VAR_STATIC uint8_t ucStream_Tick[MAV_DATA_STREAM_ENUM_END] = { // tick counters for data streams
-    MAX_STREAM_RATE,    /*  0: all data streams */
-    MAX_STREAM_RATE,    /*  1: IMU_RAW, GPS_RAW, GPS_STATUS */
-    MAX_STREAM_RATE,    /*  2: GPS_STATUS, CONTROL_STATUS, AUX_STATUS */
-    MAX_STREAM_RATE,    /*  3: RC_CHANNELS_SCALED, RC_CHANNELS_RAW, SERVO_OUTPUT_RAW */
-    MAX_STREAM_RATE,    /*  4: ATTITUDE_CONTROLLER_OUTPUT, POSITION_CONTROLLER_OUTPUT, NAV_CONTROLLER_OUTPUT */
-    MAX_STREAM_RATE,    /*  5: - */
-    MAX_STREAM_RATE,    /*  6: LOCAL_POSITION, GLOBAL_POSITION/GLOBAL_POSITION_INT */
-    MAX_STREAM_RATE,    /*  7: - */
-    MAX_STREAM_RATE,    /*  8: - */
-    MAX_STREAM_RATE,    /*  9: - */
-    MAX_STREAM_RATE,    /* 10: Extra 1, autopilot dependent */
-    MAX_STREAM_RATE,    /* 11: Extra 2, autopilot dependent */
-    MAX_STREAM_RATE     /* 12: Extra 3, autopilot dependent */
-};
+VAR_STATIC xRing * px_Tx = NULL;                        // transmit ring while a frame is built
+VAR_STATIC uint8_t tx_msgid;                            // ID of frame being built
+VAR_STATIC uint8_t tx_header;                           // header length of frame being built
+VAR_STATIC uint8_t tx_length;                           // payload bytes written
+VAR_STATIC uint8_t tx_zeros;                            // zero bytes not yet written
+VAR_STATIC bool b_Version_2 = FALSE;                    // MAVLink 2 framing, set by GCS
+VAR_STATIC uint8_t uc_Report = 0;                       // next achieved rate to report
+#if (PROFILE == 1)
+VAR_STATIC uint8_t uc_Profile = 0;                      // next profile zone to report
+#endif
+VAR_STATIC telStruct_Sample x_Sample[SAMPLE_QUEUE];      // AHRS samples, written by attitude task
+VAR_STATIC volatile uint8_t uc_Sample_Head = 0;         // next sample written, changed by attitude task only
+VAR_STATIC volatile uint8_t uc_Sample_Tail = 0;         // next sample sent, changed by telemetry task only
+VAR_STATIC uint32_t ul_Sample_Number = 0;               // samples taken since start up
+VAR_STATIC uint16_t ui_Upload_Count = 0;                // items of mission being uploaded
+VAR_STATIC uint16_t ui_Upload_Seq = 0;                  // next item expected
+VAR_STATIC uint8_t uc_Upload_Timer = 0;                 // ticks before request is repeated, 0 = no upload
+VAR_STATIC uint8_t uc_Upload_Retry = 0;                 // requests repeated for current item
+VAR_STATIC int16_t i_Hil_Sensor[2][6];                  // HIL raw sensors, written alternately
+VAR_STATIC volatile uint8_t uc_Hil_Sensor = 0;          // HIL sensors last written, read by attitude task
+VAR_STATIC float f_Hil_Altitude = 0.0f;                 // HIL altitude [m]
+VAR_STATIC telStruct_Gps x_Hil_Gps;                     // HIL fix, read by navigation task
+VAR_STATIC volatile uint8_t uc_Hil_Gps = 0;             // HIL fix sequence, odd while fix is written
+VAR_STATIC uint8_t uc_Hil_Gps_Read = 0;                 // HIL fix sequence last read by navigation
+VAR_STATIC uint8_t uc_Hil_Timer = 0;                    // ticks before HIL_CONTROLS stops, 0 = no HIL
 VAR_STATIC uint8_t ucStream_Rate[MAV_DATA_STREAM_ENUM_END] = { // frequency of data streams
     0,  /*  0: all data streams */
     0,  /*  1: IMU_RAW, GPS_RAW, GPS_STATUS */
@@ -625,100 +782,241 @@ VAR_STATIC uint8_t ucStream_Rate[MAV_DATA_STREAM_ENUM_END] = { // frequency of d
     2,  /* 11: Extra 2, autopilot dependent */
     0   /* 12: Extra 3, autopilot dependent */
 };
-VAR_STATIC float fParam_Value[ONBOARD_PARAM_COUNT] = {
-    ROLL_KP,    //!< default roll kp
-    ROLL_KI,    //!< default roll ki
-    PITCH_KP,   //!< default pitch kp
-    PITCH_KI,   //!< default pitch ki
-    0.0f,       //!< dummy placeholder
-    0.0f,       //!< dummy placeholder
-    NAV_KP,     //!< default direction kp
-    NAV_KI,     //!< default direction ki
-    NAV_BANK    //!< default max bank angle
-};              //!< gains for PID loops
 
 /*--------------------------------- Prototypes -------------------------------*/
 
-static __inline void Checksum_Init( void );
-static __inline void Checksum_Accumulate( uint8_t data );
-static void Mavlink_Send( uint8_t crc_extra );
+static bool Mavlink_Begin( uint8_t length, uint8_t id );
+static __inline void Mavlink_Put_Byte( uint8_t data );
+static void Mavlink_Put_Word( uint16_t data );
+static void Mavlink_Put_Long( uint32_t data );
+static void Mavlink_Put_Float( float data );
+static void Mavlink_Put_Zero( uint8_t count );
+static void Mavlink_End( void );
 void Mavlink_Heartbeat( void );
+void Mavlink_Sys_Status( void );
 void Mavlink_Hud( void );
 void Mavlink_Attitude( void );
 void Mavlink_Gps_Raw( void );
 void Mavlink_Position( void );
 void Mavlink_Param_Send( uint16_t param_index, uint16_t param_count );
 void Mavlink_Param_Set( void );
+static void Mavlink_Param_Request( uint16_t param_index );
+void Mavlink_Param_List( void );
+void Mavlink_Param_Read( void );
 void Mavlink_HIL_State( void );
+void Mavlink_Hil_Sensor( void );
+void Mavlink_Hil_Gps( void );
+void Mavlink_Hil_Controls( void );
+static void Mavlink_Hil_Imu( const float * pfAccel, const float * pfGyro );
+static void Mavlink_Hil_Fix( const telStruct_Gps * pxFix );
+void Mavlink_Command( void );
 static bool Mavlink_Parse( void );
-bool Mavlink_Stream_Trigger( uint8_t stream );
+void Mavlink_Param_Next( void );
+void Mavlink_Stream_Rate( void );
+#if (PROFILE == 1)
+void Mavlink_Profile( void );
+#endif
+void Mavlink_Raw_Imu( void );
+static void Mavlink_Mission_Request( void );
+static void Mavlink_Mission_Ack( uint8_t result );
+void Mavlink_Mission_Upload( void );
+void Mavlink_Mission_Load( void );
+
+/// periodic messages, see telEnum_Stream
+VAR_STATIC xStream x_Stream[STREAM_NUMBER] = {
+    { .pvSend = Mavlink_Heartbeat,    .ucSize = 17, .ucRate = 1 },
+    { .pvSend = Mavlink_Hil_Controls, .ucSize = 50, .ucRate = 0 },
+    { .pvSend = Mavlink_Param_Next,   .ucSize = 33, .ucRate = 0 },
+    { .pvSend = Mavlink_Raw_Imu,      .ucSize = 63, .ucRate = 0 },
+    { .pvSend = Mavlink_Attitude,     .ucSize = 36, .ucRate = 0 },
+    { .pvSend = Mavlink_Position,     .ucSize = 36, .ucRate = 0 },
+    { .pvSend = Mavlink_Hud,          .ucSize = 28, .ucRate = 0 },
+    { .pvSend = Mavlink_Sys_Status,   .ucSize = 39, .ucRate = 1 },
+    { .pvSend = Mavlink_Stream_Rate,  .ucSize = 12, .ucRate = 1 },
+#if (PROFILE == 1)
+    { .pvSend = Mavlink_Profile,      .ucSize = 78, .ucRate = (uint8_t)PROFILE_ZONES },
+#endif
+};
+/// data streams whose achieved rate is reported
+VAR_STATIC const uint8_t ucReport[][2] = {
+    { (uint8_t)STREAM_RAW,      (uint8_t)MAV_DATA_STREAM_RAW_SENSORS },
+    { (uint8_t)STREAM_ATTITUDE, (uint8_t)MAV_DATA_STREAM_EXTRA1 },
+    { (uint8_t)STREAM_POSITION, (uint8_t)MAV_DATA_STREAM_POSITION },
+    { (uint8_t)STREAM_HUD,      (uint8_t)MAV_DATA_STREAM_EXTRA2 }
+};
 
 /*---------------------------------- Functions -------------------------------*/
 
-///----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+//
+/// \brief   Start a packet in transmit buffer
+/// \param   length = payload length
+/// \param   id = message ID
+/// \returns TRUE if packet fits in transmit buffer, FALSE if it's dropped
+/// \remarks Packet is written in place: fields are written in payload order
+///          with Mavlink_Put_xxx and Mavlink_End publishes the whole packet.
+///          Space is reserved for the full payload, MAVLink 2 truncation
+///          only shortens it. Length byte is written by Mavlink_End.
+///          Sequence number is incremented for dropped packets too, so
+///          receiver sees the loss.
+///
+//----------------------------------------------------------------------------
+static bool Mavlink_Begin( uint8_t length, uint8_t id ) {
+
+    uint8_t seq = current_tx_seq++;        // One sequence number per component
+
+    tx_header = b_Version_2 ? HEADER_LEN_V2 : HEADER_LEN;
+    px_Tx = USART1_Tx_Reserve((uint16_t)tx_header + length + 2);
+    if (px_Tx == NULL) {                    // transmit buffer full
+        return FALSE;
+    }
+    tx_msgid = id;
+    tx_length = 0;
+    tx_zeros = 0;
+    if (b_Version_2) {
+        Ring_Put(px_Tx, MAVLINK_STX_V2);
+        Ring_Put(px_Tx, length);            // updated by Mavlink_End
+        Ring_Put(px_Tx, 0);                 // incompatibility flags
+        Ring_Put(px_Tx, 0);                 // compatibility flags
+    } else {
+        Ring_Put(px_Tx, MAVLINK_STX);
+        Ring_Put(px_Tx, length);
+    }
+    Ring_Put(px_Tx, seq);
+    Ring_Put(px_Tx, System_ID);
+    Ring_Put(px_Tx, (uint8_t)Component_ID);
+    Ring_Put(px_Tx, id);
+    if (b_Version_2) {
+        Ring_Put(px_Tx, 0);                 // message ID, bits 8 - 23
+        Ring_Put(px_Tx, 0);
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Write a byte of payload
+/// \param   data = byte
+/// \returns -
+/// \remarks Zero bytes are held back until a non zero byte follows, so
+///          trailing zeros are never written when they're truncated.
 ///
-/// \brief   Initialize CRC
-/// \return  -
+//----------------------------------------------------------------------------
+static __inline void Mavlink_Put_Byte( uint8_t data ) {
+
+    if (data == 0) {
+        tx_zeros++;
+    } else {
+        while (tx_zeros != 0) {
+            Ring_Put(px_Tx, 0);
+            tx_zeros--;
+            tx_length++;
+        }
+        Ring_Put(px_Tx, data);
+        tx_length++;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Write a 16 bit field of payload, little endian
+/// \param   data = field value
+/// \returns -
 /// \remarks -
 ///
-///----------------------------------------------------------------------------
-static __inline void Checksum_Init(void)
-{
-   Crc = X25_INIT_CRC;
+//----------------------------------------------------------------------------
+static void Mavlink_Put_Word( uint16_t data ) {
+
+    Mavlink_Put_Byte((uint8_t)(data & 0xFF));
+    Mavlink_Put_Byte((uint8_t)(data >> 8));
 }
 
-///----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+//
+/// \brief   Write a 32 bit field of payload, little endian
+/// \param   data = field value
+/// \returns -
+/// \remarks -
 ///
-/// \brief   Accumulate one byte of data into the CRC
-/// \return  -
+//----------------------------------------------------------------------------
+static void Mavlink_Put_Long( uint32_t data ) {
+
+    Mavlink_Put_Byte((uint8_t)(data & 0xFF));
+    Mavlink_Put_Byte((uint8_t)((data >> 8) & 0xFF));
+    Mavlink_Put_Byte((uint8_t)((data >> 16) & 0xFF));
+    Mavlink_Put_Byte((uint8_t)(data >> 24));
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Write a float field of payload
+/// \param   data = field value
+/// \returns -
 /// \remarks -
 ///
-///----------------------------------------------------------------------------
-static __inline void Checksum_Accumulate(uint8_t data)
-{
-    uint8_t tmp;
+//----------------------------------------------------------------------------
+static void Mavlink_Put_Float( float data ) {
 
-    tmp = data ^ (uint8_t)(Crc & 0xFF);
-    tmp ^= (tmp << 4);
-    Crc = (Crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4);
+    union {
+        float f;
+        uint32_t ul;
+    } value;
+
+    value.f = data;
+    Mavlink_Put_Long(value.ul);
 }
 
+//----------------------------------------------------------------------------
+//
+/// \brief   Write unused fields of payload
+/// \param   count = number of zero bytes
+/// \returns -
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Put_Zero( uint8_t count ) {
+
+    while (count-- != 0) {
+        Mavlink_Put_Byte(0);
+    }
+}
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Send communication packets
+/// \brief   Complete a packet and send it
 /// \param   -
 /// \returns -
-/// \remarks
-///   0          MAVLINK_STX Start Transmission   0xFE
-///   1          len         Length               0 - 255
-///   2          seq         Sequence             0 - 255
-///   3          SYSID       System identifier    0 - 255
-///   4          COMPID      Component identifier 0 - 255
-///   5          MSGID       Message identifier   0 - 255
+/// \remarks MAVLink 1 writes held back zeros. MAVLink 2 drops them, keeping
+///          at least one byte of payload, and patches length byte. CRC is
+///          then computed over the frame in place, from length byte to end
+///          of payload, plus CRC extra of message ID.
 ///
 //----------------------------------------------------------------------------
-static void Mavlink_Send( uint8_t crc_extra ) {
-	uint16_t j;
-    uint8_t length = Tx_Msg[1];
+static void Mavlink_End( void ) {
 
-    Checksum_Init();
-    Tx_Msg[0] = MAVLINK_STX;
-    Tx_Msg[2] = current_tx_seq++;          // One sequence number per component
-    Tx_Msg[3] = System_ID;
-    Tx_Msg[4] = (uint8_t)Component_ID;
+    uint16_t crc = CRC_X25_INIT;
+    uint8_t j, size;
 
-    for (j = 1; j < length + 6; j++) {
-        Checksum_Accumulate(Tx_Msg[j]);
+    if (!b_Version_2 || (tx_length == 0)) {
+        if (b_Version_2) {
+            tx_zeros = 1;                   // first byte is never truncated
+        }
+        while (tx_zeros != 0) {
+            Ring_Put(px_Tx, 0);
+            tx_zeros--;
+            tx_length++;
+        }
     }
-    Checksum_Accumulate(crc_extra);
-
-    Tx_Msg[j++] = (uint8_t)(Crc & 0xFF);
-    Tx_Msg[j] = (uint8_t)(Crc >> 8);
-    for (j = 0; j < length + 8; j++) {
-        USART1_Putch(Tx_Msg[j]);
+    *Ring_Reserved(px_Tx, 1) = tx_length;
+    size = tx_header + tx_length;
+    for (j = 1; j < size; j++) {
+        crc = Crc_X25_Byte(crc, *Ring_Reserved(px_Tx, j));
     }
-    USART1_Transmit();
+    crc = Crc_X25_Byte(crc, Mavlink_Crc[tx_msgid]);
+    Ring_Put(px_Tx, (uint8_t)(crc & 0xFF));
+    Ring_Put(px_Tx, (uint8_t)(crc >> 8));
+    USART1_Tx_Commit();                     // publish whole frame
+    Stream_Charge((uint16_t)size + 2);      // replies count against link budget
 }
 
 //----------------------------------------------------------------------------
@@ -746,16 +1044,70 @@ static void Mavlink_Send( uint8_t crc_extra ) {
 ///
 //----------------------------------------------------------------------------
 void Mavlink_Heartbeat( void ) {
-	uint16_t j;
 
-    for (j = 0; j < PACKET_LEN; j++) {
-        Tx_Msg[j] = 0;
+    if (Mavlink_Begin(9, MAVLINK_MSG_ID_HEARTBEAT)) {
+        Mavlink_Put_Zero(4);                        // Custom mode
+        Mavlink_Put_Byte((uint8_t)MAV_TYPE_FIXED_WING); // Type of the MAV, defined in MAV_TYPE ENUM
+#if (SIMULATOR == HIL_MAVLINK)
+        Mavlink_Put_Byte((uint8_t)MAV_AUTOPILOT_GENERIC); // Autopilot
+        Mavlink_Put_Byte((uint8_t)HIL_MODE);        // Base mode, simulator sends HIL messages
+        Mavlink_Put_Zero(2);                        // Status, version
+#else
+        Mavlink_Put_Zero(4);                        // Autopilot, base mode, status, version
+#endif
+        Mavlink_End();
     }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Send system status
+/// \param   -
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_SYS_STATUS, ID = 1, Length = 31
+/// Battery isn't measured, error counters report link health.
+///
+/// Field             Offset  Type     Meaning
+/// ----------------------------------------------------------------------------
+/// Sensors present      0   uint32_t  Bitfield, see MAV_SYS_STATUS_SENSOR ENUM
+/// Sensors enabled      4   uint32_t  Bitfield
+/// Sensors health       8   uint32_t  Bitfield
+/// Load                12   uint16_t  Downlink load, 0.1 % of link budget
+/// Battery voltage     14   uint16_t  mV, UINT16_MAX if not measured
+/// Battery current     16   int16_t   10 mA, -1 if not measured
+/// Drop rate comm      18   uint16_t  Due messages delayed by budget, 0.01 %
+/// Errors comm         20   uint16_t  Frames discarded by parser
+/// Errors count 1      22   uint16_t  Uplink receive overruns
+/// Errors count 2      24   uint16_t  Uplink framing and noise errors
+/// Errors count 3      26   uint16_t  Downlink frames dropped
+/// Errors count 4      28   uint16_t  -
+/// Battery remaining   30   int8_t    %, -1 if not measured
+///
+//----------------------------------------------------------------------------
+void Mavlink_Sys_Status( void ) {
+
+    uint32_t late = 0, due = 0;
+    uint8_t j;
 
-    Tx_Msg[1] = 9;                              // Payload length
-	Tx_Msg[5] = MAVLINK_MSG_ID_HEARTBEAT;       // Heartbeat message ID
-	Tx_Msg[10] = (uint8_t)MAV_TYPE_FIXED_WING;  // Type of the MAV, defined in MAV_TYPE ENUM
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_HEARTBEAT]);
+    for (j = 0; j < (uint8_t)STREAM_NUMBER; j++) {
+        late += x_Stream[j].ucLate;
+        due += x_Stream[j].ucLate + x_Stream[j].ucAchieved;
+    }
+    if (Mavlink_Begin(31, MAVLINK_MSG_ID_SYS_STATUS)) {
+        Mavlink_Put_Zero(12);                       // Sensors
+        Mavlink_Put_Word(Stream_Load());            // Link load
+        Mavlink_Put_Word(0xFFFF);                   // Battery voltage
+        Mavlink_Put_Word((uint16_t)(-1));           // Battery current
+        Mavlink_Put_Word((due == 0) ? 0 : (uint16_t)((late * 10000) / due)); // Drop rate
+        Mavlink_Put_Word(rx_resync);                // Parser resyncs
+        Mavlink_Put_Word(USART1_Rx_Overruns());     // Uplink overruns
+        Mavlink_Put_Word(USART1_Rx_Errors());       // Uplink errors
+        Mavlink_Put_Word(USART1_Tx_Dropped());      // Downlink drops
+        Mavlink_Put_Word(0);                        // Errors count 4
+        Mavlink_Put_Byte((uint8_t)(-1));            // Battery remaining
+        Mavlink_End();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -778,16 +1130,15 @@ void Mavlink_Heartbeat( void ) {
 //----------------------------------------------------------------------------
 void Mavlink_Hud( void ) {
 
-    Tx_Msg[1] = 20;                                          // Payload length
-    Tx_Msg[5] = MAVLINK_MSG_ID_VFR_HUD;                      // VFR HUD message ID
-    *((float *)(&Tx_Msg[6])) = 0.0f;                         // Airspeed
-    *((float *)(&Tx_Msg[10])) = (float)Gps_Speed_Kt();       // GPS speed
-    *((float *)(&Tx_Msg[14])) = Nav_Altitude();              // Altitude
-    *((float *)(&Tx_Msg[18])) = 0.0f;                        // Climb rate
-    *((uint16_t *)(&Tx_Msg[22])) = Gps_Heading_Deg();        // Heading
-    *((int16_t *)(&Tx_Msg[24])) = Servo_Get(SERVO_THROTTLE); // Throttle
-
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_VFR_HUD]);
+    if (Mavlink_Begin(20, MAVLINK_MSG_ID_VFR_HUD)) {
+        Mavlink_Put_Float(0.0f);                             // Airspeed
+        Mavlink_Put_Float((float)Gps_Speed_Kt());            // GPS speed
+        Mavlink_Put_Float(Nav_Altitude());                   // Altitude
+        Mavlink_Put_Float(0.0f);                             // Climb rate
+        Mavlink_Put_Word(Gps_Heading_Deg());                 // Heading
+        Mavlink_Put_Word((uint16_t)Servo_Get(SERVO_THROTTLE)); // Throttle
+        Mavlink_End();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -811,17 +1162,93 @@ void Mavlink_Hud( void ) {
 //----------------------------------------------------------------------------
 void Mavlink_Attitude( void ) {
 
-    Tx_Msg[1] = 28;                                    // Payload length
-    Tx_Msg[5] = MAVLINK_MSG_ID_ATTITUDE;               // Attitude message ID
-    *((uint32_t *)(&Tx_Msg[6])) = 0;                   // time from boot [ms]
-    *((float *)(&Tx_Msg[10])) = Attitude_Roll_Rad();   // roll
-    *((float *)(&Tx_Msg[14])) = Attitude_Pitch_Rad();  // pitch
-    *((float *)(&Tx_Msg[18])) = Attitude_Yaw_Rad();    // yaw
-    *((float *)(&Tx_Msg[22])) = 0.0f;                  // roll rate
-    *((float *)(&Tx_Msg[26])) = 0.0f;                  // pitch rate
-    *((float *)(&Tx_Msg[30])) = 0.0f;                  // yaw rate
-
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_ATTITUDE]);
+    if (Mavlink_Begin(28, MAVLINK_MSG_ID_ATTITUDE)) {
+        Mavlink_Put_Long(0);                        // time from boot [ms]
+        Mavlink_Put_Float(Attitude_Roll_Rad());     // roll
+        Mavlink_Put_Float(Attitude_Pitch_Rad());    // pitch
+        Mavlink_Put_Float(Attitude_Yaw_Rad());      // yaw
+        Mavlink_Put_Float(0.0f);                    // roll rate
+        Mavlink_Put_Float(0.0f);                    // pitch rate
+        Mavlink_Put_Float(0.0f);                    // yaw rate
+        Mavlink_End();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Send AHRS samples
+/// \param   -
+/// \returns -
+/// \remarks
+/// Every AHRS sample is queued by the attitude task, so at full rate
+/// (STREAM_TICK_HZ, same as SAMPLES_PER_SECOND) each sample is sent once
+/// even though the two tasks aren't synchronized. At lower rates only the
+/// newest sample is sent. Timestamp is sample number times AHRS period, so
+/// lost samples show up as gaps. Sensors are AHRS inputs, i.e. corrected for
+/// offset, scale and sign, gravity added to z acceleration.
+///
+/// Name = MAVLINK_MSG_ID_RAW_IMU, ID = 27, Length = 26
+///
+/// Field        Offset Type     Meaning
+/// -------------------------------------
+/// time_usec     0     uint64_t  sample time [us]
+/// xacc          8     int16_t
+/// yacc         10     int16_t
+/// zacc         12     int16_t
+/// xgyro        14     int16_t
+/// ygyro        16     int16_t
+/// zgyro        18     int16_t
+/// xmag         20     int16_t   not measured
+/// ymag         22     int16_t   not measured
+/// zmag         24     int16_t   not measured
+///
+/// Name = MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, ID = 36, Length = 21
+///
+/// Field        Offset Type     Meaning
+/// -------------------------------------
+/// time_usec     0     uint32_t  sample time [us]
+/// servo1_raw    4     uint16_t  aileron [us]
+/// servo2_raw    6     uint16_t  rudder [us]
+/// servo3_raw    8     uint16_t  elevator [us]
+/// servo4_raw   10     uint16_t  throttle [us]
+/// servo5_raw   12     uint16_t  -
+/// ...
+/// servo8_raw   18     uint16_t  -
+/// port         20     uint8_t   0
+///
+//----------------------------------------------------------------------------
+void Mavlink_Raw_Imu( void ) {
+
+    uint8_t j, tail, next;
+    uint64_t time;
+    bool all = (x_Stream[STREAM_RAW].ucRate >= STREAM_TICK_HZ);
+
+    tail = uc_Sample_Tail;
+    while (tail != uc_Sample_Head) {
+        next = (tail + 1) % SAMPLE_QUEUE;
+        if (all || (next == uc_Sample_Head)) {
+            time = (uint64_t)x_Sample[tail].ulNumber * SAMPLE_PERIOD;
+            if (Mavlink_Begin(26, MAVLINK_MSG_ID_RAW_IMU)) {
+                Mavlink_Put_Long((uint32_t)time);   // sample time, 64 bit
+                Mavlink_Put_Long((uint32_t)(time >> 32));
+                for (j = 0; j < 6; j++) {           // acceleration, rate
+                    Mavlink_Put_Word((uint16_t)x_Sample[tail].iSensor[j]);
+                }
+                Mavlink_Put_Zero(6);                // magnetic field
+                Mavlink_End();
+            }
+            if (Mavlink_Begin(21, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW)) {
+                Mavlink_Put_Long((uint32_t)time);   // sample time
+                for (j = 0; j < SERVO_NUMBER; j++) {
+                    Mavlink_Put_Word((uint16_t)x_Sample[tail].iServo[j]);
+                }
+                Mavlink_Put_Zero(2 * (8 - SERVO_NUMBER) + 1); // unused servos, port
+                Mavlink_End();
+            }
+        }
+        tail = next;
+    }
+    uc_Sample_Tail = tail;                          // release samples
 }
 
 //----------------------------------------------------------------------------
@@ -848,20 +1275,19 @@ void Mavlink_Attitude( void ) {
 //----------------------------------------------------------------------------
 void Mavlink_Gps_Raw( void ) {
 
-    Tx_Msg[1] = 30;                                            // Payload length
-    Tx_Msg[5] = MAVLINK_MSG_ID_GPS_RAW_INT;                    // GPS message ID
-    *((uint64_t *)(&Tx_Msg[6])) = 0;                           // time from boot [us]
-    *((int32_t *)(&Tx_Msg[14])) = Gps_Latitude();              // latitude
-    *((int32_t *)(&Tx_Msg[18])) = Gps_Longitude();             // longitude
-    *((int32_t *)(&Tx_Msg[22])) = (int32_t)Nav_Altitude();     // altitude
-    *((uint16_t *)(&Tx_Msg[26])) = 65535;                      // eph
-    *((uint16_t *)(&Tx_Msg[28])) = 65535;                      // epv
-    *((uint16_t *)(&Tx_Msg[30])) = Gps_Speed_Kt();             // velocity
-    *((uint16_t *)(&Tx_Msg[32])) = Gps_Heading_Deg();          // course over ground
-    Tx_Msg[34] = Gps_Fix();                                    // fix type
-    Tx_Msg[35] = 255;                                          // satellites
-
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_GPS_RAW_INT]);
+    if (Mavlink_Begin(30, MAVLINK_MSG_ID_GPS_RAW_INT)) {
+        Mavlink_Put_Zero(8);                                // time from boot [us]
+        Mavlink_Put_Long((uint32_t)Gps_Latitude());         // latitude
+        Mavlink_Put_Long((uint32_t)Gps_Longitude());        // longitude
+        Mavlink_Put_Long((uint32_t)(int32_t)Nav_Altitude()); // altitude
+        Mavlink_Put_Word(65535);                            // eph
+        Mavlink_Put_Word(65535);                            // epv
+        Mavlink_Put_Word(Gps_Speed_Kt());                   // velocity
+        Mavlink_Put_Word(Gps_Heading_Deg());                // course over ground
+        Mavlink_Put_Byte(Gps_Fix());                        // fix type
+        Mavlink_Put_Byte(255);                              // satellites
+        Mavlink_End();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -887,19 +1313,16 @@ void Mavlink_Gps_Raw( void ) {
 //----------------------------------------------------------------------------
 void Mavlink_Position( void ) {
 
-    Tx_Msg[1] = 28;                                            // payload length
-    Tx_Msg[5] = MAVLINK_MSG_ID_GLOBAL_POSITION_INT;            // global position message ID
-    *((uint32_t *)(&Tx_Msg[6])) = 0;                           // time from boot [ms]
-    *(( int32_t *)(&Tx_Msg[10])) = Gps_Latitude();             // latitude
-    *(( int32_t *)(&Tx_Msg[14])) = Gps_Longitude();            // longitude
-    *(( int32_t *)(&Tx_Msg[18])) = (int32_t)Nav_Altitude();    // altitude
-    *(( int32_t *)(&Tx_Msg[22])) = (int32_t)Nav_Altitude();    // altitude above ground
-    *((uint16_t *)(&Tx_Msg[26])) = 0;                          // ground x speed
-    *((uint16_t *)(&Tx_Msg[28])) = 0;                          // ground y speed
-    *((uint16_t *)(&Tx_Msg[30])) = 0;                          // ground z speed
-    *((uint16_t *)(&Tx_Msg[32])) = Gps_Heading_Deg();          // compass heading
-
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_GLOBAL_POSITION_INT]);
+    if (Mavlink_Begin(28, MAVLINK_MSG_ID_GLOBAL_POSITION_INT)) {
+        Mavlink_Put_Long(0);                                // time from boot [ms]
+        Mavlink_Put_Long((uint32_t)Gps_Latitude());         // latitude
+        Mavlink_Put_Long((uint32_t)Gps_Longitude());        // longitude
+        Mavlink_Put_Long((uint32_t)(int32_t)Nav_Altitude()); // altitude
+        Mavlink_Put_Long((uint32_t)(int32_t)Nav_Altitude()); // altitude above ground
+        Mavlink_Put_Zero(6);                                // ground x, y, z speed
+        Mavlink_Put_Word(Gps_Heading_Deg());                // compass heading
+        Mavlink_End();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -922,18 +1345,18 @@ void Mavlink_Position( void ) {
 void Mavlink_Param_Send( uint16_t param_index, uint16_t param_count ) {
 
     uint8_t j;
-
-    Tx_Msg[1] = 25;                                        // Payload length
-    Tx_Msg[5] = MAVLINK_MSG_ID_PARAM_VALUE;                // Parameter value message ID
-    *((float *)(&Tx_Msg[6])) = fParam_Value[param_index];  // Parameter value
-    *((uint16_t *)(&Tx_Msg[10])) = param_count;            // Total number of parameters
-    *((uint16_t *)(&Tx_Msg[12])) = param_index;            // Parameter index
-    for (j = 0; j < 16; j++) {
-        Tx_Msg[j + 14] = sParameter_Name[param_index][j];  // Parameter name
+    const uint8_t * name = Param_Name((paramEnum_Id)param_index);
+
+    if (Mavlink_Begin(25, MAVLINK_MSG_ID_PARAM_VALUE)) {
+        Mavlink_Put_Float(Param_Get((paramEnum_Id)param_index)); // Parameter value
+        Mavlink_Put_Word(param_count);                      // Total number of parameters
+        Mavlink_Put_Word(param_index);                      // Parameter index
+        for (j = 0; j < PARAM_NAME_LENGTH; j++) {
+            Mavlink_Put_Byte(name[j]);                      // Parameter name
+        }
+        Mavlink_Put_Byte((uint8_t)Param_Type((paramEnum_Id)param_index)); // Parameter type
+        Mavlink_End();
     }
-    Tx_Msg[30] = (uint8_t)MAVLINK_TYPE_FLOAT;              // Parameter type
-
-    Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_PARAM_VALUE]);
 }
 
 //----------------------------------------------------------------------------
@@ -954,46 +1377,118 @@ void Mavlink_Param_Send( uint16_t param_index, uint16_t param_count ) {
 ///                               without null termination if length = 16 chars
 /// param_type      22   uint8_t  Onboard parameter type: see MAVLINK_TYPE enum
 ///
+/// Value is written if type matches and it's within parameter bounds, then
+/// saved in flash. Current value is sent back in any case, so GCS sees a
+/// rejected value.
+///
 //----------------------------------------------------------------------------
 void Mavlink_Param_Set( void ) {
 
-    float f_value;
-    bool match;
-	uint8_t i, j;
+    paramEnum_Id id;
 
-    f_value = *(float *)(&Rx_Msg[0]);
     if ((Rx_Msg[4] == System_ID) &&                // message is for this system
         (Rx_Msg[5] == Component_ID)) {             // message is for this component
-        for (i = 0; i < ONBOARD_PARAM_COUNT; i++) {
-            match = TRUE;
-            for (j = 0; j < ONBOARD_PARAM_NAME_LENGTH; j++) {
-                if (Rx_Msg[j + 6] != sParameter_Name[i][j]) {   // compare name
-                    match = FALSE;
-                }
-                if (sParameter_Name[i][j] == '\0') {            // null termination is reached
-                    j = ONBOARD_PARAM_NAME_LENGTH;              // force termination of for loop
-                }
-            }
-            if (match) {                                            // name matched and
-                if ((fParam_Value[i] != f_value) &&                 // there is a difference and
-                     !isnan(f_value) &&                             // new value is a number and
-                     !isinf(f_value) &&                             // is NOT infinity and
-                     (Rx_Msg[22] == (uint8_t)MAVLINK_TYPE_FLOAT)) { // is a float
-                    fParam_Value[i] = f_value;                      // write changes
-                    Mavlink_Param_Send(i, 1);                       // emit changes
+        id = Param_Find(&Rx_Msg[6]);                            // binary search of name
+        if (id != PARAM_NUMBER) {                               // name matched
+            if (Rx_Msg[22] == (uint8_t)Param_Type(id)) {        // type matches
+                if (Param_Set(id, *(float *)(&Rx_Msg[0]))) {    // write changes
+                    (void)Store_Save();                         // append to flash log
                 }
             }
+            Mavlink_Param_Send((uint16_t)id, ONBOARD_PARAM_COUNT); // emit value
         }
     }
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Get HIL status
+/// \brief   Mark a parameter to be sent
+/// \param   param_index = index of parameter
+/// \returns -
+/// \remarks sent by Mavlink_Param_Next, a parameter already pending is
+///          sent once
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Param_Request( uint16_t param_index ) {
+
+    uint8_t mask = (uint8_t)(1 << (param_index % 8));
+
+    if ((param_index < ONBOARD_PARAM_COUNT) &&
+        ((uc_Param_Pending[param_index / 8] & mask) == 0)) {
+        uc_Param_Pending[param_index / 8] |= mask;
+        ui_Param_Count++;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Request parameter list
+/// \param   -
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_PARAM_REQUEST_LIST, ID = 21, Length = 2
+///
+/// Field            Offset Type     Meaning
+/// -----------------------------------------
+/// target_system      0    uint8_t  System ID
+/// target_component   1    uint8_t  Component ID
+///
+/// All parameters become pending, list is sent again from index 0.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Param_List( void ) {
+
+    uint16_t j;
+
+    for (j = 0; j < ONBOARD_PARAM_COUNT; j++) {
+        Mavlink_Param_Request(j);
+    }
+    ui_Param_Index = 0;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Request one parameter
 /// \param   -
 /// \returns -
 /// \remarks
-/// Name = MAVLINK_MSG_ID_HIL_STATE
+/// Name = MAVLINK_MSG_ID_PARAM_REQUEST_READ, ID = 20, Length = 20
+///
+/// Field            Offset Type     Meaning
+/// -----------------------------------------
+/// param_index        0    int16_t  Parameter index, -1 to use param_id
+/// target_system      2    uint8_t  System ID
+/// target_component   3    uint8_t  Component ID
+/// param_id, 16       4    array    Parameter name, null terminated if
+///                                  length < 16 chars
+///
+/// Used by GCS to get indices missing from a list download. Parameter
+/// becomes pending and is sent with next burst.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Param_Read( void ) {
+
+    int16_t index = (int16_t)((uint16_t)Rx_Msg[0] | ((uint16_t)Rx_Msg[1] << 8));
+
+    if ((Rx_Msg[2] == System_ID) &&                // message is for this system
+        (Rx_Msg[3] == Component_ID)) {             // message is for this component
+        if (index < 0) {
+            Mavlink_Param_Request((uint16_t)Param_Find(&Rx_Msg[4])); // search name
+        } else {
+            Mavlink_Param_Request((uint16_t)index);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Get HIL status
+/// \param   -
+/// \returns -
+/// \remarks Rates and accelerations are AHRS sensors, position is the
+///          navigation fix, altitude replaces barometric altitude. Speed
+///          and course are computed from ground speed components.
+/// Name = MAVLINK_MSG_ID_HIL_STATE, ID = 90, Length = 56
 ///
 /// Field       Offset Type     Meaning
 /// -------------------------------------
@@ -1001,32 +1496,283 @@ void Mavlink_Param_Set( void ) {
 /// roll           8   float
 /// pitch         12   float
 /// yaw           16   float
-/// rollspeed     20   float
-/// pitchspeed    24   float
-/// yawspeed      28   float
-/// lat           32   int32_t
-/// lon           36   int32_t
-/// alt           40   int32_t
-/// vx            44   int16_t
-/// vy            46   int16_t
+/// rollspeed     20   float    roll rate [rad/s]
+/// pitchspeed    24   float    pitch rate [rad/s]
+/// yawspeed      28   float    yaw rate [rad/s]
+/// lat           32   int32_t  latitude [deg * 1E7]
+/// lon           36   int32_t  longitude [deg * 1E7]
+/// alt           40   int32_t  altitude [mm]
+/// vx            44   int16_t  ground speed north [cm/s]
+/// vy            46   int16_t  ground speed east [cm/s]
 /// vz            48   int16_t
-/// xacc          50   int16_t
-/// yacc          52   int16_t
-/// zacc          54   int16_t
+/// xacc          50   int16_t  acceleration x [mg]
+/// yacc          52   int16_t  acceleration y [mg]
+/// zacc          54   int16_t  acceleration z [mg]
 ///
 //----------------------------------------------------------------------------
 void Mavlink_HIL_State( void ) {
-/*
-    rollspeed  = *((float *)(&Tx_Msg[26]));    //
-    pitchspeed = *((float *)(&Tx_Msg[30]));    //
-    yawspeed   = *((float *)(&Tx_Msg[34]));    //
-    lat = *((int32_t *)(&Tx_Msg[38]));         //
-    lon = *((int32_t *)(&Tx_Msg[42]));         //
-    alt = *((int32_t *)(&Tx_Msg[46]));         //
-    xacc = *((int16_t *)(&Tx_Msg[56]));        //
-    yacc = *((int16_t *)(&Tx_Msg[58]));        //
-    zacc = *((int16_t *)(&Tx_Msg[60]));        //
-*/
+
+    uint8_t j;
+    float f_accel[3];
+    float f_north, f_east, f_course;
+    telStruct_Gps x_fix;
+
+    for (j = 0; j < 3; j++) {                       // [mg] to [m/s^2]
+        f_accel[j] = (float)(*((int16_t *)(&Rx_Msg[50 + 2 * j]))) * (HIL_GRAVITY / 1000.0f);
+    }
+    Mavlink_Hil_Imu(f_accel, (float *)(&Rx_Msg[20]));
+    f_Hil_Altitude = (float)(*((int32_t *)(&Rx_Msg[40]))) / 1000.0f;
+
+    f_north = (float)(*((int16_t *)(&Rx_Msg[44])));
+    f_east = (float)(*((int16_t *)(&Rx_Msg[46])));
+    f_course = ToDeg(atan2f(f_east, f_north)) * 100.0f;
+    if (f_course < 0.0f) {
+        f_course += 36000.0f;
+    }
+    x_fix.lLat = *((int32_t *)(&Rx_Msg[32]));
+    x_fix.lLon = *((int32_t *)(&Rx_Msg[36]));
+    x_fix.lAlt = *((int32_t *)(&Rx_Msg[40]));
+    x_fix.uiSpeed = (uint16_t)sqrtf((f_north * f_north) + (f_east * f_east));
+    x_fix.uiCourse = (uint16_t)f_course;
+    x_fix.ucFix = 3;                                // 3D fix
+    Mavlink_Hil_Fix(&x_fix);
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Get HIL sensors
+/// \param   -
+/// \returns -
+/// \remarks Accelerations and rates are AHRS sensors, pressure altitude
+///          replaces barometric altitude. Magnetic field, pressures and
+///          temperature aren't used. All fields are taken regardless of
+///          fields_updated.
+/// Name = MAVLINK_MSG_ID_HIL_SENSOR, ID = 107, Length = 64
+///
+/// Field          Offset Type     Meaning
+/// ----------------------------------------
+/// time_usec         0   uint64_t
+/// xacc              8   float    acceleration x [m/s^2]
+/// yacc             12   float    acceleration y [m/s^2]
+/// zacc             16   float    acceleration z [m/s^2]
+/// xgyro            20   float    roll rate [rad/s]
+/// ygyro            24   float    pitch rate [rad/s]
+/// zgyro            28   float    yaw rate [rad/s]
+/// xmag             32   float
+/// ymag             36   float
+/// zmag             40   float
+/// abs_pressure     44   float
+/// diff_pressure    48   float
+/// pressure_alt     52   float    altitude [m]
+/// temperature      56   float
+/// fields_updated   60   uint32_t
+/// id               64   uint8_t  MAVLink 2 extension
+///
+//----------------------------------------------------------------------------
+void Mavlink_Hil_Sensor( void ) {
+
+    Mavlink_Hil_Imu((float *)(&Rx_Msg[8]), (float *)(&Rx_Msg[20]));
+    f_Hil_Altitude = *((float *)(&Rx_Msg[52]));
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Get HIL GPS fix
+/// \param   -
+/// \returns -
+/// \remarks Fix is read by navigation task through Telemetry_Get_Gps().
+/// Name = MAVLINK_MSG_ID_HIL_GPS, ID = 113, Length = 36
+///
+/// Field              Offset Type     Meaning
+/// --------------------------------------------
+/// time_usec             0   uint64_t
+/// lat                   8   int32_t  latitude [deg * 1E7]
+/// lon                  12   int32_t  longitude [deg * 1E7]
+/// alt                  16   int32_t  altitude [mm]
+/// eph                  20   uint16_t
+/// epv                  22   uint16_t
+/// vel                  24   uint16_t ground speed [cm/s], UINT16_MAX if unknown
+/// vn                   26   int16_t
+/// ve                   28   int16_t
+/// vd                   30   int16_t
+/// cog                  32   uint16_t course [deg * 100], UINT16_MAX if unknown
+/// fix_type             34   uint8_t  0-1 = no fix, 2 = 2D fix, 3 = 3D fix
+/// satellites_visible   35   uint8_t
+///
+//----------------------------------------------------------------------------
+void Mavlink_Hil_Gps( void ) {
+
+    telStruct_Gps x_fix;
+
+    x_fix.lLat = *((int32_t *)(&Rx_Msg[8]));
+    x_fix.lLon = *((int32_t *)(&Rx_Msg[12]));
+    x_fix.lAlt = *((int32_t *)(&Rx_Msg[16]));
+    x_fix.uiSpeed = *((uint16_t *)(&Rx_Msg[24]));
+    x_fix.uiCourse = *((uint16_t *)(&Rx_Msg[32]));
+    x_fix.ucFix = Rx_Msg[34];
+    Mavlink_Hil_Fix(&x_fix);
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Convert HIL accelerations and rates to raw sensor data
+/// \param   pfAccel = pointer to accelerations x, y, z [m/s^2]
+/// \param   pfGyro = pointer to rates x, y, z [rad/s]
+/// \returns -
+/// \remarks HIL accelerations are specific force in body axes, i.e. z is
+///          -1 g when level, whereas AHRS input is +GRAVITY. Gravity is
+///          removed from z, so a level and still aircraft reads zero on all
+///          sensors, as it does before first HIL message: offsets found by
+///          calibration are zero either way. Data are written to the buffer
+///          not being read, attitude task has higher priority and can't be
+///          interrupted by this function while copying.
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Hil_Imu( const float * pfAccel, const float * pfGyro ) {
+
+    uint8_t j;
+    uint8_t slot = uc_Hil_Sensor ^ 1;
+    float f_value[6];
+
+    for (j = 0; j < 3; j++) {
+        f_value[j] = -pfAccel[j] * ((float)GRAVITY / HIL_GRAVITY);
+        f_value[j + 3] = pfGyro[j] / GYRO_GAIN;
+    }
+    f_value[2] -= (float)GRAVITY;                   // level reads zero
+    for (j = 0; j < 6; j++) {
+        f_value[j] *= (float)Hil_Sign[j];           // AHRS to raw sign
+        if (f_value[j] > 32767.0f) {                // saturate as ADC does
+            f_value[j] = 32767.0f;
+        } else if (f_value[j] < -32768.0f) {
+            f_value[j] = -32768.0f;
+        }
+        i_Hil_Sensor[slot][j] = (int16_t)floorf(f_value[j] + 0.5f);
+    }
+    uc_Hil_Sensor = slot;                           // publish sensors
+    uc_Hil_Timer = HIL_TIMEOUT;                     // keep sending controls
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Publish HIL GPS fix
+/// \param   pxFix = pointer to fix
+/// \returns -
+/// \remarks Sequence number is odd while the fix is written, so that
+///          navigation task, which has the same priority, can tell a fix
+///          that changed while it was copied.
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Hil_Fix( const telStruct_Gps * pxFix ) {
+
+    uc_Hil_Gps++;                                   // odd, fix being written
+    x_Hil_Gps = *pxFix;
+    uc_Hil_Gps++;                                   // even, fix complete
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Send HIL controls
+/// \param   -
+/// \returns -
+/// \remarks Servo positions are normalized, signs are those of servo outputs.
+///          Timestamp is that of latest AHRS sample.
+/// Name = MAVLINK_MSG_ID_HIL_CONTROLS, ID = 91, Length = 42
+///
+/// Field            Offset Type     Meaning
+/// ------------------------------------------
+/// time_usec           0   uint64_t sample time [us]
+/// roll_ailerons       8   float    aileron [-1, 1]
+/// pitch_elevator     12   float    elevator [-1, 1]
+/// yaw_rudder         16   float    rudder [-1, 1]
+/// throttle           20   float    throttle [0, 1]
+/// aux1 ... aux4      24   float    0
+/// mode               40   uint8_t  HIL_MODE
+/// nav_mode           41   uint8_t  0
+///
+//----------------------------------------------------------------------------
+void Mavlink_Hil_Controls( void ) {
+
+    uint64_t time = (uint64_t)ul_Sample_Number * SAMPLE_PERIOD;
+    float f_throttle;
+
+    f_throttle = (float)(Servo_Get(SERVO_THROTTLE) - (SERVO_NEUTRAL - 500)) / 1000.0f;
+    if (f_throttle < 0.0f) {
+        f_throttle = 0.0f;
+    } else if (f_throttle > 1.0f) {
+        f_throttle = 1.0f;
+    }
+    if (Mavlink_Begin(42, MAVLINK_MSG_ID_HIL_CONTROLS)) {
+        Mavlink_Put_Long((uint32_t)time);           // sample time, 64 bit
+        Mavlink_Put_Long((uint32_t)(time >> 32));
+        Mavlink_Put_Float((float)(Servo_Get(SERVO_AILERON) - SERVO_NEUTRAL) / 500.0f);
+        Mavlink_Put_Float((float)(Servo_Get(SERVO_ELEVATOR) - SERVO_NEUTRAL) / 500.0f);
+        Mavlink_Put_Float((float)(Servo_Get(SERVO_RUDDER) - SERVO_NEUTRAL) / 500.0f);
+        Mavlink_Put_Float(f_throttle);
+        Mavlink_Put_Zero(16);                       // aux 1 - 4
+        Mavlink_Put_Byte((uint8_t)HIL_MODE);        // mode
+        Mavlink_Put_Zero(1);                        // navigation mode
+        Mavlink_End();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Execute command
+/// \param   -
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_COMMAND_LONG, ID = 76, Length = 33
+///
+/// Field         Offset Type   Meaning
+/// ----------------------------------------------------------------------
+/// param1           0 float    parameter 1, as defined by MAV_CMD enum
+/// ...
+/// param7          24 float    parameter 7, as defined by MAV_CMD enum
+/// command         28 uint16_t command ID, as defined by MAV_CMD enum
+/// target_system   30 uint8_t  system which should execute the command
+/// target_component 31 uint8_t component which should execute the command
+/// confirmation    32 uint8_t  0: first transmission, 1-255: confirmations
+///
+/// Reply is MAVLINK_MSG_ID_COMMAND_ACK, ID = 77, Length = 3
+///
+/// Field         Offset Type   Meaning
+/// ----------------------------------------------------------------------
+/// command          0 uint16_t command ID, as defined by MAV_CMD enum
+/// result           2 uint8_t  see MAV_RESULT enum
+///
+/// Only MAV_CMD_PREFLIGHT_CALIBRATION with gyro calibration is supported.
+/// It's accepted only when Attitude_On_Ground() holds: manual mode, throttle
+/// at idle, and aircraft stopped by GPS or, without a fix, gyros still.
+/// Otherwise it's answered with MAV_RESULT_TEMPORARILY_REJECTED, since
+/// servos aren't updated while the attitude task calibrates. The attitude
+/// task checks again before it starts.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Command( void ) {
+
+    uint16_t command;
+    uint8_t result;
+
+    if ((Rx_Msg[30] == System_ID) &&                // message is for this system
+        (Rx_Msg[31] == Component_ID)) {             // message is for this component
+        command = *((uint16_t *)(&Rx_Msg[28]));
+        if ((command == (uint16_t)MAV_CMD_PREFLIGHT_CALIBRATION) &&
+            (*((float *)(&Rx_Msg[0])) == 1.0f)) {   // gyro calibration
+            if (Attitude_On_Ground()) {             // aircraft stopped on ground
+                Calibration_Request();              // done by attitude task
+                result = (uint8_t)MAV_RESULT_ACCEPTED;
+            } else {
+                result = (uint8_t)MAV_RESULT_TEMPORARILY_REJECTED;
+            }
+        } else {
+            result = (uint8_t)MAV_RESULT_UNSUPPORTED;
+        }
+        if (Mavlink_Begin(3, MAVLINK_MSG_ID_COMMAND_ACK)) {
+            Mavlink_Put_Word(command);              // command
+            Mavlink_Put_Byte(result);               // result
+            Mavlink_End();
+        }
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -1127,11 +1873,11 @@ void Mavlink_Mission_Count( void ) {
 
     if ((Rx_Msg[0] == System_ID) &&                // message is for this system
         (Rx_Msg[1] == Component_ID)) {             // message is for this component
-        Tx_Msg[1] = 4;                                  // payload length
-        Tx_Msg[5] = MAVLINK_MSG_ID_MISSION_COUNT;       // mission count message ID
-        *((uint16_t *)(&Tx_Msg[6])) = Nav_Wpt_Number(); // number of waypoints
-
-        Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_MISSION_COUNT]);
+        if (Mavlink_Begin(4, MAVLINK_MSG_ID_MISSION_COUNT)) {
+            Mavlink_Put_Word(Nav_Wpt_Number());         // number of waypoints
+            Mavlink_Put_Zero(2);                        // target system, component
+            Mavlink_End();
+        }
     }
 }
 
@@ -1171,33 +1917,186 @@ void Mavlink_Mission_Item( void ) {
 
         index = *((uint16_t *)(&Rx_Msg[0]));                    // get waypoint index
         Nav_Wpt_Get(index, &wpt);                               // get waypoint data
-        Tx_Msg[1] = 37;                                         // payload length
-        Tx_Msg[5] = MAVLINK_MSG_ID_MISSION_ITEM;                // message ID
-        *((float    *)(&Tx_Msg[ 6])) = 100.0f;                  // radius
-        *((float    *)(&Tx_Msg[10])) =   0.0f;                  // time
-        *((float    *)(&Tx_Msg[14])) =   0.0f;                  // orbit
-        *((float    *)(&Tx_Msg[18])) =   0.0f;                  // yaw
-        *((float    *)(&Tx_Msg[22])) = wpt.Lat;                 // latitude
-        *((float    *)(&Tx_Msg[26])) = wpt.Lon;                 // longitude
-        *((float    *)(&Tx_Msg[30])) = wpt.Alt;                 // altitude
-        *((uint16_t *)(&Tx_Msg[34])) = index;                   // sequence
-        *((uint16_t *)(&Tx_Msg[36])) = (uint8_t)MAV_CMD_NAV_WAYPOINT; // command
-                          Tx_Msg[38] = 1;                       // target sys
-                          Tx_Msg[39] = 1;                       // target comp
-                          Tx_Msg[40] = (uint8_t)MAV_FRAME_GLOBAL; // frame
-                          Tx_Msg[41] = 0;                       // current
-                          Tx_Msg[42] = 1;                       // auto continue
-
-        Mavlink_Send(Mavlink_Crc[MAVLINK_MSG_ID_MISSION_ITEM]);
+        if (Mavlink_Begin(37, MAVLINK_MSG_ID_MISSION_ITEM)) {
+            Mavlink_Put_Float(100.0f);                          // radius
+            Mavlink_Put_Float(0.0f);                            // time
+            Mavlink_Put_Float(0.0f);                            // orbit
+            Mavlink_Put_Float(0.0f);                            // yaw
+            Mavlink_Put_Float(wpt.Lat);                         // latitude
+            Mavlink_Put_Float(wpt.Lon);                         // longitude
+            Mavlink_Put_Float(wpt.Alt);                         // altitude
+            Mavlink_Put_Word(index);                            // sequence
+            Mavlink_Put_Word((uint16_t)MAV_CMD_NAV_WAYPOINT);   // command
+            Mavlink_Put_Byte(1);                                // target sys
+            Mavlink_Put_Byte(1);                                // target comp
+            Mavlink_Put_Byte((uint8_t)MAV_FRAME_GLOBAL);        // frame
+            Mavlink_Put_Byte(0);                                // current
+            Mavlink_Put_Byte(1);                                // auto continue
+            Mavlink_End();
+        }
     }
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Parse communication packets
+/// \brief   Request mission item being uploaded
 /// \param   -
 /// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_MISSION_REQUEST, ID = 40, Length = 4
+///
+/// Field         Offset Type   Meaning
+/// ----------------------------------------------------------------------
+/// seq              0 uint16_t sequence of requested item
+/// target_system    2 uint8_t  system ID
+/// target_component 3 uint8_t  component ID
+///
+/// Restarts timeout of the upload.
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Mission_Request( void ) {
+
+    uc_Upload_Timer = MISSION_TIMEOUT;
+    if (Mavlink_Begin(4, MAVLINK_MSG_ID_MISSION_REQUEST)) {
+        Mavlink_Put_Word(ui_Upload_Seq);            // sequence
+        Mavlink_Put_Zero(2);                        // target system, component
+        Mavlink_End();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Terminate mission upload
+/// \param   result = see MAV_MISSION_RESULT enum
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_MISSION_ACK, ID = 47, Length = 3
+///
+/// Field         Offset Type   Meaning
+/// ----------------------------------------------------------------------
+/// target_system    0 uint8_t  system ID
+/// target_component 1 uint8_t  component ID
+/// type             2 uint8_t  see MAV_MISSION_RESULT enum
+///
+//----------------------------------------------------------------------------
+static void Mavlink_Mission_Ack( uint8_t result ) {
+
+    uc_Upload_Timer = 0;                            // upload is over
+    if (Mavlink_Begin(3, MAVLINK_MSG_ID_MISSION_ACK)) {
+        Mavlink_Put_Zero(2);                        // target system, component
+        Mavlink_Put_Byte(result);                   // result
+        Mavlink_End();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Start mission upload
+/// \param   -
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_MISSION_COUNT, ID = 44, Length = 4
+///
+/// Field         Offset Type   Meaning
+/// ----------------------------------------------------------------------
+/// count            0 uint16_t number of items, launch position included
+/// target_system    2 uint8_t  system ID
+/// target_component 3 uint8_t  component ID
+///
+/// A new count restarts an upload in progress. Upload is refused while
+/// navigation hasn't activated the previous one yet. A mission without
+/// waypoints is accepted at once, aircraft returns to launch.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Mission_Upload( void ) {
+
+    if ((Rx_Msg[2] == System_ID) &&                // message is for this system
+        (Rx_Msg[3] == Component_ID)) {             // message is for this component
+        ui_Upload_Count = *((uint16_t *)(&Rx_Msg[0]));
+        ui_Upload_Seq = 0;
+        uc_Upload_Retry = 0;
+        if (ui_Upload_Count > MISSION_MAX) {
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_NO_SPACE);
+        } else if (Mission_Pending()) {
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_ERROR);
+        } else if (ui_Upload_Count == 0) {
+            (void)Mission_Commit(0);
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_ACCEPTED);
+        } else {
+            Mavlink_Mission_Request();
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Load uploaded mission item
+/// \param   -
+/// \returns -
+/// \remarks
+/// Name = MAVLINK_MSG_ID_MISSION_ITEM, ID = 39, Length = 37
+/// See Mavlink_Mission_Item for fields.
+///
+/// Only MAV_CMD_NAV_WAYPOINT in a global frame is supported. Item 0 is the
+/// launch position, which is set by navigation and not overwritten. After
+/// the last item the mission is validated and handed to navigation.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Mission_Load( void ) {
+
+    uint16_t seq;
+    uint8_t frame;
+
+    if ((Rx_Msg[32] == System_ID) &&               // message is for this system
+        (Rx_Msg[33] == Component_ID) &&            // message is for this component
+        (uc_Upload_Timer != 0)) {                  // upload in progress
+        seq = *((uint16_t *)(&Rx_Msg[28]));
+        frame = Rx_Msg[34];
+        if (seq != ui_Upload_Seq) {                 // lost or repeated item
+            Mavlink_Mission_Request();              // ask expected one
+            return;
+        }
+        if (seq != 0) {
+            if ((frame != (uint8_t)MAV_FRAME_GLOBAL) &&
+                (frame != (uint8_t)MAV_FRAME_GLOBAL_RELATIVE_ALT)) {
+                Mavlink_Mission_Ack((uint8_t)MAV_MISSION_UNSUPPORTED_FRAME);
+                return;
+            }
+            if (*((uint16_t *)(&Rx_Msg[30])) != (uint16_t)MAV_CMD_NAV_WAYPOINT) {
+                Mavlink_Mission_Ack((uint8_t)MAV_MISSION_UNSUPPORTED);
+                return;
+            }
+            wpt.Lat = *((float *)(&Rx_Msg[16]));
+            wpt.Lon = *((float *)(&Rx_Msg[20]));
+            wpt.Alt = *((float *)(&Rx_Msg[24]));
+            if (!Mission_Load(seq, &wpt)) {
+                Mavlink_Mission_Ack((uint8_t)MAV_MISSION_ERROR);
+                return;
+            }
+        }
+        uc_Upload_Retry = 0;
+        if (++ui_Upload_Seq < ui_Upload_Count) {
+            Mavlink_Mission_Request();              // next item
+        } else if (Mission_Commit(ui_Upload_Count)) {
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_ACCEPTED);
+        } else {
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_INVALID);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Parse communication packets
+/// \param   -
+/// \returns TRUE if a packet has been received
 /// \remarks This function decodes packets on the protocol level.
+///          It stops after each packet, so that following packets in the
+///          buffer aren't lost. Discarded frames are counted in rx_resync.
+///          Both MAVLink 1 and 2 are accepted, payload of MAVLink 2 is
+///          padded with zeros. First valid MAVLink 2 frame switches
+///          transmission to MAVLink 2. Signed frames and message IDs above
+///          255 are discarded.
 ///
 //----------------------------------------------------------------------------
 static bool Mavlink_Parse(void) {
@@ -1214,80 +2113,118 @@ static bool Mavlink_Parse(void) {
     static uint8_t packet_idx;
     static uint8_t seq;
     static uint8_t current_rx_seq;
+    static bool rx_v2;
     bool msg_received = FALSE;
 
-    while (USART1_Getch (&c)) {               // received another character
+    while (!msg_received && USART1_Getch (&c)) { // one packet at a time
 	switch (parse_state) {
         case MAVLINK_PARSE_STATE_UNINIT:
         case MAVLINK_PARSE_STATE_IDLE:
-            if (c == MAVLINK_STX) {
+            if ((c == MAVLINK_STX) || (c == MAVLINK_STX_V2)) {
                 parse_state = MAVLINK_PARSE_STATE_GOT_STX;
                 len = 0;
 //                magic = c;
-                Checksum_Init();
+                rx_v2 = (c == MAVLINK_STX_V2);
+                rx_crc = CRC_X25_INIT;
             }
             break;
 
         case MAVLINK_PARSE_STATE_GOT_STX:
-            if (msg_received || (c > PAYLOAD_LEN)) {
-//                buffer_overrun++;
-//                parse_error++;
-                msg_received = FALSE;
+            if (c > PAYLOAD_LEN - 2) {     // payload and CRC must fit Rx_Msg
+                rx_resync++;
                 parse_state = MAVLINK_PARSE_STATE_IDLE;
             } else {
                 len = c; // NOT counting STX, LENGTH, SEQ, SYSID, COMPID, MSGID, CRC1 and CRC2
                 packet_idx = 0;
-                Checksum_Accumulate(c);
+                rx_crc = Crc_X25_Byte(rx_crc, c);
                 parse_state = MAVLINK_PARSE_STATE_GOT_LENGTH;
             }
             break;
 
         case MAVLINK_PARSE_STATE_GOT_LENGTH:
+            if (!rx_v2) {
+                seq = c;
+                rx_crc = Crc_X25_Byte(rx_crc, c);
+                parse_state = MAVLINK_PARSE_STATE_GOT_SEQ;
+            } else if (c != 0) {            // signed or unknown features
+                rx_resync++;
+                parse_state = MAVLINK_PARSE_STATE_IDLE;
+            } else {
+                rx_crc = Crc_X25_Byte(rx_crc, c);
+                parse_state = MAVLINK_PARSE_STATE_GOT_INCOMPAT_FLAGS;
+            }
+            break;
+
+        case MAVLINK_PARSE_STATE_GOT_INCOMPAT_FLAGS:
+            rx_crc = Crc_X25_Byte(rx_crc, c);
+            parse_state = MAVLINK_PARSE_STATE_GOT_COMPAT_FLAGS;
+            break;
+
+        case MAVLINK_PARSE_STATE_GOT_COMPAT_FLAGS:
             seq = c;
-            Checksum_Accumulate(c);
+            rx_crc = Crc_X25_Byte(rx_crc, c);
             parse_state = MAVLINK_PARSE_STATE_GOT_SEQ;
             break;
 
         case MAVLINK_PARSE_STATE_GOT_SEQ:
 //            sysid = c;
-            Checksum_Accumulate(c);
+            rx_crc = Crc_X25_Byte(rx_crc, c);
             parse_state = MAVLINK_PARSE_STATE_GOT_SYSID;
             break;
 
         case MAVLINK_PARSE_STATE_GOT_SYSID:
 //            compid = c;
-            Checksum_Accumulate(c);
+            rx_crc = Crc_X25_Byte(rx_crc, c);
             parse_state = MAVLINK_PARSE_STATE_GOT_COMPID;
             break;
 
         case MAVLINK_PARSE_STATE_GOT_COMPID:
             msgid = c;
-            Checksum_Accumulate(c);
-            if (len == 0) {
+            rx_crc = Crc_X25_Byte(rx_crc, c);
+            if (rx_v2) {
+                parse_state = MAVLINK_PARSE_STATE_GOT_MSGID1;
+            } else if (len == 0) {
                 parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD;
             } else {
                 parse_state = MAVLINK_PARSE_STATE_GOT_MSGID;
             }
             break;
 
+        case MAVLINK_PARSE_STATE_GOT_MSGID1:
+        case MAVLINK_PARSE_STATE_GOT_MSGID2:
+            if (c != 0) {                   // no CRC extra for ID above 255
+                rx_resync++;
+                parse_state = MAVLINK_PARSE_STATE_IDLE;
+            } else {
+                rx_crc = Crc_X25_Byte(rx_crc, c);
+                if (parse_state == MAVLINK_PARSE_STATE_GOT_MSGID1) {
+                    parse_state = MAVLINK_PARSE_STATE_GOT_MSGID2;
+                } else if (len == 0) {
+                    parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD;
+                } else {
+                    parse_state = MAVLINK_PARSE_STATE_GOT_MSGID;
+                }
+            }
+            break;
+
         case MAVLINK_PARSE_STATE_GOT_MSGID:
             Rx_Msg[packet_idx++] = c;
-            Checksum_Accumulate(c);
+            rx_crc = Crc_X25_Byte(rx_crc, c);
             if (packet_idx == len) {
                 parse_state = MAVLINK_PARSE_STATE_GOT_PAYLOAD;
             }
             break;
 
         case MAVLINK_PARSE_STATE_GOT_PAYLOAD:
-            Checksum_Accumulate(Mavlink_Crc[msgid]);
-            if (c != (Crc & 0xFF)) { // Check first checksum byte
-//                parse_error++;
-                msg_received = FALSE;
+            rx_crc = Crc_X25_Byte(rx_crc, Mavlink_Crc[msgid]);
+            if (c != (rx_crc & 0xFF)) { // Check first checksum byte
+                rx_resync++;
                 parse_state = MAVLINK_PARSE_STATE_IDLE;
-                if (c == MAVLINK_STX) {
+                if ((c == MAVLINK_STX) || (c == MAVLINK_STX_V2)) {
                     parse_state = MAVLINK_PARSE_STATE_GOT_STX;
                     len = 0;
-                    Checksum_Init();
+                    rx_v2 = (c == MAVLINK_STX_V2);
+                    rx_crc = CRC_X25_INIT;
                 }
             } else {
                 parse_state = MAVLINK_PARSE_STATE_GOT_CRC1;
@@ -1296,19 +2233,25 @@ static bool Mavlink_Parse(void) {
             break;
 
         case MAVLINK_PARSE_STATE_GOT_CRC1:
-            if (c != (Crc >> 8)) {	// Check second checksum byte
-//                parse_error++;
-                msg_received = FALSE;
+            if (c != (rx_crc >> 8)) {	// Check second checksum byte
+                rx_resync++;
                 parse_state = MAVLINK_PARSE_STATE_IDLE;
-                if (c == MAVLINK_STX) {
+                if ((c == MAVLINK_STX) || (c == MAVLINK_STX_V2)) {
                     parse_state = MAVLINK_PARSE_STATE_GOT_STX;
                     len = 0;
-                    Checksum_Init();
+                    rx_v2 = (c == MAVLINK_STX_V2);
+                    rx_crc = CRC_X25_INIT;
                 }
             } else {		        // Successfully got message
                 msg_received = TRUE;
                 parse_state = MAVLINK_PARSE_STATE_IDLE;
                 Rx_Msg[packet_idx + 1] = c;
+                if (rx_v2) {
+                    while (packet_idx < PAYLOAD_LEN) {  // pad truncated payload
+                        Rx_Msg[packet_idx++] = 0;
+                    }
+                    b_Version_2 = TRUE;     // GCS speaks MAVLink 2
+                }
     //            memcpy(r_message, rxmsg, sizeof(mavlink_message_t));
             }
             break;
@@ -1342,7 +2285,7 @@ static bool Mavlink_Parse(void) {
 //----------------------------------------------------------------------------
 void Mavlink_Receive(void)
 {
-    if (Mavlink_Parse()) {                          // Received a correct packet
+    while (Mavlink_Parse()) {                       // Received a correct packet
         switch (msgid) {                            // Handle message
             case MAVLINK_MSG_ID_HEARTBEAT:          // E.g. read GCS heartbeat and go into comm lost mode if timer times out
                 break;
@@ -1350,9 +2293,13 @@ void Mavlink_Receive(void)
                 Mavlink_Data_Stream();
                 break;
             case MAVLINK_MSG_ID_COMMAND_LONG:	    //
+                Mavlink_Command();
                 break;
             case MAVLINK_MSG_ID_PARAM_REQUEST_LIST: //
-                m_parameter_i = 0;
+                Mavlink_Param_List();
+                break;
+            case MAVLINK_MSG_ID_PARAM_REQUEST_READ: // missing parameter
+                Mavlink_Param_Read();
                 break;
             case MAVLINK_MSG_ID_PARAM_SET:          //
                 Mavlink_Param_Set();
@@ -1362,12 +2309,24 @@ void Mavlink_Receive(void)
             case MAVLINK_MSG_ID_HIL_STATE:
                 Mavlink_HIL_State();
                 break;
+            case MAVLINK_MSG_ID_HIL_SENSOR:
+                Mavlink_Hil_Sensor();
+                break;
+            case MAVLINK_MSG_ID_HIL_GPS:
+                Mavlink_Hil_Gps();
+                break;
             case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
                 Mavlink_Mission_Count();
                 break;
             case MAVLINK_MSG_ID_MISSION_REQUEST:
                 Mavlink_Mission_Item();
                 break;
+            case MAVLINK_MSG_ID_MISSION_COUNT:
+                Mavlink_Mission_Upload();
+                break;
+            case MAVLINK_MSG_ID_MISSION_ITEM:
+                Mavlink_Mission_Load();
+                break;
             default:				                // Do nothing
                 break;
         }
@@ -1377,184 +2336,243 @@ void Mavlink_Receive(void)
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Send low-priority messages at a maximum rate of xx Hertz
+/// \brief   Initialize telemetry
 /// \param   -
 /// \returns -
-/// \remarks This function sends messages at a lower rate to not exceed the
-///          wireless bandwidth. It sends one message each time it is called
-///          until the buffer is empty.
-///          Call this function with xx Hertz to increase/decrease bandwidth.
-///          See Ardupilot function queued_param_send at link:
-/// https://github.com/diydrones/ardupilot/blob/master/ArduPlane/GCS_Mavlink.pde
+/// \remarks call function once, before Mavlink_Stream_Send
 ///
 //----------------------------------------------------------------------------
-void Mavlink_Queued_Send(uint8_t cycles)
+void Mavlink_Init(void)
 {
-    if (m_parameter_i < ONBOARD_PARAM_COUNT) {      // must send parameters
-        if ((cycles % 10) == 0) {                   // @ 5 Hz
-            Mavlink_Param_Send(m_parameter_i++, ONBOARD_PARAM_COUNT);  // send parameters
-        }
-    } else if ((cycles % 200) == 0) {               // @ 0.25 Hz
-    } else if ((cycles % 50) == 0) {                // @ 1 Hz
-        Mavlink_Heartbeat();                        // send heartbeat
-    } else if ((cycles % 5) == 0) {                 // @ 10 Hz
-    }
+    Stream_Init(x_Stream, (uint8_t)STREAM_NUMBER, LINK_BUDGET);
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Send data stream
+/// \brief   Send data streams
 /// \param   -
 /// \returns -
-/// \remarks call function @ 50 Hz
+/// \remarks call function @ STREAM_TICK_HZ.
+///          Rates requested by GCS are copied to the stream table, then the
+///          scheduler sends the streams that are due, by priority, as long
+///          as the link byte budget allows. Replaces Ardupilot functions
+///          stream_trigger and queued_param_send, whose stream_slowdown
+///          reacted to a full buffer, i.e. only after messages were lost.
+///          Heartbeat comes first, so it's never pre-empted by parameters,
+///          which throttle the other streams while pending. HIL controls
+///          come in between, so the simulator loop is closed at full rate.
+///          Mission item requests without answer are repeated here.
 ///
 //----------------------------------------------------------------------------
 void Mavlink_Stream_Send(void)
 {
-/*
-    if (_queued_parameter != NULL) {
-        if (streamRateParams.get() <= 0) {
-            streamRateParams.set(50);
-        }
-        if (stream_trigger(STREAM_PARAMS)) {
-            send_message(MSG_NEXT_PARAM);
+    if ((uc_Upload_Timer != 0) && (--uc_Upload_Timer == 0)) {  // item not received
+        if (++uc_Upload_Retry > MISSION_RETRIES) {
+            Mavlink_Mission_Ack((uint8_t)MAV_MISSION_ERROR);   // give up
+        } else {
+            Mavlink_Mission_Request();                      // ask again
         }
     }
-*/
-
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_RAW_SENSORS)) {
-        // MSG_RAW_IMU1
-        // MSG_RAW_IMU2
-        // MSG_RAW_IMU3
-    }
-
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_EXTENDED_STATUS)) {
-        // MSG_EXTENDED_STATUS1
-        // MSG_EXTENDED_STATUS2
-        // MSG_CURRENT_WAYPOINT
-        // MSG_GPS_RAW TODO - remove this message after location message is working
-        // MSG_NAV_CONTROLLER_OUTPUT
-        // MSG_FENCE_STATUS
-    }
-
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_RC_CHANNELS)) {
-        // MSG_RADIO_OUT
-        // MSG_RADIO_IN
-    }
-
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_RAW_CONTROLLER)) {
-        // MSG_SERVO_OUT
+    x_Stream[STREAM_RAW].ucRate = ucStream_Rate[MAV_DATA_STREAM_RAW_SENSORS];
+    x_Stream[STREAM_ATTITUDE].ucRate = ucStream_Rate[MAV_DATA_STREAM_EXTRA1];
+    x_Stream[STREAM_POSITION].ucRate = ucStream_Rate[MAV_DATA_STREAM_POSITION];
+    x_Stream[STREAM_HUD].ucRate = ucStream_Rate[MAV_DATA_STREAM_EXTRA2];
+    x_Stream[STREAM_PARAMS].ucRate = (ui_Param_Count != 0) ? STREAM_TICK_HZ : 0;
+#if (SIMULATOR == HIL_MAVLINK)
+    if (uc_Hil_Timer != 0) {                        // HIL input arrives
+        uc_Hil_Timer--;
     }
+    x_Stream[STREAM_HIL].ucRate = (uc_Hil_Timer != 0) ? STREAM_TICK_HZ : 0;
+#endif
+    Stream_Run();
+}
 
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_POSITION)) {
-        Mavlink_Position();
+//----------------------------------------------------------------------------
+//
+/// \brief   Send pending parameters
+/// \param   -
+/// \returns -
+/// \remarks called by scheduler each tick while parameters are pending.
+///          First frame has been granted by the scheduler, next ones are
+///          sent as long as link credit stays above PARAM_RESERVE and the
+///          transmit ring has room for a whole frame, so none is dropped.
+///          Parameters are sent in index order, wrapping around.
+///
+//----------------------------------------------------------------------------
+void Mavlink_Param_Next(void)
+{
+    uint16_t size = (uint16_t)(b_Version_2 ? HEADER_LEN_V2 : HEADER_LEN) + 25 + 2;
+    bool first = TRUE;
+
+    while ((ui_Param_Count != 0) &&
+           (first || (Stream_Credit() >= (int16_t)(size + PARAM_RESERVE))) &&
+           (USART1_Tx_Free() >= size)) {
+        while ((uc_Param_Pending[ui_Param_Index / 8] & (1 << (ui_Param_Index % 8))) == 0) {
+            if (++ui_Param_Index >= ONBOARD_PARAM_COUNT) {
+                ui_Param_Index = 0;
+            }
+        }
+        uc_Param_Pending[ui_Param_Index / 8] &= (uint8_t)~(1 << (ui_Param_Index % 8));
+        ui_Param_Count--;
+        Mavlink_Param_Send(ui_Param_Index, ONBOARD_PARAM_COUNT);
+        first = FALSE;
     }
+}
 
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_EXTRA1)) {
-        Mavlink_Attitude();
-        // MSG_SIMSTATE
-    }
+//----------------------------------------------------------------------------
+//
+/// \brief   Send achieved rate of a data stream
+/// \param   -
+/// \returns -
+/// \remarks Data streams are reported in turn, so GCS can compare achieved
+///          rate with requested one. Rate is the number of messages actually
+///          sent during last second.
+///   Pos.   Field          Type     Description
+///   0      message_rate   uint16   achieved rate [Hz]
+///   2      stream_id      uint8    data stream ID
+///   3      on_off         uint8    1 if stream is enabled
+///
+//----------------------------------------------------------------------------
+void Mavlink_Stream_Rate(void)
+{
+    uint8_t stream = ucReport[uc_Report][0];
+    uint8_t id = ucReport[uc_Report][1];
 
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_EXTRA2)) {
-        Mavlink_Hud();
+    if (++uc_Report >= (uint8_t)(sizeof(ucReport) / sizeof(ucReport[0]))) {
+        uc_Report = 0;
     }
-
-    if (Mavlink_Stream_Trigger((uint8_t)MAV_DATA_STREAM_EXTRA3)) {
-        // MSG_AHRS
-        // MSG_HWSTATUS
-        // MSG_WIND
+    if (Mavlink_Begin(4, MAVLINK_MSG_ID_DATA_STREAM)) {
+        Mavlink_Put_Word(x_Stream[stream].ucAchieved);
+        Mavlink_Put_Byte(id);
+        Mavlink_Put_Byte((ucStream_Rate[id] != 0) ? 1 : 0);
+        Mavlink_End();
     }
 }
 
+#if (PROFILE == 1)
 //----------------------------------------------------------------------------
 //
-/// \brief   Updates stream tick and tells if it must be transmitted
-/// \param   stream = ID of strem to be checked
-/// \returns TRUE if stream must be transmitted
-/// \remarks Working principle:
-///     - if there's a "queued parameter" or we're receiving waypoints,
-///       transmission frequency is divided by 4
-///     - queued parameters are those requested with PARAM_REQUEST_LIST
-///     - slowdown factor is always < 100 and depends on tx buffer space:
-///         buffer space < 20  slowdown +3
-///         buffer space < 50  slowdown +1
-///         buffer space > 95  slowdown -2
-///         buffer space > 90  slowdown -1
-///
-//----------------------------------------------------------------------------
-bool Mavlink_Stream_Trigger(uint8_t stream)
+/// \brief   Send execution times of a profile zone
+/// \param   -
+/// \returns -
+/// \remarks Zones are reported in turn, a zone per call, so at the stream
+///          rate of PROFILE_ZONES each zone is reported once a second. A
+///          zone is a batch of three messages, named after the zone with
+///          suffix _MIN, _AVG and _MAX, e.g. MATUPD_AVG. Times are in CPU
+///          cycles (ns on host), over the runs since the zone was last
+///          reported; a zone that didn't run reports 0.
+/// Name = MAVLINK_MSG_ID_NAMED_VALUE_INT, ID = 252, Length = 18
+///
+/// Field        Offset Type     Meaning
+/// -------------------------------------
+/// time_boot_ms  0     uint32_t
+/// value         4     int32_t
+/// name          8     char[10]
+///
+//----------------------------------------------------------------------------
+void Mavlink_Profile( void )
 {
-    uint8_t rate = ucStream_Rate[stream];
-
-    // send at a much lower rate while handling waypoints and parameter sends
-/*
-    if (waypoint_receiving || _queued_parameter != NULL ) {
-        rate >>= 2;
-    }
-*/
-    if (rate == 0) {
-        return FALSE;
+    static const char * const pc_suffix[3] = { "_MIN", "_AVG", "_MAX" };
+    const char * p_name;
+    uint32_t ul_time[3];
+    uint8_t j, k;
+
+    (void)Profile_Read((profileEnum_Zone)uc_Profile, &ul_time[0], &ul_time[1], &ul_time[2]);
+    p_name = Profile_Name((profileEnum_Zone)uc_Profile);
+    if (++uc_Profile >= (uint8_t)PROFILE_ZONES) {
+        uc_Profile = 0;
     }
-
-    if (ucStream_Tick[stream] == 0) {   // we're triggering now,
-        if (rate > MAX_STREAM_RATE) {   // setup the next trigger point
-            rate = MAX_STREAM_RATE;
+    for (j = 0; j < 3; j++) {
+        if (Mavlink_Begin(18, MAVLINK_MSG_ID_NAMED_VALUE_INT)) {
+            Mavlink_Put_Long(0);                    // time from boot [ms]
+            Mavlink_Put_Long(ul_time[j]);           // value
+            k = 0;
+            while (p_name[k] != 0) {                // name of zone
+                Mavlink_Put_Byte((uint8_t)p_name[k++]);
+            }
+            Mavlink_Put_Byte((uint8_t)pc_suffix[j][0]);
+            Mavlink_Put_Byte((uint8_t)pc_suffix[j][1]);
+            Mavlink_Put_Byte((uint8_t)pc_suffix[j][2]);
+            Mavlink_Put_Byte((uint8_t)pc_suffix[j][3]);
+            Mavlink_Put_Zero(PROFILE_NAME_LEN - k); // pad to 10 characters
+            Mavlink_End();
         }
-        ucStream_Tick[stream] = (MAX_STREAM_RATE / rate) /* + stream_slowdown*/;
-        return TRUE;
     }
-
-    ucStream_Tick[stream]--;            // count down at 50Hz
-    return FALSE;
 }
+#endif
 
 //----------------------------------------------------------------------------
 //
-/// \brief
-/// \param   -
+/// \brief   Get HIL sensors
+/// \param   piSensors = pointer to raw sensor data, acceleration x, y, z,
+///                      rate x, y, z
 /// \returns -
-/// \remarks
+/// \remarks Called by attitude task in place of sensor drivers when
+///          SIMULATOR == HIL_MAVLINK. Zero until first HIL message.
 ///
 //----------------------------------------------------------------------------
 void Telemetry_Get_Sensors(int16_t * piSensors)
 {
-   (void) piSensors;
+    uint8_t j;
+    const int16_t * p_sensor = i_Hil_Sensor[uc_Hil_Sensor];
+
+    for (j = 0; j < 6; j++) {
+        piSensors[j] = p_sensor[j];
+    }
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief
-/// \param   -
-/// \returns -
-/// \remarks
+/// \brief   Get HIL GPS fix
+/// \param   pxGps = pointer to fix
+/// \returns TRUE if a new fix has been copied
+/// \remarks Called by navigation task in place of NMEA parser when
+///          SIMULATOR == HIL_MAVLINK. A fix being written, or changed while
+///          it was copied, is reported as not new: it's read at next call.
 ///
 //----------------------------------------------------------------------------
-float Telemetry_Get_Gain(telEnum_Gain gain)
+bool Telemetry_Get_Gps(telStruct_Gps * pxGps)
 {
-    float f_result;
-
-    switch (gain) {
-        case TEL_ROLL_KP :
-        case TEL_ROLL_KI :
-        case TEL_PITCH_KP :
-        case TEL_PITCH_KI :
-        case TEL_ALT_KP :
-        case TEL_ALT_KI :
-        case TEL_NAV_KP :
-        case TEL_NAV_KI :
-            f_result = fParam_Value[gain];
-            break;
-
-        case TEL_NAV_BANK :
-            f_result = ToRad(fParam_Value[gain]);
-            break;
+    uint8_t seq = uc_Hil_Gps;
+    bool b_new = FALSE;
+
+    if (((seq & 1) == 0) && (seq != uc_Hil_Gps_Read)) { // complete new fix
+        *pxGps = x_Hil_Gps;
+        if (seq == uc_Hil_Gps) {                    // unchanged while copied
+            uc_Hil_Gps_Read = seq;
+            b_new = TRUE;
+        }
+    }
+    return b_new;
+}
 
-        case TEL_GAIN_NUMBER :
-        default :
-            f_result = 0.0f;
-            break;
+//----------------------------------------------------------------------------
+//
+/// \brief   Queue an AHRS sample for RAW_IMU stream
+/// \param   piSensors = pointer to corrected sensor data
+/// \returns -
+/// \remarks Called by attitude task each AHRS cycle, together with servo
+///          positions. Sample is dropped if queue is full, its number is
+///          used anyway so that the gap is seen on ground.
+///
+//----------------------------------------------------------------------------
+void Telemetry_Put_Sample(const int16_t * piSensors)
+{
+    uint8_t j;
+    uint8_t head = uc_Sample_Head;
+    uint8_t next = (head + 1) % SAMPLE_QUEUE;
+
+    ul_Sample_Number++;
+    if (next != uc_Sample_Tail) {                   // queue not full
+        x_Sample[head].ulNumber = ul_Sample_Number;
+        for (j = 0; j < 6; j++) {
+            x_Sample[head].iSensor[j] = piSensors[j];
+        }
+        for (j = 0; j < SERVO_NUMBER; j++) {
+            x_Sample[head].iServo[j] = Servo_Get((SERVO_TYPE)j);
+        }
+        uc_Sample_Head = next;                      // publish sample
     }
-    return f_result;
 }
 
 //----------------------------------------------------------------------------
@@ -1572,15 +2590,17 @@ float Telemetry_Get_Speed(void)
 
 //----------------------------------------------------------------------------
 //
-/// \brief
+/// \brief   Get HIL altitude
 /// \param   -
-/// \returns -
-/// \remarks
+/// \returns altitude [m]
+/// \remarks pressure altitude of HIL_SENSOR, or altitude of HIL_STATE.
+///          Called by navigation task in place of barometric altitude when
+///          SIMULATOR == HIL_MAVLINK.
 ///
 //----------------------------------------------------------------------------
 float Telemetry_Get_Altitude(void)
 {
-    return 0.0f;    //fAltitude;
+    return f_Hil_Altitude;
 }
 
 
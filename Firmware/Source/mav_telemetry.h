@@ -10,6 +10,8 @@
 ///
 ///
 /// Changes: added TEL_NAV_BANK parameter, maximum bank angle during navigation
+///          PID gains moved to parameter registry
+//          GPS fix from HIL messages
 ///
 //============================================================================*/
 
@@ -26,19 +28,15 @@
 
 /*----------------------------------- Types ----------------------------------*/
 
-/// PID gains
-typedef enum {
-    TEL_ROLL_KP = 0,    ///<
-    TEL_ROLL_KI,        ///<
-    TEL_PITCH_KP,       ///<
-    TEL_PITCH_KI,       ///<
-    TEL_ALT_KP,         ///<
-    TEL_ALT_KI,         ///<
-    TEL_NAV_KP,         ///<
-    TEL_NAV_KI,         ///<
-    TEL_NAV_BANK,       ///<
-    TEL_GAIN_NUMBER
-} telEnum_Gain;
+/// GPS fix from HIL_GPS or HIL_STATE
+typedef struct {
+    int32_t lLat;                       ///< latitude [deg * 1E7]
+    int32_t lLon;                       ///< longitude [deg * 1E7]
+    int32_t lAlt;                       ///< altitude [mm]
+    uint16_t uiSpeed;                   ///< ground speed [cm/s], UINT16_MAX if unknown
+    uint16_t uiCourse;                  ///< course over ground [deg * 100], UINT16_MAX if unknown
+    uint8_t ucFix;                      ///< 0-1 = no fix, 2 = 2D fix, 3 = 3D fix
+} telStruct_Gps;
 
 /*---------------------------------- Constants -------------------------------*/
 
@@ -46,11 +44,12 @@ typedef enum {
 
 /*---------------------------------- Interface -------------------------------*/
 
+void Mavlink_Init(void);
 void Mavlink_Receive(void);
 void Mavlink_Stream_Send(void);
-void Mavlink_Queued_Send(uint8_t cycles);
-float Telemetry_Get_Gain(telEnum_Gain gain);
 void Telemetry_Get_Sensors(int16_t * piSensors);
+bool Telemetry_Get_Gps(telStruct_Gps * pxGps);
+void Telemetry_Put_Sample(const int16_t * piSensors);
 float Telemetry_Get_Speed(void);
 float Telemetry_Get_Altitude(void);
 
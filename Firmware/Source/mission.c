@@ -0,0 +1,192 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief waypoint tables
+///
+/// \file
+///  Two waypoint tables: navigation flies the active one while a new mission
+///  is written into the shadow one, either from path file at start up or
+///  from ground station during flight. When the new mission is complete it's
+///  validated and committed, then navigation task swaps the tables at its
+///  next cycle, so it never sees a partially written mission and never
+///  waits for the upload.
+/// \code
+///   loader (telemetry task)           navigation task
+///   Mission_Load(1 .. n - 1)
+///   Mission_Commit(n)  --- pending -->  Mission_Swap()
+///                                       Mission_Get() ...
+/// \endcode
+///  Each table has its own waypoint number, so a reader always gets a
+///  consistent table. Entry 0 is the launch position, shared by both tables.
+///  Shadow table belongs to the loader until commit, to navigation task
+///  until swap, so no lock is needed. Doesn't depend on any peripheral, so
+///  it can be tested on host.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "nav.h"
+#include "mission.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC STRUCT_WPT x_Wpt[2][MISSION_MAX];        //!< active and shadow tables
+VAR_STATIC uint16_t ui_Number[2] = { 0, 0 };        //!< waypoints in each table, 0 = none
+VAR_STATIC volatile uint8_t uc_Active = 0;          //!< active table, changed by navigation only
+VAR_STATIC volatile bool b_Pending = FALSE;         //!< shadow table waits for swap
+VAR_STATIC STRUCT_WPT x_Home = { 0.0f, 0.0f, 0.0f }; //!< launch position
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes a waypoint into shadow table
+/// \param   uiIndex = waypoint index, 1 to MISSION_MAX - 1
+/// \param   pxWpt = pointer to waypoint
+/// \return  TRUE if written, FALSE if index is out of range or a swap is
+///          pending
+/// \remarks called by loader only
+///
+///----------------------------------------------------------------------------
+bool Mission_Load(uint16_t uiIndex, const STRUCT_WPT * pxWpt)
+{
+    if (b_Pending || (uiIndex == 0) || (uiIndex >= MISSION_MAX)) {
+        return FALSE;
+    }
+    x_Wpt[uc_Active ^ 1][uiIndex] = *pxWpt;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   validates shadow table and requests swap
+/// \param   uiNumber = number of waypoints, launch position included,
+///          0 or 1 for a mission without waypoints (return to launch)
+/// \return  TRUE if committed, FALSE if number or a waypoint isn't valid or a
+///          swap is already pending
+/// \remarks called by loader only
+///
+///----------------------------------------------------------------------------
+bool Mission_Commit(uint16_t uiNumber)
+{
+    uint16_t j;
+    const STRUCT_WPT * p_wpt;
+
+    if (b_Pending || (uiNumber > MISSION_MAX)) {
+        return FALSE;
+    }
+    if (uiNumber == 1) {
+        uiNumber = 0;
+    }
+    for (j = 1; j < uiNumber; j++) {
+        p_wpt = &x_Wpt[uc_Active ^ 1][j];
+        if (!((p_wpt->Lat >= -90.0f) && (p_wpt->Lat <= 90.0f) &&  // false for NaN too
+              (p_wpt->Lon >= -180.0f) && (p_wpt->Lon <= 180.0f) &&
+              (p_wpt->Alt >= 0.0f) && (p_wpt->Alt <= MISSION_MAX_ALT))) {
+            return FALSE;
+        }
+    }
+    ui_Number[uc_Active ^ 1] = uiNumber;
+    b_Pending = TRUE;                               // hand over to navigation
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   tells if a committed mission waits for swap
+/// \return  TRUE if swap is pending
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Mission_Pending(void)
+{
+    return b_Pending;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   activates committed mission
+/// \return  TRUE if tables have been swapped
+/// \remarks called by navigation task only, at the start of its cycle
+///
+///----------------------------------------------------------------------------
+bool Mission_Swap(void)
+{
+    if (!b_Pending) {
+        return FALSE;
+    }
+    uc_Active ^= 1;                                 // single store, atomic
+    b_Pending = FALSE;                              // old table back to loader
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets launch position
+/// \param   fLat = latitude
+/// \param   fLon = longitude
+/// \return  -
+/// \remarks called by navigation task only
+///
+///----------------------------------------------------------------------------
+void Mission_Set_Home(float fLat, float fLon)
+{
+    x_Home.Lat = fLat;
+    x_Home.Lon = fLon;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   number of waypoints of active mission
+/// \return  waypoints, launch position included, 0 if there are none
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Mission_Number(void)
+{
+    return ui_Number[uc_Active];
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets a waypoint of active mission
+/// \param   uiIndex = waypoint index, 0 = launch position
+/// \param   pxWpt = pointer to waypoint
+/// \return  -
+/// \remarks launch position is returned for an index out of range
+///
+///----------------------------------------------------------------------------
+void Mission_Get(uint16_t uiIndex, STRUCT_WPT * pxWpt)
+{
+    uint8_t uc_active = uc_Active;
+
+    if ((uiIndex == 0) || (uiIndex >= ui_Number[uc_active])) {
+        *pxWpt = x_Home;
+    } else {
+        *pxWpt = x_Wpt[uc_active][uiIndex];
+    }
+}
@@ -0,0 +1,44 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief waypoint tables header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define MISSION_MAX         8           //!< maximum number of waypoints, launch position included
+#define MISSION_MAX_ALT     5000.0f     //!< maximum waypoint altitude [m]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+bool Mission_Load(uint16_t uiIndex, const STRUCT_WPT * pxWpt);
+bool Mission_Commit(uint16_t uiNumber);
+bool Mission_Pending(void);
+bool Mission_Swap(void);
+void Mission_Set_Home(float fLat, float fLon);
+uint16_t Mission_Number(void);
+void Mission_Get(uint16_t uiIndex, STRUCT_WPT * pxWpt);
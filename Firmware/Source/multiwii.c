@@ -69,6 +69,7 @@
 ///    - 30 velocity D      1
 ///
 //  Change function Gps_Speed() renamed Gps_Speed_Kt()
+//         PID gains moved to parameter registry
 //
 //============================================================================*/
 
@@ -83,8 +84,11 @@
 #include "attitude.h"
 #include "ppmdriver.h"
 #include "servodriver.h"
+#include "ring.h"
 #include "usart1driver.h"
-#include "bmp085_driver.h"
+#include "BMP085_driver.h"
+#include "param.h"
+#include "store.h"
 #include "multiwii.h"
 
 /*--------------------------------- Definitions ------------------------------*/
@@ -100,6 +104,7 @@
 #define   VAR_GLOBAL
 
 #define PAYLOAD_SIZE        32  //!< maximum size of payload
+#define REPLY_SIZE          64  //!< maximum size of reply, header and checksum included
 
 #define VERSION             0	//!< multiwii version
 #define MWI_VERSION         0   //!< Multiwii Serial Protocol 0
@@ -226,17 +231,9 @@ VAR_STATIC uint8_t MWI_Command;                     //!< command identifier
 VAR_STATIC uint8_t MWI_Size;                        //!< payload size
 VAR_STATIC uint8_t MWI_Index;                       //!< payload index
 VAR_STATIC uint8_t MWI_Buffer[48];                  //!< payload buffer
+VAR_STATIC uint8_t MWI_Reply[REPLY_SIZE];           //!< reply buffer
+VAR_STATIC uint8_t MWI_Reply_Length;                //!< reply length
 VAR_STATIC int16_t iSensor[8];                      //!< simulator sensor data
-VAR_STATIC float fPIDGain[TEL_GAIN_NUMBER] = {
-    PITCH_KP,                                       //!< default pitch kp
-    PITCH_KI,                                       //!< default pitch ki
-    ROLL_KP,                                        //!< default roll kp
-    ROLL_KI,                                        //!< default roll ki
-    NAV_KP,                                         //!< default direction kp
-    NAV_KI,                                         //!< default direction ki
-    0.0f,                                           //!< dummy placeholder
-    0.0f                                            //!< dummy placeholder
-};                                                  //!< gains for PID loops
 
 /*--------------------------------- Prototypes -------------------------------*/
 
@@ -287,11 +284,13 @@ static uint32_t read32(void) {
 /// \brief   Append a byte to outgoing message
 /// \return  -
 /// \param   a = message byte
-/// \remarks
+/// \remarks message is built in reply buffer and sent as a whole
 ///
 ///----------------------------------------------------------------------------
 static void MWI_Append_8(uint8_t a) {
-  USART1_Putch(a);
+  if (MWI_Reply_Length < REPLY_SIZE) {
+    MWI_Reply[MWI_Reply_Length++] = a;
+  }
   MWI_Checksum ^= a;
 }
 
@@ -346,6 +345,7 @@ static void MWI_Append_Name(const uint8_t* s) {
 ///
 ///----------------------------------------------------------------------------
 static void __inline MWI_Init_Response(uint8_t length) {
+  MWI_Reply_Length = 0;         // new reply
   MWI_Append_8('$');            // header
   MWI_Append_8('M');            // multiwii protocol
   MWI_Append_8('>');            // outgoing message
@@ -363,6 +363,7 @@ static void __inline MWI_Init_Response(uint8_t length) {
 ///
 ///----------------------------------------------------------------------------
 static void __inline MWI_Init_Error(uint8_t length) {
+  MWI_Reply_Length = 0;         // new reply
   MWI_Append_8('$');            // header
   MWI_Append_8('M');            // multiwii protocol
   MWI_Append_8('!');            // error message
@@ -375,7 +376,8 @@ static void __inline MWI_Init_Error(uint8_t length) {
 ///
 /// \brief   parses multiwii commands
 /// \return  -
-/// \remarks -
+/// \remarks Reply is queued with a single USART1_Write, so a reply that
+///          doesn't fit in transmit buffer is dropped as a whole and counted.
 ///
 ///----------------------------------------------------------------------------
 void MWI_Parse_Command( void ) {
@@ -387,20 +389,19 @@ void MWI_Parse_Command( void ) {
   switch (MWI_Command) {
 
     case MWI_SET_PID:                   // set PID values
-     i = TEL_ROLL_KP;                   // start with first gain
-     fPIDGain[i++] = read8() / 10.0f;   // roll P
-     fPIDGain[i++] = read8() / 1000.0f; // roll I
+     (void)Param_Set(PARAM_ROLL_KP, read8() / 10.0f);    // roll P
+     (void)Param_Set(PARAM_ROLL_KI, read8() / 1000.0f);  // roll I
      (void)read8();                     // skip roll D
-     fPIDGain[i++] = read8() / 10.0f;   // pitch P
-     fPIDGain[i++] = read8() / 1000.0f; // pitch I
+     (void)Param_Set(PARAM_PITCH_KP, read8() / 10.0f);   // pitch P
+     (void)Param_Set(PARAM_PITCH_KI, read8() / 1000.0f); // pitch I
      (void)read32();                    // skip pitch D and yaw P, I, D
-     fPIDGain[i++] = read8() / 10.0f;   // alt P
-     fPIDGain[i++] = read8() / 1000.0f; // alt I
+     (void)Param_Set(PARAM_ALT_KP, read8() / 10.0f);     // alt P
+     (void)Param_Set(PARAM_ALT_KI, read8() / 1000.0f);   // alt I
      (void)read32();                    // skip alt D and pos P, I, D
      (void)read16();                    // skip pos rate P, I
      (void)read8();                     // skip pos rate D
-     fPIDGain[i++] = read8() / 10.0f;   // nav P
-     fPIDGain[i++] = read8() / 100.0f;  // nav I
+     (void)Param_Set(PARAM_NAV_KP, read8() / 10.0f);     // nav P
+     (void)Param_Set(PARAM_NAV_KI, read8() / 100.0f);    // nav I
      MWI_Init_Response(0);              // initialize response
      break;
 
@@ -472,20 +473,19 @@ void MWI_Parse_Command( void ) {
 
     case MWI_PID:                                       // requested PID values
      MWI_Init_Response(30);                             // initialize response
-     i = TEL_ROLL_KP;                                   // start with first gain
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 10.0f));    // roll P
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 1000.0f));  // roll I
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_ROLL_KP) * 10.0f));    // roll P
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_ROLL_KI) * 1000.0f));  // roll I
      MWI_Append_8(0);                                   // roll D: skip
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 10.0f));    // pitch P
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 1000.0f));  // pitch I
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_PITCH_KP) * 10.0f));   // pitch P
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_PITCH_KI) * 1000.0f)); // pitch I
      MWI_Append_32(0);                                  // skip pitch D, yaw P, I, D
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 10.0f));    // alt P
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 1000.0f));  // alt I
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_ALT_KP) * 10.0f));     // alt P
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_ALT_KI) * 1000.0f));   // alt I
      MWI_Append_32(0);                                  // skip alt D and pos P, I, D
      MWI_Append_16(0);                                  // skip pos rate P, I
      MWI_Append_8(0);                                   // skip pos rate D
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 10.0f));    // nav P
-     MWI_Append_8((uint8_t)(fPIDGain[i++] * 100.0f));   // nav I
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_NAV_KP) * 10.0f));     // nav P
+     MWI_Append_8((uint8_t)(Param_Get(PARAM_NAV_KI) * 100.0f));    // nav I
      MWI_Append_32(0);                                  // skip nav D and level P, I, D
      MWI_Append_32(0);                                  // skip mag P, I, D and velocity P
      MWI_Append_16(0);                                  // skip velocity I, D
@@ -556,7 +556,11 @@ void MWI_Parse_Command( void ) {
      break;
 
    case MWI_EEPROM_WRITE:               // write parameters to eeprom
-     MWI_Init_Response(0);              // initialize response
+     if (Store_Save()) {                // append changes to flash log
+       MWI_Init_Response(0);            // initialize response
+     } else {
+       MWI_Init_Error(0);               // flash log full until next power up
+     }
      break;
 
    case MWI_DEBUG:                      // debug message
@@ -568,7 +572,7 @@ void MWI_Parse_Command( void ) {
      break;
   }
   MWI_Append_8(MWI_Checksum);           // append message checksum
-  USART1_Transmit();                    // transmit
+  (void)USART1_Write(MWI_Reply, MWI_Reply_Length); // queue whole reply and transmit
 }
 
 ///----------------------------------------------------------------------------
@@ -665,22 +669,6 @@ float Telemetry_Get_Altitude(void) {
     return 0.0f;//fAltitude;
 }
 
-///----------------------------------------------------------------------------
-///
-/// \brief   Get PID gain
-/// \param   gain, gain number
-/// \return  gain value
-/// \remarks -
-///
-///----------------------------------------------------------------------------
-float Telemetry_Get_Gain(telEnum_Gain gain) {
-    if (gain < TEL_GAIN_NUMBER) {
-        return fPIDGain[gain];
-    } else {
-        return 0.0f;
-    }
-}
-
 ///----------------------------------------------------------------------------
 ///
 /// \brief   Get sensor value
@@ -695,3 +683,15 @@ void Telemetry_Get_Raw_IMU(int16_t * piSensor) {
         *piSensor++ = iSensor[j];
     }
 }
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Queue an AHRS sample
+/// \param   piSensors = pointer to corrected sensor data
+/// \return  -
+/// \remarks MultiWii protocol has no raw data stream, samples are ignored
+///
+///----------------------------------------------------------------------------
+void Telemetry_Put_Sample(const int16_t * piSensors) {
+    (void)piSensors;
+}
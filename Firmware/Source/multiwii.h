@@ -28,19 +28,6 @@
 
 /*----------------------------------- Types ----------------------------------*/
 
-/// PID gains
-typedef enum {
-    TEL_ROLL_KP = 0,    ///<
-    TEL_ROLL_KI,        ///<
-    TEL_PITCH_KP,       ///<
-    TEL_PITCH_KI,       ///<
-    TEL_ALT_KP,         ///<
-    TEL_ALT_KI,         ///<
-    TEL_NAV_KP,         ///<
-    TEL_NAV_KI,         ///<
-    TEL_GAIN_NUMBER
-} telEnum_Gain;
-
 /*---------------------------------- Constants -------------------------------*/
 
 /*---------------------------------- Globals ---------------------------------*/
@@ -49,7 +36,6 @@ typedef enum {
 
 void MWI_Receive(void);
 void Telemetry_Get_Raw_IMU(int16_t * piSensors);
-float Telemetry_Get_Gain(telEnum_Gain gain);
 void Telemetry_Send_Controls(void);
 float Telemetry_Get_Speed(void);
 float Telemetry_Get_Altitude(void);
@@ -10,15 +10,17 @@
 /// \file
 /// - Initialization:
 ///   reads from SD card a text file containing waypoints, translates strings
-///   into coordinates and altitude, saves waypoints in the array Waypoint[],
-///   updates number of available waypoints.
-///   If SD card is missing or in case of error during file read, the number
-///   of available waypoints is set to 0.
+///   into coordinates and altitude, loads waypoints into mission tables.
+///   Waypoints read before an error during file read are kept. If SD card
+///   is missing, no waypoint could be read or a waypoint isn't valid, there
+///   is no mission.
 /// - Navigation:
-///   waits for GPS fix, saves coordinates of launch point in the first entry
-///   of array Waypoint[], computes heading and distance to next waypoint.
-///   If available waypoints are 0, computes heading and distance to launch
+///   waits for GPS fix, saves coordinates of launch point as waypoint 0,
+///   computes heading and distance to next waypoint.
+///   If there's no mission, computes heading and distance to launch
 ///   point (RTL).
+///   A mission uploaded by ground station is activated at the start of the
+///   next cycle, navigation restarts from its first waypoint.
 ///   Navigation error is the difference (heading - bearing), sign corrected
 ///   when < -180 or > 180. Cross product and dot product of heading vector
 ///   with bearing vector doesn't work because bearing vector is not a versor.
@@ -37,26 +39,33 @@
 /// \endcode
 ///
 /// Change: corrected sign of direction error, corrected heading range [0,2PI].
+///         waypoints moved to mission tables, mission replaced in flight.
+///         GPS fix and altitude from MAVLink HIL messages.
 //
 //============================================================================*/
 
 #include "FreeRTOS.h"
+#include "task.h"
 
 #include "stm32f10x_usart.h"
 #include "stm32f10x_dma.h"
-#include "bmp085_driver.h"
+#include "BMP085_driver.h"
 #include "ppmdriver.h"
-#include "dcm.h"
+#include "DCM.h"
 #include "math.h"
 #include "simulator.h"
 #include "mav_telemetry.h"
 #include "attitude.h"
 #include "config.h"
 #include "ff.h"
-#include "pid.h"
+#include "PID.h"
 #include "log.h"
-#include "globals.h"
+#include "filesystem.h"
+#include "boot.h"
+#include "restart.h"
 #include "nav.h"
+#include "mission.h"
+#include "profile.h"
 
 /*--------------------------------- Definitions ------------------------------*/
 
@@ -66,7 +75,6 @@
 
 #define USART2_DR_Base  0x40004404
 
-#define MAX_WAYPOINTS   8       //!< maximum number of waypoints
 #define MIN_DISTANCE    100     //!< minimum distance from waypoint [m]
 
 #define LINE_LENGTH     48      //!< length of lines read from file
@@ -97,7 +105,7 @@ typedef enum {
 /*----------------------------------- Locals ---------------------------------*/
 
 VAR_STATIC uint8_t uc_Gps_Buffer[BUFFER_LENGTH];        //!< gps data buffer
-VAR_STATIC STRUCT_WPT Waypoint[MAX_WAYPOINTS];         	//!< waypoints array
+VAR_STATIC STRUCT_WPT x_Wpt;                            //!< waypoint during parse
 VAR_STATIC const uint8_t sz_File[16] = "path.txt";      //!< file name
 VAR_STATIC uint8_t sz_Line[LINE_LENGTH];                //!< input line
 VAR_STATIC UINT w_File_Bytes;                           //!< counter of read bytes
@@ -115,7 +123,7 @@ VAR_STATIC float f_Bearing;                             //!< angle to destinatio
 VAR_STATIC float f_Heading;                             //!< aircraft navigation heading []
 VAR_STATIC uint32_t ul_Temp_Coord;                      //!< temporary for coordinate parser
 VAR_STATIC uint16_t ui_Distance;                        //!< distance to destination [m]
-VAR_STATIC uint16_t ui_Wpt_Number;                      //!< total number of waypoints
+VAR_STATIC uint16_t ui_Wpt_Load;                        //!< waypoints loaded from file
 VAR_STATIC uint16_t ui_Wpt_Index;                       //!< waypoint index
 VAR_STATIC uint16_t ui_Gps_Heading;                     //!< aircraft GPS heading []
 VAR_STATIC uint16_t ui_Gps_Speed;                       //!< speed [kt/10]
@@ -127,6 +135,7 @@ VAR_STATIC uint8_t uc_Rindex;                           //!< USART buffer read i
 /*--------------------------------- Prototypes -------------------------------*/
 
 static void load_path( void );
+static void load_destination( void );
 static void gps_init( void );
 static bool parse_waypoint ( const uint8_t * psz_line );
 static void parse_coord( float * fCoord, uint8_t c );
@@ -154,6 +163,7 @@ static bool cmp_prefix( const uint8_t * src , const uint8_t * dest );
 void Navigation_Task( void *pvParameters ) {
 
     float f_temp, f_dx, f_dy;
+    bool b_sentence;
 
     (void)pvParameters;
 
@@ -164,36 +174,64 @@ void Navigation_Task( void *pvParameters ) {
     ui_Gps_Heading = 0;                                 // aircraft GPS heading []
     ui_Gps_Speed = 0;                                   // aircraft GPS speed [kt]
     ui_Distance = 0;                                    // distance to destination [m]
-    ui_Wpt_Number = 0;                                  // no waypoint yet
 
     /* WARNING: mission file must be loaded before initializing GPS UART !!! */
+    (void)Boot_Wait(BOOT_FS_MOUNTED, portMAX_DELAY);    // wait file system
     load_path();                                        // load path from SD card
+    (void)Mission_Swap();                               // activate it
+    Boot_Signal(BOOT_MISSION_LOADED);                   // SD card released
     /* WARNING: GPS UART must be initialized after loading mission file !!! */
     gps_init();                                         // initialize USART for GPS
+    Boot_Signal(BOOT_GPS_CONFIGURED);                   // GPS configured
+
+    if (Restart_Warm() && (Restart_Get()->ucHome != 0)) {   // launch position preserved
+        Mission_Set_Home(Restart_Get()->fHome_Lat,      // restore launch position
+                         Restart_Get()->fHome_Lon);
+        ui_Wpt_Index = Restart_Get()->uiWpt_Index;      // restore waypoint index
+        if (Mission_Number() == 0) {                    // no waypoint file
+            ui_Wpt_Index = 0;                           // use launch position
+        } else if ((ui_Wpt_Index == 0) ||               // index not valid for
+                   (ui_Wpt_Index >= Mission_Number())) {// current waypoint file
+            ui_Wpt_Index = 1;                           // read first waypoint
+        }
+    } else {
+        /* Wait GPS fix */
+        while ((parse_gps() == FALSE) ||                // NMEA sentence not completed
+               (uc_Gps_Status != GPS_FIX)) {            // no satellite fix
+            vTaskDelay(1);                              // parse again next tick
+        }
 
-    /* Wait GPS fix */
-    while ((parse_gps() == FALSE) ||                    // NMEA sentence not completed
-           (uc_Gps_Status != GPS_FIX)) {                // no satellite fix
-        ;                                               // keep parsing NMEA sentences
-    }
-
-    /* Save launch position */
-    Waypoint[0].Lon = f_Curr_Lon;                       // launch position as first waypoint
-    Waypoint[0].Lat = f_Curr_Lat;
-    if (ui_Wpt_Number != 0) {                           // waypoint file available
-        ui_Wpt_Index = 1;                               // read first waypoint
-    } else {                                            // no waypoint file
-        ui_Wpt_Index = 0;                               // use launch position
+        /* Save launch position */
+        Mission_Set_Home(f_Curr_Lat, f_Curr_Lon);       // launch position as first waypoint
+        Restart_Set_Home(f_Curr_Lat, f_Curr_Lon);
+        if (Mission_Number() != 0) {                    // waypoint file available
+            ui_Wpt_Index = 1;                           // read first waypoint
+        } else {                                        // no waypoint file
+            ui_Wpt_Index = 0;                           // use launch position
+        }
     }
-    f_Dest_Lon = Waypoint[ui_Wpt_Index].Lon;            // load destination longitude
-    f_Dest_Lat = Waypoint[ui_Wpt_Index].Lat;            // load destination latitude
-    f_Dest_Alt = Waypoint[ui_Wpt_Index].Alt;            // load destination altitude
+    Restart_Set_Wpt(ui_Wpt_Index);
+    load_destination();
 
     for (;;) {
-        if (parse_gps()) {                              // NMEA sentence completed
+        if (Mission_Swap()) {                           // new mission uploaded
+            if (Mission_Number() != 0) {                // waypoints do exist
+                ui_Wpt_Index = 1;                       // read first waypoint
+            } else {                                    // empty mission
+                ui_Wpt_Index = 0;                       // use launch position
+            }
+            Restart_Set_Wpt(ui_Wpt_Index);
+            load_destination();
+        }
+        PROFILE_BEGIN(PROFILE_PARSE_GPS);
+        b_sentence = parse_gps();                       // parse received characters
+        PROFILE_END(PROFILE_PARSE_GPS);
+        if (b_sentence) {                               // NMEA sentence completed
 #if (SIMULATOR == SIM_NONE)                             // normal mode
             f_Curr_Alt = (float)BMP085_Get_Altitude();  // get barometric altitude
 //            f_Curr_Alt = (float)ui_Gps_Alt;             // get GPS altitude
+#elif (SIMULATOR == HIL_MAVLINK)                        // hardware in the loop
+            f_Curr_Alt = Telemetry_Get_Altitude();      // get HIL altitude
 #else                                                   // simulation mode
             f_Curr_Alt = Simulator_Get_Altitude();      // get simulator altitude
 #endif
@@ -233,19 +271,38 @@ void Navigation_Task( void *pvParameters ) {
 
             /* Check distance to waypoint */
             if (ui_Distance < MIN_DISTANCE) {               // waypoint reached
-                if (ui_Wpt_Number != 0) {                   // waypoints do exist
-                    if (++ui_Wpt_Index == ui_Wpt_Number) {  // get next waypoint or
+                if (Mission_Number() != 0) {                // waypoints do exist
+                    if (++ui_Wpt_Index >= Mission_Number()) {   // get next waypoint or
                         ui_Wpt_Index = 1;                   // go back to first waypoint
                     }
+                    Restart_Set_Wpt(ui_Wpt_Index);
                 }
-                f_Dest_Lon = Waypoint[ui_Wpt_Index].Lon;    // new destination longitude
-                f_Dest_Lat = Waypoint[ui_Wpt_Index].Lat;    // new destination latitude
-                f_Dest_Alt = Waypoint[ui_Wpt_Index].Alt;    // new destination altitude
+                load_destination();                         // new destination
             }
+        } else {
+            vTaskDelay(1);                                  // parse again next tick
         }
     }
 }
 
+//----------------------------------------------------------------------------
+//
+/// \brief   Load destination from active mission
+/// \param   -
+/// \return  -
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+static void load_destination( void ) {
+
+    STRUCT_WPT wpt;
+
+    Mission_Get(ui_Wpt_Index, &wpt);
+    f_Dest_Lon = wpt.Lon;                           // load destination longitude
+    f_Dest_Lat = wpt.Lat;                           // load destination latitude
+    f_Dest_Alt = wpt.Alt;                           // load destination altitude
+}
+
 //----------------------------------------------------------------------------
 //
 /// \brief   Load path from file on SD card
@@ -253,6 +310,8 @@ void Navigation_Task( void *pvParameters ) {
 /// \return  -
 /// \remarks uc_Gps_Buffer[] array is used for file reading.
 ///          USART 2 must be disabled because it uses same array for reception.
+///          Waypoints are loaded into shadow mission table, activated by
+///          next Mission_Swap().
 ///
 //----------------------------------------------------------------------------
 static void load_path( void ) {
@@ -260,25 +319,25 @@ static void load_path( void ) {
     uint8_t c, uc_counter;
     uint8_t * p_buffer_pointer;
     uint8_t * psz_line_pointer;
+    FIL * p_file;
     bool b_error = TRUE;
 
     psz_line_pointer = sz_Line;                     // init line pointer
     uc_counter = LINE_LENGTH - 1;                   // init char counter
 
-    /* Mount file system and open waypoint file */
-    if (!b_FS_Ok) {                               // file system not mounted
-        ui_Wpt_Number = 0;                          // no waypoint available
-    } else if (FR_OK != f_open(&st_File, (const XCHAR *)sz_File,FA_READ)) {
+    /* Open waypoint file */
+    p_file = File_Open(sz_File, FA_READ);
+    if (p_file == 0) {                              // file system not mounted or
                                                     // error opening file
-        ui_Wpt_Number = 0;                          // no waypoint available
+        ui_Wpt_Load = 0;                            // no waypoint available
     } else {                                        // file system ok and
         b_error = FALSE;                            // file succesfully open
-        ui_Wpt_Number = 1;                          // waypoint available
+        ui_Wpt_Load = 1;                            // first after launch position
     }
 
     /* Read waypoint file */
     while ((!b_error) &&
-           (FR_OK == f_read(&st_File, uc_Gps_Buffer, BUFFER_LENGTH, &w_File_Bytes))) {
+           (FR_OK == f_read(p_file, uc_Gps_Buffer, BUFFER_LENGTH, &w_File_Bytes))) {
         b_error = (w_File_Bytes == 0);              // force error if end of file
         p_buffer_pointer = uc_Gps_Buffer;           // init buffer pointer
         while ((w_File_Bytes != 0) && (!b_error)) { // buffer not empty and no error
@@ -300,7 +359,10 @@ static void load_path( void ) {
             }
         }
     }
-    ( void )f_close( &st_File );                     // close file
+    if (p_file != 0) {
+        File_Close(p_file);                         // close file
+    }
+    (void)Mission_Commit(ui_Wpt_Load);              // no mission if not valid
 }
 
 //----------------------------------------------------------------------------
@@ -378,6 +440,7 @@ static void gps_init( void ) {
 ///          where x = longitude, y = latitude, a = altitude
 ///          [ ] are zero or more spaces,
 ///          [.[a]] is an optional decimal point with an optional decimal data
+///          A waypoint beyond mission table size is an error.
 ///
 //----------------------------------------------------------------------------
 static bool parse_waypoint ( const uint8_t * psz_line ) {
@@ -428,9 +491,14 @@ static bool parse_waypoint ( const uint8_t * psz_line ) {
         }
         /* assign */
         switch ( uc_field++ ) {
-            case 0: Waypoint[ui_Wpt_Number].Lon = f_temp; break;
-            case 1: Waypoint[ui_Wpt_Number].Lat = f_temp; break;
-            case 2: Waypoint[ui_Wpt_Number++].Alt = f_temp; break;
+            case 0: x_Wpt.Lon = f_temp; break;
+            case 1: x_Wpt.Lat = f_temp; break;
+            case 2: x_Wpt.Alt = f_temp;
+                    if (!Mission_Load(ui_Wpt_Load, &x_Wpt)) {
+                        return TRUE;                    // mission table full
+                    }
+                    ui_Wpt_Load++;
+                    break;
             default: break;
         }
     }
@@ -477,6 +545,40 @@ static void parse_coord( float * f_coord, uint8_t c )
 }
 
 
+#if (SIMULATOR == HIL_MAVLINK)
+//----------------------------------------------------------------------------
+//
+/// \brief   Get GPS fix from HIL messages
+/// \param   -
+/// \returns true if new coordinate data are available, false otherwise
+/// \remarks replaces NMEA parsing in hardware in the loop simulation, fix
+///          is converted to the units of NMEA data. Unknown speed or course
+///          keep their previous value.
+///
+//----------------------------------------------------------------------------
+static bool parse_gps( void )
+{
+    telStruct_Gps x_gps;
+    bool b_completed = FALSE;           //!< true when a fix is available
+
+    if (Telemetry_Get_Gps(&x_gps)) {            // new HIL fix
+        uc_Gps_Status = (x_gps.ucFix >= 2) ? GPS_FIX : GPS_NOFIX;
+        if (x_gps.uiSpeed != 0xFFFF) {          // [cm/s] to [kt/10]
+            ui_Gps_Speed = (uint16_t)((float)x_gps.uiSpeed * 0.194384f);
+        }
+        if (x_gps.uiCourse != 0xFFFF) {         // [deg * 100] to [deg]
+            ui_Gps_Heading = x_gps.uiCourse / 100;
+        }
+        ui_Gps_Alt = (uint16_t)(x_gps.lAlt / 1000);
+        if (uc_Gps_Status == GPS_FIX) {
+            f_Curr_Lat = (float)x_gps.lLat / 10000000.0f;
+            f_Curr_Lon = (float)x_gps.lLon / 10000000.0f;
+            b_completed = TRUE;
+        }
+    }
+    return b_completed;
+}
+#else
 //----------------------------------------------------------------------------
 //
 /// \brief   Parse GPS sentences
@@ -645,6 +747,7 @@ static bool parse_gps( void )
     }
     return b_completed;
 }
+#endif
 
 //----------------------------------------------------------------------------
 //
@@ -696,7 +799,7 @@ static bool cmp_prefix( const uint8_t * src , const uint8_t * dest ) {
 ///
 //----------------------------------------------------------------------------
 uint16_t Nav_Wpt_Number ( void ) {
-  return ui_Wpt_Number;
+  return Mission_Number();
 }
 
 //----------------------------------------------------------------------------
@@ -720,7 +823,7 @@ uint16_t Nav_Wpt_Index ( void ) {
 ///
 //----------------------------------------------------------------------------
 uint16_t Nav_Wpt_Altitude ( void ) {
-  return (uint16_t)Waypoint[ui_Wpt_Index].Alt;
+  return (uint16_t)f_Dest_Alt;
 }
 
 //----------------------------------------------------------------------------
@@ -732,26 +835,7 @@ uint16_t Nav_Wpt_Altitude ( void ) {
 ///
 //----------------------------------------------------------------------------
 void Nav_Wpt_Get ( uint16_t index, STRUCT_WPT * wpt ) {
-  if (index > ui_Wpt_Number) {
-     index = 0;
-  }
-  wpt->Lat = Waypoint[index].Lat;
-  wpt->Lon = Waypoint[index].Lon;
-  wpt->Alt = Waypoint[index].Alt;
-}
-
-//----------------------------------------------------------------------------
-//
-/// \brief   Set waypoint data
-/// \param   index = waypoint number
-/// \param   wpt = waypoint data structure
-/// \returns -
-/// \remarks -
-///
-//----------------------------------------------------------------------------
-void Nav_Wpt_Set ( uint16_t index, STRUCT_WPT wpt ) {
-    (void) index;
-    (void) wpt;
+  Mission_Get(index, wpt);
 }
 
 //----------------------------------------------------------------------------
@@ -64,6 +64,5 @@ uint16_t Nav_Wpt_Number ( void );
 uint16_t Nav_Wpt_Index ( void );
 uint16_t Nav_Wpt_Altitude ( void );
 void Nav_Wpt_Get ( uint16_t index, STRUCT_WPT *wpt );
-void Nav_Wpt_Set ( uint16_t index, STRUCT_WPT wpt );
 
 
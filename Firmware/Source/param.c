@@ -0,0 +1,242 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief parameter registry
+///
+/// \file
+///  Single table of tunable parameters shared by telemetry protocols. Each
+///  entry has a name, a type, a default value and bounds. Values are stored
+///  as float, integer types are rounded when set.
+///  Names are found by binary search on an index sorted at start up, so a
+///  lookup costs log2(PARAM_NUMBER) name compares instead of a scan of the
+///  whole table.
+///  A task using a parameter registers a change callback instead of reading
+///  it periodically: the callback is called at registration and each time
+///  the value actually changes, in the context of the task that changed it.
+///  Callbacks must be short, e.g. store the value in a single variable.
+///  Doesn't depend on any peripheral, so it can be tested on host.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "math.h"
+#include "stddef.h"
+#include "string.h"
+
+#include "config.h"
+#include "param.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// parameter description
+typedef struct {
+    uint8_t szName[PARAM_NAME_LENGTH];  ///< name, zero padded, not terminated if 16 characters
+    paramEnum_Type eType;               ///< type
+    float fDefault;                     ///< default value
+    float fMin;                         ///< minimum value
+    float fMax;                         ///< maximum value
+} xParam;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// parameter table, same order as paramEnum_Id
+/// names follow Copter GCS standard: GROUP_SUBGROUP_P / _I / _D / _IMAX
+VAR_STATIC const xParam x_Param[PARAM_NUMBER] = {
+    { "ROL_ANG_P", PARAM_TYPE_FLOAT, ROLL_KP,  0.0f, 10.0f },
+    { "ROL_ANG_I", PARAM_TYPE_FLOAT, ROLL_KI,  0.0f,  1.0f },
+    { "PCH_ANG_P", PARAM_TYPE_FLOAT, PITCH_KP, 0.0f, 10.0f },
+    { "PCH_ANG_I", PARAM_TYPE_FLOAT, PITCH_KI, 0.0f,  1.0f },
+    { "ALT_POS_P", PARAM_TYPE_FLOAT, ALT_KP,   0.0f, 10.0f },
+    { "ALT_POS_I", PARAM_TYPE_FLOAT, ALT_KI,   0.0f,  1.0f },
+    { "NAV_ANG_P", PARAM_TYPE_FLOAT, NAV_KP,   0.0f, 20.0f },
+    { "NAV_ANG_I", PARAM_TYPE_FLOAT, NAV_KI,   0.0f,  1.0f },
+    { "NAV_BANK",  PARAM_TYPE_UINT8, NAV_BANK, 5.0f, 45.0f },
+    { "AHRS_RP_P", PARAM_TYPE_FLOAT, PITCHROLL_KP, 0.0f, 1.0f },
+    { "AHRS_YAW_P", PARAM_TYPE_FLOAT, YAW_KP,  0.0f,  5.0f }
+};
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC float f_Value[PARAM_NUMBER];             //!< current values
+VAR_STATIC uint8_t uc_Sorted[PARAM_NUMBER];         //!< parameters sorted by name
+VAR_STATIC paramCallback pf_Callback[PARAM_NUMBER]; //!< change callbacks
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static int Param_Compare(const uint8_t * pucName, paramEnum_Id eId);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   compares a name with name of a parameter
+/// \param   pucName = name, zero terminated or PARAM_NAME_LENGTH characters
+/// \param   eId = parameter
+/// \return  < 0, 0, > 0 if name is before, equal to, after parameter name
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int Param_Compare(const uint8_t * pucName, paramEnum_Id eId)
+{
+    return strncmp((const char *)pucName, (const char *)x_Param[eId].szName,
+                   PARAM_NAME_LENGTH);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   initializes parameters with default values
+/// \return  -
+/// \remarks called by main before starting scheduler, removes callbacks
+///
+///----------------------------------------------------------------------------
+void Param_Init(void)
+{
+    uint8_t i, j, uc_id;
+
+    for (i = 0; i < (uint8_t)PARAM_NUMBER; i++) {
+        f_Value[i] = x_Param[i].fDefault;
+        pf_Callback[i] = NULL;
+        uc_id = i;                                  // insertion sort of names
+        for (j = i; (j > 0) &&
+             (Param_Compare(x_Param[uc_id].szName, (paramEnum_Id)uc_Sorted[j - 1]) < 0); j--) {
+            uc_Sorted[j] = uc_Sorted[j - 1];
+        }
+        uc_Sorted[j] = uc_id;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets value of a parameter
+/// \param   eId = parameter
+/// \return  value, 0 if parameter doesn't exist
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+float Param_Get(paramEnum_Id eId)
+{
+    if (eId >= PARAM_NUMBER) {
+        return 0.0f;
+    }
+    return f_Value[eId];
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets value of a parameter
+/// \param   eId = parameter
+/// \param   fValue = new value
+/// \return  TRUE if value is valid, FALSE if parameter doesn't exist or
+///          value isn't a number or is out of bounds
+/// \remarks value is rounded for integer types, callback is called only if
+///          value has changed
+///
+///----------------------------------------------------------------------------
+bool Param_Set(paramEnum_Id eId, float fValue)
+{
+    if ((eId >= PARAM_NUMBER) ||
+        !((fValue >= x_Param[eId].fMin) &&          // false for NaN too
+          (fValue <= x_Param[eId].fMax))) {
+        return FALSE;
+    }
+    if (x_Param[eId].eType != PARAM_TYPE_FLOAT) {
+        fValue = floorf(fValue + 0.5f);
+    }
+    if (f_Value[eId] != fValue) {
+        f_Value[eId] = fValue;
+        if (pf_Callback[eId] != NULL) {
+            pf_Callback[eId](eId, fValue);
+        }
+    }
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   finds a parameter by name
+/// \param   pucName = name, zero terminated or PARAM_NAME_LENGTH characters
+/// \return  parameter, PARAM_NUMBER if not found
+/// \remarks binary search on names sorted by Param_Init
+///
+///----------------------------------------------------------------------------
+paramEnum_Id Param_Find(const uint8_t * pucName)
+{
+    uint8_t uc_low = 0, uc_high = (uint8_t)PARAM_NUMBER, uc_mid;
+    int i_compare;
+
+    while (uc_low < uc_high) {
+        uc_mid = (uc_low + uc_high) / 2;
+        i_compare = Param_Compare(pucName, (paramEnum_Id)uc_Sorted[uc_mid]);
+        if (i_compare == 0) {
+            return (paramEnum_Id)uc_Sorted[uc_mid];
+        } else if (i_compare < 0) {
+            uc_high = uc_mid;
+        } else {
+            uc_low = uc_mid + 1;
+        }
+    }
+    return PARAM_NUMBER;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets name of a parameter
+/// \param   eId = parameter, must exist
+/// \return  pointer to PARAM_NAME_LENGTH characters, zero padded
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const uint8_t * Param_Name(paramEnum_Id eId)
+{
+    return x_Param[eId].szName;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets type of a parameter
+/// \param   eId = parameter, must exist
+/// \return  type
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+paramEnum_Type Param_Type(paramEnum_Id eId)
+{
+    return x_Param[eId].eType;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   registers change callback of a parameter
+/// \param   eId = parameter
+/// \param   pfCallback = callback, NULL to remove it
+/// \return  -
+/// \remarks callback is called at once with current value
+///
+///----------------------------------------------------------------------------
+void Param_Notify(paramEnum_Id eId, paramCallback pfCallback)
+{
+    if (eId < PARAM_NUMBER) {
+        pf_Callback[eId] = pfCallback;
+        if (pfCallback != NULL) {
+            pfCallback(eId, f_Value[eId]);
+        }
+    }
+}
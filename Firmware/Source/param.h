@@ -0,0 +1,69 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief parameter registry header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define PARAM_NAME_LENGTH   16          //!< maximum name length, as MAVLink param_id
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/// parameters
+typedef enum {
+    PARAM_ROLL_KP = 0,  ///< roll P gain
+    PARAM_ROLL_KI,      ///< roll I gain
+    PARAM_PITCH_KP,     ///< pitch P gain
+    PARAM_PITCH_KI,     ///< pitch I gain
+    PARAM_ALT_KP,       ///< altitude P gain
+    PARAM_ALT_KI,       ///< altitude I gain
+    PARAM_NAV_KP,       ///< navigation P gain
+    PARAM_NAV_KI,       ///< navigation I gain
+    PARAM_NAV_BANK,     ///< maximum bank angle during navigation [deg]
+    PARAM_PITCHROLL_KP, ///< DCM roll and pitch drift correction P gain
+    PARAM_YAW_KP,       ///< DCM yaw drift correction P gain
+    PARAM_NUMBER
+} paramEnum_Id;
+
+/// parameter types, same values as MAVLink MAV_PARAM_TYPE
+typedef enum {
+    PARAM_TYPE_UINT8 = 1,   ///< integer 0 to 255
+    PARAM_TYPE_INT16 = 4,   ///< integer -32768 to 32767
+    PARAM_TYPE_FLOAT = 9    ///< single precision float
+} paramEnum_Type;
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// change callback, called with new value by the task that changed it
+typedef void (* paramCallback)(paramEnum_Id eId, float fValue);
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Param_Init(void);
+float Param_Get(paramEnum_Id eId);
+bool Param_Set(paramEnum_Id eId, float fValue);
+paramEnum_Id Param_Find(const uint8_t * pucName);
+const uint8_t * Param_Name(paramEnum_Id eId);
+paramEnum_Type Param_Type(paramEnum_Id eId);
+void Param_Notify(paramEnum_Id eId, paramCallback pfCallback);
@@ -38,7 +38,7 @@
 
 #include "config.h"
 #include "led.h"
-#include "freertosconfig.h"
+#include "FreeRTOSConfig.h"
 #include "ppmdriver.h"
 
 /*--------------------------------- Definitions ------------------------------*/
@@ -0,0 +1,233 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief execution time profiler
+///
+/// \file
+///  Counts the time spent between the markers PROFILE_BEGIN and PROFILE_END
+///  of a zone, and keeps min, average and max of each zone since it was last
+///  read. On the Cortex-M3 time is the DWT cycle counter, i.e. CPU cycles at
+///  24 MHz, wrapping every 179 s; on the host build (SIL) it's a monotonic
+///  clock in nanoseconds. Time of interrupts and of higher priority tasks
+///  pre-empting a zone is included, so min is the cost of the code itself
+///  and max its worst case in flight.
+///  A zone is updated by the task running it only. The reader doesn't clear
+///  it, it asks the task to start a new window at the next end of the zone,
+///  so no locking is needed.
+///  Compiled in with PROFILE == 1 only, see config.h.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "config.h"
+#include "profile.h"
+
+#if (PROFILE == 1)
+
+#ifdef SIL
+#include <time.h>
+#endif
+
+/** @addtogroup cortex_ap
+  * @{
+  */
+
+/** @addtogroup profile
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+#define DWT_CTRL            (*(volatile uint32_t *)0xE0001000)  //!< DWT control register
+#define DWT_CYCCNT          (*(volatile uint32_t *)0xE0001004)  //!< DWT cycle counter
+#define DWT_CTRL_CYCCNTENA  0x00000001                          //!< cycle counter enable
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// counters of a profile zone
+typedef struct {
+    uint32_t ulStart;                   ///< time at begin of zone
+    uint32_t ulMin;                     ///< min time in window
+    uint32_t ulMax;                     ///< max time in window
+    uint32_t ulSum;                     ///< total time in window
+    uint32_t ulCount;                   ///< zone runs in window, 0 = empty window
+    volatile bool bClear;               ///< new window requested by reader
+} xProfile_Zone;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// zone names, at most PROFILE_NAME_LEN characters
+VAR_STATIC const char * const pc_Name[PROFILE_ZONES] = {
+    "MATUPD",
+    "DRIFT",
+    "NORM",
+    "CTRL",
+    "GPS",
+    "MAVTX"
+};
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xProfile_Zone x_Zone[PROFILE_ZONES];
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static __inline uint32_t Profile_Now(void);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   current time
+/// \return  CPU cycles, nanoseconds on host
+/// \remarks only differences are meaningful, both counters wrap around
+///
+///----------------------------------------------------------------------------
+static __inline uint32_t Profile_Now(void)
+{
+#ifdef SIL
+    struct timespec x_now;
+
+    clock_gettime(CLOCK_MONOTONIC, &x_now);
+    return ((uint32_t)x_now.tv_sec * 1000000000UL) + (uint32_t)x_now.tv_nsec;
+#else
+    return DWT_CYCCNT;
+#endif
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts cycle counter and clears zones
+/// \return  -
+/// \remarks call before scheduler starts. Counter runs without debugger,
+///          once trace is enabled.
+///
+///----------------------------------------------------------------------------
+void Profile_Init(void)
+{
+    uint8_t j;
+
+#ifndef SIL
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // enable DWT
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;                 // start cycle counter
+#endif
+    for (j = 0; j < (uint8_t)PROFILE_ZONES; j++) {
+        x_Zone[j].ulCount = 0;
+        x_Zone[j].bClear = TRUE;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   marks begin of a zone
+/// \param   eZone = zone
+/// \return  -
+/// \remarks counter is read last, so call overhead is left out
+///
+///----------------------------------------------------------------------------
+void Profile_Begin(profileEnum_Zone eZone)
+{
+    x_Zone[eZone].ulStart = Profile_Now();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   marks end of a zone
+/// \param   eZone = zone
+/// \return  -
+/// \remarks Counter is read first. A new window is started when the reader
+///          asked for it, or when the total would overflow.
+///
+///----------------------------------------------------------------------------
+void Profile_End(profileEnum_Zone eZone)
+{
+    uint32_t ul_time = Profile_Now() - x_Zone[eZone].ulStart;
+    xProfile_Zone * p_zone = &x_Zone[eZone];
+
+    if (p_zone->bClear || (p_zone->ulSum + ul_time < p_zone->ulSum)) {
+        p_zone->ulMin = ul_time;
+        p_zone->ulMax = ul_time;
+        p_zone->ulSum = 0;
+        p_zone->ulCount = 0;
+        p_zone->bClear = FALSE;
+    }
+    if (ul_time < p_zone->ulMin) {
+        p_zone->ulMin = ul_time;
+    }
+    if (ul_time > p_zone->ulMax) {
+        p_zone->ulMax = ul_time;
+    }
+    p_zone->ulSum += ul_time;
+    p_zone->ulCount++;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reads counters of a zone and starts a new window
+/// \param   eZone = zone
+/// \param   pulMin, pulAvg, pulMax = pointers to min, average and max time
+///          [cycles, ns on host]
+/// \return  FALSE if zone didn't run since last read, times are then 0
+/// \remarks Called from another task than the zone's: a window may be read
+///          while the zone ends, which at most shifts a run to next window.
+///
+///----------------------------------------------------------------------------
+bool Profile_Read(profileEnum_Zone eZone, uint32_t * pulMin, uint32_t * pulAvg, uint32_t * pulMax)
+{
+    xProfile_Zone * p_zone = &x_Zone[eZone];
+    uint32_t ul_count = p_zone->ulCount;
+
+    if (p_zone->bClear || (ul_count == 0)) {
+        *pulMin = 0;
+        *pulAvg = 0;
+        *pulMax = 0;
+        return FALSE;
+    }
+    *pulMin = p_zone->ulMin;
+    *pulAvg = p_zone->ulSum / ul_count;
+    *pulMax = p_zone->ulMax;
+    p_zone->bClear = TRUE;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   name of a zone
+/// \param   eZone = zone
+/// \return  pointer to name, at most PROFILE_NAME_LEN characters
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+const char * Profile_Name(profileEnum_Zone eZone)
+{
+    return pc_Name[eZone];
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif
+
+/*****END OF FILE****/
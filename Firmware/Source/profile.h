@@ -0,0 +1,62 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief execution time profiler header file
+///
+/// \file
+///  Include after config.h: with PROFILE == 0 the zone markers expand to
+///  nothing, so code and timing are the same as without them.
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define PROFILE_NAME_LEN    6           //!< max length of a zone name
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#if (PROFILE == 1)
+#define PROFILE_BEGIN(zone) Profile_Begin(zone)     //!< start of a profile zone
+#define PROFILE_END(zone)   Profile_End(zone)       //!< end of a profile zone
+#else
+#define PROFILE_BEGIN(zone)                         //!< profiling disabled
+#define PROFILE_END(zone)                           //!< profiling disabled
+#endif
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/// profile zones, each one run by a single task
+typedef enum {
+    PROFILE_MATRIX_UPDATE = 0,  ///< MatrixUpdate, attitude task
+    PROFILE_COMPENSATE_DRIFT,   ///< CompensateDrift, attitude task
+    PROFILE_NORMALIZE,          ///< Normalize, attitude task
+    PROFILE_ATTITUDE_CONTROL,   ///< Attitude_Control, attitude task
+    PROFILE_PARSE_GPS,          ///< parse_gps, navigation task
+    PROFILE_STREAM_SEND,        ///< Mavlink_Stream_Send, telemetry task
+    PROFILE_ZONES
+} profileEnum_Zone;
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Profile_Init(void);
+void Profile_Begin(profileEnum_Zone eZone);
+void Profile_End(profileEnum_Zone eZone);
+bool Profile_Read(profileEnum_Zone eZone, uint32_t * pulMin, uint32_t * pulAvg, uint32_t * pulMax);
+const char * Profile_Name(profileEnum_Zone eZone);
@@ -0,0 +1,223 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief warm restart
+///
+/// \file
+///  Flight state is copied each AHRS cycle into a RAM region that isn't
+///  initialized by the C library at start up (IRAM2, NoInit in target
+///  options). After a window watchdog reset, a state with valid signature and
+///  CRC is restored instead of performing a cold boot:
+/// \code
+///   cold boot                      | warm restart
+/// ---------------------------------+-----------------------------------
+///   sensor power up delay          | skipped
+///   offset calibration             | offsets restored
+///   DCM from identity              | DCM and gyro bias restored
+///   wait GPS fix for launch pos.   | launch position restored
+///   first waypoint                 | waypoint index restored
+///   servos neutral                 | servo positions restored
+///   mode from radio                | saved mode for RESTART_HOLD cycles
+/// ---------------------------------+-----------------------------------
+/// \endcode
+///  After RESTART_MAX consecutive warm restarts without RESTART_STABLE
+///  saves in between, the state is considered the cause of the resets and a
+///  cold boot is performed.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stddef.h"
+
+#include "stm32f10x.h"
+#include "DCM.h"
+#include "crc.h"
+#include "restart.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+#if defined(__CC_ARM)
+VAR_STATIC xRestart_State x_State __attribute__((at(RESTART_ADDRESS), zero_init)); //!< preserved state
+#else
+VAR_STATIC xRestart_State x_State __attribute__((section(".noinit")));            //!< preserved state
+#endif
+VAR_STATIC bool b_Warm = FALSE;             //!< warm restart in progress
+VAR_STATIC bool b_Home = FALSE;             //!< launch position is valid
+VAR_STATIC float f_Home_Lat;                //!< launch latitude
+VAR_STATIC float f_Home_Lon;                //!< launch longitude
+VAR_STATIC uint16_t ui_Wpt_Index = 0;       //!< waypoint index
+VAR_STATIC uint16_t ui_Saves = 0;           //!< saves since start up
+VAR_STATIC uint8_t uc_Count = 0;            //!< consecutive warm restarts
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static uint16_t Restart_Crc(void);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   computes CRC of preserved state
+/// \return  X25 CRC of all fields but the CRC itself
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint16_t Restart_Crc(void)
+{
+    return Crc_X25(CRC_X25_INIT, (const uint8_t *)&x_State,
+                   offsetof(xRestart_State, uiCrc));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks preserved state
+/// \param   b_Watchdog_Reset = TRUE if start up follows a watchdog reset
+/// \return  TRUE if state is valid and a warm restart must be performed
+/// \remarks called by main before starting scheduler. State is invalidated
+///          on cold boot, it's valid again after first call of Restart_Save.
+///          Counters of this module start again, as after any reset.
+///
+///----------------------------------------------------------------------------
+bool Restart_Init(bool b_Watchdog_Reset)
+{
+    b_Warm = (b_Watchdog_Reset &&
+              (x_State.ulMagic == RESTART_MAGIC) &&
+              (x_State.uiCrc == Restart_Crc()) &&
+              (x_State.ucCount < RESTART_MAX)) ? TRUE : FALSE;
+
+    ui_Saves = 0;
+    if (b_Warm) {
+        uc_Count = x_State.ucCount + 1;
+        b_Home = (x_State.ucHome != 0) ? TRUE : FALSE;
+        f_Home_Lat = x_State.fHome_Lat;
+        f_Home_Lon = x_State.fHome_Lon;
+        ui_Wpt_Index = x_State.uiWpt_Index;
+    } else {
+        x_State.ulMagic = 0;
+        uc_Count = 0;
+        b_Home = FALSE;
+        ui_Wpt_Index = 0;
+    }
+    return b_Warm;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   warm restart status
+/// \return  TRUE if a warm restart is in progress
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool Restart_Warm(void)
+{
+    return b_Warm;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gets preserved state
+/// \return  pointer to preserved state
+/// \remarks content is meaningful only if Restart_Warm() returns TRUE
+///
+///----------------------------------------------------------------------------
+const xRestart_State * Restart_Get(void)
+{
+    return &x_State;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets launch position
+/// \param   f_Lat = launch latitude
+/// \param   f_Lon = launch longitude
+/// \return  -
+/// \remarks called by navigation task, saved with next Restart_Save
+///
+///----------------------------------------------------------------------------
+void Restart_Set_Home(float f_Lat, float f_Lon)
+{
+    taskENTER_CRITICAL();
+    f_Home_Lat = f_Lat;
+    f_Home_Lon = f_Lon;
+    b_Home = TRUE;
+    taskEXIT_CRITICAL();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets waypoint index
+/// \param   ui_Index = waypoint index
+/// \return  -
+/// \remarks called by navigation task, saved with next Restart_Save
+///
+///----------------------------------------------------------------------------
+void Restart_Set_Wpt(uint16_t ui_Index)
+{
+    ui_Wpt_Index = ui_Index;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   saves flight state
+/// \param   pi_Offset = pointer to sensor offsets
+/// \param   pi_Servo = pointer to aileron, elevator, throttle positions
+/// \param   uc_Mode = control mode
+/// \return  -
+/// \remarks called by attitude task each AHRS cycle
+///
+///----------------------------------------------------------------------------
+void Restart_Save(const int16_t * pi_Offset, const int16_t * pi_Servo, uint8_t uc_Mode)
+{
+    uint8_t j;
+
+    if (ui_Saves < RESTART_STABLE) {
+        if (++ui_Saves == RESTART_STABLE) {             // running long enough
+            uc_Count = 0;                               // clear restart counter
+        }
+    }
+
+    for (j = 0; j < 9; j++) {
+        x_State.fDCM[j / 3][j % 3] = DCM_Matrix[j / 3][j % 3];
+    }
+    GetGyroBias(x_State.fBias);
+    for (j = 0; j < 6; j++) {
+        x_State.iOffset[j] = pi_Offset[j];
+    }
+    for (j = 0; j < 3; j++) {
+        x_State.iServo[j] = pi_Servo[j];
+    }
+    taskENTER_CRITICAL();
+    x_State.fHome_Lat = f_Home_Lat;
+    x_State.fHome_Lon = f_Home_Lon;
+    x_State.ucHome = b_Home ? 1 : 0;
+    taskEXIT_CRITICAL();
+    x_State.uiWpt_Index = ui_Wpt_Index;
+    x_State.ucMode = uc_Mode;
+    x_State.ucCount = uc_Count;
+    x_State.ucReserved = 0;
+    x_State.ulMagic = RESTART_MAGIC;
+    x_State.uiCrc = Restart_Crc();
+}
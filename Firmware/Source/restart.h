@@ -0,0 +1,63 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief warm restart header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define RESTART_ADDRESS     0x20001F80  //!< no init RAM region (IRAM2), last 128 bytes
+#define RESTART_MAGIC       0x57A12001  //!< state signature and version
+#define RESTART_MAX         3           //!< max consecutive warm restarts
+#define RESTART_STABLE      500         //!< saves before warm restart counter is cleared
+#define RESTART_HOLD        5           //!< AHRS cycles before radio is trusted again
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// flight state preserved across a watchdog reset
+typedef struct {
+    uint32_t ulMagic;                   ///< signature and version
+    float fDCM[3][3];                   ///< direction cosine matrix
+    float fBias[3];                     ///< DCM gyro bias estimate (integral term)
+    float fHome_Lat;                    ///< launch latitude
+    float fHome_Lon;                    ///< launch longitude
+    int16_t iOffset[6];                 ///< sensor offsets
+    int16_t iServo[3];                  ///< aileron, elevator, throttle position
+    uint16_t uiWpt_Index;               ///< waypoint index
+    uint8_t ucMode;                     ///< control mode
+    uint8_t ucCount;                    ///< consecutive warm restarts
+    uint8_t ucHome;                     ///< launch position is valid
+    uint8_t ucReserved;                 ///< padding
+    uint16_t uiCrc;                     ///< X25 CRC of all previous fields
+} xRestart_State;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+bool Restart_Init(bool b_Watchdog_Reset);
+bool Restart_Warm(void);
+const xRestart_State * Restart_Get(void);
+void Restart_Set_Home(float f_Lat, float f_Lon);
+void Restart_Set_Wpt(uint16_t ui_Index);
+void Restart_Save(const int16_t * pi_Offset, const int16_t * pi_Servo, uint8_t uc_Mode);
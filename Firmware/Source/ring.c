@@ -0,0 +1,244 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief byte ring buffer
+///
+/// \file
+///  Ring of bytes written by a task and transferred by DMA in blocks.
+///  A block is the contiguous data between read index and either write index
+///  or end of buffer, so wrapped data are sent with two transfers. Data
+///  written while a block is being transferred are sent with next block.
+/// \code
+///             uiTail          uiTail + uiBlock   uiHead
+///               |                   |              |
+///   ...free...  [ block in transfer ][ next block ]  ...free...
+/// \endcode
+///  Write index is changed by producer only, read index and block length by
+///  consumer only, so the producer never has to disable the DMA interrupt.
+///  Writes are all or nothing: a message that doesn't fit is rejected and
+///  counted, it's never sent truncated.
+///  Alternatively a message can be built in place: Ring_Reserve checks space,
+///  Ring_Put writes bytes after the write index, where they're invisible to
+///  the consumer, and Ring_Commit publishes all of them at once. A message
+///  that isn't committed is simply discarded by next reservation. Bytes
+///  already put can be read back or patched with Ring_Reserved, e.g. a length
+///  field known only at the end of the message.
+///  Doesn't depend on any peripheral, so it can be tested on host.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "ring.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   initializes a ring
+/// \param   pxRing = pointer to ring
+/// \param   pucBuffer = pointer to data buffer
+/// \param   uiSize = size of data buffer
+/// \return  -
+/// \remarks ring can hold uiSize - 1 bytes
+///
+///----------------------------------------------------------------------------
+void Ring_Init(xRing * pxRing, uint8_t * pucBuffer, uint16_t uiSize)
+{
+    pxRing->pucBuffer = pucBuffer;
+    pxRing->uiSize = uiSize;
+    pxRing->uiHead = 0;
+    pxRing->uiTail = 0;
+    pxRing->uiBlock = 0;
+    pxRing->uiReserve = 0;
+    pxRing->uiDropped = 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   number of bytes in ring
+/// \param   pxRing = pointer to ring
+/// \return  bytes waiting or being transferred
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Ring_Used(const xRing * pxRing)
+{
+    uint16_t ui_head = pxRing->uiHead;
+    uint16_t ui_tail = pxRing->uiTail;
+
+    if (ui_head >= ui_tail) {
+        return (ui_head - ui_tail);
+    } else {
+        return (pxRing->uiSize - ui_tail + ui_head);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   free space in ring
+/// \param   pxRing = pointer to ring
+/// \return  number of bytes that can be written
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Ring_Free(const xRing * pxRing)
+{
+    return (pxRing->uiSize - 1 - Ring_Used(pxRing));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes data into ring
+/// \param   pxRing = pointer to ring
+/// \param   pucData = pointer to data
+/// \param   uiLength = number of bytes
+/// \return  TRUE if data have been written, FALSE if there wasn't enough space
+/// \remarks nothing is written if data don't fit
+///
+///----------------------------------------------------------------------------
+bool Ring_Write(xRing * pxRing, const uint8_t * pucData, uint16_t uiLength)
+{
+    uint16_t ui_head;
+
+    if (uiLength > Ring_Free(pxRing)) {                 // back pressure
+        pxRing->uiDropped++;
+        return FALSE;
+    }
+    ui_head = pxRing->uiHead;
+    while (uiLength-- != 0) {
+        pxRing->pucBuffer[ui_head++] = *pucData++;
+        if (ui_head >= pxRing->uiSize) {
+            ui_head = 0;
+        }
+    }
+    pxRing->uiHead = ui_head;                           // publish data
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reserves space for a message built in place
+/// \param   pxRing = pointer to ring
+/// \param   uiLength = number of bytes
+/// \return  TRUE if space is available, FALSE otherwise
+/// \remarks message is written with Ring_Put and published with Ring_Commit,
+///          producer must not call Ring_Write in between
+///
+///----------------------------------------------------------------------------
+bool Ring_Reserve(xRing * pxRing, uint16_t uiLength)
+{
+    if (uiLength > Ring_Free(pxRing)) {                 // back pressure
+        pxRing->uiDropped++;
+        return FALSE;
+    }
+    pxRing->uiReserve = pxRing->uiHead;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   publishes a message built in place
+/// \param   pxRing = pointer to ring
+/// \return  -
+/// \remarks all bytes written by Ring_Put since Ring_Reserve become visible
+///
+///----------------------------------------------------------------------------
+void Ring_Commit(xRing * pxRing)
+{
+    pxRing->uiHead = pxRing->uiReserve;                 // publish data
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   accesses a byte of a message built in place
+/// \param   pxRing = pointer to ring
+/// \param   uiOffset = offset from start of message
+/// \return  pointer to byte
+/// \remarks offset must be less than the reserved length
+///
+///----------------------------------------------------------------------------
+uint8_t * Ring_Reserved(xRing * pxRing, uint16_t uiOffset)
+{
+    uint16_t ui_index = pxRing->uiHead + uiOffset;
+
+    if (ui_index >= pxRing->uiSize) {
+        ui_index -= pxRing->uiSize;
+    }
+    return &pxRing->pucBuffer[ui_index];
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts transfer of a block
+/// \param   pxRing = pointer to ring
+/// \param   ppucBlock = pointer to start address of block
+/// \return  block length, 0 if ring is empty or a block is still in transfer
+/// \remarks block stops at end of buffer, remaining data make next block
+///
+///----------------------------------------------------------------------------
+uint16_t Ring_Block_Start(xRing * pxRing, uint8_t ** ppucBlock)
+{
+    uint16_t ui_head = pxRing->uiHead;
+    uint16_t ui_tail = pxRing->uiTail;
+
+    if (pxRing->uiBlock != 0) {                         // transfer in progress
+        return 0;
+    }
+    if (ui_head >= ui_tail) {                           // contiguous data
+        pxRing->uiBlock = ui_head - ui_tail;
+    } else {                                            // wrapped data
+        pxRing->uiBlock = pxRing->uiSize - ui_tail;     // up to end of buffer
+    }
+    *ppucBlock = &pxRing->pucBuffer[ui_tail];
+    return pxRing->uiBlock;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   ends transfer of a block
+/// \param   pxRing = pointer to ring
+/// \param   uiRemaining = bytes of block not transferred (DMA counter)
+/// \return  -
+/// \remarks bytes not transferred are sent again with next block
+///
+///----------------------------------------------------------------------------
+void Ring_Block_End(xRing * pxRing, uint16_t uiRemaining)
+{
+    uint16_t ui_tail;
+
+    if (uiRemaining > pxRing->uiBlock) {
+        uiRemaining = pxRing->uiBlock;
+    }
+    ui_tail = pxRing->uiTail + (pxRing->uiBlock - uiRemaining);
+    if (ui_tail >= pxRing->uiSize) {
+        ui_tail -= pxRing->uiSize;
+    }
+    pxRing->uiTail = ui_tail;                           // release space
+    pxRing->uiBlock = 0;
+}
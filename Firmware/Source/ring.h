@@ -0,0 +1,62 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief byte ring buffer header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/// writes a byte at next reserved position, space must have been reserved
+#define Ring_Put(pxRing, ucData) {                                  \
+    (pxRing)->pucBuffer[(pxRing)->uiReserve] = (ucData);            \
+    if (++(pxRing)->uiReserve >= (pxRing)->uiSize) {                \
+        (pxRing)->uiReserve = 0;                                    \
+    }                                                               \
+}
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// byte ring with one producer and one block consumer (DMA)
+typedef struct {
+    uint8_t * pucBuffer;                ///< data buffer
+    uint16_t uiSize;                    ///< buffer size, one byte is always free
+    volatile uint16_t uiHead;           ///< write index, changed by producer only
+    volatile uint16_t uiTail;           ///< read index, changed by consumer only
+    volatile uint16_t uiBlock;          ///< length of block being transferred
+    uint16_t uiReserve;                 ///< write index of data not yet committed
+    uint16_t uiDropped;                 ///< writes rejected for lack of space
+} xRing;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Ring_Init(xRing * pxRing, uint8_t * pucBuffer, uint16_t uiSize);
+uint16_t Ring_Used(const xRing * pxRing);
+uint16_t Ring_Free(const xRing * pxRing);
+bool Ring_Write(xRing * pxRing, const uint8_t * pucData, uint16_t uiLength);
+bool Ring_Reserve(xRing * pxRing, uint16_t uiLength);
+void Ring_Commit(xRing * pxRing);
+uint8_t * Ring_Reserved(xRing * pxRing, uint16_t uiOffset);
+uint16_t Ring_Block_Start(xRing * pxRing, uint8_t ** ppucBlock);
+void Ring_Block_End(xRing * pxRing, uint16_t uiRemaining);
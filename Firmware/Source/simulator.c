@@ -42,8 +42,49 @@
 /// ------------------------+------------------------+-------------------------
 ///                                                                     \endcode
 ///
+/// Frame structure, both directions, multibyte fields little endian :  \code
+///
+///  Byte        Name        Content
+/// ---------------------------------------------------------------
+///   0          SIM_SYNC_1  0xA5
+///   1          SIM_SYNC_2  0x5A
+///   2          length      payload length, 0 - SIM_PAYLOAD_MAX
+///   3          sequence    incremented by sender for each frame
+///   4          type        message type, see wait_code_t
+///   5          payload
+///   5 + len    CRC low     X25 CRC of bytes 2 ... 4 + len
+///   6 + len    CRC high
+///
+///  Type            Dir  Len  Payload
+/// ---------------------------------------------------------------
+///  SIM_SENSORS     up   16   accel x, y, z, gyro x, y, z  int16_t  raw ADC
+///                            true air speed               uint16_t [cm/s]
+///                            altitude                     int16_t  [m]
+///  SIM_GAINS       up   12   pitch kp, ki, roll kp, ki,   uint16_t gain * 2000
+///                            nav kp, ki
+///  SIM_SERVO_POS   down  8   elevator, aileron, rudder,   int16_t  [us]
+///                            throttle
+///  SIM_DCM         down 18   DCM by rows                  int16_t  * 16384
+///  SIM_WAYPOINT    down  7   waypoint index               uint8_t
+///                            bearing                      uint16_t [deg]
+///                            altitude                     uint16_t [m]
+///                            distance                     uint16_t [m]
+///  SIM_LINK        down  4   lost uplink frames           uint16_t
+///                            discarded uplink frames      uint16_t
+///                                                                     \endcode
+/// A sensor frame is 23 bytes, so the uplink carries a full sensor set at
+/// up to 250 Hz at USART1_BAUDRATE. Frames with bad length or CRC are
+/// discarded and counted, sequence gaps are counted as lost frames. Both
+/// counters are sent back in SIM_LINK, so the link quality is seen on the
+/// simulator side.
+/// Software/Python/simlink.py is the reference implementation on the PC
+/// side. It also bridges a simulator still speaking the former ASCII
+/// protocol ($S sensor and $K gain sentences, e.g. ApSim) to this one.
+///
 //  Change removed function Simulator_Send_Position() for transmitting GPS 
 //         position (not used since X-Plane already knows aircraft position)
+//         binary framed protocol with sequence number and CRC, replaces
+//         ASCII $S and $K sentences
 //
 //============================================================================*/
 
@@ -55,6 +96,8 @@
 #include "nav.h"
 #include "DCM.h"
 #include "servodriver.h"
+#include "ring.h"
+#include "crc.h"
 #include "usart1driver.h"
 #include "simulator.h"
 
@@ -64,6 +107,12 @@
 #define VAR_STATIC static
 #endif
 
+#define SIM_SYNC_1      0xA5            //!< first byte of frame
+#define SIM_SYNC_2      0x5A            //!< second byte of frame
+#define SIM_HEADER      5               //!< sync, length, sequence, type
+#define SIM_PAYLOAD_MAX 18              //!< longest payload [bytes]
+#define SIM_FRAME_MAX   (SIM_HEADER + SIM_PAYLOAD_MAX + 2) //!< longest frame [bytes]
+
 /*----------------------------------- Macros ---------------------------------*/
 
 /*-------------------------------- Enumerations ------------------------------*/
@@ -78,29 +127,22 @@ typedef enum E_SIMULATOR {
     SIM_GYRO,
     SIM_DEBUG_I,
     SIM_DEBUG_F,
-    SIM_DCM
+    SIM_DCM,
+    SIM_SENSORS,
+    SIM_GAINS,
+    SIM_LINK
 } wait_code_t;
 
 /// simulator parser stati
 typedef enum E_PARSER {
-    PARSE_PREAMBLE = 0, // preamble
-    PARSE_TYPE,         // 1: data type ('S'= sensor, 'K'= gains)
-    PARSE_SENSORS,      // 2: sensor start
-    PARSE_SENSOR_1,     // 3: sensor 1
-    PARSE_SENSOR_2,     // 4: sensor 2
-    PARSE_SENSOR_3,     // 5: sensor 3
-    PARSE_SENSOR_4,     // 6: sensor 4
-    PARSE_SENSOR_5,     // 7: sensor 5
-    PARSE_SENSOR_6,     // 8: sensor 6
-    PARSE_AIRSPEED,     // 9: airspeed
-    PARSE_ALTITUDE,     // 10: altitude
-    PARSE_GAINS,        // 11: PID gains start
-    PARSE_GAIN_1,       // 12: gain 1
-    PARSE_GAIN_2,       // 13: gain 2
-    PARSE_GAIN_3,       // 14: gain 3
-    PARSE_GAIN_4,       // 15: gain 4
-    PARSE_GAIN_5,       // 16: gain 5
-    PARSE_GAIN_6        // 17: gain 6
+    PARSE_SYNC_1 = 0,   // first sync byte
+    PARSE_SYNC_2,       // second sync byte
+    PARSE_LENGTH,       // payload length
+    PARSE_SEQUENCE,     // sequence number
+    PARSE_TYPE,         // message type
+    PARSE_PAYLOAD,      // payload
+    PARSE_CRC_1,        // CRC low byte
+    PARSE_CRC_2         // CRC high byte
 } parser_status_t;
 
 /*----------------------------------- Types ----------------------------------*/
@@ -110,20 +152,22 @@ typedef enum E_PARSER {
 /*---------------------------------- Globals ---------------------------------*/
 
 /*----------------------------------- Locals ---------------------------------*/
-/*
-"$S,100,200,300,400,500,600,110\n"
-"$S,560,112,-12,12345,0,1023,110\n"
-"$S,512,512,512,512,512,512,512,110,110\n"
-"$S,512,512,512,\n$S,512,512,512,512,512,512\n"
-"$GPRMC,194617.04,A,4534.6714,N,01128.8559,E,000.0,287.0,091008,001.9,E,A*31\n"
-"$K,8799,1299, 899, 199,4999,4999\r\n"
-"$S,560,112,-12,12345,0,1023,110\n"
-*/
-VAR_STATIC parser_status_t xStatus = PARSE_PREAMBLE;//!< status of parser
-VAR_STATIC float fTemp = 0.0f;                      //!< temporary for parser
+
+VAR_STATIC parser_status_t xStatus = PARSE_SYNC_1;  //!< status of parser
+VAR_STATIC uint8_t ucLength;                        //!< payload length of frame
+VAR_STATIC uint8_t ucSequence;                      //!< sequence number of frame
+VAR_STATIC uint8_t ucType;                          //!< message type of frame
+VAR_STATIC uint8_t ucIndex;                         //!< payload bytes received
+VAR_STATIC uint8_t ucPayload[SIM_PAYLOAD_MAX];      //!< payload of frame
+VAR_STATIC uint16_t uiCrc;                          //!< CRC of frame
+VAR_STATIC uint8_t ucExpected;                      //!< next sequence number expected
+VAR_STATIC bool bSynced = FALSE;                    //!< a frame has been received
+VAR_STATIC uint16_t uiLost = 0;                     //!< frames lost, from sequence gaps
+VAR_STATIC uint16_t uiErrors = 0;                   //!< frames discarded, bad length or CRC
+VAR_STATIC uint8_t ucTx_Sequence = 0;               //!< sequence number of next frame sent
 VAR_STATIC float fTrueAirSpeed = 0.0f;              //!< simulator true air speed
 VAR_STATIC float fAltitude;                         //!< simulator altitude
-VAR_STATIC float fSensor[8];                        //!< simulator sensor data
+VAR_STATIC int16_t iSensor[6];                      //!< simulator sensor data
 VAR_STATIC float fGain[SIM_GAIN_NUMBER] = {
     PITCH_KP,                                       //!< default pitch kp
     PITCH_KI,                                       //!< default pitch ki
@@ -137,13 +181,16 @@ VAR_STATIC float fGain[SIM_GAIN_NUMBER] = {
 
 /*--------------------------------- Prototypes -------------------------------*/
 
+static void Simulator_Decode(void);
+static void Simulator_Send_Frame(wait_code_t type, const uint8_t * payload, uint8_t length);
+
 /*---------------------------------- Functions -------------------------------*/
 
 //----------------------------------------------------------------------------
 //
 /// \brief   parse simulator data
 /// \returns -
-/// \remarks information uploadED during simulation:
+/// \remarks information uploaded during simulation:
 ///
 ///          INFORMATION  NOTE
 ///          -------------------------------------------
@@ -153,19 +200,10 @@ VAR_STATIC float fGain[SIM_GAIN_NUMBER] = {
 ///          PID gains    PID gains are input on ground
 ///                       control station
 ///
-///          Simulator messages start with a preamble (2 characters) used to
-///          discriminate the type of message. The preamble format has been
-///          chosen to resemble the GPS NMEA sentences.
-///          Preamble is followed by useful data. Number of data fields and
-///          data field format depends on message type:
-///
-///          PREAMBLE  MESSAGE CONTENT  DATA FIELDS DATA FORMAT
-///          -------------------------------------------------------------
-///             $S     gyro,accel,speed     7        16 bit decimal integers
-///             $K     PID gains            6        16 bit decimal integers
-///
-///         Parsing of sensor data and PID gains is a simple string to float
-///         conversion. Sensor data and gains have no final checksum.
+///          All received frames are decoded, so the simulator may send
+///          faster than it is parsed: newest data are used. Parser resyncs
+///          on the sync word after a bad frame. A frame is decoded only
+///          when its CRC is correct.
 ///
 //----------------------------------------------------------------------------
 void Simulator_Parse ( void )
@@ -173,214 +211,259 @@ void Simulator_Parse ( void )
     uint8_t c;
     while (USART1_Getch(&c)) {          // received another character
         switch (xStatus) {
-            case PARSE_PREAMBLE :   /* ------------- preamble -------------- */
-                if (c == '$') { xStatus++; }    // preamble ok
+            case PARSE_SYNC_1 :
+                if (c == SIM_SYNC_1) { xStatus = PARSE_SYNC_2; }
                 break;
-            case PARSE_TYPE :       /* ------------- data type ------------- */
-                switch (c) {
-                    case 'S': xStatus = PARSE_SENSORS; break;   // sensor data
-                    case 'K': xStatus = PARSE_GAINS; break;     // gain data
-                    default : xStatus = PARSE_PREAMBLE; break;  // error
+            case PARSE_SYNC_2 :
+                if (c == SIM_SYNC_2) {
+                    xStatus = PARSE_LENGTH;
+                } else if (c != SIM_SYNC_1) {
+                    xStatus = PARSE_SYNC_1;
                 }
                 break;
-            case PARSE_SENSORS :    /* -------------- sensors -------------- */
-                if (c == ',') { xStatus++; } else { xStatus = PARSE_PREAMBLE; }
-                break;
-            case PARSE_SENSOR_1 :
-            case PARSE_SENSOR_2 :
-            case PARSE_SENSOR_3 :
-            case PARSE_SENSOR_4 :
-            case PARSE_SENSOR_5 :
-            case PARSE_SENSOR_6 :
-                if (c == ',') {
-                    fSensor[xStatus - 3] = 32767.0f - fTemp;    // save sensor
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus++;                                  // next sensor
-                } else if ((c >= '0') && (c <= '9')) {          // numeric char
-                    fTemp = fTemp * 10.0f + (float)(c - '0');   // add to temp
-                } else if (c != ' ') {                          // error
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus = PARSE_PREAMBLE;                   // reset parser
+            case PARSE_LENGTH :
+                if (c > SIM_PAYLOAD_MAX) {                      // can't be a frame
+                    uiErrors++;
+                    xStatus = PARSE_SYNC_1;
+                } else {
+                    ucLength = c;
+                    uiCrc = Crc_X25_Byte(CRC_X25_INIT, c);
+                    xStatus = PARSE_SEQUENCE;
                 }
                 break;
-            case PARSE_AIRSPEED :
-                if (c == ',') {
-                    fTrueAirSpeed = fTemp / 100.0f;             // save airspeed
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus++;                                  // next data
-                } else if ((c >= '0') && (c <= '9')) {          // numeric char
-                    fTemp = fTemp * 10.0f + (float)(c - '0');   // add to temp
-                } else if (c != ' ') {                          // error
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus = PARSE_PREAMBLE;                   // reset parser
-                } else {
-				}
+            case PARSE_SEQUENCE :
+                ucSequence = c;
+                uiCrc = Crc_X25_Byte(uiCrc, c);
+                xStatus = PARSE_TYPE;
                 break;
-            case PARSE_ALTITUDE :
-                if (c == '\r') {                                // end of data
-                    fAltitude = fTemp;                          // save altitude
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus = PARSE_PREAMBLE;                   // reset parser
-                } else if ((c >= '0') && (c <= '9')) {          // numeric char
-                    fTemp = fTemp * 10.0f + (float)(c - '0');   // add to temp
-                } else if (c != ' ') {                          // error
-                    fTemp = 0.0f;                               // clear temp
-                    xStatus = PARSE_PREAMBLE;                   // reset parser
-                } else {
-				}
+            case PARSE_TYPE :
+                ucType = c;
+                uiCrc = Crc_X25_Byte(uiCrc, c);
+                ucIndex = 0;
+                xStatus = (ucLength == 0) ? PARSE_CRC_1 : PARSE_PAYLOAD;
                 break;
-
-            case PARSE_GAINS :  /* --------------- PID gains ------------------ */
-                if (c == ',') { xStatus++; } else { xStatus = PARSE_PREAMBLE; }
+            case PARSE_PAYLOAD :
+                ucPayload[ucIndex++] = c;
+                uiCrc = Crc_X25_Byte(uiCrc, c);
+                if (ucIndex == ucLength) { xStatus = PARSE_CRC_1; }
                 break;
-            case PARSE_GAIN_1 :
-            case PARSE_GAIN_2 :
-            case PARSE_GAIN_3 :
-            case PARSE_GAIN_4 :
-            case PARSE_GAIN_5 :
-            case PARSE_GAIN_6 :
-                if ((c == '\r') || (c == '\n')) {                   // end of data
-                    fGain[xStatus - PARSE_GAIN_1] = fTemp / 2000.0f;// save last gain
-                    fTemp = 0.0f;                                   // clear temp
-                    xStatus = PARSE_PREAMBLE;                       // reset parser
-                } else if (c == ',') {                              // comma
-                    fGain[xStatus - PARSE_GAIN_1] = fTemp / 2000.0f;// save gain
-                    fTemp = 0.0f;                                   // clear temp
-                    xStatus++;                                      // next gain
-                } else if ((c >= '0') && (c <= '9')) {              // numeric char
-                    fTemp = fTemp * 10.0f + (float)(c - '0');       // add to temp
-                } else if (c != ' ') {                              // error
-                    fTemp = 0.0f;                                   // clear temp
-                    xStatus = PARSE_PREAMBLE;                       // reset parser
+            case PARSE_CRC_1 :
+                if (c == (uint8_t)(uiCrc & 0xFF)) {
+                    xStatus = PARSE_CRC_2;
                 } else {
-				}
+                    uiErrors++;
+                    xStatus = (c == SIM_SYNC_1) ? PARSE_SYNC_2 : PARSE_SYNC_1;
+                }
+                break;
+            case PARSE_CRC_2 :
+                if (c == (uint8_t)(uiCrc >> 8)) {
+                    if (bSynced) {                              // count gap
+                        uiLost += (uint8_t)(ucSequence - ucExpected);
+                    }
+                    bSynced = TRUE;
+                    ucExpected = ucSequence + 1;
+                    Simulator_Decode();
+                    xStatus = PARSE_SYNC_1;
+                } else {
+                    uiErrors++;
+                    xStatus = (c == SIM_SYNC_1) ? PARSE_SYNC_2 : PARSE_SYNC_1;
+                }
                 break;
-
             default:                                            // wrong status
-                fTemp = 0.0f;                                   // clear temp
-                xStatus = PARSE_PREAMBLE;                       // reset parser
+                xStatus = PARSE_SYNC_1;                         // reset parser
                 break;
         }
     }
 }
 
+//----------------------------------------------------------------------------
+//
+/// \brief   decode a received frame
+/// \returns -
+/// \remarks frames of unknown type or length are ignored
+///
+//----------------------------------------------------------------------------
+static void Simulator_Decode(void)
+{
+    uint8_t j;
+
+    switch (ucType) {
+        case SIM_SENSORS :
+            if (ucLength == 16) {
+                for (j = 0; j < 6; j++) {
+                    iSensor[j] = (int16_t)(ucPayload[2 * j] | (ucPayload[2 * j + 1] << 8));
+                }
+                fTrueAirSpeed = (float)(uint16_t)(ucPayload[12] | (ucPayload[13] << 8)) / 100.0f;
+                fAltitude = (float)(int16_t)(ucPayload[14] | (ucPayload[15] << 8));
+            }
+            break;
+        case SIM_GAINS :
+            if (ucLength == 12) {
+                for (j = 0; j < 6; j++) {
+                    fGain[j] = (float)(uint16_t)(ucPayload[2 * j] | (ucPayload[2 * j + 1] << 8)) / 2000.0f;
+                }
+            }
+            break;
+        default :
+            break;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   send a frame
+/// \param   type = message type
+/// \param   payload = pointer to payload
+/// \param   length = payload length, up to SIM_PAYLOAD_MAX
+/// \returns -
+/// \remarks frame is dropped as a whole if transmit buffer is full, its
+///          sequence number is used anyway so that the gap is seen.
+///
+//----------------------------------------------------------------------------
+static void Simulator_Send_Frame(wait_code_t type, const uint8_t * payload, uint8_t length)
+{
+    uint8_t frame[SIM_FRAME_MAX];
+    uint16_t crc;
+    uint8_t j;
+
+    frame[0] = SIM_SYNC_1;
+    frame[1] = SIM_SYNC_2;
+    frame[2] = length;
+    frame[3] = ucTx_Sequence++;
+    frame[4] = (uint8_t)type;
+    for (j = 0; j < length; j++) {
+        frame[SIM_HEADER + j] = payload[j];
+    }
+    crc = Crc_X25(CRC_X25_INIT, &frame[2], (uint16_t)length + 3);
+    frame[SIM_HEADER + length] = (uint8_t)(crc & 0xFF);
+    frame[SIM_HEADER + length + 1] = (uint8_t)(crc >> 8);
+    (void)USART1_Write(frame, (uint16_t)length + SIM_HEADER + 2);
+}
+
 //----------------------------------------------------------------------------
 //
 /// \brief   Downlink controls
 /// \returns -
-/// \remarks buffer content:
+/// \remarks payload content:
 ///
 ///             index   content
 ///
-///               0     TEL_SERVO_POS
-///               1     elevator
-///               2         "
+///               0     elevator
+///               1         "
+///               2     ailerons
 ///               3         "
-///               4         "
-///               5     ailerons
-///               6         "
+///               4     rudder
+///               5         "
+///               6     throttle
 ///               7         "
-///               8         "
-///               9     rudder
-///              10         "
-///              11         "
-///              12         "
-///              13     throttle
-///              14         "
-///              15         "
-///              16         "
 ///
 //----------------------------------------------------------------------------
 void Simulator_Send_Controls(void)
 {
-    USART1_Putch(SIM_SERVO_POS);                    // simulator wait code
-    USART1_Putf((float)Servo_Get(SERVO_ELEVATOR));  // elevator
-    USART1_Putf((float)Servo_Get(SERVO_AILERON));   // ailerons
-    USART1_Putf((float)Servo_Get(SERVO_RUDDER));    // rudder
-    USART1_Putf((float)Servo_Get(SERVO_THROTTLE));  // throttle
-
-    USART1_Transmit();                              // send data
+    uint8_t payload[8];
+    int16_t position;
+
+    position = Servo_Get(SERVO_ELEVATOR);           // elevator
+    payload[0] = (uint8_t)position;
+    payload[1] = (uint8_t)((uint16_t)position >> 8);
+    position = Servo_Get(SERVO_AILERON);            // ailerons
+    payload[2] = (uint8_t)position;
+    payload[3] = (uint8_t)((uint16_t)position >> 8);
+    position = Servo_Get(SERVO_RUDDER);             // rudder
+    payload[4] = (uint8_t)position;
+    payload[5] = (uint8_t)((uint16_t)position >> 8);
+    position = Servo_Get(SERVO_THROTTLE);           // throttle
+    payload[6] = (uint8_t)position;
+    payload[7] = (uint8_t)((uint16_t)position >> 8);
+
+    Simulator_Send_Frame(SIM_SERVO_POS, payload, 8);
 }
 
 //----------------------------------------------------------------------------
 //
 /// \brief   Downlink waypoint data
 /// \returns -
-/// \remarks buffer content:
+/// \remarks payload content:
 ///
 ///             index   content
 ///
-///               0     TEL_WAYPOINT
-///               1     waypoint index
-///               2     bearing
-///               3         "
-///               4     altitude
-///               5         "
-///               6     distance
-///               7         "
+///               0     waypoint index
+///               1     bearing
+///               2         "
+///               3     altitude
+///               4         "
+///               5     distance
+///               6         "
 ///
 //----------------------------------------------------------------------------
 void Simulator_Send_Waypoint(void)
 {
-    USART1_Putch(SIM_WAYPOINT);                 // simulator wait code
-    USART1_Putch((uint8_t)Nav_Wpt_Index());     // waypoint index
-    USART1_Putw((uint16_t)Nav_Bearing_Deg());   // bearing to waypoint
-    USART1_Putw((uint16_t)Nav_Wpt_Altitude());  // waypoint altitude
-    USART1_Putw(Nav_Distance());                // distance to waypoint
-
-    USART1_Transmit();                          // send data
+    uint8_t payload[7];
+    uint16_t value;
+
+    payload[0] = (uint8_t)Nav_Wpt_Index();          // waypoint index
+    value = (uint16_t)Nav_Bearing_Deg();            // bearing to waypoint
+    payload[1] = (uint8_t)value;
+    payload[2] = (uint8_t)(value >> 8);
+    value = (uint16_t)Nav_Wpt_Altitude();           // waypoint altitude
+    payload[3] = (uint8_t)value;
+    payload[4] = (uint8_t)(value >> 8);
+    value = Nav_Distance();                         // distance to waypoint
+    payload[5] = (uint8_t)value;
+    payload[6] = (uint8_t)(value >> 8);
+
+    Simulator_Send_Frame(SIM_WAYPOINT, payload, 7);
 }
 
-///----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+//
+/// \brief   Downlink uplink quality counters
+/// \returns -
+/// \remarks payload content:
 ///
-/// \brief   sends data via telemetry USART
-/// \return  -
-/// \param   data, pointer to message
-/// \param   num number of elements
-/// \remarks message is an array of 'num' words, each word is 16 bit.
-///          Each element is converted to an hexadecimal string and sent to UART
+///             index   content
 ///
-///----------------------------------------------------------------------------
-void Simulator_Send_Message(const uint16_t *data, uint8_t num)
+///               0     lost frames
+///               1         "
+///               2     discarded frames
+///               3         "
+///
+///          Counters are totals since start, wrapping at 65535.
+///
+//----------------------------------------------------------------------------
+void Simulator_Send_Link(void)
 {
-    uint32_t l_temp;
-    uint8_t digit, i = 0;
-
-    for (i = 0; i < num; i++) {
-        l_temp = *data++;
-        USART1_Putch(' ');
-        digit = ((l_temp >> 12) & 0x0000000F);
-        USART1_Putch(((digit < 10) ? (digit + '0') : ((digit - 10) + 'A')));
-        digit = ((l_temp >> 8) & 0x0000000F);
-        USART1_Putch(((digit < 10) ? (digit + '0') : ((digit - 10) + 'A')));
-        digit = ((l_temp >> 4) & 0x0000000F);
-        USART1_Putch(((digit < 10) ? (digit + '0') : ((digit - 10) + 'A')));
-        digit = (l_temp & 0x0000000F);
-        USART1_Putch(((digit < 10) ? (digit + '0') : ((digit - 10) + 'A')));
-    }
-    USART1_Putch('\n');
+    uint8_t payload[4];
 
-    USART1_Transmit();                      // send data
+    payload[0] = (uint8_t)uiLost;                   // lost frames
+    payload[1] = (uint8_t)(uiLost >> 8);
+    payload[2] = (uint8_t)uiErrors;                 // discarded frames
+    payload[3] = (uint8_t)(uiErrors >> 8);
+
+    Simulator_Send_Frame(SIM_LINK, payload, 4);
 }
 
 ///----------------------------------------------------------------------------
 ///
 /// \brief   sends DCM matrix via USART
 /// \return  -
-/// \remarks entries of DCM matrix are sent as raw bytes
+/// \remarks entries of DCM matrix are sent by rows, scaled by 16384
 ///
 ///----------------------------------------------------------------------------
 void Simulator_Send_DCM(void) {
 
+    uint8_t payload[18];
     uint8_t x, y;
+    int16_t value;
 
-    USART1_Putch(SIM_DCM);                  // telemetry wait code
     for (y = 0; y < 3; y++) {               // 3 rows
       for (x = 0; x < 3; x++) {             // 3 columns
-          USART1_Putf(DCM_Matrix[y][x]);    // DCM entry
+          value = (int16_t)(DCM_Matrix[y][x] * 16384.0f);
+          payload[2 * (3 * y + x)] = (uint8_t)value;
+          payload[2 * (3 * y + x) + 1] = (uint8_t)((uint16_t)value >> 8);
       }
     }
-    USART1_Transmit();                      // send data
+    Simulator_Send_Frame(SIM_DCM, payload, 18);
 }
 
 ///----------------------------------------------------------------------------
@@ -433,7 +516,29 @@ void Simulator_Get_Raw_IMU(int16_t * piSensor) {
     uint8_t j;
 
     for (j = 0; j < 6; j++) {
-        *piSensor++ = (int16_t)fSensor[j];
+        *piSensor++ = iSensor[j];
     }
 }
 
+///----------------------------------------------------------------------------
+///
+/// \brief   Get number of lost frames
+/// \return  frames missing from received sequence numbers
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Simulator_Get_Lost(void) {
+    return uiLost;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   Get number of discarded frames
+/// \return  frames with bad length or CRC
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Simulator_Get_Errors(void) {
+    return uiErrors;
+}
+
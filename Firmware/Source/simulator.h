@@ -12,6 +12,7 @@
 ///
 //  Change removed function Simulator_Send_Position() for transmitting GPS
 //         position (not used since X-Plane already knows aircraft position)
+//         counters of lost and discarded frames
 //
 //============================================================================
 
@@ -54,12 +55,14 @@ typedef enum {
 /*---------------------------------- Interface -------------------------------*/
 
 void Simulator_Parse( void );
-void Simulator_Send_Message(const uint16_t *data, uint8_t num);
 void Simulator_Send_DCM( void );
 void Simulator_Send_Controls( void );
 void Simulator_Send_Waypoint( void );
+void Simulator_Send_Link( void );
 void Simulator_Get_Raw_IMU(int16_t * piSensors);
 float Simulator_Get_Gain(simEnum_Gain gain);
 float Simulator_Get_Speed(void);
 float Simulator_Get_Altitude(void);
+uint16_t Simulator_Get_Lost(void);
+uint16_t Simulator_Get_Errors(void);
 
@@ -0,0 +1,359 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief parameter store
+///
+/// \file
+///  Parameters changed by telemetry are kept in two 1 KB pages of internal
+///  flash, written as a log of records. The active page begins with a header
+///  and is followed by records appended in order of change:
+/// \code
+///   | header | key, value, crc | key, value, crc | ... | 0xFFFF ...
+/// \endcode
+///  A record holds the X25 CRC of the parameter name as key, so parameters
+///  can be reordered or added by a new firmware, the value, and a CRC of both
+///  written last, so a record interrupted by a power loss is ignored.
+///  At start up the active page is scanned once, last valid record of each
+///  key wins. Saving a change costs four half word programs (~0.2 ms).
+///  When the active page is full, current values of stored parameters are
+///  copied into the other page, then its header is written with next
+///  sequence number: until then the old page remains the valid one.
+///  A page erase stalls the CPU for ~20 ms, more than an AHRS cycle, so pages
+///  are erased only by Store_Init, before the scheduler starts. The spare
+///  page is therefore always blank in flight, which allows one compaction
+///  per power cycle, i.e. at least 2 * STORE_RECORDS - PARAM_NUMBER saves.
+///  Further saves are refused, values remain in use until power off.
+///  Erases alternate between the two pages, one per page filled.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "stm32f10x_flash.h"
+#include "stddef.h"
+#include "string.h"
+
+#include "crc.h"
+#include "param.h"
+#include "store.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/* number of half words in a record */
+#define STORE_HALF_WORDS    (sizeof(xStore_Record) / 2)
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/// flash address of a slot, slot 0 is the page header
+#define Store_Address(ucPage, uiSlot) \
+    (STORE_PAGE_ADDRESS + ((uint32_t)(ucPage) * STORE_PAGE_SIZE) + \
+     ((uint32_t)(uiSlot) * sizeof(xStore_Record)))
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC uint16_t ui_Key[PARAM_NUMBER];       //!< record key of each parameter
+VAR_STATIC float f_Stored[PARAM_NUMBER];        //!< value in flash, default if none
+VAR_STATIC bool b_Stored[PARAM_NUMBER];         //!< parameter has a record in flash
+VAR_STATIC uint16_t ui_Sequence = 0;            //!< sequence number of active page
+VAR_STATIC uint16_t ui_Next = 0;                //!< next free slot of active page
+VAR_STATIC uint8_t uc_Page = 0;                 //!< active page
+VAR_STATIC bool b_Spare = FALSE;                //!< other page is blank
+VAR_STATIC bool b_Ready = FALSE;                //!< active page can be written
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static bool Store_Blank(uint32_t ulAddress, uint16_t uiLength);
+static bool Store_Header(uint8_t ucPage, uint16_t * puiSequence);
+static FLASH_Status Store_Program(uint32_t ulAddress, const uint16_t * puiData, uint16_t uiCount);
+static FLASH_Status Store_Write(uint8_t ucPage, uint16_t uiSlot, uint8_t ucId, float fValue);
+static FLASH_Status Store_Start(uint8_t ucPage, uint16_t uiSequence);
+static bool Store_Compact(void);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks that flash is erased
+/// \param   ulAddress = start address
+/// \param   uiLength = number of bytes, even
+/// \return  TRUE if all half words are 0xFFFF
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static bool Store_Blank(uint32_t ulAddress, uint16_t uiLength)
+{
+    const uint16_t * p_flash = (const uint16_t *)ulAddress;
+
+    for (uiLength /= 2; uiLength != 0; uiLength--) {
+        if (*p_flash++ != 0xFFFF) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks page header
+/// \param   ucPage = page
+/// \param   puiSequence = pointer to sequence number
+/// \return  TRUE if header is valid
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static bool Store_Header(uint8_t ucPage, uint16_t * puiSequence)
+{
+    const xStore_Header * p_header = (const xStore_Header *)Store_Address(ucPage, 0);
+
+    *puiSequence = p_header->uiSequence;
+    return ((p_header->uiMagic[0] == (uint16_t)STORE_MAGIC) &&
+            (p_header->uiMagic[1] == (uint16_t)(STORE_MAGIC >> 16)) &&
+            (p_header->uiCheck == (uint16_t)~p_header->uiSequence)) ? TRUE : FALSE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   programs half words
+/// \param   ulAddress = start address
+/// \param   puiData = pointer to data
+/// \param   uiCount = number of half words
+/// \return  FLASH_COMPLETE or status of first failed program
+/// \remarks flash must be unlocked, half words are written in order
+///
+///----------------------------------------------------------------------------
+static FLASH_Status Store_Program(uint32_t ulAddress, const uint16_t * puiData, uint16_t uiCount)
+{
+    FLASH_Status status = FLASH_COMPLETE;
+
+    for (; (uiCount != 0) && (status == FLASH_COMPLETE); uiCount--) {
+        status = FLASH_ProgramHalfWord(ulAddress, *puiData++);
+        ulAddress += 2;
+    }
+    return status;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes a record
+/// \param   ucPage = page
+/// \param   uiSlot = free slot
+/// \param   ucId = parameter
+/// \param   fValue = value
+/// \return  FLASH_COMPLETE if record has been written
+/// \remarks key is written first and CRC last
+///
+///----------------------------------------------------------------------------
+static FLASH_Status Store_Write(uint8_t ucPage, uint16_t uiSlot, uint8_t ucId, float fValue)
+{
+    xStore_Record x_record;
+
+    x_record.uiKey = ui_Key[ucId];
+    memcpy(x_record.uiValue, &fValue, sizeof(float));
+    x_record.uiCrc = Crc_X25(CRC_X25_INIT, (const uint8_t *)&x_record,
+                             offsetof(xStore_Record, uiCrc));
+    return Store_Program(Store_Address(ucPage, uiSlot),
+                         (const uint16_t *)&x_record, STORE_HALF_WORDS);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   writes page header
+/// \param   ucPage = page
+/// \param   uiSequence = sequence number
+/// \return  FLASH_COMPLETE if header has been written
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static FLASH_Status Store_Start(uint8_t ucPage, uint16_t uiSequence)
+{
+    xStore_Header x_header;
+
+    x_header.uiMagic[0] = (uint16_t)STORE_MAGIC;
+    x_header.uiMagic[1] = (uint16_t)(STORE_MAGIC >> 16);
+    x_header.uiSequence = uiSequence;
+    x_header.uiCheck = (uint16_t)~uiSequence;
+    return Store_Program(Store_Address(ucPage, 0),
+                         (const uint16_t *)&x_header, STORE_HALF_WORDS);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   copies stored and changed parameters into spare page
+/// \return  TRUE if spare page has become the active page
+/// \remarks flash must be unlocked. Spare page isn't blank any more, even
+///          if compaction fails, until next Store_Init.
+///
+///----------------------------------------------------------------------------
+static bool Store_Compact(void)
+{
+    uint8_t j, uc_page = (uint8_t)(1 - uc_Page);
+    uint16_t ui_slot = 1;
+    float f_value;
+    FLASH_Status status = FLASH_COMPLETE;
+
+    if (!b_Spare) {                                     // not erased in flight
+        return FALSE;
+    }
+    b_Spare = FALSE;
+    for (j = 0; (j < (uint8_t)PARAM_NUMBER) && (status == FLASH_COMPLETE); j++) {
+        f_value = Param_Get((paramEnum_Id)j);
+        if (b_Stored[j] || (f_value != f_Stored[j])) {
+            status = Store_Write(uc_page, ui_slot++, j, f_value);
+        }
+    }
+    if (status == FLASH_COMPLETE) {                     // page becomes valid
+        status = Store_Start(uc_page, (uint16_t)(ui_Sequence + 1));
+    }
+    if (status != FLASH_COMPLETE) {
+        return FALSE;
+    }
+    for (j = 0; j < (uint8_t)PARAM_NUMBER; j++) {
+        f_value = Param_Get((paramEnum_Id)j);
+        if (b_Stored[j] || (f_value != f_Stored[j])) {
+            f_Stored[j] = f_value;
+            b_Stored[j] = TRUE;
+        }
+    }
+    ui_Sequence++;
+    uc_Page = uc_page;
+    ui_Next = ui_slot;
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   loads stored parameters
+/// \return  -
+/// \remarks called by main after Param_Init and before starting scheduler,
+///          erases the page that isn't active: may stall CPU ~40 ms
+///
+///----------------------------------------------------------------------------
+void Store_Init(void)
+{
+    uint8_t j;
+    uint16_t ui_seq[STORE_PAGES];
+    bool b_valid[STORE_PAGES];
+    const xStore_Record * p_record;
+    float f_value;
+    FLASH_Status status = FLASH_COMPLETE;
+
+    for (j = 0; j < (uint8_t)PARAM_NUMBER; j++) {
+        ui_Key[j] = Crc_X25(CRC_X25_INIT, Param_Name((paramEnum_Id)j), PARAM_NAME_LENGTH);
+        f_Stored[j] = Param_Get((paramEnum_Id)j);
+        b_Stored[j] = FALSE;
+    }
+    b_valid[0] = Store_Header(0, &ui_seq[0]);
+    b_valid[1] = Store_Header(1, &ui_seq[1]);
+    if (b_valid[0] && b_valid[1]) {                     // compaction not erased yet
+        uc_Page = ((int16_t)(ui_seq[1] - ui_seq[0]) > 0) ? 1 : 0;
+    } else {
+        uc_Page = b_valid[1] ? 1 : 0;
+    }
+
+    FLASH_Unlock();
+    FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPRTERR);
+    if (b_valid[uc_Page]) {                             // scan log
+        ui_Sequence = ui_seq[uc_Page];
+        for (ui_Next = 1; (ui_Next <= STORE_RECORDS) &&
+             !Store_Blank(Store_Address(uc_Page, ui_Next), sizeof(xStore_Record)); ui_Next++) {
+            p_record = (const xStore_Record *)Store_Address(uc_Page, ui_Next);
+            if (p_record->uiCrc != Crc_X25(CRC_X25_INIT, (const uint8_t *)p_record,
+                                           offsetof(xStore_Record, uiCrc))) {
+                continue;                               // interrupted write
+            }
+            for (j = 0; (j < (uint8_t)PARAM_NUMBER) && (ui_Key[j] != p_record->uiKey); j++) {
+            }
+            memcpy(&f_value, p_record->uiValue, sizeof(float));
+            if ((j < (uint8_t)PARAM_NUMBER) && Param_Set((paramEnum_Id)j, f_value)) {
+                f_Stored[j] = Param_Get((paramEnum_Id)j);
+                b_Stored[j] = TRUE;
+            }
+        }
+    } else {                                            // first use
+        ui_Sequence = 0;
+        ui_Next = 1;
+        if (!Store_Blank(Store_Address(uc_Page, 0), STORE_PAGE_SIZE)) {
+            status = FLASH_ErasePage(Store_Address(uc_Page, 0));
+        }
+        if (status == FLASH_COMPLETE) {
+            status = Store_Start(uc_Page, ui_Sequence);
+        }
+    }
+    b_Ready = (status == FLASH_COMPLETE) ? TRUE : FALSE;
+
+    j = (uint8_t)(1 - uc_Page);                         // prepare spare page
+    status = FLASH_COMPLETE;
+    if (!Store_Blank(Store_Address(j, 0), STORE_PAGE_SIZE)) {
+        status = FLASH_ErasePage(Store_Address(j, 0));
+    }
+    b_Spare = (status == FLASH_COMPLETE) ? TRUE : FALSE;
+    FLASH_Lock();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   saves changed parameters
+/// \return  TRUE if all parameters are stored with their current value
+/// \remarks called by telemetry task after parameters have been set.
+///          Appends one record for each changed parameter, compacts if the
+///          active page is full, never erases.
+///
+///----------------------------------------------------------------------------
+bool Store_Save(void)
+{
+    uint8_t j;
+    float f_value;
+    bool b_ok = TRUE;
+
+    FLASH_Unlock();
+    FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPRTERR);
+    for (j = 0; (j < (uint8_t)PARAM_NUMBER) && b_ok; j++) {
+        f_value = Param_Get((paramEnum_Id)j);
+        if (f_value == f_Stored[j]) {                   // no change
+            continue;
+        }
+        if (!b_Ready) {                                 // both pages used
+            b_ok = FALSE;
+        } else if (ui_Next > STORE_RECORDS) {           // page full
+            b_Ready = Store_Compact();
+            b_ok = b_Ready;
+            break;                                      // changes copied as well
+        } else if (Store_Write(uc_Page, ui_Next++, j, f_value) == FLASH_COMPLETE) {
+            f_Stored[j] = f_value;
+            b_Stored[j] = TRUE;
+        } else {
+            b_ok = FALSE;                               // slot is lost
+        }
+    }
+    FLASH_Lock();
+    return b_ok;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   free records of active page
+/// \return  number of changes that can be saved before next compaction
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Store_Free(void)
+{
+    return b_Ready ? (uint16_t)(STORE_RECORDS + 1 - ui_Next) : 0;
+}
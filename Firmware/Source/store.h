@@ -0,0 +1,59 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief parameter store header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define STORE_PAGE_ADDRESS  0x0801F400  //!< first of two 1 KB pages before calibration page, excluded from IROM
+#define STORE_PAGE_SIZE     1024        //!< size of a flash page [bytes]
+#define STORE_PAGES         2           //!< number of pages used alternately
+#define STORE_MAGIC         0x57025701  //!< page signature and version
+
+/// number of records in a page, first slot is the page header
+#define STORE_RECORDS       ((STORE_PAGE_SIZE / sizeof(xStore_Record)) - 1)
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// parameter record, appended to active page
+typedef struct {
+    uint16_t uiKey;                     ///< X25 CRC of parameter name, written first
+    uint16_t uiValue[2];                ///< value as float, low half word first
+    uint16_t uiCrc;                     ///< X25 CRC of key and value, written last
+} xStore_Record;
+
+/// page header, written after all records copied by a compaction
+typedef struct {
+    uint16_t uiMagic[2];                ///< signature, low half word first
+    uint16_t uiSequence;                ///< incremented by each compaction
+    uint16_t uiCheck;                   ///< ones' complement of sequence
+} xStore_Header;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Store_Init(void);
+bool Store_Save(void);
+uint16_t Store_Free(void);
@@ -0,0 +1,192 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief telemetry stream scheduler
+///
+/// \file
+///  Periodic messages are scheduled with two levels of token buckets:
+///  - each stream earns its requested rate every tick and is due when its
+///    credit reaches STREAM_TICK_HZ, credit is capped to two messages so a
+///    delayed stream doesn't burst afterwards;
+///  - the link earns its byte budget every tick and is charged with the
+///    actual size of every frame sent, periodic or not (Stream_Charge).
+///  Streams are served in priority order. A due stream whose expected size
+///  exceeds link credit is delayed and lower priority streams wait too, so
+///  when the ground station asks for more than the link can carry, the
+///  lowest priority streams slow down first while the others keep their rate.
+///  A sender may send several frames while Stream_Credit allows, e.g. a bulk
+///  transfer of the parameter list: it then uses the link for as long as it
+///  runs, at the expense of the streams following it.
+///  Achieved rates and link load of last second are kept for reporting.
+///  Doesn't depend on any peripheral, so it can be tested on host.
+///
+//  Change
+//
+//============================================================================*/
+
+#include "stm32f10x.h"
+#include "stream.h"
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifndef VAR_STATIC
+#define VAR_STATIC static
+#endif
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC xStream * px_Streams = 0;        //!< streams, by decreasing priority
+VAR_STATIC uint8_t uc_Number = 0;           //!< number of streams
+VAR_STATIC uint16_t ui_Budget = 0;          //!< link budget per tick [bytes]
+VAR_STATIC int16_t i_Credit = 0;            //!< link credit [bytes], negative if overdrawn
+VAR_STATIC uint8_t uc_Tick = 0;             //!< ticks in current second
+VAR_STATIC uint32_t ul_Bytes = 0;           //!< bytes sent in current second
+VAR_STATIC uint16_t ui_Load = 0;            //!< link load of last second [0.1 %]
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   initializes scheduler
+/// \param   pxStreams = pointer to streams, by decreasing priority
+/// \param   ucNumber = number of streams
+/// \param   uiBudget = link budget per tick [bytes]
+/// \return  -
+/// \remarks rates and senders must be set by caller
+///
+///----------------------------------------------------------------------------
+void Stream_Init(xStream * pxStreams, uint8_t ucNumber, uint16_t uiBudget)
+{
+    uint8_t j;
+
+    px_Streams = pxStreams;
+    uc_Number = ucNumber;
+    ui_Budget = uiBudget;
+    i_Credit = (int16_t)uiBudget;
+    uc_Tick = 0;
+    ul_Bytes = 0;
+    ui_Load = 0;
+    for (j = 0; j < ucNumber; j++) {
+        pxStreams[j].ucTokens = 0;
+        pxStreams[j].ucCount = 0;
+        pxStreams[j].ucAchieved = 0;
+        pxStreams[j].ucDelayed = 0;
+        pxStreams[j].ucLate = 0;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends due streams
+/// \return  -
+/// \remarks call at STREAM_TICK_HZ
+///
+///----------------------------------------------------------------------------
+void Stream_Run(void)
+{
+    xStream * px_stream;
+    uint8_t j, rate;
+    bool b_delayed = FALSE;
+
+    i_Credit += (int16_t)ui_Budget;                         // link bucket
+    if (i_Credit > (int16_t)(ui_Budget * STREAM_BURST)) {
+        i_Credit = (int16_t)(ui_Budget * STREAM_BURST);
+    }
+
+    for (j = 0; j < uc_Number; j++) {
+        px_stream = &px_Streams[j];
+        rate = px_stream->ucRate;
+        if (rate == 0) {                                    // stream is off
+            px_stream->ucTokens = 0;
+            continue;
+        }
+        if (rate > STREAM_TICK_HZ) {
+            rate = STREAM_TICK_HZ;
+        }
+        if (px_stream->ucTokens < 2 * STREAM_TICK_HZ) {     // stream bucket
+            px_stream->ucTokens += rate;
+        }
+        if (px_stream->ucTokens < STREAM_TICK_HZ) {         // not due
+            continue;
+        }
+        if (b_delayed || (i_Credit < (int16_t)px_stream->ucSize)) {
+            b_delayed = TRUE;                               // lower priorities wait too
+            if (px_stream->ucDelayed < 255) {
+                px_stream->ucDelayed++;
+            }
+        } else {
+            px_stream->ucTokens -= STREAM_TICK_HZ;
+            px_stream->ucCount++;
+            px_stream->pvSend();                            // charges link
+        }
+    }
+
+    if (++uc_Tick >= STREAM_TICK_HZ) {                      // one second elapsed
+        uc_Tick = 0;
+        for (j = 0; j < uc_Number; j++) {
+            px_Streams[j].ucAchieved = px_Streams[j].ucCount;
+            px_Streams[j].ucLate = px_Streams[j].ucDelayed;
+            px_Streams[j].ucCount = 0;
+            px_Streams[j].ucDelayed = 0;
+        }
+        ui_Load = (uint16_t)((ul_Bytes * 1000) / ((uint32_t)ui_Budget * STREAM_TICK_HZ));
+        ul_Bytes = 0;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   charges link with a frame
+/// \param   uiBytes = frame size on wire
+/// \return  -
+/// \remarks called for every frame sent, periodic or not
+///
+///----------------------------------------------------------------------------
+void Stream_Charge(uint16_t uiBytes)
+{
+    i_Credit -= (int16_t)uiBytes;
+    if (i_Credit < -(int16_t)(ui_Budget * STREAM_BURST)) {  // don't starve for long
+        i_Credit = -(int16_t)(ui_Budget * STREAM_BURST);
+    }
+    ul_Bytes += uiBytes;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   link credit
+/// \return  bytes that can be sent in current tick, negative if overdrawn
+/// \remarks used by senders of several frames per tick
+///
+///----------------------------------------------------------------------------
+int16_t Stream_Credit(void)
+{
+    return i_Credit;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   link load
+/// \return  bytes sent in last second relative to budget [0.1 %]
+/// \remarks may exceed 1000 when replies overdraw the budget
+///
+///----------------------------------------------------------------------------
+uint16_t Stream_Load(void)
+{
+    return ui_Load;
+}
@@ -0,0 +1,54 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief telemetry stream scheduler header file
+///
+/// \file
+///
+//  Change
+//
+//============================================================================*/
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL extern
+
+#define STREAM_TICK_HZ      50          //!< scheduler frequency, max stream rate
+#define STREAM_BURST        2           //!< link credit kept, in ticks of budget
+
+/*----------------------------------- Macros ---------------------------------*/
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// periodic message, streams are given in decreasing priority
+typedef struct {
+    void (*pvSend)(void);               ///< sends one message
+    uint8_t ucSize;                     ///< expected frame size on wire [bytes]
+    uint8_t ucRate;                     ///< requested rate [Hz], 0 = off
+    uint8_t ucTokens;                   ///< rate credit, message is due at STREAM_TICK_HZ
+    uint8_t ucCount;                    ///< messages sent in current second
+    uint8_t ucAchieved;                 ///< messages sent in last second
+    uint8_t ucDelayed;                  ///< ticks delayed by link budget in current second
+    uint8_t ucLate;                     ///< ticks delayed by link budget in last second
+} xStream;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*----------------------------------- Globals --------------------------------*/
+
+/*---------------------------------- Interface -------------------------------*/
+
+void Stream_Init(xStream * pxStreams, uint8_t ucNumber, uint16_t uiBudget);
+void Stream_Run(void);
+void Stream_Charge(uint16_t uiBytes);
+int16_t Stream_Credit(void);
+uint16_t Stream_Load(void);
@@ -8,6 +8,18 @@
 /// \brief usart 1 driver
 ///
 /// \file
+///  Transmission is made by DMA1 channel 4 from a ring buffer: senders write
+///  into the ring and return at once, USART1_Transmit only starts the DMA if
+///  it's idle. Transfer complete interrupt starts next block, if any.
+///  A message that doesn't fit into the ring is dropped as a whole and
+///  counted (see USART1_Tx_Dropped). Messages can also be built directly in
+///  the ring between USART1_Tx_Reserve and USART1_Tx_Commit.
+///  Reception is made by DMA1 channel 5 into a circular buffer, without any
+///  interrupt per character. DMA half and full transfer interrupts and the
+///  USART idle line interrupt update the count of received bytes, so a
+///  reader lapped by DMA is detected (see USART1_Rx_Overruns) and resumes
+///  from newest data. Idle line also wakes tasks waiting with USART1_Rx_Wait.
+///  USART framing and noise errors are counted (see USART1_Rx_Errors).
 ///
 /// Change (Lint) modified file #inclusion, removed #undef and VAR_GLOBAL, 
 //
@@ -16,7 +28,11 @@
 // ---- Include Files -------------------------------------------------------
 
 #include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 #include "stm32f10x_usart.h"
+#include "stm32f10x_dma.h"
+#include "ring.h"
 #include "usart1driver.h"
 
 /*--------------------------------- Definitions ------------------------------*/
@@ -25,8 +41,8 @@
 #define   VAR_STATIC static
 #endif
 
-#define RX_BUFFER_LENGTH    48  //!< length of receive buffer
-#define TX_BUFFER_LENGTH    48  //!< length of transmit buffer
+#define RX_BUFFER_LENGTH    256 //!< length of receive buffer, about 44 ms @ 57600 baud
+#define TX_BUFFER_LENGTH    256 //!< length of transmit buffer, about 5 MAVLink frames
 
 /*----------------------------------- Macros ---------------------------------*/
 
@@ -40,15 +56,22 @@
 
 /*----------------------------------- Locals ---------------------------------*/
 
-VAR_STATIC uint8_t ucRxWindex;                      //!< uplink write index
-VAR_STATIC uint8_t ucRxRindex;                      //!< uplink read index
-VAR_STATIC uint8_t ucTxWindex;                      //!< downlink write index
-VAR_STATIC uint8_t ucTxRindex;                      //!< downlink read index
+VAR_STATIC uint16_t uiRxRindex;                     //!< uplink read index
+VAR_STATIC uint16_t uiRxPosition;                   //!< DMA write index at last update
+VAR_STATIC volatile uint32_t ulRxReceived;          //!< bytes written by DMA
+VAR_STATIC uint32_t ulRxRead;                       //!< bytes read
+VAR_STATIC uint16_t uiRxOverruns;                   //!< times reader was lapped by DMA
+VAR_STATIC uint16_t uiRxErrors;                     //!< framing, noise and USART overrun errors
 VAR_STATIC uint8_t ucRxBuffer[RX_BUFFER_LENGTH];    //!< uplink data buffer
+VAR_STATIC xSemaphoreHandle xRxIdle = NULL;         //!< given at end of each uplink burst
 VAR_STATIC uint8_t ucTxBuffer[TX_BUFFER_LENGTH];    //!< downlink data buffer
+VAR_STATIC xRing xTxRing;                           //!< downlink ring
 
 /*--------------------------------- Prototypes -------------------------------*/
 
+static void USART1_Start( void );
+static void USART1_Rx_Update( void );
+
 /*---------------------------------- Functions -------------------------------*/
 
 //----------------------------------------------------------------------------
@@ -63,10 +86,21 @@ VAR_STATIC uint8_t ucTxBuffer[TX_BUFFER_LENGTH];    //!< downlink data buffer
 void USART1_Init( void ) {
 
     USART_InitTypeDef USART_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
     NVIC_InitTypeDef NVIC_InitStructure;
 
+    uiRxRindex = 0;                                 // clear uplink read index
+    uiRxPosition = 0;
+    ulRxReceived = 0;
+    ulRxRead = 0;
+    uiRxOverruns = 0;
+    uiRxErrors = 0;
+    vSemaphoreCreateBinary(xRxIdle);                // created given
+    (void)xSemaphoreTake(xRxIdle, 0);               // wait next burst
+    Ring_Init(&xTxRing, ucTxBuffer, TX_BUFFER_LENGTH); // clear downlink ring
+
     // Initialize USART1 structure
-    USART_InitStructure.USART_BaudRate = 57600;
+    USART_InitStructure.USART_BaudRate = USART1_BAUDRATE;
     USART_InitStructure.USART_WordLength = USART_WordLength_8b;
     USART_InitStructure.USART_StopBits = USART_StopBits_1;
     USART_InitStructure.USART_Parity = USART_Parity_No;
@@ -75,8 +109,8 @@ void USART1_Init( void ) {
 
     USART_Init(USART1, &USART_InitStructure);       // configure USART1
 
-    USART_ITConfig(USART1, USART_IT_RXNE, ENABLE);  // enable USART1 interrupt
-    //USART_ITConfig(USART1, USART_IT_TXE, ENABLE);
+    USART_ITConfig(USART1, USART_IT_IDLE, ENABLE);  // end of uplink burst
+    USART_ITConfig(USART1, USART_IT_ERR, ENABLE);   // framing, noise, overrun with DMA
 
     // Configure NVIC for USART1 interrupt
     NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
@@ -85,12 +119,134 @@ void USART1_Init( void ) {
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init( &NVIC_InitStructure );
 
+    // Initialize DMA1 channel 4, triggered by USART1 TX
+    DMA_DeInit(DMA1_Channel4);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART1->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ucTxBuffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 1;          // set by each transfer
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(DMA1_Channel4, &DMA_InitStructure);
+    DMA_ITConfig(DMA1_Channel4, DMA_IT_TC, ENABLE); // interrupt at end of block
+
+    // Configure NVIC for DMA1 channel 4 interrupt
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel4_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = configLIBRARY_KERNEL_INTERRUPT_PRIORITY;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init( &NVIC_InitStructure );
+
+    // Initialize DMA1 channel 5, triggered by USART1 RX, never stops
+    DMA_DeInit(DMA1_Channel5);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART1->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ucRxBuffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = RX_BUFFER_LENGTH;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(DMA1_Channel5, &DMA_InitStructure);
+    DMA_ITConfig(DMA1_Channel5, DMA_IT_HT | DMA_IT_TC, ENABLE); // twice per lap
+
+    // Configure NVIC for DMA1 channel 5 interrupt
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel5_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = configLIBRARY_KERNEL_INTERRUPT_PRIORITY;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init( &NVIC_InitStructure );
+    DMA_Cmd(DMA1_Channel5, ENABLE);
+
+    USART_DMACmd(USART1, USART_DMAReq_Tx | USART_DMAReq_Rx, ENABLE); // USART1 requests DMA
     USART_Cmd(USART1, ENABLE);                      // enable the USART1
+}
 
-    ucRxWindex = 0;                                 // clear uplink write index
-    ucRxRindex = 0;                                 // clear uplink read index
-    ucTxWindex = 0;                                 // clear downlink write index
-    ucTxRindex = 0;                                 // clear downlink read index
+//----------------------------------------------------------------------------
+//
+/// \brief   Start transfer of next block
+/// \param   -
+/// \returns -
+/// \remarks called by DMA interrupt or within a critical section
+///
+//----------------------------------------------------------------------------
+static void USART1_Start( void ) {
+
+    uint8_t * pucBlock;
+    uint16_t uiLength;
+
+    uiLength = Ring_Block_Start(&xTxRing, &pucBlock);
+    if (uiLength != 0) {                            // DMA idle and data waiting
+        DMA1_Channel4->CMAR = (uint32_t)pucBlock;
+        DMA1_Channel4->CNDTR = uiLength;
+        DMA_Cmd(DMA1_Channel4, ENABLE);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   DMA1 channel 4 interrupt handler
+/// \param   -
+/// \returns -
+/// \remarks block transferred, release space and start next block
+///
+//----------------------------------------------------------------------------
+void DMA1_Channel4_IRQHandler( void ) {
+
+    if (DMA_GetITStatus(DMA1_IT_TC4)) {             // transfer complete
+        DMA_ClearITPendingBit(DMA1_IT_GL4);
+        DMA_Cmd(DMA1_Channel4, DISABLE);
+        Ring_Block_End(&xTxRing, DMA_GetCurrDataCounter(DMA1_Channel4));
+        USART1_Start();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Update count of received bytes
+/// \param   -
+/// \returns -
+/// \remarks called by interrupts or within a critical section. Called at
+///          least twice per lap of DMA, so a difference of positions is
+///          never ambiguous.
+///
+//----------------------------------------------------------------------------
+static void USART1_Rx_Update( void ) {
+
+    uint16_t uiPosition;
+
+    uiPosition = RX_BUFFER_LENGTH - DMA_GetCurrDataCounter(DMA1_Channel5);
+    if (uiPosition >= RX_BUFFER_LENGTH) {           // counter just reloaded
+        uiPosition = 0;
+    }
+    if (uiPosition >= uiRxPosition) {
+        ulRxReceived += uiPosition - uiRxPosition;
+    } else {                                        // DMA wrapped
+        ulRxReceived += RX_BUFFER_LENGTH - uiRxPosition + uiPosition;
+    }
+    uiRxPosition = uiPosition;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   DMA1 channel 5 interrupt handler
+/// \param   -
+/// \returns -
+/// \remarks half or whole buffer received
+///
+//----------------------------------------------------------------------------
+void DMA1_Channel5_IRQHandler( void ) {
+
+    DMA_ClearITPendingBit(DMA1_IT_GL5);
+    USART1_Rx_Update();
 }
 
 //----------------------------------------------------------------------------
@@ -98,114 +254,190 @@ void USART1_Init( void ) {
 /// \brief   USART 1 interrupt handler
 /// \param   -
 /// \returns -
-/// \remarks -
+/// \remarks idle line after a burst, or reception error. Flags are cleared by
+///          reading SR then DR: DMA has already read data when idle line is
+///          detected, with an error the character is discarded anyway.
 ///
 //----------------------------------------------------------------------------
 void USART1_IRQHandler( void ) {
-//  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
-//  portCHAR cChar;
-
-    if (((USART1->CR1 & 0x00000020) != 0) &&
-        (USART1->SR & 0x00000020) != 0) {               // USART_IT_RXNE == SET
-//		xQueueSendFromISR( xRxedChars, &cChar, &xHigherPriorityTaskWoken );
-		ucRxBuffer[ucRxWindex++] = (uint8_t)USART1->DR;
-        if (ucRxWindex >= RX_BUFFER_LENGTH) {
-            ucRxWindex = 0;
+
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    uint16_t uiStatus;
+
+    uiStatus = USART1->SR;
+    if ((uiStatus & (USART_FLAG_IDLE | USART_FLAG_ORE | USART_FLAG_NE | USART_FLAG_FE)) != 0) {
+        if ((uiStatus & (USART_FLAG_ORE | USART_FLAG_NE | USART_FLAG_FE)) != 0) {
+            uiRxErrors++;
+        }
+        (void)USART1->DR;                           // clear flags
+        USART1_Rx_Update();
+        if ((uiStatus & USART_FLAG_IDLE) != 0) {    // end of burst
+            (void)xSemaphoreGiveFromISR(xRxIdle, &xHigherPriorityTaskWoken);
         }
     }
-//	portEND_SWITCHING_ISR( xHigherPriorityTaskWoken );
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
 }
 
-
 //----------------------------------------------------------------------------
 //
 /// \brief   Get character from USART 1 buffer
 /// \param   c = pointer to destination character
 /// \returns TRUE if receive buffer wasn't empty
-/// \remarks -
+/// \remarks if DMA has overwritten unread data, they're discarded and
+///          reading resumes with next character
 ///
 //----------------------------------------------------------------------------
 bool USART1_Getch(uint8_t * c) {
 
-    if (ucRxRindex != ucRxWindex) {           // received another character
-        *c = ucRxBuffer[ucRxRindex++];        // read character
-        if (ucRxRindex >= RX_BUFFER_LENGTH) { // update read index
-            ucRxRindex = 0;
-        }
-        return TRUE;
-    } else {
+    uint32_t ulWaiting;
+
+    if (ulRxRead == ulRxReceived) {                 // nothing left since last update
+        taskENTER_CRITICAL();
+        USART1_Rx_Update();
+        taskEXIT_CRITICAL();
+    }
+    ulWaiting = ulRxReceived - ulRxRead;
+    if (ulWaiting == 0) {
+        return FALSE;
+    }
+    if (ulWaiting > RX_BUFFER_LENGTH) {             // lapped by DMA
+        uiRxOverruns++;
+        taskENTER_CRITICAL();                       // resume from newest data
+        ulRxRead = ulRxReceived;
+        uiRxRindex = uiRxPosition;
+        taskEXIT_CRITICAL();
         return FALSE;
     }
+    *c = ucRxBuffer[uiRxRindex++];                  // read character
+    if (uiRxRindex >= RX_BUFFER_LENGTH) {           // update read index
+        uiRxRindex = 0;
+    }
+    ulRxRead++;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Put a character into USART 1 buffer
-/// \param   c = character
-/// \returns
+/// \brief   Wait for end of an uplink burst
+/// \param   ulTicks = max waiting time, in ticks
+/// \returns TRUE if idle line has been detected, FALSE on timeout
 /// \remarks -
 ///
 //----------------------------------------------------------------------------
-void USART1_Putch(uint8_t c) {
+bool USART1_Rx_Wait(uint32_t ulTicks) {
 
-    ucTxBuffer[ucTxWindex++] = c;           // store character
-    if (ucTxWindex >= TX_BUFFER_LENGTH) {   // update write index
-        ucTxWindex = 0;
-    }
+    return (xSemaphoreTake(xRxIdle, (portTickType)ulTicks) == pdTRUE) ? TRUE : FALSE;
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Put a word into USART 1 buffer
-/// \param   w = word
-/// \returns
+/// \brief   Number of receive overruns
+/// \param   -
+/// \returns times unread data have been overwritten by DMA
 /// \remarks -
 ///
 //----------------------------------------------------------------------------
-void USART1_Putw(uint16_t w) {
+uint16_t USART1_Rx_Overruns( void ) {
 
-    uint8_t ucTemp;
-
-    ucTemp = (uint8_t)(w & 0x00FF);         // get LSB
-    USART1_Putch(ucTemp);                   // store LSB
-    ucTemp = (uint8_t)((w >> 8) & 0x00FF);  // get MSB
-    USART1_Putch(ucTemp);                   // store MSB
+    return uiRxOverruns;
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief   Put a float number into USART 1 buffer
-/// \param   f = float number
-/// \returns
+/// \brief   Number of receive errors
+/// \param   -
+/// \returns framing, noise and USART overrun errors
 /// \remarks -
 ///
 //----------------------------------------------------------------------------
-void USART1_Putf(float f) {
+uint16_t USART1_Rx_Errors( void ) {
 
-    uint8_t * pucTemp = (uint8_t *)&f;
+    return uiRxErrors;
+}
 
-    USART1_Putch(*pucTemp++);   // store byte 1
-    USART1_Putch(*pucTemp++);   // store byte 2
-    USART1_Putch(*pucTemp++);   // store byte 3
-    USART1_Putch(*pucTemp);     // store byte 4
+//----------------------------------------------------------------------------
+//
+/// \brief   Put a message into USART 1 buffer and start transmission
+/// \param   pucData = pointer to message
+/// \param   uiLength = message length
+/// \returns TRUE if message has been queued, FALSE if buffer was full
+/// \remarks message is never truncated, it's dropped as a whole
+///
+//----------------------------------------------------------------------------
+bool USART1_Write(const uint8_t * pucData, uint16_t uiLength) {
+
+    bool bResult;
+
+    bResult = Ring_Write(&xTxRing, pucData, uiLength);
+    USART1_Transmit();
+    return bResult;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Reserve space for a message built in USART 1 buffer
+/// \param   uiLength = message length
+/// \returns pointer to transmit ring, NULL if buffer is full
+/// \remarks message is written with Ring_Put, then sent by USART1_Tx_Commit.
+///          Message is dropped as a whole if it doesn't fit.
+///
+//----------------------------------------------------------------------------
+xRing * USART1_Tx_Reserve(uint16_t uiLength) {
+
+    return Ring_Reserve(&xTxRing, uiLength) ? &xTxRing : NULL;
 }
 
 //----------------------------------------------------------------------------
 //
-/// \brief
-/// \param
-/// \returns
+/// \brief   Send a message built in USART 1 buffer
+/// \param   -
+/// \returns -
+/// \remarks publishes all bytes written since USART1_Tx_Reserve
+///
+//----------------------------------------------------------------------------
+void USART1_Tx_Commit( void ) {
+
+    Ring_Commit(&xTxRing);
+    USART1_Transmit();
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Free space in USART 1 transmit buffer
+/// \param   -
+/// \returns number of bytes that can be queued
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+uint16_t USART1_Tx_Free( void ) {
+
+    return Ring_Free(&xTxRing);
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Number of messages dropped
+/// \param   -
+/// \returns number of writes rejected because transmit buffer was full
 /// \remarks -
 ///
 //----------------------------------------------------------------------------
+uint16_t USART1_Tx_Dropped( void ) {
+
+    return xTxRing.uiDropped;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Start transmission of USART 1 buffer
+/// \param   -
+/// \returns -
+/// \remarks doesn't wait, starts DMA if it's idle
+///
+//----------------------------------------------------------------------------
 void USART1_Transmit( void ) {
 
-    while (ucTxRindex != ucTxWindex) {
-        while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {
-        }
-        USART_SendData(USART1, ucTxBuffer[ucTxRindex++]);
-        if (ucTxRindex >= RX_BUFFER_LENGTH) {
-            ucTxRindex = 0;
-        }
-    }
+    taskENTER_CRITICAL();                   // DMA interrupt may start a block
+    USART1_Start();
+    taskEXIT_CRITICAL();
 }
@@ -29,6 +29,7 @@
 #endif
 #define   VAR_GLOBAL
 
+#define USART1_BAUDRATE     57600   //!< telemetry link speed
 
 /*----------------------------------- Macros ---------------------------------*/
 
@@ -44,7 +45,12 @@
 
 void USART1_Init(void);            // Initialize USART1
 bool USART1_Getch(uint8_t * c);    // Get character from USART 1 buffer
-void USART1_Putch(uint8_t c);      // Put a character into USART 1 buffer
-void USART1_Putw(uint16_t w);      // Put a word into USART 1 buffer
-void USART1_Putf(float f);         // Put a float number into USART 1 buffer
-void USART1_Transmit( void );      // 
+bool USART1_Write(const uint8_t * pucData, uint16_t uiLength); // Put a message and transmit
+xRing * USART1_Tx_Reserve(uint16_t uiLength); // Reserve space for a message built in place
+void USART1_Tx_Commit( void );     // Send a message built in place
+uint16_t USART1_Tx_Free( void );   // Free space in USART 1 transmit buffer
+uint16_t USART1_Tx_Dropped( void ); // Number of messages dropped
+void USART1_Transmit( void );      // Start transmission of USART 1 buffer
+bool USART1_Rx_Wait(uint32_t ulTicks); // Wait for end of an uplink burst
+uint16_t USART1_Rx_Overruns( void ); // Number of receive overruns
+uint16_t USART1_Rx_Errors( void ); // Number of receive errors
@@ -0,0 +1,408 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of black box encoder: lossless round trip, resynchronization,
+///  double buffering, drop count and compression ratio on a synthetic flight.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_blackbox.c ../../Source/blackbox.c -lm
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "stm32f10x.h"
+
+#include "blackbox.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup blackbox
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define CHANNELS        18          //!< 6 sensors, 9 DCM, 3 servos
+#define RECORDS         (50 * 600)  //!< 10 minutes at 50 Hz
+#define STREAM_SIZE     (RECORDS * BBOX_MAX_RECORD)
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;
+VAR_STATIC int16_t i_Data[RECORDS][CHANNELS];
+VAR_STATIC uint8_t uc_Stream[STREAM_SIZE];
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static int16_t noise(int16_t amplitude);
+static void make_flight(void);
+static uint32_t encode_all(uint8_t * pucOut);
+static void test_round_trip(void);
+static void test_extremes(void);
+static void test_resync(void);
+static void test_buffers(void);
+
+/*--------------------------------- Functions --------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   uniform noise
+/// \param   amplitude = max absolute value
+/// \return  noise sample
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int16_t noise(int16_t amplitude)
+{
+    return (int16_t)((rand() % (2 * amplitude + 1)) - amplitude);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   synthetic flight: slow turns and pitch changes
+/// \return  -
+/// \remarks sensors are raw ADC counts with noise, DCM is scaled by 16384,
+///          servos are pulse widths in microseconds
+///
+///----------------------------------------------------------------------------
+static void make_flight(void)
+{
+    int32_t j;
+    float t, roll, pitch, yaw = 0.0f;
+    float cr, sr, cp, sp, cy, sy;
+
+    srand(1);
+    for (j = 0; j < RECORDS; j++) {
+        t = (float)j / 50.0f;
+        roll = 0.5f * sinf(0.1f * t);
+        pitch = 0.1f * sinf(0.05f * t);
+        yaw += 0.02f * roll;
+        cr = cosf(roll);  sr = sinf(roll);
+        cp = cosf(pitch); sp = sinf(pitch);
+        cy = cosf(yaw);   sy = sinf(yaw);
+
+        i_Data[j][0] = (int16_t)(64.0f * sp) + noise(3);            // accel x
+        i_Data[j][1] = (int16_t)(-64.0f * cp * sr) + noise(3);      // accel y
+        i_Data[j][2] = (int16_t)(64.0f * cp * cr) + noise(3);       // accel z
+        i_Data[j][3] = (int16_t)(40.0f * cosf(0.1f * t)) + noise(2);// roll rate
+        i_Data[j][4] = (int16_t)(10.0f * cosf(0.05f * t)) + noise(2);// pitch rate
+        i_Data[j][5] = (int16_t)(800.0f * roll) + noise(2);         // yaw rate
+
+        i_Data[j][6]  = (int16_t)(16384.0f * cp * cy);
+        i_Data[j][7]  = (int16_t)(16384.0f * (sr * sp * cy - cr * sy));
+        i_Data[j][8]  = (int16_t)(16384.0f * (cr * sp * cy + sr * sy));
+        i_Data[j][9]  = (int16_t)(16384.0f * cp * sy);
+        i_Data[j][10] = (int16_t)(16384.0f * (sr * sp * sy + cr * cy));
+        i_Data[j][11] = (int16_t)(16384.0f * (cr * sp * sy - sr * cy));
+        i_Data[j][12] = (int16_t)(-16384.0f * sp);
+        i_Data[j][13] = (int16_t)(16384.0f * sr * cp);
+        i_Data[j][14] = (int16_t)(16384.0f * cr * cp);
+
+        i_Data[j][15] = 1500 + (int16_t)(300.0f * roll) + noise(1); // aileron
+        i_Data[j][16] = 1500 + (int16_t)(500.0f * pitch) + noise(1);// elevator
+        i_Data[j][17] = 1700;                                       // throttle
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   encodes whole flight
+/// \param   pucOut = destination stream
+/// \return  stream length
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint32_t encode_all(uint8_t * pucOut)
+{
+    xBBox_Codec x_enc;
+    uint32_t j, ul_length = 0;
+
+    Blackbox_Codec_Init(&x_enc, CHANNELS);
+    for (j = 0; j < RECORDS; j++) {
+        ul_length += Blackbox_Encode(&x_enc, i_Data[j], &pucOut[ul_length]);
+    }
+    return ul_length;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   lossless round trip and compression ratio
+/// \return  -
+/// \remarks compares with raw 16 bit binary and with ASCII format of log.c
+///
+///----------------------------------------------------------------------------
+static void test_round_trip(void)
+{
+    xBBox_Codec x_dec;
+    int16_t i_out[CHANNELS];
+    uint32_t j, ul_length, ul_pos = 0;
+    uint8_t k, uc_num;
+    float f_binary, f_ascii;
+
+    make_flight();
+    ul_length = encode_all(uc_Stream);
+
+    Blackbox_Codec_Init(&x_dec, 0);
+    for (j = 0; (j < RECORDS) && (ul_pos < ul_length); j++) {
+        uc_num = Blackbox_Decode(&x_dec, &uc_Stream[ul_pos], i_out);
+        CHECK(uc_num != 0);
+        if (uc_num == 0) {
+            return;
+        }
+        ul_pos += uc_num;
+        CHECK(x_dec.ucChannels == CHANNELS);
+        CHECK(x_dec.ulCount == j + 1);
+        for (k = 0; k < CHANNELS; k++) {
+            if (i_out[k] != i_Data[j][k]) {
+                CHECK(i_out[k] == i_Data[j][k]);
+                return;
+            }
+        }
+    }
+    CHECK(j == RECORDS);
+    CHECK(ul_pos == ul_length);
+
+    f_binary = (float)(RECORDS * CHANNELS * 2) / (float)ul_length;
+    f_ascii = (float)(RECORDS * (CHANNELS * 9 + 1)) / (float)ul_length;
+    printf("records %d, encoded %u bytes, %.1f bytes/record\n",
+           RECORDS, (unsigned)ul_length, (float)ul_length / RECORDS);
+    printf("ratio vs 16 bit binary %.2f, vs ASCII log %.2f\n", f_binary, f_ascii);
+    CHECK(f_ascii >= 3.0f);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   full scale steps between records
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void test_extremes(void)
+{
+    xBBox_Codec x_enc, x_dec;
+    int16_t i_in[4][3] = {{ 32767, -32768, 0 },
+                          { -32768, 32767, -1 },
+                          { 32767, -32768, 1 },
+                          { 0, 0, 0 }};
+    int16_t i_out[3];
+    uint8_t uc_buf[BBOX_MAX_RECORD];
+    uint8_t j, uc_len;
+
+    Blackbox_Codec_Init(&x_enc, 3);
+    Blackbox_Codec_Init(&x_dec, 0);
+    for (j = 0; j < 4; j++) {
+        uc_len = Blackbox_Encode(&x_enc, i_in[j], uc_buf);
+        CHECK(uc_len <= BBOX_MAX_RECORD);
+        CHECK(Blackbox_Decode(&x_dec, uc_buf, i_out) == uc_len);
+        CHECK((i_out[0] == i_in[j][0]) && (i_out[1] == i_in[j][1]) && (i_out[2] == i_in[j][2]));
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   decoder waits for a key frame after data loss
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void test_resync(void)
+{
+    xBBox_Codec x_dec;
+    int16_t i_out[CHANNELS];
+    uint32_t j, ul_length, ul_pos;
+    uint8_t k, uc_num;
+
+    ul_length = encode_all(uc_Stream);
+    ul_pos = ul_length / 3;                     // start in the middle of stream
+
+    Blackbox_Codec_Init(&x_dec, 0);
+    while ((ul_pos < ul_length) && (uc_Stream[ul_pos] != BBOX_KEY_FRAME)) {
+        CHECK(Blackbox_Decode(&x_dec, &uc_Stream[ul_pos], i_out) == 0);
+        ul_pos++;
+    }
+    for (j = 0; (j < 2 * BBOX_KEY_PERIOD) && (ul_pos < ul_length); j++) {
+        uc_num = Blackbox_Decode(&x_dec, &uc_Stream[ul_pos], i_out);
+        CHECK(uc_num != 0);
+        if (uc_num == 0) {
+            return;
+        }
+        ul_pos += uc_num;
+        for (k = 0; k < CHANNELS; k++) {
+            CHECK(i_out[k] == i_Data[x_dec.ulCount - 1][k]);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   double buffering and dropped records
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void test_buffers(void)
+{
+    xBBox_Codec x_dec;
+    int16_t i_out[CHANNELS];
+    uint8_t * p_buf;
+    uint16_t ui_len;
+    uint32_t j, ul_pos, ul_length = 0, ul_count = 0;
+    uint8_t uc_num;
+
+    Blackbox_Init(CHANNELS);
+    CHECK(Blackbox_Get_Buffer(&ui_len) == 0);
+
+    for (j = 0; j < 1000; j++) {
+        Blackbox_Record(i_Data[j]);
+        if ((j % 50) == 0) {                        // log task is late
+            continue;
+        }
+        p_buf = Blackbox_Get_Buffer(&ui_len);
+        if (p_buf != 0) {
+            CHECK(ui_len <= BBOX_BUFFER_SIZE);
+            memcpy(&uc_Stream[ul_length], p_buf, ui_len);
+            ul_length += ui_len;
+            Blackbox_Release_Buffer();
+        }
+    }
+    CHECK(Blackbox_Dropped() == 0);
+
+    for (j = 0; j < 1000; j++) {                    // log task stalls
+        Blackbox_Record(i_Data[j]);
+    }
+    CHECK(Blackbox_Dropped() != 0);
+
+    Blackbox_Codec_Init(&x_dec, 0);
+    for (ul_pos = 0; ul_pos < ul_length; ul_pos += uc_num) {
+        uc_num = Blackbox_Decode(&x_dec, &uc_Stream[ul_pos], i_out);
+        CHECK(uc_num != 0);
+        if (uc_num == 0) {
+            return;
+        }
+        CHECK(i_out[0] == i_Data[x_dec.ulCount - 1][0]);
+        ul_count++;
+    }
+    CHECK(ul_count > 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   drop count written between buffers, as log task does
+/// \return  -
+/// \remarks decoder skips drop counts, records plus drops give the counter
+///
+///----------------------------------------------------------------------------
+static void test_dropped(void)
+{
+    xBBox_Codec x_dec;
+    int16_t i_out[CHANNELS];
+    uint8_t uc_buf[BBOX_MAX_DROP];
+    uint8_t * p_buf;
+    uint16_t ui_len, ui_dropped = 0xFFFF;
+    uint32_t j, ul_pos, ul_length = 0, ul_count = 0;
+    uint8_t uc_num;
+
+    uc_num = Blackbox_Encode_Dropped(0xFFFF, uc_buf);
+    CHECK(uc_num == BBOX_MAX_DROP);
+    CHECK(Blackbox_Decode_Dropped(uc_buf, &ui_dropped) == uc_num);
+    CHECK(ui_dropped == 0xFFFF);
+    Blackbox_Codec_Init(&x_dec, 0);
+    CHECK(Blackbox_Decode(&x_dec, uc_buf, i_out) == 0);       // not a record
+
+    Blackbox_Init(CHANNELS);
+    for (j = 0; j < 300; j++) {                     // log task stalls
+        Blackbox_Record(i_Data[j]);
+    }
+    for (j = 300; j < 600; j++) {                   // then catches up
+        Blackbox_Record(i_Data[j]);
+        while ((p_buf = Blackbox_Get_Buffer(&ui_len)) != 0) {
+            memcpy(&uc_Stream[ul_length], p_buf, ui_len);
+            ul_length += ui_len;
+            ul_length += Blackbox_Encode_Dropped(Blackbox_Dropped(), &uc_Stream[ul_length]);
+            Blackbox_Release_Buffer();
+        }
+    }
+    CHECK(Blackbox_Dropped() != 0);
+
+    for (ul_pos = 0; ul_pos < ul_length; ul_pos += uc_num) {
+        uc_num = Blackbox_Decode_Dropped(&uc_Stream[ul_pos], &ui_dropped);
+        if (uc_num == 0) {
+            uc_num = Blackbox_Decode(&x_dec, &uc_Stream[ul_pos], i_out);
+            CHECK(uc_num != 0);
+            if (uc_num == 0) {
+                return;
+            }
+            CHECK(i_out[0] == i_Data[x_dec.ulCount - 1][0]);
+            ul_count++;
+        }
+    }
+    CHECK(ui_dropped == Blackbox_Dropped());
+    CHECK(ul_count + ui_dropped == x_dec.ulCount);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of failed checks
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    test_round_trip();
+    test_extremes();
+    test_resync();
+    test_buffers();
+    test_dropped();
+    printf("%s, %d errors\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
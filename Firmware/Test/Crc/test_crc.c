@@ -0,0 +1,237 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of X25 CRC: known answers (CRC catalogue check value and
+///  MAVLink frames captured from ground station, see Test/Mavlink), table
+///  against MAVLink crc_accumulate on random data, byte by byte against
+///  whole buffer, and a benchmark of both implementations.
+///  Build and run on PC:
+/// \code
+///   gcc -O2 -I../Host -I../../Source test_crc.c ../../Source/crc.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+
+#include "crc.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup crc
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define BENCH_LENGTH    4096        //!< bytes per benchmark buffer
+#define BENCH_LOOPS     4096        //!< benchmark iterations
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// known answer: MAVLink 1.0 frame and CRC extra of its message ID
+typedef struct {
+    const char * pcName;
+    uint8_t ucExtra;
+    uint8_t ucLength;
+    uint8_t ucFrame[16];
+} xKat;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// frames sent by ground station
+VAR_STATIC const xKat x_Kat[] = {
+    { "PARAM_REQUEST_LIST",  159, 10,
+      { 0xFE, 0x02, 0x08, 0xFF, 0x00, 0x15, 0x00, 0x00, 0xAD, 0x95 } },
+    { "REQUEST_DATA_STREAM", 148, 14,
+      { 0xFE, 0x06, 0x0C, 0xFF, 0x00, 0x42, 0x14, 0x00, 0x00, 0x00, 0x0A, 0x01, 0x8B, 0x56 } },
+    { "REQUEST_DATA_STREAM", 148, 14,
+      { 0xFE, 0x06, 0x04, 0xFF, 0x00, 0x42, 0x01, 0x00, 0x00, 0x00, 0x02, 0x01, 0x89, 0x69 } }
+};
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint8_t uc_Data[BENCH_LENGTH];           //!< random data
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   reference CRC
+/// \param   crc = CRC so far
+/// \param   data = byte
+/// \return  updated CRC
+/// \remarks crc_accumulate of mavlink\checksum.h, formerly used by firmware
+///
+///----------------------------------------------------------------------------
+static uint16_t Crc_Reference(uint16_t crc, uint8_t data)
+{
+    uint8_t tmp;
+
+    tmp = data ^ (uint8_t)(crc & 0xFF);
+    tmp ^= (tmp << 4);
+    return (crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   known answers
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Test_Known_Answers(void)
+{
+    const uint8_t * p_frame;
+    uint16_t crc;
+    uint8_t j;
+
+    crc = Crc_X25(CRC_X25_INIT, (const uint8_t *)"123456789", 9);
+    CHECK(crc == 0x6F91);                           // CRC-16/MCRF4XX check
+    CHECK(Crc_X25(CRC_X25_INIT, uc_Data, 0) == CRC_X25_INIT);
+
+    for (j = 0; j < sizeof(x_Kat) / sizeof(x_Kat[0]); j++) {
+        p_frame = x_Kat[j].ucFrame;
+        crc = Crc_X25(CRC_X25_INIT, &p_frame[1], x_Kat[j].ucLength - 3);
+        crc = Crc_X25_Byte(crc, x_Kat[j].ucExtra);
+        if ((crc & 0xFF) != p_frame[x_Kat[j].ucLength - 2] ||
+            (crc >> 8) != p_frame[x_Kat[j].ucLength - 1]) {
+            printf("FAIL %s: CRC %04X\n", x_Kat[j].pcName, crc);
+            i_Errors++;
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   table against reference
+/// \return  -
+/// \remarks every table entry, then random buffers of random length, both
+///          whole and split at a random position
+///
+///----------------------------------------------------------------------------
+static void Test_Reference(void)
+{
+    uint16_t j, k, length, split, crc, crc_ref, crc_split;
+
+    for (j = 0; j < 256; j++) {
+        CHECK(Crc_X25_Table[j] == Crc_Reference(0, (uint8_t)j));
+    }
+    for (j = 0; j < BENCH_LENGTH; j++) {
+        uc_Data[j] = (uint8_t)rand();
+    }
+    for (k = 0; k < 1000; k++) {
+        length = rand() % BENCH_LENGTH;
+        split = (length == 0) ? 0 : rand() % length;
+        crc_ref = CRC_X25_INIT;
+        for (j = 0; j < length; j++) {
+            crc_ref = Crc_Reference(crc_ref, uc_Data[j]);
+        }
+        crc = Crc_X25(CRC_X25_INIT, uc_Data, length);
+        crc_split = Crc_X25(CRC_X25_INIT, uc_Data, split);
+        crc_split = Crc_X25(crc_split, &uc_Data[split], length - split);
+        CHECK(crc == crc_ref);
+        CHECK(crc_split == crc_ref);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   benchmark
+/// \return  -
+/// \remarks host figures only show the ratio, on target measure with a timer
+///
+///----------------------------------------------------------------------------
+static void Test_Benchmark(void)
+{
+    volatile uint16_t crc_sink;
+    uint16_t j, k, crc;
+    clock_t start;
+    double t_ref, t_table;
+
+    start = clock();
+    for (k = 0; k < BENCH_LOOPS; k++) {
+        crc = CRC_X25_INIT;
+        for (j = 0; j < BENCH_LENGTH; j++) {
+            crc = Crc_Reference(crc, uc_Data[j]);
+        }
+        crc_sink = crc;
+    }
+    t_ref = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (k = 0; k < BENCH_LOOPS; k++) {
+        crc_sink = Crc_X25(CRC_X25_INIT, uc_Data, BENCH_LENGTH);
+    }
+    t_table = (double)(clock() - start) / CLOCKS_PER_SEC;
+    (void)crc_sink;
+
+    printf("crc_accumulate: %.1f MB/s\n", (BENCH_LENGTH * (double)BENCH_LOOPS) / (t_ref * 1e6));
+    printf("Crc_X25 table:  %.1f MB/s\n", (BENCH_LENGTH * (double)BENCH_LOOPS) / (t_table * 1e6));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   test program
+/// \return  number of failed checks
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    srand(1);
+    Test_Known_Answers();
+    Test_Reference();
+    Test_Benchmark();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
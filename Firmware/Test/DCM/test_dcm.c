@@ -0,0 +1,525 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Accuracy and cost benchmark of the AHRS (DCM.c, vmath.c) on synthetic
+///  trajectories with known attitude: level flight, coordinated turns,
+///  loops, turns with strong vibration, and recovery from a wrong initial
+///  attitude. Sensor samples are made as the attitude task gives them to
+///  MatrixUpdate(): offset stripped, sign corrected, in ADC counts, with
+///  noise, constant gyro bias and 5 Hz GPS speed and course. For each
+///  trajectory it writes a CSV line:
+///  - rms_roll, rms_pitch, rms_yaw: RMS of attitude error about body axes,
+///    from the rotation between true and estimated DCM [deg]
+///  - max_error: max total attitude error [deg]
+///  - converge: time after which roll and pitch errors stay within 2 deg
+///    and yaw error within 5 deg, -1 if never [s]; errors are taken from
+///    then on
+///  - ns_update: host time of MatrixUpdate(), CompensateDrift() and
+///    Normalize(), best of BENCH_RUNS passes [ns]
+///  Lines starting with # are comments. The first argument names the build
+///  variant in the CSV, so that results of builds with different sources or
+///  compiler options, or of different commits, can be collected in a file
+///  and compared. Errors above the limits of x_Trajectories fail the test:
+///  they are those of the current sources with some margin, so that they
+///  catch regressions. Turns don't converge within limits: the centrifugal
+///  correction of AccelAdjust() is scaled by 9.81 / GRAVITY on a vector
+///  already in m/s^2.
+///  Build and run on PC:
+/// \code
+///   gcc -O2 -I../Host -I../../Source test_dcm.c ../../Source/DCM.c
+///       ../../Source/vmath.c -lm
+///   ./a.out [variant] >> ahrs.csv
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "nav.h"
+#include "DCM.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup dcm
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define SPEED           15.0        //!< airspeed of every trajectory [m/s]
+#define G               9.81        //!< gravity [m/s^2]
+#define MAX_SEGMENTS    12          //!< max segments of a trajectory
+#define MAX_SAMPLES     (SAMPLES_PER_SECOND * 180) //!< max length of a trajectory
+#define GPS_SAMPLES     (SAMPLES_PER_SECOND / 5)   //!< samples between GPS fixes
+#define GYRO_BIAS       0.01        //!< constant gyro bias, every axis [rad/s]
+#define LIMIT_LEVEL     2.0         //!< roll and pitch error of convergence [deg]
+#define LIMIT_YAW       5.0         //!< yaw error of convergence [deg]
+#define BENCH_RUNS      20          //!< timed passes of each trajectory
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("# FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+#define RAD(x)      ((x) * M_PI / 180.0)    //!< degree to radian
+#define DEG(x)      ((x) * 180.0 / M_PI)    //!< radian to degree
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/// part of a trajectory with constant body rates
+typedef struct {
+    double dTime;                   ///< duration [s]
+    double dRate[3];                ///< roll, pitch, yaw rates in body axes [rad/s]
+} xSegment;
+
+/// trajectory and limits of its errors
+typedef struct {
+    const char * pcName;            ///< name in CSV
+    double dAccel_Noise;            ///< accelerometer noise [m/s^2]
+    double dGyro_Noise;             ///< gyro noise [rad/s]
+    double dStart[3];               ///< initial error of estimate, roll, pitch, yaw [deg]
+    double dMax_Rms;                ///< limit of RMS error of each axis [deg]
+    double dMax_Converge;           ///< limit of convergence time, < 0 not checked [s]
+    xSegment xSegments[MAX_SEGMENTS];///< segments, ended by one of 0 s
+} xTrajectory;
+
+/// result of a trajectory
+typedef struct {
+    double dRms[3];                 ///< RMS error about x, y, z body axes [deg]
+    double dMax;                    ///< max total error [deg]
+    double dConverge;               ///< convergence time, -1 if never [s]
+    double dNs;                     ///< time per update [ns]
+} xResult;
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// rates of a coordinated turn, banked 30 deg, right and left: roll in and
+/// out in 1.5 s, turn rate w = g tan(bank) / V, pitch rate w sin(bank), yaw
+/// rate w cos(bank)
+#define TURN_P      (RAD(30.0) / 1.5)
+#define TURN_Q      0.188794
+#define TURN_R      0.327000
+#define TURN(t)     { 1.5, { TURN_P, 0.0, 0.0 } }, { t, { 0.0, TURN_Q, TURN_R } }, \
+                    { 1.5, { -TURN_P, 0.0, 0.0 } }, { 5.0, { 0.0, 0.0, 0.0 } },  \
+                    { 1.5, { -TURN_P, 0.0, 0.0 } }, { t, { 0.0, TURN_Q, -TURN_R } }, \
+                    { 1.5, { TURN_P, 0.0, 0.0 } }, { 10.0, { 0.0, 0.0, 0.0 } }
+
+/// pitch rate of a loop of 25 m radius
+#define LOOP_Q      (SPEED / 25.0)
+#define LOOP        { 2.0 * M_PI / LOOP_Q, { 0.0, LOOP_Q, 0.0 } }
+
+/// trajectories
+VAR_STATIC const xTrajectory x_Trajectories[] = {
+    { "level",     0.3, 0.005, { 0.0, 0.0, 0.0 },     2.0, 30.0,
+      { { 60.0, { 0.0, 0.0, 0.0 } } } },
+    { "turn",      0.3, 0.005, { 0.0, 0.0, 0.0 },    14.0, -1.0,
+      { { 5.0, { 0.0, 0.0, 0.0 } }, TURN(40.0) } },
+    { "loop",      0.3, 0.005, { 0.0, 0.0, 0.0 },     2.0, 70.0,
+      { { 10.0, { 0.0, 0.0, 0.0 } }, LOOP, { 10.0, { 0.0, 0.0, 0.0 } }, LOOP,
+        { 30.0, { 0.0, 0.0, 0.0 } } } },
+    { "vibration", 6.0, 0.1,   { 0.0, 0.0, 0.0 },    15.0, -1.0,
+      { { 5.0, { 0.0, 0.0, 0.0 } }, TURN(40.0) } },
+    { "recovery",  0.3, 0.005, { 30.0, -20.0, 90.0 }, 2.0, 40.0,
+      { { 120.0, { 0.0, 0.0, 0.0 } } } }
+};
+
+#define TRAJECTORIES (sizeof(x_Trajectories) / sizeof(x_Trajectories[0]))
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint64_t ull_Random = 1;                 //!< noise generator state
+VAR_STATIC uint16_t ui_Speed;                       //!< GPS speed [kt/10]
+VAR_STATIC uint16_t ui_Heading;                     //!< GPS course [deg]
+
+VAR_STATIC int16_t i_Sensors[MAX_SAMPLES][6];       //!< sensor samples
+VAR_STATIC uint16_t ui_Gps[MAX_SAMPLES][2];         //!< GPS speed and course held at each sample
+VAR_STATIC double d_Truth[MAX_SAMPLES][3][3];       //!< true DCM after each sample
+VAR_STATIC float f_Estimate[MAX_SAMPLES][3][3];     //!< estimated DCM after each sample
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   GPS speed, stub of nav.c
+/// \return  speed [kt/10]
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Gps_Speed_Kt(void)
+{
+    return ui_Speed;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   GPS course, stub of nav.c
+/// \return  course [deg]
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint16_t Gps_Heading_Deg(void)
+{
+    return ui_Heading;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   normal random number
+/// \return  sample with standard deviation 1
+/// \remarks xorshift64* and Box-Muller, repeatable on every host
+///
+///----------------------------------------------------------------------------
+static double Gauss(void)
+{
+    double d_u[2];
+    int j;
+
+    for (j = 0; j < 2; j++) {
+        ull_Random ^= ull_Random >> 12;
+        ull_Random ^= ull_Random << 25;
+        ull_Random ^= ull_Random >> 27;
+        d_u[j] = ((double)((ull_Random * 2685821657736338717ULL) >> 11) + 1.0) / 9007199254740993.0;
+    }
+    return sqrt(-2.0 * log(d_u[0])) * cos(2.0 * M_PI * d_u[1]);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   rotation matrix from roll, pitch, yaw
+/// \param   pdEuler = roll, pitch, yaw [rad]
+/// \param   pdR = body to earth rotation, as DCM_Matrix
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Euler_To_Dcm(const double * pdEuler, double pdR[3][3])
+{
+    double cr = cos(pdEuler[0]), sr = sin(pdEuler[0]);
+    double cp = cos(pdEuler[1]), sp = sin(pdEuler[1]);
+    double cy = cos(pdEuler[2]), sy = sin(pdEuler[2]);
+
+    pdR[0][0] = cp * cy; pdR[0][1] = sr * sp * cy - cr * sy; pdR[0][2] = cr * sp * cy + sr * sy;
+    pdR[1][0] = cp * sy; pdR[1][1] = sr * sp * sy + cr * cy; pdR[1][2] = cr * sp * sy - sr * cy;
+    pdR[2][0] = -sp;     pdR[2][1] = sr * cp;                pdR[2][2] = cr * cp;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   rotates a DCM by constant body rates
+/// \param   pdR = body to earth rotation, updated
+/// \param   pdRate = body rates [rad/s]
+/// \param   dTime = time [s]
+/// \return  -
+/// \remarks exact, Rodrigues formula
+///
+///----------------------------------------------------------------------------
+static void Rotate(double pdR[3][3], const double * pdRate, double dTime)
+{
+    double d_angle = sqrt(pdRate[0] * pdRate[0] + pdRate[1] * pdRate[1] +
+                          pdRate[2] * pdRate[2]) * dTime;
+    double d_k[3], d_e[3][3], d_r[3][3];
+    double s, c;
+    int i, j, k;
+
+    if (d_angle < 1e-12) {
+        return;
+    }
+    for (j = 0; j < 3; j++) {
+        d_k[j] = pdRate[j] * dTime / d_angle;
+    }
+    s = sin(d_angle);
+    c = 1.0 - cos(d_angle);
+    d_e[0][0] = 1.0 - c * (d_k[1] * d_k[1] + d_k[2] * d_k[2]);
+    d_e[1][1] = 1.0 - c * (d_k[0] * d_k[0] + d_k[2] * d_k[2]);
+    d_e[2][2] = 1.0 - c * (d_k[0] * d_k[0] + d_k[1] * d_k[1]);
+    d_e[0][1] = -s * d_k[2] + c * d_k[0] * d_k[1];
+    d_e[1][0] =  s * d_k[2] + c * d_k[0] * d_k[1];
+    d_e[0][2] =  s * d_k[1] + c * d_k[0] * d_k[2];
+    d_e[2][0] = -s * d_k[1] + c * d_k[0] * d_k[2];
+    d_e[1][2] = -s * d_k[0] + c * d_k[1] * d_k[2];
+    d_e[2][1] =  s * d_k[0] + c * d_k[1] * d_k[2];
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            d_r[i][j] = 0.0;
+            for (k = 0; k < 3; k++) {
+                d_r[i][j] += pdR[i][k] * d_e[k][j];
+            }
+        }
+    }
+    memcpy(pdR, d_r, sizeof(d_r));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   ADC counts of a sensor value
+/// \param   dValue = value in physical units
+/// \param   dGain = units per count
+/// \return  rounded and saturated counts
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int16_t Counts(double dValue, double dGain)
+{
+    double d_counts = floor((dValue / dGain) + 0.5);
+
+    return (int16_t)fmax(-32768.0, fmin(32767.0, d_counts));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   makes sensor samples and truth of a trajectory
+/// \param   pxTrajectory = trajectory
+/// \return  number of samples
+/// \remarks Flight is at constant speed along body x axis, so acceleration
+///          is omega x V. Accelerometers give gravity minus acceleration,
+///          as MatrixUpdate() expects, starting north and level.
+///
+///----------------------------------------------------------------------------
+static uint32_t Make_Samples(const xTrajectory * pxTrajectory)
+{
+    const xSegment * p_seg = pxTrajectory->xSegments;
+    double d_r[3][3], d_mid[3][3];
+    const double d_zero[3] = { 0.0, 0.0, 0.0 };
+    double d_grav[3], d_north, d_east, d_left;
+    uint32_t ul_n = 0;
+    int j;
+
+    Euler_To_Dcm(d_zero, d_r);
+    ull_Random = 0x9E3779B97F4A7C15ULL;
+    ui_Speed = 0;
+    ui_Heading = 0;
+    for (; p_seg->dTime > 0.0; p_seg++) {
+        for (d_left = p_seg->dTime; (d_left > 1e-9) && (ul_n < MAX_SAMPLES); d_left -= DELTA_T) {
+            memcpy(d_mid, d_r, sizeof(d_mid));      // attitude at mid sample
+            Rotate(d_mid, p_seg->dRate, DELTA_T / 2.0);
+            for (j = 0; j < 3; j++) {               // gravity in body axes
+                d_grav[j] = G * d_mid[2][j];
+            }
+            d_grav[1] -= p_seg->dRate[2] * SPEED;   // minus omega x V
+            d_grav[2] += p_seg->dRate[1] * SPEED;
+            for (j = 0; j < 3; j++) {
+                i_Sensors[ul_n][j] = Counts(d_grav[j] + pxTrajectory->dAccel_Noise * Gauss(),
+                                            ACCEL_GAIN);
+                i_Sensors[ul_n][j + 3] = Counts(p_seg->dRate[j] + GYRO_BIAS +
+                                                pxTrajectory->dGyro_Noise * Gauss(), GYRO_GAIN);
+            }
+            if ((ul_n % GPS_SAMPLES) == 0) {        // new GPS fix
+                d_north = SPEED * d_mid[0][0];
+                d_east = SPEED * d_mid[1][0];
+                if (hypot(d_north, d_east) > 1.0) { // course held when climbing
+                    ui_Heading = (uint16_t)fmod(DEG(atan2(d_east, d_north)) + 360.5, 360.0);
+                }
+                ui_Speed = (uint16_t)(hypot(d_north, d_east) * 36000.0 / 1852.0 + 0.5);
+            }
+            ui_Gps[ul_n][0] = ui_Speed;
+            ui_Gps[ul_n][1] = ui_Heading;
+            Rotate(d_r, p_seg->dRate, DELTA_T);
+            memcpy(d_Truth[ul_n], d_r, sizeof(d_r));
+            ul_n++;
+        }
+    }
+    return ul_n;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   runs the AHRS on the samples of a trajectory
+/// \param   pxTrajectory = trajectory
+/// \param   ulSamples = number of samples
+/// \return  time per update, best of BENCH_RUNS passes [ns]
+/// \remarks Each pass starts from the same estimate, with zero gyro bias.
+///          Estimates of the last pass are kept.
+///
+///----------------------------------------------------------------------------
+static double Run_Ahrs(const xTrajectory * pxTrajectory, uint32_t ulSamples)
+{
+    const float f_zero[3] = { 0.0f, 0.0f, 0.0f };
+    double d_euler[3], d_start[3][3], d_best = 0.0, d_ns;
+    struct timespec x_t0, x_t1;
+    uint32_t n;
+    int i, j;
+
+    for (j = 0; j < 3; j++) {
+        d_euler[j] = RAD(pxTrajectory->dStart[j]);
+    }
+    Euler_To_Dcm(d_euler, d_start);
+    for (i = 0; i < BENCH_RUNS; i++) {
+        for (j = 0; j < 9; j++) {
+            DCM_Matrix[j / 3][j % 3] = (float)d_start[j / 3][j % 3];
+        }
+        SetGyroBias(f_zero);
+        clock_gettime(CLOCK_MONOTONIC, &x_t0);
+        for (n = 0; n < ulSamples; n++) {
+            ui_Speed = ui_Gps[n][0];
+            ui_Heading = ui_Gps[n][1];
+            MatrixUpdate(i_Sensors[n]);
+            CompensateDrift();
+            Normalize();
+            memcpy(f_Estimate[n], DCM_Matrix, sizeof(DCM_Matrix));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &x_t1);
+        d_ns = ((double)(x_t1.tv_sec - x_t0.tv_sec) * 1e9 +
+                (double)(x_t1.tv_nsec - x_t0.tv_nsec)) / ulSamples;
+        if ((i == 0) || (d_ns < d_best)) {
+            d_best = d_ns;
+        }
+    }
+    return d_best;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   attitude error of a sample
+/// \param   ulSample = sample
+/// \param   pdError = rotation from true to estimated attitude, about body
+///          x, y, z axes [rad]
+/// \return  -
+/// \remarks estimate is orthonormalized first, Normalize() leaves it close
+///
+///----------------------------------------------------------------------------
+static void Error(uint32_t ulSample, double * pdError)
+{
+    double d_e[3][3], d_angle, d_sin, d_cos;
+    int i, j, k;
+
+    for (i = 0; i < 3; i++) {                       // truth transposed times estimate
+        for (j = 0; j < 3; j++) {
+            d_e[i][j] = 0.0;
+            for (k = 0; k < 3; k++) {
+                d_e[i][j] += d_Truth[ulSample][k][i] * f_Estimate[ulSample][k][j];
+            }
+        }
+    }
+    pdError[0] = 0.5 * (d_e[2][1] - d_e[1][2]);
+    pdError[1] = 0.5 * (d_e[0][2] - d_e[2][0]);
+    pdError[2] = 0.5 * (d_e[1][0] - d_e[0][1]);
+    d_sin = sqrt(pdError[0] * pdError[0] + pdError[1] * pdError[1] + pdError[2] * pdError[2]);
+    d_cos = 0.5 * (d_e[0][0] + d_e[1][1] + d_e[2][2] - 1.0);
+    d_angle = atan2(d_sin, d_cos);
+    for (j = 0; (j < 3) && (d_sin > 1e-12); j++) {  // axis times angle
+        pdError[j] *= d_angle / d_sin;
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   errors of a trajectory
+/// \param   ulSamples = number of samples
+/// \param   pxResult = result
+/// \return  -
+/// \remarks errors are taken after convergence, on all samples if never
+///
+///----------------------------------------------------------------------------
+static void Score(uint32_t ulSamples, xResult * pxResult)
+{
+    double d_error[3], d_sum[3] = { 0.0, 0.0, 0.0 };
+    uint32_t n, ul_first = 0;
+    int j;
+
+    for (n = 0; n < ulSamples; n++) {               // last sample out of limits
+        Error(n, d_error);
+        if ((fabs(DEG(d_error[0])) > LIMIT_LEVEL) || (fabs(DEG(d_error[1])) > LIMIT_LEVEL) ||
+            (fabs(DEG(d_error[2])) > LIMIT_YAW)) {
+            ul_first = n + 1;
+        }
+    }
+    pxResult->dConverge = (ul_first < ulSamples) ? ul_first * DELTA_T : -1.0;
+    if (ul_first >= ulSamples) {
+        ul_first = 0;
+    }
+    pxResult->dMax = 0.0;
+    for (n = ul_first; n < ulSamples; n++) {
+        Error(n, d_error);
+        for (j = 0; j < 3; j++) {
+            d_sum[j] += d_error[j] * d_error[j];
+        }
+        pxResult->dMax = fmax(pxResult->dMax, DEG(sqrt(d_error[0] * d_error[0] +
+                                                       d_error[1] * d_error[1] +
+                                                       d_error[2] * d_error[2])));
+    }
+    for (j = 0; j < 3; j++) {
+        pxResult->dRms[j] = DEG(sqrt(d_sum[j] / (ulSamples - ul_first)));
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   test program
+/// \param   argc, argv = command line, optional variant name
+/// \return  number of failed checks
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(int argc, char ** argv)
+{
+    const char * pc_variant = (argc > 1) ? argv[1] : "default";
+    const xTrajectory * p_traj;
+    xResult x_result;
+    uint32_t ul_samples;
+    uint32_t t;
+
+    printf("# AHRS benchmark, %d Hz, gyro bias %.3f rad/s\n", SAMPLES_PER_SECOND, GYRO_BIAS);
+    printf("variant,trajectory,samples,rms_roll,rms_pitch,rms_yaw,max_error,converge,ns_update\n");
+    for (t = 0; t < TRAJECTORIES; t++) {
+        p_traj = &x_Trajectories[t];
+        ul_samples = Make_Samples(p_traj);
+        x_result.dNs = Run_Ahrs(p_traj, ul_samples);
+        Score(ul_samples, &x_result);
+        printf("%s,%s,%u,%.3f,%.3f,%.3f,%.3f,%.2f,%.1f\n", pc_variant, p_traj->pcName,
+               (unsigned)ul_samples, x_result.dRms[0], x_result.dRms[1], x_result.dRms[2],
+               x_result.dMax, x_result.dConverge, x_result.dNs);
+        if (p_traj->dMax_Converge >= 0.0) {
+            CHECK(x_result.dConverge >= 0.0);
+            CHECK(x_result.dConverge <= p_traj->dMax_Converge);
+        }
+        CHECK(x_result.dRms[0] <= p_traj->dMax_Rms);
+        CHECK(x_result.dRms[1] <= p_traj->dMax_Rms);
+        CHECK(x_result.dRms[2] <= p_traj->dMax_Rms);
+    }
+
+    printf("# %s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,30 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief FreeRTOS header stub for host tests
+///
+/// \file
+///  Replaces FreeRTOS.h when a module using critical sections only is
+///  tested on the development PC, single threaded, e.g.:
+/// \code
+///   gcc -I../Host -I../../Source test_xxx.c ../../Source/xxx.c
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+
+/*----------------------------------- Types ----------------------------------*/
+
+typedef uint32_t portTickType;
+
+#endif /* INC_FREERTOS_H */
@@ -0,0 +1,241 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief flash simulation for host tests
+///
+/// \file
+///  Simulates internal flash pages with the semantics of STM32F10x:
+///  - pages are mapped at their target address, so firmware reads flash
+///    through plain pointers as on target
+///  - erase sets a whole page to 0xFF
+///  - a half word can be programmed only if erased (0xFFFF), or with 0x0000;
+///    otherwise nothing is written and FLASH_ERROR_PG is returned
+///  - erase and program are refused with FLASH_ERROR_WRP while locked
+///  - a power cut can be scheduled after a number of operations: the
+///    operation in progress is left incomplete (some bits of a half word
+///    programmed, half of a page erased) and following ones have no effect
+///    until power is restored
+///
+//  Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "stm32f10x_flash.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup flash
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#define FLASH_SIM_PAGES     8           //!< max number of simulated pages
+#define MAP_ALIGN           4096        //!< host page size
+
+/*----------------------------------- Locals ---------------------------------*/
+
+static uint8_t * puc_Flash = NULL;              //!< simulated pages
+static uint32_t ul_Base = 0;                    //!< address of first page
+static uint16_t ui_Pages = 0;                   //!< number of pages
+static int i_Locked = 1;                        //!< flash is locked
+static uint32_t ul_Cut = 0;                     //!< operations before power cut, 0 = none
+static int i_Off = 0;                           //!< power is cut
+static uint32_t ul_Erases[FLASH_SIM_PAGES];     //!< erases of each page
+static uint32_t ul_Programs = 0;                //!< half words programmed
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   maps simulated pages, erased
+/// \param   ulAddress = address of first page
+/// \param   uiPages = number of pages
+/// \return  -
+/// \remarks exits if pages can't be mapped at requested address
+///
+///----------------------------------------------------------------------------
+void Flash_Sim_Init(uint32_t ulAddress, uint16_t uiPages)
+{
+    uintptr_t ul_map = ulAddress & ~(uintptr_t)(MAP_ALIGN - 1);
+    uint8_t * p_map;
+
+    if (puc_Flash == NULL) {                    // host pages are larger
+        p_map = mmap((void *)ul_map, (ulAddress - ul_map) + FLASH_SIM_PAGES * FLASH_SIM_PAGE_SIZE,
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        puc_Flash = p_map + (ulAddress - ul_map);
+        if (p_map != (uint8_t *)ul_map) {
+            printf("can't map flash at 0x%08X\n", (unsigned)ulAddress);
+            exit(1);
+        }
+    }
+    ul_Base = ulAddress;
+    ui_Pages = (uiPages < FLASH_SIM_PAGES) ? uiPages : FLASH_SIM_PAGES;
+    memset(puc_Flash, 0xFF, ui_Pages * FLASH_SIM_PAGE_SIZE);
+    memset(ul_Erases, 0, sizeof(ul_Erases));
+    ul_Programs = 0;
+    ul_Cut = 0;
+    i_Off = 0;
+    i_Locked = 1;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   schedules a power cut
+/// \param   ulOperations = operations completed before cut, 0 restores power
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void Flash_Sim_Cut(uint32_t ulOperations)
+{
+    ul_Cut = ulOperations;
+    i_Off = 0;
+    i_Locked = 1;                               // reset state
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   counts an operation toward a scheduled power cut
+/// \return  1 if power is cut during this operation
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static int Flash_Sim_Cutting(void)
+{
+    if ((ul_Cut != 0) && (--ul_Cut == 0)) {
+        i_Off = 1;
+        return 1;
+    }
+    return 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   number of erases of a page
+/// \param   uiPage = page index
+/// \return  erases since Flash_Sim_Init
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint32_t Flash_Sim_Erases(uint16_t uiPage)
+{
+    return (uiPage < ui_Pages) ? ul_Erases[uiPage] : 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   number of half words programmed
+/// \return  programs since Flash_Sim_Init
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+uint32_t Flash_Sim_Programs(void)
+{
+    return ul_Programs;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   lock status
+/// \return  1 if flash is locked
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int Flash_Sim_Locked(void)
+{
+    return i_Locked;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   driver functions
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void FLASH_Unlock(void)
+{
+    i_Locked = 0;
+}
+
+void FLASH_Lock(void)
+{
+    i_Locked = 1;
+}
+
+void FLASH_ClearFlag(uint32_t FLASH_FLAG)
+{
+    (void)FLASH_FLAG;
+}
+
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address)
+{
+    uint32_t ul_page = (Page_Address - ul_Base) / FLASH_SIM_PAGE_SIZE;
+    uint32_t ul_start = 0;
+
+    if ((Page_Address < ul_Base) || (ul_page >= ui_Pages)) {
+        printf("erase outside simulated flash 0x%08X\n", (unsigned)Page_Address);
+        exit(1);
+    }
+    if (i_Off) {
+        return FLASH_TIMEOUT;
+    }
+    if (i_Locked) {
+        return FLASH_ERROR_WRP;
+    }
+    if (Flash_Sim_Cutting()) {
+        ul_start = FLASH_SIM_PAGE_SIZE / 2;     // header kept, records partially erased
+    }
+    memset(&puc_Flash[ul_page * FLASH_SIM_PAGE_SIZE + ul_start], 0xFF,
+           FLASH_SIM_PAGE_SIZE - ul_start);
+    ul_Erases[ul_page]++;
+    return i_Off ? FLASH_TIMEOUT : FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+    uint16_t * p_data = (uint16_t *)&puc_Flash[Address - ul_Base];
+
+    if ((Address < ul_Base) || (Address >= ul_Base + ui_Pages * FLASH_SIM_PAGE_SIZE) ||
+        ((Address & 1) != 0)) {
+        printf("program outside simulated flash 0x%08X\n", (unsigned)Address);
+        exit(1);
+    }
+    if (i_Off) {
+        return FLASH_TIMEOUT;
+    }
+    if (i_Locked) {
+        return FLASH_ERROR_WRP;
+    }
+    if ((*p_data != 0xFFFF) && (Data != 0x0000)) {
+        return FLASH_ERROR_PG;
+    }
+    if (Flash_Sim_Cutting()) {
+        Data |= 0x5555;                         // some bits not programmed
+    }
+    *p_data &= Data;
+    ul_Programs++;
+    return i_Off ? FLASH_TIMEOUT : FLASH_COMPLETE;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,30 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief device header stub for host tests
+///
+/// \file
+///  Replaces CMSIS stm32f10x.h when platform independent modules are
+///  compiled and tested on the development PC, e.g.:
+/// \code
+///   gcc -I../Host -I../../Source test_xxx.c ../../Source/xxx.c
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+/*----------------------------------- Types ----------------------------------*/
+
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+
+#endif /* __STM32F10x_H */
@@ -0,0 +1,59 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief flash driver stub for host tests
+///
+/// \file
+///  Replaces StdPeriph stm32f10x_flash.h with the subset of the driver used
+///  by the firmware, implemented by flash.c on simulated pages, e.g.:
+/// \code
+///   gcc -I../Host -I../../Source test_xxx.c ../Host/flash.c ../../Source/xxx.c
+/// \endcode
+///
+//  Change
+//
+//============================================================================*/
+
+#ifndef __STM32F10x_FLASH_H
+#define __STM32F10x_FLASH_H
+
+#include <stdint.h>
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#define FLASH_FLAG_EOP      ((uint32_t)0x00000020)  //!< end of operation flag
+#define FLASH_FLAG_PGERR    ((uint32_t)0x00000004)  //!< program error flag
+#define FLASH_FLAG_WRPRTERR ((uint32_t)0x00000010)  //!< write protection error flag
+
+#define FLASH_SIM_PAGE_SIZE 1024                    //!< page size of STM32F100RB [bytes]
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/// operation status, same values as StdPeriph driver
+typedef enum {
+    FLASH_BUSY = 1,
+    FLASH_ERROR_PG,
+    FLASH_ERROR_WRP,
+    FLASH_COMPLETE,
+    FLASH_TIMEOUT
+} FLASH_Status;
+
+/*---------------------------------- Interface -------------------------------*/
+
+void FLASH_Unlock(void);
+void FLASH_Lock(void);
+void FLASH_ClearFlag(uint32_t FLASH_FLAG);
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address);
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data);
+
+void Flash_Sim_Init(uint32_t ulAddress, uint16_t uiPages);
+void Flash_Sim_Cut(uint32_t ulOperations);
+uint32_t Flash_Sim_Erases(uint16_t uiPage);
+uint32_t Flash_Sim_Programs(void);
+int Flash_Sim_Locked(void);
+
+#endif /* __STM32F10x_FLASH_H */
@@ -0,0 +1,25 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief FreeRTOS task header stub for host tests
+///
+/// \file
+///  Critical sections are empty, host tests run a single thread.
+///
+//  Change
+//
+//============================================================================*/
+
+#ifndef TASK_H
+#define TASK_H
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define taskENTER_CRITICAL()    //!< no other task to lock out
+#define taskEXIT_CRITICAL()     //!< no other task to lock out
+
+#endif /* TASK_H */
@@ -20,6 +20,7 @@
 
 #include "stm32f10x.h"
 #include "stm32f10x_usart.h"
+#include "ring.h"
 
 /*--------------------------------- Definitions ------------------------------*/
 
@@ -60,6 +61,8 @@ VAR_STATIC uint8_t ucTxWindex;                      //!< downlink write index
 VAR_STATIC uint8_t ucTxRindex;                      //!< downlink read index
 VAR_STATIC uint8_t ucRxBuffer[RX_BUFFER_LENGTH];    //!< uplink data buffer
 VAR_STATIC uint8_t ucTxBuffer[TX_BUFFER_LENGTH];    //!< downlink data buffer
+VAR_STATIC uint8_t ucTxFrame[TX_BUFFER_LENGTH];     //!< downlink frames built in place
+VAR_STATIC xRing xTxRing;                           //!< downlink frame ring
 
 /*--------------------------------- Prototypes -------------------------------*/
 
@@ -98,6 +101,7 @@ void USART1_Init( void ) {
     ucRxRindex = 0;         // clear uplink read index
     ucTxWindex = 0;         // clear downlink write index
     ucTxRindex = 0;         // clear downlink read index
+    Ring_Init(&xTxRing, ucTxFrame, TX_BUFFER_LENGTH);
     bTest_Running = TRUE;
 }
 
@@ -187,6 +191,81 @@ void USART1_Transmit( void ) {
     bTest_Running = FALSE;
 }
 
+//----------------------------------------------------------------------------
+//
+/// \brief   Reserve space for a message built in USART 1 buffer
+/// \param   uiLength = message length
+/// \returns pointer to frame ring, NULL if it's full
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+xRing * USART1_Tx_Reserve(uint16_t uiLength) {
+    return Ring_Reserve(&xTxRing, uiLength) ? &xTxRing : 0;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Send a message built in USART 1 buffer
+/// \param   -
+/// \returns -
+/// \remarks frame stays in ucTxFrame for inspection until next USART1_Init
+///
+//----------------------------------------------------------------------------
+void USART1_Tx_Commit( void ) {
+    Ring_Commit(&xTxRing);
+    USART1_Transmit();
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Free space in USART 1 transmit buffer
+/// \param   -
+/// \returns number of bytes that can be queued
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+uint16_t USART1_Tx_Free( void ) {
+    return Ring_Free(&xTxRing);
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Write a message into USART 1 buffer
+/// \param   pucData = pointer to message
+/// \param   uiLength = message length
+/// \returns TRUE, buffer is never full in test
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+bool USART1_Write(const uint8_t * pucData, uint16_t uiLength) {
+
+    while (uiLength-- != 0) {
+        USART1_Putch(*pucData++);
+    }
+    USART1_Transmit();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------------
+//
+/// \brief   Link error counters
+/// \param   -
+/// \returns 0, no errors in test
+/// \remarks -
+///
+//----------------------------------------------------------------------------
+uint16_t USART1_Tx_Dropped( void ) {
+    return 0;
+}
+
+uint16_t USART1_Rx_Overruns( void ) {
+    return 0;
+}
+
+uint16_t USART1_Rx_Errors( void ) {
+    return 0;
+}
+
 //----------------------------------------------------------------------------
 //
 /// \brief
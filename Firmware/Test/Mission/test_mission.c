@@ -0,0 +1,777 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of in flight mission upload: scripted ground station frames
+///  are fed to the MAVLink parser, replies are decoded from the transmit
+///  ring. Checks normal upload and table swap, lost, repeated and out of
+///  sequence items, timeout, too many items, invalid waypoints and upload
+///  refused while a swap is pending. Active table must never change before
+///  navigation swaps it. Parameter list download: whole list at link rate,
+///  missing parameters requested again by index or by name. HIL messages
+///  converted to raw sensors, fix and altitude, HIL_CONTROLS content.
+///  Gyro calibration command accepted on ground, rejected otherwise.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_mission.c ../../Source/mission.c
+///       ../../Source/mav_telemetry.c ../../Source/stream.c
+///       ../../Source/ring.c ../../Source/crc.c ../../Source/param.c -lm
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+
+#include "crc.h"
+#include "ring.h"
+#include "usart1driver.h"
+#include "servodriver.h"
+#include "nav.h"
+#include "mission.h"
+#include "param.h"
+#include "stream.h"
+#include "mav_telemetry.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup mission
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define MISSION_TIMEOUT     25      //!< as in mav_telemetry.c [ticks]
+#define MISSION_RETRIES     5       //!< as in mav_telemetry.c
+#define LINK_BUDGET         103     //!< as in mav_telemetry.c [bytes per tick]
+#define PARAM_RESERVE       (LINK_BUDGET / 4) //!< as in mav_telemetry.c
+#define PARAM_FRAME         33      //!< PARAM_VALUE frame size [bytes]
+
+#define ID_PARAM_REQUEST_READ 20    //!< MAVLink message IDs
+#define ID_PARAM_REQUEST_LIST 21
+#define ID_PARAM_VALUE      22
+#define ID_MISSION_ITEM     39
+#define ID_MISSION_REQUEST  40
+#define ID_MISSION_COUNT    44
+#define ID_MISSION_ACK      47
+#define ID_COMMAND_LONG     76
+#define ID_COMMAND_ACK      77
+#define ID_HIL_STATE        90
+#define ID_HIL_CONTROLS     91
+#define ID_HIL_SENSOR       107
+#define ID_HIL_GPS          113
+
+#define CRC_PARAM_REQUEST_READ 214  //!< MAVLink CRC extras
+#define CRC_PARAM_REQUEST_LIST 159
+#define CRC_MISSION_ITEM    254
+#define CRC_MISSION_COUNT   221
+#define CRC_COMMAND_LONG    152
+#define CRC_HIL_STATE       183
+#define CRC_HIL_SENSOR      108
+#define CRC_HIL_GPS         124
+
+#define ACK_ACCEPTED        0       //!< MAV_MISSION_RESULT values
+#define ACK_ERROR           1
+#define ACK_UNSUPPORTED     3
+#define ACK_NO_SPACE        4
+#define ACK_INVALID         5
+
+#define CMD_PREFLIGHT_CALIBRATION 241 //!< MAV_CMD value
+#define RESULT_ACCEPTED     0       //!< MAV_RESULT values
+#define RESULT_REJECTED     1
+#define RESULT_UNSUPPORTED  3
+
+#define NO_REPLY            0xFFFF  //!< no request or ack received
+
+#define G                   9.80665f //!< standard gravity [m/s^2]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint8_t uc_Rx[80];                       //!< frame from ground station
+VAR_STATIC uint16_t ui_Rx_Length = 0;               //!< length of frame
+VAR_STATIC uint16_t ui_Rx_Index = 0;                //!< next byte read by parser
+VAR_STATIC uint8_t uc_Rx_Seq = 0;                   //!< ground station sequence
+VAR_STATIC uint8_t uc_Tx[512];                      //!< transmit ring buffer
+VAR_STATIC xRing x_Tx;                              //!< transmit ring
+VAR_STATIC uint16_t ui_Request;                     //!< last requested item
+VAR_STATIC uint16_t ui_Requests;                    //!< number of requests
+VAR_STATIC uint16_t ui_Ack;                         //!< last mission ack
+VAR_STATIC uint16_t ui_Param[PARAM_NUMBER];         //!< PARAM_VALUE received for each parameter
+VAR_STATIC uint16_t ui_Params;                      //!< PARAM_VALUE received
+VAR_STATIC uint16_t ui_Bytes;                       //!< bytes of last replies
+VAR_STATIC uint8_t uc_Controls[42];                 //!< payload of last HIL_CONTROLS
+VAR_STATIC uint16_t ui_Controls;                    //!< HIL_CONTROLS received
+VAR_STATIC uint16_t ui_Result;                      //!< result of last COMMAND_ACK
+VAR_STATIC bool b_On_Ground = FALSE;                //!< aircraft on ground
+VAR_STATIC uint16_t ui_Calibrations = 0;            //!< calibration requests
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+void Mavlink_Hil_Controls(void);
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   stubs of drivers and tasks used by telemetry
+/// \remarks waypoints come from the mission tables under test
+///
+///----------------------------------------------------------------------------
+bool USART1_Getch(uint8_t * c)
+{
+    if (ui_Rx_Index < ui_Rx_Length) {
+        *c = uc_Rx[ui_Rx_Index++];
+        return TRUE;
+    }
+    return FALSE;
+}
+xRing * USART1_Tx_Reserve(uint16_t uiLength) { return Ring_Reserve(&x_Tx, uiLength) ? &x_Tx : NULL; }
+void USART1_Tx_Commit(void) { Ring_Commit(&x_Tx); }
+uint16_t USART1_Tx_Free(void) { return Ring_Free(&x_Tx); }
+uint16_t USART1_Tx_Dropped(void) { return x_Tx.uiDropped; }
+uint16_t USART1_Rx_Overruns(void) { return 0; }
+uint16_t USART1_Rx_Errors(void) { return 0; }
+uint8_t Gps_Fix(void) { return GPS_FIX; }
+uint16_t Gps_Speed_Kt(void) { return 0; }
+uint16_t Gps_Heading_Deg(void) { return 0; }
+int32_t Gps_Latitude(void) { return 0; }
+int32_t Gps_Longitude(void) { return 0; }
+float Nav_Altitude(void) { return 0.0f; }
+uint16_t Nav_Wpt_Number(void) { return Mission_Number(); }
+void Nav_Wpt_Get(uint16_t index, STRUCT_WPT * wpt) { Mission_Get(index, wpt); }
+float Attitude_Roll_Rad(void) { return 0.0f; }
+float Attitude_Pitch_Rad(void) { return 0.0f; }
+float Attitude_Yaw_Rad(void) { return 0.0f; }
+int16_t Servo_Get(SERVO_TYPE servo) { (void)servo; return 1500; }
+uint8_t PPMGetMode(void) { return 0; }
+void Calibration_Request(void) { ui_Calibrations++; }
+bool Attitude_On_Ground(void) { return b_On_Ground; }
+bool Store_Save(void) { return TRUE; }
+
+///----------------------------------------------------------------------------
+///
+/// \brief   decodes frames sent by telemetry
+/// \return  -
+/// \remarks keeps last MISSION_REQUEST, MISSION_ACK, COMMAND_ACK and
+///          HIL_CONTROLS, counts
+///          PARAM_VALUE, other frames are skipped. Ring is drained, so frames are always
+///          complete.
+///
+///----------------------------------------------------------------------------
+static void Replies(void)
+{
+    uint8_t uc_frames[sizeof(uc_Tx)];
+    uint8_t * p_block;
+    uint16_t ui_length, ui_total = 0, j;
+
+    while ((ui_length = Ring_Block_Start(&x_Tx, &p_block)) != 0) {
+        memcpy(&uc_frames[ui_total], p_block, ui_length);
+        ui_total += ui_length;
+        Ring_Block_End(&x_Tx, 0);
+    }
+    for (j = 0; j + 8 <= ui_total; j += uc_frames[j + 1] + 8) {
+        if (uc_frames[j] != 0xFE) {                     // tests use MAVLink 1
+            printf("FAIL bad frame\n");
+            i_Errors++;
+            break;
+        }
+        if (uc_frames[j + 5] == ID_MISSION_REQUEST) {
+            ui_Request = uc_frames[j + 6] | (uc_frames[j + 7] << 8);
+            ui_Requests++;
+        } else if (uc_frames[j + 5] == ID_MISSION_ACK) {
+            ui_Ack = uc_frames[j + 8];
+        } else if (uc_frames[j + 5] == ID_COMMAND_ACK) {
+            ui_Result = uc_frames[j + 8];
+        } else if (uc_frames[j + 5] == ID_PARAM_VALUE) {
+            ui_Params++;
+            if (uc_frames[j + 12] < PARAM_NUMBER) {
+                ui_Param[uc_frames[j + 12]]++;
+            }
+        } else if ((uc_frames[j + 5] == ID_HIL_CONTROLS) &&
+                   (uc_frames[j + 1] == sizeof(uc_Controls))) {
+            memcpy(uc_Controls, &uc_frames[j + 6], sizeof(uc_Controls));
+            ui_Controls++;
+        }
+    }
+    ui_Bytes = ui_total;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends a frame from ground station
+/// \param   ucId = message ID
+/// \param   ucExtra = CRC extra of message
+/// \param   pucPayload = payload
+/// \param   ucLength = payload length
+/// \return  -
+/// \remarks replies are decoded
+///
+///----------------------------------------------------------------------------
+static void Gcs_Send(uint8_t ucId, uint8_t ucExtra, const uint8_t * pucPayload, uint8_t ucLength)
+{
+    uint16_t ui_crc;
+
+    ui_Request = NO_REPLY;
+    ui_Ack = NO_REPLY;
+    ui_Result = NO_REPLY;
+    uc_Rx[0] = 0xFE;
+    uc_Rx[1] = ucLength;
+    uc_Rx[2] = uc_Rx_Seq++;
+    uc_Rx[3] = 255;                                 // GCS system
+    uc_Rx[4] = 190;                                 // mission planner
+    uc_Rx[5] = ucId;
+    memcpy(&uc_Rx[6], pucPayload, ucLength);
+    ui_crc = Crc_X25(CRC_X25_INIT, &uc_Rx[1], ucLength + 5);
+    ui_crc = Crc_X25_Byte(ui_crc, ucExtra);
+    uc_Rx[6 + ucLength] = (uint8_t)ui_crc;
+    uc_Rx[7 + ucLength] = (uint8_t)(ui_crc >> 8);
+    ui_Rx_Length = ucLength + 8;
+    ui_Rx_Index = 0;
+    Mavlink_Receive();
+    Replies();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends MISSION_COUNT
+/// \param   uiCount = number of items
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Gcs_Count(uint16_t uiCount)
+{
+    uint8_t uc_payload[4];
+
+    memcpy(&uc_payload[0], &uiCount, 2);
+    uc_payload[2] = 1;                              // target system
+    uc_payload[3] = 1;                              // target component
+    Gcs_Send(ID_MISSION_COUNT, CRC_MISSION_COUNT, uc_payload, 4);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends MISSION_ITEM
+/// \param   uiSeq = item sequence
+/// \param   uiCommand = MAV_CMD
+/// \param   fLat = latitude
+/// \param   fLon = longitude
+/// \param   fAlt = altitude
+/// \return  -
+/// \remarks frame is global, relative altitude
+///
+///----------------------------------------------------------------------------
+static void Gcs_Item_Cmd(uint16_t uiSeq, uint16_t uiCommand, float fLat, float fLon, float fAlt)
+{
+    uint8_t uc_payload[37];
+
+    memset(uc_payload, 0, sizeof(uc_payload));
+    memcpy(&uc_payload[16], &fLat, 4);
+    memcpy(&uc_payload[20], &fLon, 4);
+    memcpy(&uc_payload[24], &fAlt, 4);
+    memcpy(&uc_payload[28], &uiSeq, 2);
+    memcpy(&uc_payload[30], &uiCommand, 2);
+    uc_payload[32] = 1;                             // target system
+    uc_payload[33] = 1;                             // target component
+    uc_payload[34] = 3;                             // MAV_FRAME_GLOBAL_RELATIVE_ALT
+    uc_payload[36] = 1;                             // auto continue
+    Gcs_Send(ID_MISSION_ITEM, CRC_MISSION_ITEM, uc_payload, 37);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends MISSION_ITEM with waypoint j of a test pattern
+/// \param   uiSeq = item sequence
+/// \param   uiBase = pattern number
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Gcs_Item(uint16_t uiSeq, uint16_t uiBase)
+{
+    Gcs_Item_Cmd(uiSeq, 16, 45.0f + uiBase + uiSeq * 0.01f, 9.0f + uiSeq * 0.01f, 100.0f + uiSeq);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks that active mission is a test pattern
+/// \param   uiNumber = expected number of waypoints
+/// \param   uiBase = pattern number
+/// \return  TRUE if active mission matches
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static bool Active_Is(uint16_t uiNumber, uint16_t uiBase)
+{
+    STRUCT_WPT x_wpt;
+    uint16_t j;
+
+    if (Mission_Number() != uiNumber) {
+        return FALSE;
+    }
+    for (j = 1; j < uiNumber; j++) {
+        Mission_Get(j, &x_wpt);
+        if ((x_wpt.Lat != 45.0f + uiBase + j * 0.01f) ||
+            (x_wpt.Lon != 9.0f + j * 0.01f) ||
+            (x_wpt.Alt != 100.0f + j)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   uploads a test pattern
+/// \param   uiNumber = number of items
+/// \param   uiBase = pattern number
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Upload(uint16_t uiNumber, uint16_t uiBase)
+{
+    uint16_t j;
+
+    Gcs_Count(uiNumber);
+    for (j = 0; j < uiNumber; j++) {
+        CHECK(ui_Request == j);
+        Gcs_Item(j, uiBase);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   runs telemetry
+/// \param   uiTicks = number of scheduler ticks
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Run(uint16_t uiTicks)
+{
+    ui_Request = NO_REPLY;
+    ui_Ack = NO_REPLY;
+    while (uiTicks-- != 0) {
+        Mavlink_Stream_Send();
+        Replies();
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   normal upload
+/// \return  -
+/// \remarks navigation keeps the old mission until it swaps tables
+///
+///----------------------------------------------------------------------------
+static void Test_Upload(void)
+{
+    STRUCT_WPT x_wpt;
+
+    CHECK(Mission_Number() == 0);
+    Upload(4, 0);
+    CHECK(ui_Ack == ACK_ACCEPTED);
+    CHECK(Mission_Pending());
+    CHECK(Mission_Number() == 0);                   // not yet active
+    CHECK(Mission_Swap());
+    CHECK(!Mission_Swap());
+    CHECK(Active_Is(4, 0));
+    Mission_Get(0, &x_wpt);                         // launch position
+    CHECK((x_wpt.Lat == 44.0f) && (x_wpt.Lon == 8.0f));
+    Mission_Get(4, &x_wpt);                         // out of range
+    CHECK((x_wpt.Lat == 44.0f) && (x_wpt.Lon == 8.0f));
+
+    Upload(MISSION_MAX, 1);                         // largest mission
+    CHECK(ui_Ack == ACK_ACCEPTED);
+    CHECK(Active_Is(4, 0));
+    CHECK(Mission_Swap());
+    CHECK(Active_Is(MISSION_MAX, 1));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   lost, repeated and out of sequence items
+/// \return  -
+/// \remarks expected item is requested again, old mission stays active
+///
+///----------------------------------------------------------------------------
+static void Test_Lost(void)
+{
+    uint16_t j;
+
+    Gcs_Count(3);
+    CHECK(ui_Request == 0);
+    Gcs_Item(0, 2);
+    CHECK(ui_Request == 1);
+
+    ui_Requests = 0;                                // item 1 lost
+    Run(MISSION_TIMEOUT - 1);
+    CHECK(ui_Requests == 0);
+    Run(1);
+    CHECK(ui_Requests == 1);
+    CHECK(ui_Request == 1);
+
+    Gcs_Item(2, 2);                                 // out of sequence
+    CHECK(ui_Request == 1);
+    Gcs_Item(1, 2);
+    CHECK(ui_Request == 2);
+    Gcs_Item(1, 2);                                 // repeated
+    CHECK(ui_Request == 2);
+    CHECK(Active_Is(MISSION_MAX, 1));
+    Gcs_Item(2, 2);
+    CHECK(ui_Ack == ACK_ACCEPTED);
+    CHECK(Mission_Swap());
+    CHECK(Active_Is(3, 2));
+
+    Gcs_Count(3);                                   // ground station gone
+    for (j = 0; j < MISSION_RETRIES; j++) {
+        Run(MISSION_TIMEOUT);
+        CHECK(ui_Request == 0);
+        CHECK(ui_Ack == NO_REPLY);
+    }
+    Run(MISSION_TIMEOUT);
+    CHECK(ui_Request == NO_REPLY);
+    CHECK(ui_Ack == ACK_ERROR);
+    Gcs_Item(0, 3);                                 // too late
+    CHECK((ui_Request == NO_REPLY) && (ui_Ack == NO_REPLY));
+    CHECK(!Mission_Pending());
+    CHECK(Active_Is(3, 2));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   rejected missions
+/// \return  -
+/// \remarks active mission is never changed
+///
+///----------------------------------------------------------------------------
+static void Test_Rejected(void)
+{
+    Gcs_Count(MISSION_MAX + 1);                     // too many items
+    CHECK(ui_Ack == ACK_NO_SPACE);
+    CHECK(ui_Request == NO_REPLY);
+
+    Gcs_Count(3);                                   // latitude out of range
+    Gcs_Item_Cmd(0, 16, 0.0f, 0.0f, 0.0f);
+    Gcs_Item_Cmd(1, 16, 91.0f, 9.0f, 100.0f);
+    Gcs_Item_Cmd(2, 16, 45.0f, 9.0f, 100.0f);
+    CHECK(ui_Ack == ACK_INVALID);
+    CHECK(!Mission_Pending());
+
+    Gcs_Count(2);                                   // unsupported command
+    Gcs_Item_Cmd(0, 16, 0.0f, 0.0f, 0.0f);
+    Gcs_Item_Cmd(1, 21, 45.0f, 9.0f, 0.0f);         // MAV_CMD_NAV_LAND
+    CHECK(ui_Ack == ACK_UNSUPPORTED);
+    CHECK(!Mission_Pending());
+    CHECK(Active_Is(3, 2));
+
+    Upload(2, 4);                                   // navigation hasn't swapped
+    CHECK(ui_Ack == ACK_ACCEPTED);
+    Gcs_Count(3);
+    CHECK(ui_Ack == ACK_ERROR);
+    CHECK(ui_Request == NO_REPLY);
+    CHECK(Active_Is(3, 2));
+    CHECK(Mission_Swap());
+    CHECK(Active_Is(2, 4));
+
+    Gcs_Count(0);                                   // no waypoints, RTL
+    CHECK(ui_Ack == ACK_ACCEPTED);
+    CHECK(Mission_Swap());
+    CHECK(Mission_Number() == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends PARAM_REQUEST_READ
+/// \param   iIndex = parameter index, -1 to use name
+/// \param   pcName = parameter name
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Gcs_Param_Read(int16_t iIndex, const char * pcName)
+{
+    uint8_t uc_payload[20];
+
+    memset(uc_payload, 0, sizeof(uc_payload));
+    memcpy(&uc_payload[0], &iIndex, 2);
+    uc_payload[2] = 1;                              // target system
+    uc_payload[3] = 1;                              // target component
+    strncpy((char *)&uc_payload[4], pcName, PARAM_NAME_LENGTH);
+    Gcs_Send(ID_PARAM_REQUEST_READ, CRC_PARAM_REQUEST_READ, uc_payload, 20);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   parameter download
+/// \return  -
+/// \remarks list is sent in bursts limited by link credit, each parameter
+///          once, then missing ones are requested by index and by name
+///
+///----------------------------------------------------------------------------
+static void Test_Params(void)
+{
+    const uint8_t uc_list[2] = { 1, 1 };
+    uint16_t j, ui_ticks = 0;
+
+    Run(STREAM_TICK_HZ);                            // link credit settled
+    memset(ui_Param, 0, sizeof(ui_Param));
+    ui_Params = 0;
+    Gcs_Send(ID_PARAM_REQUEST_LIST, CRC_PARAM_REQUEST_LIST, uc_list, 2);
+    while ((ui_Params < PARAM_NUMBER) && (ui_ticks < STREAM_TICK_HZ)) {
+        Run(1);
+        ui_ticks++;
+        CHECK(ui_Bytes <= LINK_BUDGET * STREAM_BURST);
+    }
+    for (j = 0; j < PARAM_NUMBER; j++) {
+        CHECK(ui_Param[j] == 1);
+    }
+    CHECK(ui_ticks <= (PARAM_NUMBER * PARAM_FRAME) / (LINK_BUDGET - PARAM_RESERVE - PARAM_FRAME) + 1);
+    Run(STREAM_TICK_HZ);
+    CHECK(ui_Params == PARAM_NUMBER);               // nothing sent twice
+
+    Gcs_Param_Read(4, "");                          // missing index
+    Gcs_Param_Read(4, "");                          // repeated request
+    Run(1);
+    CHECK(ui_Param[4] == 2);
+    CHECK(ui_Params == PARAM_NUMBER + 1);
+
+    Gcs_Param_Read(-1, "NAV_BANK");                 // by name
+    Gcs_Param_Read(-1, "NO_SUCH_PARAM");
+    Gcs_Param_Read(PARAM_NUMBER, "");
+    Run(1);
+    CHECK(ui_Param[PARAM_NAV_BANK] == 2);
+    CHECK(ui_Params == PARAM_NUMBER + 2);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends HIL_SENSOR
+/// \param   pfAccel = accelerations x, y, z [m/s^2]
+/// \param   pfGyro = rates x, y, z [rad/s]
+/// \param   fAltitude = pressure altitude [m]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Gcs_Hil_Sensor(const float * pfAccel, const float * pfGyro, float fAltitude)
+{
+    uint8_t uc_payload[64];
+
+    memset(uc_payload, 0, sizeof(uc_payload));
+    memcpy(&uc_payload[8], pfAccel, 12);
+    memcpy(&uc_payload[20], pfGyro, 12);
+    memcpy(&uc_payload[52], &fAltitude, 4);
+    Gcs_Send(ID_HIL_SENSOR, CRC_HIL_SENSOR, uc_payload, 64);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   hardware in the loop
+/// \return  -
+/// \remarks sensors are raw data that AHRS correction turns back into HIL
+///          values, level and still aircraft reads zero; fix and altitude
+///          from HIL_GPS, HIL_SENSOR and HIL_STATE; HIL_CONTROLS content
+///
+///----------------------------------------------------------------------------
+static void Test_Hil(void)
+{
+    const float f_level[3] = { 0.0f, 0.0f, -G };
+    const float f_still[3] = { 0.0f, 0.0f, 0.0f };
+    const float f_accel[3] = { G, -G, -2.0f * G };
+    const float f_gyro[3] = { 0.1f, 0.1f, -0.1f };
+    uint8_t uc_payload[56];
+    int16_t i_sensor[6];
+    int16_t i_value;
+    int32_t l_value;
+    uint16_t ui_value;
+    float f_value;
+    telStruct_Gps x_gps;
+
+    Telemetry_Get_Sensors(i_sensor);                // before first message
+    CHECK((i_sensor[0] == 0) && (i_sensor[2] == 0) && (i_sensor[5] == 0));
+    CHECK(!Telemetry_Get_Gps(&x_gps));
+
+    Gcs_Hil_Sensor(f_level, f_still, 123.5f);
+    Telemetry_Get_Sensors(i_sensor);
+    CHECK((i_sensor[0] == 0) && (i_sensor[1] == 0) && (i_sensor[2] == 0));
+    CHECK((i_sensor[3] == 0) && (i_sensor[4] == 0) && (i_sensor[5] == 0));
+    CHECK(Telemetry_Get_Altitude() == 123.5f);
+
+    Gcs_Hil_Sensor(f_accel, f_gyro, 0.0f);          // 1 g forward, 1 g left, 2 g pull
+    Telemetry_Get_Sensors(i_sensor);                // raw = sign * AHRS input
+    CHECK(i_sensor[0] == 64);                       // sign -1, -1 g
+    CHECK(i_sensor[1] == 64);                       // sign +1, +1 g
+    CHECK(i_sensor[2] == 64);                       // sign +1, +2 g - gravity
+    CHECK(i_sensor[3] == 82);                       // 0.1 rad/s / GYRO_GAIN
+    CHECK(i_sensor[4] == -82);
+    CHECK(i_sensor[5] == 82);
+
+    memset(uc_payload, 0, sizeof(uc_payload));      // HIL_GPS
+    l_value = 445000000;
+    memcpy(&uc_payload[8], &l_value, 4);
+    l_value = 82500000;
+    memcpy(&uc_payload[12], &l_value, 4);
+    l_value = 250000;
+    memcpy(&uc_payload[16], &l_value, 4);
+    ui_value = 1500;
+    memcpy(&uc_payload[24], &ui_value, 2);
+    ui_value = 9000;
+    memcpy(&uc_payload[32], &ui_value, 2);
+    uc_payload[34] = 3;
+    Gcs_Send(ID_HIL_GPS, CRC_HIL_GPS, uc_payload, 36);
+    CHECK(Telemetry_Get_Gps(&x_gps));
+    CHECK((x_gps.lLat == 445000000) && (x_gps.lLon == 82500000) && (x_gps.lAlt == 250000));
+    CHECK((x_gps.uiSpeed == 1500) && (x_gps.uiCourse == 9000) && (x_gps.ucFix == 3));
+    CHECK(!Telemetry_Get_Gps(&x_gps));              // read once
+
+    memset(uc_payload, 0, sizeof(uc_payload));      // HIL_STATE
+    memcpy(&uc_payload[20], f_gyro, 12);
+    l_value = 440000000;
+    memcpy(&uc_payload[32], &l_value, 4);
+    l_value = 80000000;
+    memcpy(&uc_payload[36], &l_value, 4);
+    l_value = 321000;
+    memcpy(&uc_payload[40], &l_value, 4);
+    i_value = -300;                                 // south
+    memcpy(&uc_payload[44], &i_value, 2);
+    i_value = -400;                                 // west
+    memcpy(&uc_payload[46], &i_value, 2);
+    i_value = -1000;                                // level, -1 g
+    memcpy(&uc_payload[54], &i_value, 2);
+    Gcs_Send(ID_HIL_STATE, CRC_HIL_STATE, uc_payload, 56);
+    Telemetry_Get_Sensors(i_sensor);
+    CHECK((i_sensor[0] == 0) && (i_sensor[2] == 0) && (i_sensor[3] == 82));
+    CHECK(Telemetry_Get_Altitude() == 321.0f);
+    CHECK(Telemetry_Get_Gps(&x_gps));
+    CHECK((x_gps.lLat == 440000000) && (x_gps.lLon == 80000000) && (x_gps.lAlt == 321000));
+    CHECK(x_gps.uiSpeed == 500);
+    CHECK((x_gps.uiCourse >= 23312) && (x_gps.uiCourse <= 23314)); // 233.13 deg
+
+    ui_Controls = 0;
+    Mavlink_Hil_Controls();                         // servos at neutral
+    Replies();
+    CHECK(ui_Controls == 1);
+    memcpy(&f_value, &uc_Controls[8], 4);
+    CHECK(f_value == 0.0f);                         // aileron
+    memcpy(&f_value, &uc_Controls[20], 4);
+    CHECK(f_value == 0.5f);                         // throttle
+    CHECK(uc_Controls[40] == 160);                  // armed, HIL enabled
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sends COMMAND_LONG
+/// \param   uiCommand = MAV_CMD
+/// \param   fParam1 = parameter 1
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Gcs_Command(uint16_t uiCommand, float fParam1)
+{
+    uint8_t uc_payload[33];
+
+    memset(uc_payload, 0, sizeof(uc_payload));
+    memcpy(&uc_payload[0], &fParam1, 4);
+    memcpy(&uc_payload[28], &uiCommand, 2);
+    uc_payload[30] = 1;                             // target system
+    uc_payload[31] = 1;                             // target component
+    Gcs_Send(ID_COMMAND_LONG, CRC_COMMAND_LONG, uc_payload, 33);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   gyro calibration command
+/// \return  -
+/// \remarks calibration is requested only when accepted
+///
+///----------------------------------------------------------------------------
+static void Test_Command(void)
+{
+    b_On_Ground = FALSE;                            // flying
+    Gcs_Command(CMD_PREFLIGHT_CALIBRATION, 1.0f);
+    CHECK(ui_Result == RESULT_REJECTED);
+    CHECK(ui_Calibrations == 0);
+
+    b_On_Ground = TRUE;                             // on ground
+    Gcs_Command(CMD_PREFLIGHT_CALIBRATION, 1.0f);
+    CHECK(ui_Result == RESULT_ACCEPTED);
+    CHECK(ui_Calibrations == 1);
+
+    Gcs_Command(CMD_PREFLIGHT_CALIBRATION, 0.0f);   // no gyro calibration
+    CHECK(ui_Result == RESULT_UNSUPPORTED);
+    CHECK(ui_Calibrations == 1);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Ring_Init(&x_Tx, uc_Tx, sizeof(uc_Tx));
+    Mavlink_Init();
+    Param_Init();
+    Mission_Set_Home(44.0f, 8.0f);
+
+    Test_Upload();
+    Test_Lost();
+    Test_Rejected();
+    Test_Params();
+    Test_Hil();
+    Test_Command();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,402 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of the flight model of the SIL build: sensors at rest, stable
+///  glide and powered climb of every airframe, sign of response to each
+///  control, GPS sentences and their checksums, repeatability with a seed,
+///  aircraft stopped on ground, and steps per second.
+///  Build and run on PC:
+/// \code
+///   gcc -O2 -I../Host -I../../Source -I../../Sil test_model.c ../../Sil/model.c -lm
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "model.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup sil
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define TICK            0.001f      //!< time step, as in SIL build [s]
+#define TRIM_TIME       3.0f        //!< time to settle after launch [s]
+#define BENCH_STEPS     2000000     //!< benchmark steps
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/// airframes of config.h
+VAR_STATIC const uint8_t uc_Airframes[] = { EASYSTAR, TYCHO, LEUKO, EPPFPV };
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   starts an ideal flight, launched at once
+/// \param   ucAirframe = airframe
+/// \param   fHeight = launch height [m]
+/// \return  -
+/// \remarks no noise, calm air
+///
+///----------------------------------------------------------------------------
+static void Start(uint8_t ucAirframe, float fHeight)
+{
+    xModel_Options x_options;
+
+    Model_Defaults(&x_options);
+    x_options.ucAirframe = ucAirframe;
+    x_options.fNoise = 0.0f;
+    x_options.fHeight = fHeight;
+    x_options.fLaunch = 0.0f;
+    Model_Init(&x_options);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   flies with constant controls
+/// \param   pfControl = pointer to controls
+/// \param   fTime = duration [s]
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Fly(const float * pfControl, float fTime)
+{
+    uint32_t ul_steps = (uint32_t)(fTime / TICK + 0.5f);
+
+    while (ul_steps-- != 0) {
+        Model_Step(pfControl, TICK);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sensors of aircraft held still
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Test_Rest(void)
+{
+    const float f_zero[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    xModel_Options x_options;
+    float f_accel[3], f_gyro[3];
+
+    Model_Defaults(&x_options);
+    x_options.fNoise = 0.0f;
+    Model_Init(&x_options);
+    Fly(f_zero, 1.0f);
+    Model_Imu(f_accel, f_gyro);
+    CHECK(fabsf(f_accel[0]) < 1e-4f);
+    CHECK(fabsf(f_accel[1]) < 1e-4f);
+    CHECK(fabsf(f_accel[2] + 9.80665f) < 1e-4f);
+    CHECK((f_gyro[0] == 0.0f) && (f_gyro[1] == 0.0f) && (f_gyro[2] == 0.0f));
+    CHECK(fabsf(Model_Baro() - (x_options.fAlt + x_options.fHeight)) < 1e-3f);
+    CHECK(!Model_State()->bFlying && !Model_State()->bLanded);
+    CHECK(strcmp(Model_Airframe(), "EPPFPV") == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   glide and climb of every airframe
+/// \return  -
+/// \remarks Without control the aircraft must neither stall nor diverge:
+///          wings level, airspeed near launch speed, glide ratio of a model
+///          aircraft. With power it must climb.
+///
+///----------------------------------------------------------------------------
+static void Test_Glide_Climb(void)
+{
+    const float f_glide[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float f_climb[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.9f };
+    const xModel_State * p_state = Model_State();
+    float f_distance, f_sink;
+    uint8_t j;
+
+    for (j = 0; j < sizeof(uc_Airframes); j++) {
+        Start(uc_Airframes[j], 100.0f);
+        Fly(f_glide, 40.0f);
+        f_distance = sqrtf((p_state->fPos[0] * p_state->fPos[0]) + (p_state->fPos[1] * p_state->fPos[1]));
+        f_sink = 100.0f + p_state->fPos[2];
+        printf("%-8s glide ratio %4.1f at %4.1f m/s", Model_Airframe(), f_distance / f_sink,
+               p_state->fAirspeed);
+        CHECK(p_state->bFlying);
+        CHECK((f_sink > 0.0f) && (f_distance / f_sink > 5.0f));
+        CHECK((p_state->fAirspeed > 6.0f) && (p_state->fAirspeed < 20.0f));
+        CHECK(fabsf(p_state->fEuler[0]) < ToRad(10.0f));
+
+        Start(uc_Airframes[j], 100.0f);
+        Fly(f_climb, 30.0f);
+        printf(", climb %4.1f m/s\n", (-p_state->fPos[2] - 100.0f) / 30.0f);
+        CHECK(-p_state->fPos[2] > 120.0f);
+        CHECK(fabsf(p_state->fEuler[0]) < ToRad(10.0f));
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   response to controls
+/// \return  -
+/// \remarks From a trimmed flight, a positive command must give a positive
+///          rate against the same flight without it. Rudder only on
+///          aircraft which have one: on TYCHO the aileron command drives the
+///          rudder, and rolls by dihedral.
+///
+///----------------------------------------------------------------------------
+static void Test_Controls(void)
+{
+    const float f_trim[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.5f };
+    const float f_time[MODEL_CONTROLS - 1] = { 1.0f, 0.3f, 0.5f };    // roll, pitch, yaw
+    const xModel_State * p_state = Model_State();
+    float f_control[MODEL_CONTROLS];
+    float f_base;
+    uint8_t j, k;
+
+    for (j = 0; j < sizeof(uc_Airframes); j++) {
+        for (k = MODEL_AILERON; k <= MODEL_RUDDER; k++) {
+            if ((k == MODEL_RUDDER) &&
+                ((uc_Airframes[j] == TYCHO) || (uc_Airframes[j] == LEUKO))) {
+                continue;
+            }
+            Start(uc_Airframes[j], 100.0f);
+            Fly(f_trim, TRIM_TIME + f_time[k]);
+            f_base = p_state->fRate[k];
+
+            memcpy(f_control, f_trim, sizeof(f_control));
+            f_control[k] = 0.5f;
+            Start(uc_Airframes[j], 100.0f);
+            Fly(f_trim, TRIM_TIME);
+            Fly(f_control, f_time[k]);
+            if (p_state->fRate[k] - f_base < 0.05f) {
+                printf("FAIL %s control %u: rate %.3f, without %.3f\n", Model_Airframe(), k,
+                       p_state->fRate[k], f_base);
+                i_Errors++;
+            }
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   GPS sentences
+/// \return  -
+/// \remarks checksums, order, and position read back as the parser of
+///          nav.c does
+///
+///----------------------------------------------------------------------------
+static void Test_Nmea(void)
+{
+    const float f_glide[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const xModel_State * p_state = Model_State();
+    char c_nmea[MODEL_NMEA_SIZE];
+    char * p_sentence;
+    char * p_star;
+    uint8_t uc_sum;
+    unsigned u_sum, u_sentences = 0;
+    double d_lat, d_expected;
+    uint16_t ui_length;
+
+    Start(EPPFPV, 100.0f);
+    Fly(f_glide, 10.0f);
+    ui_length = Model_Nmea(c_nmea);
+    CHECK(ui_length == strlen(c_nmea));
+    CHECK(ui_length < MODEL_NMEA_SIZE);
+    CHECK(strncmp(c_nmea, "$GPGGA,120010.00,", 17) == 0);
+    p_sentence = strstr(c_nmea, "$GPRMC,");
+    CHECK((p_sentence != NULL) && (strncmp(p_sentence + 16, ",A,", 3) == 0));
+
+    for (p_sentence = c_nmea; (p_sentence = strchr(p_sentence, '$')) != NULL; p_sentence++) {
+        p_star = strchr(p_sentence, '*');
+        CHECK(p_star != NULL);
+        if (p_star == NULL) {
+            break;
+        }
+        uc_sum = 0;
+        for (char * p = p_sentence + 1; p < p_star; p++) {
+            uc_sum ^= (uint8_t)*p;
+        }
+        CHECK((sscanf(p_star + 1, "%2X", &u_sum) == 1) && (u_sum == uc_sum));
+        CHECK(strncmp(p_star + 3, "\r\n", 2) == 0);
+        u_sentences++;
+    }
+    CHECK(u_sentences == 2);
+
+    p_sentence = strstr(c_nmea, "$GPRMC,") + 19;            // ddmm.mmmmm
+    d_lat = atof(p_sentence);
+    d_lat = floor(d_lat / 100.0) + (fmod(d_lat, 100.0) / 60.0);
+    d_expected = 45.4642 + (p_state->fPos[0] / 6371000.0) * (180.0 / 3.141592);
+    CHECK(fabs(d_lat - d_expected) < 1e-5);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   repeatability
+/// \return  -
+/// \remarks same seed, same sensors and turbulence; other seed, others
+///
+///----------------------------------------------------------------------------
+static void Test_Seed(void)
+{
+    const float f_glide[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.2f };
+    xModel_Options x_options;
+    float f_imu[3][6];
+    char c_nmea[3][MODEL_NMEA_SIZE];
+    uint8_t j;
+
+    Model_Defaults(&x_options);
+    x_options.fLaunch = 1.0f;
+    x_options.fHeight = 50.0f;
+    x_options.fWind = 5.0f;
+    x_options.fGust = 1.5f;
+    for (j = 0; j < 3; j++) {
+        x_options.ulSeed = (j == 2) ? 2 : 1;
+        Model_Init(&x_options);
+        Fly(f_glide, 20.0f);
+        Model_Imu(&f_imu[j][0], &f_imu[j][3]);
+        (void)Model_Nmea(c_nmea[j]);
+    }
+    CHECK(memcmp(f_imu[0], f_imu[1], sizeof(f_imu[0])) == 0);
+    CHECK(strcmp(c_nmea[0], c_nmea[1]) == 0);
+    CHECK(memcmp(f_imu[0], f_imu[2], sizeof(f_imu[0])) != 0);
+    CHECK(strcmp(c_nmea[0], c_nmea[2]) != 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   landing
+/// \return  -
+/// \remarks aircraft stays where it touched ground
+///
+///----------------------------------------------------------------------------
+static void Test_Landed(void)
+{
+    const float f_glide[MODEL_CONTROLS] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float f_full[MODEL_CONTROLS] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const xModel_State * p_state = Model_State();
+    float f_north;
+
+    Start(EASYSTAR, 5.0f);
+    Fly(f_glide, 30.0f);
+    CHECK(p_state->bLanded && !p_state->bFlying);
+    CHECK((p_state->fPos[2] == 0.0f) && (p_state->fVel[0] == 0.0f));
+    f_north = p_state->fPos[0];
+    Fly(f_full, 5.0f);
+    CHECK(p_state->fPos[0] == f_north);
+    CHECK(p_state->fAirspeed == 0.0f);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   benchmark
+/// \return  -
+/// \remarks steps with sensors, as in the SIL build
+///
+///----------------------------------------------------------------------------
+static void Test_Benchmark(void)
+{
+    const float f_control[MODEL_CONTROLS] = { 0.1f, 0.0f, 0.0f, 0.6f };
+    xModel_Options x_options;
+    float f_accel[3], f_gyro[3];
+    volatile float f_sink;
+    clock_t start;
+    double t_run;
+    uint32_t j;
+
+    Model_Defaults(&x_options);
+    x_options.fLaunch = 0.0f;
+    x_options.fHeight = 100000.0f;
+    x_options.fGust = 1.0f;
+    Model_Init(&x_options);
+    start = clock();
+    for (j = 0; j < BENCH_STEPS; j++) {
+        Model_Step(f_control, TICK);
+        Model_Imu(f_accel, f_gyro);
+        f_sink = Model_Baro() + f_accel[0] + f_gyro[0];
+    }
+    t_run = (double)(clock() - start) / CLOCKS_PER_SEC;
+    (void)f_sink;
+    CHECK(Model_State()->bFlying);
+
+    printf("Model_Step: %.0f steps/s\n", BENCH_STEPS / t_run);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   test program
+/// \return  number of failed checks
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Rest();
+    Test_Glide_Climb();
+    Test_Controls();
+    Test_Nmea();
+    Test_Seed();
+    Test_Landed();
+    Test_Benchmark();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
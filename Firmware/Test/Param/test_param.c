@@ -0,0 +1,212 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of parameter registry: name lookup against a linear search,
+///  names of 16 characters without terminator, bounds, rounding of integer
+///  types and change callbacks.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_param.c ../../Source/param.c -lm
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "stm32f10x.h"
+
+#include "param.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup param
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint16_t ui_Calls[PARAM_NUMBER];         //!< callbacks of each parameter
+VAR_STATIC float f_Last[PARAM_NUMBER];              //!< last value notified
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   change callback
+/// \param   eId = parameter
+/// \param   fValue = new value
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Changed(paramEnum_Id eId, float fValue)
+{
+    ui_Calls[eId]++;
+    f_Last[eId] = fValue;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   name lookup
+/// \return  -
+/// \remarks every name is found, also when padded like a MAVLink param_id,
+///          prefixes, extensions and unknown names are not
+///
+///----------------------------------------------------------------------------
+static void Test_Find(void)
+{
+    uint8_t uc_name[PARAM_NAME_LENGTH + 1];
+    uint8_t j;
+
+    for (j = 0; j < (uint8_t)PARAM_NUMBER; j++) {
+        CHECK(Param_Find(Param_Name((paramEnum_Id)j)) == (paramEnum_Id)j);
+        memset(uc_name, 0, sizeof(uc_name));
+        memcpy(uc_name, Param_Name((paramEnum_Id)j), PARAM_NAME_LENGTH);
+        CHECK(Param_Find(uc_name) == (paramEnum_Id)j);
+
+        uc_name[strlen((char *)uc_name) - 1] = 0;   // prefix
+        CHECK(Param_Find(uc_name) == PARAM_NUMBER);
+        memcpy(uc_name, Param_Name((paramEnum_Id)j), PARAM_NAME_LENGTH);
+        strcat((char *)uc_name, "X");               // extension
+        CHECK(Param_Find(uc_name) == PARAM_NUMBER);
+    }
+    CHECK(Param_Find((const uint8_t *)"") == PARAM_NUMBER);
+    CHECK(Param_Find((const uint8_t *)"AAA") == PARAM_NUMBER);
+    CHECK(Param_Find((const uint8_t *)"ZZZ") == PARAM_NUMBER);
+    CHECK(Param_Find((const uint8_t *)"ROL_ANG_D") == PARAM_NUMBER);
+    memcpy(uc_name, "ROL_ANG_P\0garbage", PARAM_NAME_LENGTH); // bytes after terminator
+    CHECK(Param_Find(uc_name) == PARAM_ROLL_KP);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   bounds and types
+/// \return  -
+/// \remarks rejected values leave parameter unchanged
+///
+///----------------------------------------------------------------------------
+static void Test_Set(void)
+{
+    float f_old = Param_Get(PARAM_ROLL_KP);
+
+    CHECK(Param_Set(PARAM_ROLL_KP, 1.5f));
+    CHECK(Param_Get(PARAM_ROLL_KP) == 1.5f);
+    CHECK(!Param_Set(PARAM_ROLL_KP, -0.1f));
+    CHECK(!Param_Set(PARAM_ROLL_KP, 1000.0f));
+    CHECK(!Param_Set(PARAM_ROLL_KP, NAN));
+    CHECK(!Param_Set(PARAM_ROLL_KP, INFINITY));
+    CHECK(Param_Get(PARAM_ROLL_KP) == 1.5f);
+    CHECK(Param_Set(PARAM_ROLL_KP, f_old));
+    CHECK(!Param_Set(PARAM_NUMBER, 1.0f));
+    CHECK(Param_Get(PARAM_NUMBER) == 0.0f);
+
+    CHECK(Param_Type(PARAM_NAV_BANK) == PARAM_TYPE_UINT8);
+    CHECK(Param_Set(PARAM_NAV_BANK, 30.4f));        // integer type is rounded
+    CHECK(Param_Get(PARAM_NAV_BANK) == 30.0f);
+    CHECK(Param_Set(PARAM_NAV_BANK, 30.6f));
+    CHECK(Param_Get(PARAM_NAV_BANK) == 31.0f);
+    CHECK(!Param_Set(PARAM_NAV_BANK, 90.0f));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   change callbacks
+/// \return  -
+/// \remarks called at registration and on actual changes only
+///
+///----------------------------------------------------------------------------
+static void Test_Notify(void)
+{
+    Param_Init();
+    memset(ui_Calls, 0, sizeof(ui_Calls));
+    Param_Notify(PARAM_PITCH_KP, Changed);
+    CHECK(ui_Calls[PARAM_PITCH_KP] == 1);           // current value at once
+    CHECK(f_Last[PARAM_PITCH_KP] == Param_Get(PARAM_PITCH_KP));
+
+    CHECK(Param_Set(PARAM_PITCH_KP, 2.0f));
+    CHECK((ui_Calls[PARAM_PITCH_KP] == 2) && (f_Last[PARAM_PITCH_KP] == 2.0f));
+    CHECK(Param_Set(PARAM_PITCH_KP, 2.0f));         // same value
+    CHECK(ui_Calls[PARAM_PITCH_KP] == 2);
+    CHECK(!Param_Set(PARAM_PITCH_KP, -1.0f));       // rejected
+    CHECK(ui_Calls[PARAM_PITCH_KP] == 2);
+    CHECK(Param_Set(PARAM_ROLL_KP, 2.0f));          // no callback
+    CHECK(ui_Calls[PARAM_ROLL_KP] == 0);
+
+    Param_Notify(PARAM_PITCH_KP, NULL);             // removed
+    CHECK(Param_Set(PARAM_PITCH_KP, 3.0f));
+    CHECK(ui_Calls[PARAM_PITCH_KP] == 2);
+
+    Param_Notify(PARAM_PITCH_KP, Changed);
+    Param_Init();                                   // defaults, no callbacks
+    CHECK(Param_Set(PARAM_PITCH_KP, 4.0f));
+    CHECK(ui_Calls[PARAM_PITCH_KP] == 3);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Param_Init();
+    Test_Find();
+    Test_Set();
+    Test_Notify();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
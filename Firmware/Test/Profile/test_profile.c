@@ -0,0 +1,203 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of execution time profiler: min, average and max of a zone,
+///  new window after each read, zones kept apart, names fit NAMED_VALUE_INT.
+///  Build and run on PC, host clock in place of DWT cycle counter:
+/// \code
+///   gcc -DSIL -DPROFILE=1 -I../Host -I../../Source test_profile.c ../../Source/profile.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "profile.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup profile
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define SHORT_NS        200000UL    //!< short run of a zone [ns]
+#define LONG_NS         2000000UL   //!< long run of a zone [ns]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   runs a zone for a time
+/// \param   eZone = zone
+/// \param   ulNs = time spent in zone, at least [ns]
+/// \return  -
+/// \remarks busy wait, so that the zone isn't shorter than asked
+///
+///----------------------------------------------------------------------------
+static void Run(profileEnum_Zone eZone, uint32_t ulNs)
+{
+    struct timespec x_start, x_now;
+
+    PROFILE_BEGIN(eZone);
+    clock_gettime(CLOCK_MONOTONIC, &x_start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &x_now);
+    } while ((uint32_t)((x_now.tv_sec - x_start.tv_sec) * 1000000000L +
+                        (x_now.tv_nsec - x_start.tv_nsec)) < ulNs);
+    PROFILE_END(eZone);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   min, average and max of a zone, window restarted by read
+/// \return  -
+/// \remarks upper bounds leave room for a loaded host
+///
+///----------------------------------------------------------------------------
+static void Test_Window(void)
+{
+    uint32_t ul_min, ul_avg, ul_max;
+
+    Profile_Init();
+    CHECK(!Profile_Read(PROFILE_NORMALIZE, &ul_min, &ul_avg, &ul_max));
+    CHECK((ul_min == 0) && (ul_avg == 0) && (ul_max == 0));
+
+    Run(PROFILE_NORMALIZE, SHORT_NS);
+    Run(PROFILE_NORMALIZE, SHORT_NS);
+    Run(PROFILE_NORMALIZE, SHORT_NS);
+    Run(PROFILE_NORMALIZE, LONG_NS);
+    CHECK(Profile_Read(PROFILE_NORMALIZE, &ul_min, &ul_avg, &ul_max));
+    CHECK(ul_min >= SHORT_NS);
+    CHECK(ul_min < LONG_NS);
+    CHECK(ul_max >= LONG_NS);
+    CHECK(ul_avg >= (3 * SHORT_NS + LONG_NS) / 4);
+    CHECK(ul_avg < ul_max);
+    CHECK(ul_avg > ul_min);
+
+    CHECK(!Profile_Read(PROFILE_NORMALIZE, &ul_min, &ul_avg, &ul_max));
+    Run(PROFILE_NORMALIZE, SHORT_NS);               // long run forgotten
+    CHECK(Profile_Read(PROFILE_NORMALIZE, &ul_min, &ul_avg, &ul_max));
+    CHECK(ul_min >= SHORT_NS);
+    CHECK(ul_max < LONG_NS);
+    CHECK((ul_min == ul_avg) && (ul_avg == ul_max));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   zones counted apart, even when nested
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Test_Zones(void)
+{
+    uint32_t ul_min, ul_avg, ul_max;
+
+    Profile_Init();
+    PROFILE_BEGIN(PROFILE_STREAM_SEND);
+    Run(PROFILE_PARSE_GPS, SHORT_NS);
+    Run(PROFILE_PARSE_GPS, SHORT_NS);
+    PROFILE_END(PROFILE_STREAM_SEND);
+
+    CHECK(Profile_Read(PROFILE_PARSE_GPS, &ul_min, &ul_avg, &ul_max));
+    CHECK(ul_min >= SHORT_NS);
+    CHECK(Profile_Read(PROFILE_STREAM_SEND, &ul_min, &ul_avg, &ul_max));
+    CHECK(ul_min >= 2 * SHORT_NS);
+    CHECK(!Profile_Read(PROFILE_MATRIX_UPDATE, &ul_min, &ul_avg, &ul_max));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   names are distinct and fit in NAMED_VALUE_INT with a suffix
+/// \return  -
+/// \remarks name field is 10 characters, suffix is 4
+///
+///----------------------------------------------------------------------------
+static void Test_Names(void)
+{
+    uint8_t j, k;
+
+    CHECK(PROFILE_NAME_LEN + 4 <= 10);
+    for (j = 0; j < (uint8_t)PROFILE_ZONES; j++) {
+        CHECK(strlen(Profile_Name((profileEnum_Zone)j)) > 0);
+        CHECK(strlen(Profile_Name((profileEnum_Zone)j)) <= PROFILE_NAME_LEN);
+        for (k = 0; k < j; k++) {
+            CHECK(strcmp(Profile_Name((profileEnum_Zone)j),
+                         Profile_Name((profileEnum_Zone)k)) != 0);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Window();
+    Test_Zones();
+    Test_Names();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,241 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of warm restart: preserved state accepted after a watchdog
+///  reset only, cold boot on bad signature or CRC, at most RESTART_MAX
+///  consecutive warm restarts, counter cleared after RESTART_STABLE saves.
+///  A reset is emulated by calling Restart_Init again, preserved state is
+///  kept as the no init RAM region is.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_restart.c ../../Source/restart.c
+///       ../../Source/crc.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+
+#include "crc.h"
+#include "DCM.h"
+#include "restart.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup restart
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define MODE_NAV    3           //!< a control mode
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+VAR_STATIC const int16_t i_Offset[6] = { 10, -20, 30, -40, 50, -60 };
+VAR_STATIC const int16_t i_Servo[3] = { 1400, 1550, 1800 };
+
+/*---------------------------------- Globals ---------------------------------*/
+
+float DCM_Matrix[3][3] = {                          //!< DCM stub, banked
+    { 0.9f, 0.1f, 0.0f },
+    { -0.1f, 0.9f, 0.3f },
+    { 0.0f, -0.3f, 0.9f }
+};
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   stub of DCM gyro bias
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+void GetGyroBias(float * bias)
+{
+    bias[0] = 0.01f;
+    bias[1] = -0.02f;
+    bias[2] = 0.03f;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   flies for a number of AHRS cycles
+/// \param   uiSaves = number of saves
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Fly(uint16_t uiSaves)
+{
+    while (uiSaves-- != 0) {
+        Restart_Save(i_Offset, i_Servo, MODE_NAV);
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   valid state restored after watchdog reset only
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Test_Valid(void)
+{
+    const xRestart_State * p_state = Restart_Get();
+
+    CHECK(!Restart_Init(FALSE));                    // power up
+    CHECK(!Restart_Warm());
+    Restart_Set_Home(44.5f, 8.25f);
+    Restart_Set_Wpt(4);
+    Fly(1);
+
+    CHECK(Restart_Init(TRUE));                      // watchdog reset
+    CHECK(Restart_Warm());
+    CHECK(p_state->ucMode == MODE_NAV);
+    CHECK(memcmp(p_state->iOffset, i_Offset, sizeof(i_Offset)) == 0);
+    CHECK(memcmp(p_state->iServo, i_Servo, sizeof(i_Servo)) == 0);
+    CHECK((p_state->fDCM[1][2] == 0.3f) && (p_state->fBias[1] == -0.02f));
+    CHECK((p_state->ucHome == 1) && (p_state->fHome_Lat == 44.5f) && (p_state->fHome_Lon == 8.25f));
+    CHECK(p_state->uiWpt_Index == 4);
+    Fly(1);                                         // restored home and waypoint saved again
+    CHECK((p_state->ucHome == 1) && (p_state->fHome_Lon == 8.25f) && (p_state->uiWpt_Index == 4));
+    CHECK(p_state->ucCount == 1);
+
+    CHECK(!Restart_Init(FALSE));                    // other reset: cold boot
+    CHECK(!Restart_Init(TRUE));                     // state was invalidated
+    Fly(1);
+    CHECK((p_state->ucHome == 0) && (p_state->uiWpt_Index == 0));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   corrupted state gives a cold boot
+/// \return  -
+/// \remarks RAM is changed as a crash writing at random would
+///
+///----------------------------------------------------------------------------
+static void Test_Corrupted(void)
+{
+    xRestart_State * p_state = (xRestart_State *)Restart_Get();
+
+    CHECK(!Restart_Init(FALSE));
+    Fly(1);
+    p_state->ulMagic ^= 0x00010000;                 // bad signature, e.g. other version
+    p_state->uiCrc = Crc_X25(CRC_X25_INIT, (const uint8_t *)p_state,
+                             offsetof(xRestart_State, uiCrc)); // with good CRC
+    CHECK(!Restart_Init(TRUE));
+    CHECK(!Restart_Warm());
+
+    Fly(1);
+    p_state->iServo[2] += 1;                        // bad CRC
+    CHECK(!Restart_Init(TRUE));
+
+    Fly(1);
+    p_state->uiCrc ^= 0x8000;                       // bad CRC field
+    CHECK(!Restart_Init(TRUE));
+
+    Fly(1);                                         // good again
+    CHECK(Restart_Init(TRUE));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   consecutive warm restarts limited, counter cleared when stable
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Test_Count(void)
+{
+    uint8_t j;
+
+    CHECK(!Restart_Init(FALSE));
+    Fly(1);
+    for (j = 1; j <= RESTART_MAX; j++) {            // resets soon after restart
+        CHECK(Restart_Init(TRUE));
+        Fly(RESTART_STABLE - 1);
+        CHECK(Restart_Get()->ucCount == j);
+    }
+    CHECK(!Restart_Init(TRUE));                     // state causes resets
+    CHECK(!Restart_Warm());
+
+    Fly(1);
+    CHECK(Restart_Init(TRUE));
+    Fly(RESTART_STABLE - 1);
+    CHECK(Restart_Get()->ucCount == 1);
+    Fly(1);                                         // stable
+    CHECK(Restart_Get()->ucCount == 0);
+    for (j = 1; j <= RESTART_MAX; j++) {            // full count again
+        CHECK(Restart_Init(TRUE));
+        Fly(1);
+    }
+    CHECK(!Restart_Init(TRUE));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Valid();
+    Test_Corrupted();
+    Test_Count();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
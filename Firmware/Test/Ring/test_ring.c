@@ -0,0 +1,338 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of transmit ring: back pressure, wrap of blocks at end of
+///  buffer, partial DMA transfers, messages built in place and a random
+///  producer / consumer run checked against the accepted byte stream.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_ring.c ../../Source/ring.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+
+#include "ring.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup ring
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define RING_SIZE       256         //!< same size as USART1 transmit ring
+#define RANDOM_STEPS    200000      //!< steps of random producer / consumer run
+#define STREAM_SIZE     (RANDOM_STEPS * 45)
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint8_t uc_Buffer[RING_SIZE];            //!< ring buffer
+VAR_STATIC xRing x_Ring;                            //!< ring under test
+VAR_STATIC uint8_t uc_Sent[STREAM_SIZE];            //!< accepted bytes
+VAR_STATIC uint8_t uc_Received[STREAM_SIZE];        //!< transferred bytes
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   back pressure
+/// \return  -
+/// \remarks a write that doesn't fit is rejected as a whole
+///
+///----------------------------------------------------------------------------
+static void Test_Back_Pressure(void)
+{
+    uint8_t uc_data[RING_SIZE];
+
+    memset(uc_data, 0x55, sizeof(uc_data));
+    Ring_Init(&x_Ring, uc_Buffer, RING_SIZE);
+    CHECK(Ring_Used(&x_Ring) == 0);
+    CHECK(Ring_Free(&x_Ring) == RING_SIZE - 1);
+
+    CHECK(Ring_Write(&x_Ring, uc_data, 200));
+    CHECK(Ring_Used(&x_Ring) == 200);
+    CHECK(!Ring_Write(&x_Ring, uc_data, 56));       // one byte too many
+    CHECK(Ring_Used(&x_Ring) == 200);               // nothing written
+    CHECK(x_Ring.uiDropped == 1);
+    CHECK(Ring_Write(&x_Ring, uc_data, 55));        // exactly full
+    CHECK(Ring_Free(&x_Ring) == 0);
+    CHECK(!Ring_Write(&x_Ring, uc_data, 1));
+    CHECK(x_Ring.uiDropped == 2);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   blocks and wrap
+/// \return  -
+/// \remarks wrapped data are sent with two blocks, data written during a
+///          transfer are sent with next block
+///
+///----------------------------------------------------------------------------
+static void Test_Wrap(void)
+{
+    uint8_t uc_data[100];
+    uint8_t * p_block;
+    uint16_t j, ui_length;
+
+    for (j = 0; j < sizeof(uc_data); j++) {
+        uc_data[j] = (uint8_t)j;
+    }
+    Ring_Init(&x_Ring, uc_Buffer, RING_SIZE);
+    CHECK(Ring_Block_Start(&x_Ring, &p_block) == 0);    // empty
+
+    (void)Ring_Write(&x_Ring, uc_data, 100);            // move indexes to 200
+    (void)Ring_Write(&x_Ring, uc_data, 100);
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);
+    CHECK(ui_length == 200);
+    CHECK(p_block == &uc_Buffer[0]);
+    CHECK(Ring_Block_Start(&x_Ring, &p_block) == 0);    // busy
+    Ring_Block_End(&x_Ring, 0);
+    CHECK(Ring_Write(&x_Ring, uc_data, 100));           // wraps
+    CHECK(Ring_Used(&x_Ring) == 100);
+
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);    // up to end of buffer
+    CHECK(ui_length == 56);
+    CHECK(p_block == &uc_Buffer[200]);
+    CHECK(memcmp(p_block, uc_data, 56) == 0);
+    CHECK(Ring_Write(&x_Ring, uc_data, 20));            // during transfer
+    Ring_Block_End(&x_Ring, 0);
+
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);    // from start of buffer
+    CHECK(ui_length == 64);
+    CHECK(p_block == &uc_Buffer[0]);
+    CHECK(memcmp(p_block, &uc_data[56], 44) == 0);
+    CHECK(memcmp(&p_block[44], uc_data, 20) == 0);
+    Ring_Block_End(&x_Ring, 0);
+    CHECK(Ring_Used(&x_Ring) == 0);
+    CHECK(Ring_Block_Start(&x_Ring, &p_block) == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   partial transfer
+/// \return  -
+/// \remarks bytes left by DMA are sent again from the right position
+///
+///----------------------------------------------------------------------------
+static void Test_Partial(void)
+{
+    uint8_t uc_data[60];
+    uint8_t * p_block;
+    uint16_t j, ui_length;
+
+    for (j = 0; j < sizeof(uc_data); j++) {
+        uc_data[j] = (uint8_t)(j + 1);
+    }
+    Ring_Init(&x_Ring, uc_Buffer, RING_SIZE);
+    (void)Ring_Write(&x_Ring, uc_data, 60);
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);
+    CHECK(ui_length == 60);
+    Ring_Block_End(&x_Ring, 25);                        // 35 bytes sent
+    CHECK(Ring_Used(&x_Ring) == 25);
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);
+    CHECK(ui_length == 25);
+    CHECK(p_block[0] == 36);
+    Ring_Block_End(&x_Ring, 1000);                      // counter out of range
+    CHECK(Ring_Used(&x_Ring) == 25);                    // nothing released
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);
+    CHECK(ui_length == 25);
+    Ring_Block_End(&x_Ring, 0);
+    CHECK(Ring_Used(&x_Ring) == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   messages built in place
+/// \return  -
+/// \remarks reserved bytes are invisible until committed, a message that
+///          isn't committed is discarded, a message may wrap
+///
+///----------------------------------------------------------------------------
+static void Test_Reserve(void)
+{
+    uint8_t uc_data[250];
+    uint8_t * p_block;
+    uint16_t j, ui_length;
+
+    memset(uc_data, 0xAA, sizeof(uc_data));
+    Ring_Init(&x_Ring, uc_Buffer, RING_SIZE);
+    (void)Ring_Write(&x_Ring, uc_data, 250);            // move indexes to 250
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);
+    Ring_Block_End(&x_Ring, 0);
+    CHECK(ui_length == 250);
+
+    CHECK(Ring_Reserve(&x_Ring, 20));
+    for (j = 0; j < 20; j++) {
+        Ring_Put(&x_Ring, (uint8_t)j);
+    }
+    CHECK(Ring_Used(&x_Ring) == 0);                     // not committed
+    CHECK(Ring_Block_Start(&x_Ring, &p_block) == 0);
+
+    CHECK(Ring_Reserve(&x_Ring, 20));                   // previous one discarded
+    for (j = 0; j < 20; j++) {
+        Ring_Put(&x_Ring, (uint8_t)(j + 100));
+    }
+    CHECK(*Ring_Reserved(&x_Ring, 0) == 100);           // read back
+    CHECK(*Ring_Reserved(&x_Ring, 10) == 110);          // wrapped
+    *Ring_Reserved(&x_Ring, 1) = 0xEE;                  // patch in place
+    Ring_Commit(&x_Ring);
+    CHECK(Ring_Used(&x_Ring) == 20);
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);    // up to end of buffer
+    CHECK(ui_length == 6);
+    CHECK((p_block[0] == 100) && (p_block[5] == 105));
+    CHECK(p_block[1] == 0xEE);
+    Ring_Block_End(&x_Ring, 0);
+    ui_length = Ring_Block_Start(&x_Ring, &p_block);    // from start of buffer
+    CHECK(ui_length == 14);
+    CHECK((p_block[0] == 106) && (p_block[13] == 119));
+    Ring_Block_End(&x_Ring, 0);
+
+    (void)Ring_Write(&x_Ring, uc_data, 250);
+    CHECK(!Ring_Reserve(&x_Ring, 6));                   // back pressure
+    CHECK(x_Ring.uiDropped == 1);
+    CHECK(Ring_Reserve(&x_Ring, 5));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   random producer and consumer
+/// \return  -
+/// \remarks producer writes or builds MAVLink sized messages, consumer transfers blocks
+///          and sometimes stops them early. Received stream must be equal to
+///          the stream of accepted messages.
+///
+///----------------------------------------------------------------------------
+static void Test_Random(void)
+{
+    uint8_t uc_msg[64];
+    uint8_t * p_block = 0;
+    uint16_t j, ui_length, ui_done;
+    uint32_t ul_step, ul_sent = 0, ul_received = 0, ul_dropped = 0;
+    uint8_t uc_seq = 0;
+    bool b_busy = FALSE;
+    bool b_accepted;
+
+    srand(1);
+    Ring_Init(&x_Ring, uc_Buffer, RING_SIZE);
+    for (ul_step = 0; ul_step < RANDOM_STEPS; ul_step++) {
+        if ((rand() % 3) != 0) {                            // producer
+            ui_length = 8 + (rand() % 50);
+            for (j = 0; j < ui_length; j++) {
+                uc_msg[j] = uc_seq++;
+            }
+            if ((rand() % 2) == 0) {                        // built in place
+                b_accepted = Ring_Reserve(&x_Ring, ui_length);
+                if (b_accepted) {
+                    for (j = 0; j < ui_length; j++) {
+                        Ring_Put(&x_Ring, uc_msg[j]);
+                    }
+                    Ring_Commit(&x_Ring);
+                }
+            } else {
+                b_accepted = Ring_Write(&x_Ring, uc_msg, ui_length);
+            }
+            if (b_accepted) {
+                memcpy(&uc_Sent[ul_sent], uc_msg, ui_length);
+                ul_sent += ui_length;
+            } else {
+                ul_dropped++;
+                uc_seq -= (uint8_t)ui_length;
+            }
+        }
+        if (!b_busy) {                                      // consumer start
+            ui_length = Ring_Block_Start(&x_Ring, &p_block);
+            CHECK(ui_length <= RING_SIZE - 1);
+            CHECK((p_block + ui_length) <= &uc_Buffer[RING_SIZE]);
+            b_busy = (ui_length != 0);
+        } else if ((rand() % 2) == 0) {                     // consumer end
+            ui_done = x_Ring.uiBlock;
+            if ((rand() % 8) == 0) {                        // stopped early
+                ui_done = rand() % (x_Ring.uiBlock + 1);
+            }
+            memcpy(&uc_Received[ul_received], p_block, ui_done);
+            ul_received += ui_done;
+            Ring_Block_End(&x_Ring, x_Ring.uiBlock - ui_done);
+            b_busy = FALSE;
+        }
+        CHECK(Ring_Used(&x_Ring) + Ring_Free(&x_Ring) == RING_SIZE - 1);
+    }
+    CHECK(ul_received <= ul_sent);
+    CHECK(memcmp(uc_Sent, uc_Received, ul_received) == 0);
+    CHECK((ul_sent - ul_received) == Ring_Used(&x_Ring));
+    CHECK(x_Ring.uiDropped == (uint16_t)ul_dropped);
+    printf("random run: %lu bytes sent, %lu received, %lu messages dropped\n",
+           (unsigned long)ul_sent, (unsigned long)ul_received, (unsigned long)ul_dropped);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   test program
+/// \return  number of failed checks
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Back_Pressure();
+    Test_Wrap();
+    Test_Partial();
+    Test_Reserve();
+    Test_Random();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,380 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of simulator binary protocol: sensor and gain frames are
+///  decoded, frames with bad CRC or length are discarded and resync on next
+///  frame, sequence gaps are counted, downlink frames are well formed and
+///  carry the link counters.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_simulator.c ../../Source/simulator.c
+///       ../../Source/crc.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f10x.h"
+
+#include "config.h"
+#include "crc.h"
+#include "ring.h"
+#include "usart1driver.h"
+#include "servodriver.h"
+#include "nav.h"
+#include "simulator.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup simulator
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define SIM_SERVO_POS   0xF1        //!< message types, as in simulator.c
+#define SIM_WAYPOINT    0xF2
+#define SIM_DCM         0xF7
+#define SIM_SENSORS     0xF8
+#define SIM_GAINS       0xF9
+#define SIM_LINK        0xFA
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+float DCM_Matrix[3][3] = {                          //!< DCM stub, identity
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f }
+};
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint8_t uc_Rx[256];                      //!< frames from simulator
+VAR_STATIC uint16_t ui_Rx_Length = 0;               //!< length of frames
+VAR_STATIC uint16_t ui_Rx_Index = 0;                //!< next byte read by parser
+VAR_STATIC uint8_t uc_Rx_Seq = 0;                   //!< simulator sequence
+VAR_STATIC uint8_t uc_Tx[64];                       //!< last frame sent
+VAR_STATIC uint16_t ui_Tx_Length = 0;               //!< length of last frame
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   stubs of drivers and tasks used by simulator interface
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+bool USART1_Getch(uint8_t * c)
+{
+    if (ui_Rx_Index < ui_Rx_Length) {
+        *c = uc_Rx[ui_Rx_Index++];
+        return TRUE;
+    }
+    return FALSE;
+}
+bool USART1_Write(const uint8_t * pucData, uint16_t uiLength)
+{
+    memcpy(uc_Tx, pucData, uiLength);
+    ui_Tx_Length = uiLength;
+    return TRUE;
+}
+int16_t Servo_Get(SERVO_TYPE servo) { return 1000 + 100 * (int16_t)servo; }
+float Nav_Bearing_Deg(void) { return 270.0f; }
+uint16_t Nav_Distance(void) { return 1234; }
+uint16_t Nav_Wpt_Index(void) { return 3; }
+uint16_t Nav_Wpt_Altitude(void) { return 150; }
+
+///----------------------------------------------------------------------------
+///
+/// \brief   appends a frame to receive buffer
+/// \param   ucType = message type
+/// \param   pucPayload = payload
+/// \param   ucLength = payload length
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Sim_Append(uint8_t ucType, const uint8_t * pucPayload, uint8_t ucLength)
+{
+    uint8_t * p = &uc_Rx[ui_Rx_Length];
+    uint16_t ui_crc;
+
+    p[0] = 0xA5;
+    p[1] = 0x5A;
+    p[2] = ucLength;
+    p[3] = uc_Rx_Seq++;
+    p[4] = ucType;
+    memcpy(&p[5], pucPayload, ucLength);
+    ui_crc = Crc_X25(CRC_X25_INIT, &p[2], ucLength + 3);
+    p[5 + ucLength] = (uint8_t)ui_crc;
+    p[6 + ucLength] = (uint8_t)(ui_crc >> 8);
+    ui_Rx_Length += ucLength + 7;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   appends a sensor frame
+/// \param   iBase = first sensor value, following ones incremented
+/// \param   iAltitude = altitude [m]
+/// \return  -
+/// \remarks true air speed is 25.00 m/s
+///
+///----------------------------------------------------------------------------
+static void Sim_Sensors(int16_t iBase, int16_t iAltitude)
+{
+    uint8_t uc_payload[16];
+    int16_t i_value[8];
+    uint8_t j;
+
+    for (j = 0; j < 6; j++) {
+        i_value[j] = iBase + j;
+    }
+    i_value[6] = 2500;
+    i_value[7] = iAltitude;
+    memcpy(uc_payload, i_value, 16);                // host is little endian
+    Sim_Append(SIM_SENSORS, uc_payload, 16);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   runs parser on receive buffer, then clears it
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Sim_Parse(void)
+{
+    Simulator_Parse();
+    ui_Rx_Length = 0;
+    ui_Rx_Index = 0;
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   checks frame just sent
+/// \param   ucType = expected message type
+/// \param   ucLength = expected payload length
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Check_Tx(uint8_t ucType, uint8_t ucLength)
+{
+    uint16_t ui_crc;
+
+    CHECK(ui_Tx_Length == ucLength + 7);
+    CHECK((uc_Tx[0] == 0xA5) && (uc_Tx[1] == 0x5A));
+    CHECK((uc_Tx[2] == ucLength) && (uc_Tx[4] == ucType));
+    ui_crc = Crc_X25(CRC_X25_INIT, &uc_Tx[2], ucLength + 3);
+    CHECK((uc_Tx[5 + ucLength] == (uint8_t)ui_crc) && (uc_Tx[6 + ucLength] == (uint8_t)(ui_crc >> 8)));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   decode of sensor and gain frames
+/// \return  -
+/// \remarks several frames queued in one tick: newest one is used
+///
+///----------------------------------------------------------------------------
+static void Test_Decode(void)
+{
+    int16_t i_sensor[6];
+    uint16_t ui_gain[6] = { 1980, 100, 3000, 0, 10000, 65535 };
+
+    CHECK(Simulator_Get_Gain(SIM_PITCH_KP) == PITCH_KP);    // defaults
+
+    Sim_Sensors(-100, 300);
+    Sim_Sensors(-200, -12);
+    Sim_Append(SIM_GAINS, (const uint8_t *)ui_gain, 12);
+    Sim_Parse();
+    Simulator_Get_Raw_IMU(i_sensor);
+    CHECK((i_sensor[0] == -200) && (i_sensor[5] == -195));
+    CHECK(Simulator_Get_Speed() == 25.0f);
+    CHECK(Simulator_Get_Altitude() == -12.0f);
+    CHECK(Simulator_Get_Gain(SIM_PITCH_KP) == 0.99f);
+    CHECK(Simulator_Get_Gain(SIM_ROLL_KP) == 1.5f);
+    CHECK(Simulator_Get_Gain(SIM_NAV_KI) == 65535.0f / 2000.0f);
+    CHECK(Simulator_Get_Lost() == 0);
+    CHECK(Simulator_Get_Errors() == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   corrupted frames and resync
+/// \return  -
+/// \remarks a frame split across two ticks is decoded too
+///
+///----------------------------------------------------------------------------
+static void Test_Errors(void)
+{
+    int16_t i_sensor[6];
+    uint16_t ui_start;
+    uint8_t uc_long[20] = { 0 };
+
+    ui_start = ui_Rx_Length;
+    Sim_Sensors(500, 100);
+    uc_Rx[ui_start + 10] ^= 0x01;                   // bad CRC
+    Sim_Parse();
+    Simulator_Get_Raw_IMU(i_sensor);
+    CHECK(i_sensor[0] == -200);                     // unchanged
+    CHECK(Simulator_Get_Errors() == 1);
+
+    uc_Rx[ui_Rx_Length++] = 0xA5;                   // noise, partial sync
+    uc_Rx[ui_Rx_Length++] = 0xA5;
+    uc_Rx[ui_Rx_Length++] = 0x00;
+    Sim_Append(SIM_SENSORS, uc_long, 20);           // too long
+    Sim_Sensors(600, 100);
+    Sim_Parse();
+    Simulator_Get_Raw_IMU(i_sensor);
+    CHECK(i_sensor[0] == 600);
+    CHECK(Simulator_Get_Errors() == 2);
+
+    Sim_Sensors(700, 100);                          // split frame
+    ui_Rx_Length = 10;
+    Simulator_Parse();
+    ui_Rx_Length = 23;
+    Sim_Parse();
+    Simulator_Get_Raw_IMU(i_sensor);
+    CHECK(i_sensor[0] == 700);
+    CHECK(Simulator_Get_Errors() == 2);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   lost frames from sequence gaps
+/// \return  -
+/// \remarks discarded frames are counted as lost too, by their sequence
+///
+///----------------------------------------------------------------------------
+static void Test_Lost(void)
+{
+    uint16_t ui_lost = Simulator_Get_Lost();
+    uint16_t j;
+    uint8_t uc_seq;
+
+    CHECK(ui_lost == 2);                            // bad CRC and too long frames
+    uc_Rx_Seq += 5;                                 // 5 frames dropped
+    Sim_Sensors(0, 0);
+    Sim_Parse();
+    CHECK(Simulator_Get_Lost() == ui_lost + 5);
+    ui_lost = Simulator_Get_Lost();
+    for (j = 0; j < 300; j++) {                     // wrap around, no gap
+        Sim_Sensors(0, 0);
+        Sim_Parse();
+    }
+    CHECK(Simulator_Get_Lost() == ui_lost);
+    uc_seq = uc_Rx_Seq;
+    uc_Rx_Seq = 254;                                // gap across wrap around
+    Sim_Sensors(0, 0);
+    uc_Rx_Seq = 1;
+    Sim_Sensors(0, 0);
+    Sim_Parse();
+    CHECK(Simulator_Get_Lost() == ui_lost + (uint8_t)(254 - uc_seq) + 2);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   downlink frames
+/// \return  -
+/// \remarks sequence number is incremented by each frame
+///
+///----------------------------------------------------------------------------
+static void Test_Downlink(void)
+{
+    int16_t i_value[9];
+    uint16_t ui_value[3];
+    uint8_t uc_seq;
+
+    Simulator_Send_Controls();
+    Check_Tx(SIM_SERVO_POS, 8);
+    uc_seq = uc_Tx[3];
+    memcpy(i_value, &uc_Tx[5], 8);
+    CHECK((i_value[0] == 1000 + 100 * SERVO_ELEVATOR) && (i_value[1] == 1000 + 100 * SERVO_AILERON));
+    CHECK((i_value[2] == 1000 + 100 * SERVO_RUDDER) && (i_value[3] == 1000 + 100 * SERVO_THROTTLE));
+
+    Simulator_Send_Waypoint();
+    Check_Tx(SIM_WAYPOINT, 7);
+    CHECK(uc_Tx[3] == (uint8_t)(uc_seq + 1));
+    CHECK(uc_Tx[5] == 3);
+    memcpy(ui_value, &uc_Tx[6], 6);
+    CHECK((ui_value[0] == 270) && (ui_value[1] == 150) && (ui_value[2] == 1234));
+
+    DCM_Matrix[0][1] = -0.5f;
+    Simulator_Send_DCM();
+    Check_Tx(SIM_DCM, 18);
+    CHECK(uc_Tx[3] == (uint8_t)(uc_seq + 2));
+    memcpy(i_value, &uc_Tx[5], 18);
+    CHECK((i_value[0] == 16384) && (i_value[1] == -8192) && (i_value[4] == 16384) && (i_value[8] == 16384));
+
+    Simulator_Send_Link();
+    Check_Tx(SIM_LINK, 4);
+    CHECK(uc_Tx[3] == (uint8_t)(uc_seq + 3));
+    memcpy(ui_value, &uc_Tx[5], 4);
+    CHECK((ui_value[0] == Simulator_Get_Lost()) && (ui_value[1] == Simulator_Get_Errors()));
+    CHECK((ui_value[0] != 0) && (ui_value[1] == 2));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Decode();
+    Test_Errors();
+    Test_Lost();
+    Test_Downlink();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,381 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of parameter store on simulated flash: first use, save and
+///  load, compaction without erase, page wear, and power cuts at every flash
+///  operation of a save and of the erase at start up.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_store.c ../Host/flash.c ../../Source/store.c
+///       ../../Source/param.c ../../Source/crc.c -lm
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stm32f10x.h"
+#include "stm32f10x_flash.h"
+
+#include "config.h"
+#include "crc.h"
+#include "param.h"
+#include "store.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup store
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+/* half words programmed by a compaction of all parameters */
+#define MAX_COMPACTION      (4 * (PARAM_NUMBER + 1))
+
+/* half words programmed by a save appending a record and compacting three */
+#define CUT_OPERATIONS      (4 + 4 * (3 + 1))
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   restores power and starts firmware
+/// \return  -
+/// \remarks same initialization sequence as main
+///
+///----------------------------------------------------------------------------
+static void Reboot(void)
+{
+    Flash_Sim_Cut(0);
+    Param_Init();
+    Store_Init();
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   total number of erases
+/// \return  erases of both pages
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static uint32_t Erases(void)
+{
+    return Flash_Sim_Erases(0) + Flash_Sim_Erases(1);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   keys
+/// \return  -
+/// \remarks keys of all parameters are different and never look erased
+///
+///----------------------------------------------------------------------------
+static void Test_Keys(void)
+{
+    uint8_t i, j;
+    uint16_t ui_key[PARAM_NUMBER];
+
+    Param_Init();
+    for (i = 0; i < PARAM_NUMBER; i++) {
+        ui_key[i] = Crc_X25(CRC_X25_INIT, Param_Name((paramEnum_Id)i), PARAM_NAME_LENGTH);
+        CHECK(ui_key[i] != 0xFFFF);
+        for (j = 0; j < i; j++) {
+            CHECK(ui_key[i] != ui_key[j]);
+        }
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   first use
+/// \return  -
+/// \remarks blank flash: defaults are kept, only a header is written
+///
+///----------------------------------------------------------------------------
+static void Test_First_Use(void)
+{
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+    Reboot();
+    CHECK(Erases() == 0);
+    CHECK(Flash_Sim_Programs() == 4);
+    CHECK(Flash_Sim_Locked());
+    CHECK(Store_Free() == STORE_RECORDS);
+    CHECK(Param_Get(PARAM_ROLL_KP) == ROLL_KP);
+    CHECK(Param_Get(PARAM_NAV_BANK) == NAV_BANK);
+    CHECK(Store_Save());                            // nothing changed
+    CHECK(Flash_Sim_Programs() == 4);
+
+    Reboot();                                       // header is found
+    CHECK(Erases() == 0);
+    CHECK(Flash_Sim_Programs() == 4);
+    CHECK(Store_Free() == STORE_RECORDS);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   save and load
+/// \return  -
+/// \remarks one record per changed parameter, last record wins, a value
+///          set back to default is stored too
+///
+///----------------------------------------------------------------------------
+static void Test_Save_Load(void)
+{
+    uint32_t ul_programs;
+
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+    Reboot();
+    ul_programs = Flash_Sim_Programs();
+    CHECK(Param_Set(PARAM_ROLL_KP, 1.5f));
+    CHECK(Param_Set(PARAM_NAV_BANK, 30.0f));
+    CHECK(Store_Save());
+    CHECK(Flash_Sim_Programs() == ul_programs + 8);
+    CHECK(Flash_Sim_Locked());
+    CHECK(Store_Save());                            // saved already
+    CHECK(Flash_Sim_Programs() == ul_programs + 8);
+    CHECK(Param_Set(PARAM_NAV_BANK, 30.0f));        // same value
+    CHECK(Store_Save());
+    CHECK(Flash_Sim_Programs() == ul_programs + 8);
+
+    Reboot();
+    CHECK(Param_Get(PARAM_ROLL_KP) == 1.5f);
+    CHECK(Param_Get(PARAM_NAV_BANK) == 30.0f);
+    CHECK(Param_Get(PARAM_PITCH_KP) == PITCH_KP);
+    CHECK(Store_Free() == STORE_RECORDS - 2);
+
+    CHECK(Param_Set(PARAM_ROLL_KP, 2.5f));
+    CHECK(Param_Set(PARAM_NAV_BANK, NAV_BANK));     // back to default
+    CHECK(Store_Save());
+    Reboot();
+    CHECK(Param_Get(PARAM_ROLL_KP) == 2.5f);
+    CHECK(Param_Get(PARAM_NAV_BANK) == NAV_BANK);
+    CHECK(Store_Free() == STORE_RECORDS - 4);
+    CHECK(Erases() == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   compaction
+/// \return  -
+/// \remarks saves never erase, full page is compacted into spare page once
+///          per power cycle, further saves are refused, old page is erased
+///          at next start up
+///
+///----------------------------------------------------------------------------
+static void Test_Compaction(void)
+{
+    uint16_t ui_saves = 0;
+    uint32_t ul_programs;
+    float f_value = 0.0f, f_saved = 0.0f;
+
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+    Reboot();
+    CHECK(Param_Set(PARAM_NAV_BANK, 25.0f));
+    CHECK(Store_Save());
+    ui_saves++;
+
+    for (;;) {
+        f_value += 0.01f;
+        CHECK(Param_Set(PARAM_ROLL_KP, f_value));
+        ul_programs = Flash_Sim_Programs();
+        if (!Store_Save()) {
+            break;
+        }
+        f_saved = f_value;
+        ui_saves++;
+        CHECK(Flash_Sim_Programs() - ul_programs <= MAX_COMPACTION);
+        CHECK(Erases() == 0);
+    }
+    CHECK(Erases() == 0);
+    CHECK(Flash_Sim_Locked());
+    CHECK(ui_saves >= 2 * STORE_RECORDS - PARAM_NUMBER);
+    CHECK(ui_saves == 2 * STORE_RECORDS - 1);       // two records copied by one save
+    CHECK(Store_Free() == 0);
+    CHECK(Param_Get(PARAM_ROLL_KP) == f_value);     // still in use
+
+    Reboot();
+    CHECK(Flash_Sim_Erases(0) == 1);                // old page
+    CHECK(Flash_Sim_Erases(1) == 0);
+    CHECK(Param_Get(PARAM_ROLL_KP) == f_saved);
+    CHECK(Param_Get(PARAM_NAV_BANK) == 25.0f);
+    CHECK(Store_Free() == 0);                       // full but compaction possible
+    CHECK(Param_Set(PARAM_PITCH_KP, 3.0f));
+    CHECK(Store_Save());
+    CHECK(Store_Free() == STORE_RECORDS - 3);
+
+    Reboot();
+    CHECK(Flash_Sim_Erases(0) == 1);
+    CHECK(Flash_Sim_Erases(1) == 1);
+    CHECK(Param_Get(PARAM_ROLL_KP) == f_saved);
+    CHECK(Param_Get(PARAM_PITCH_KP) == 3.0f);
+    CHECK(Param_Get(PARAM_NAV_BANK) == 25.0f);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   wear
+/// \return  -
+/// \remarks erases alternate between pages, one per page filled
+///
+///----------------------------------------------------------------------------
+static void Test_Wear(void)
+{
+    uint16_t ui_cycle, ui_save, ui_saves = 0;
+    float f_value = 0.0f;
+
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+    for (ui_cycle = 0; ui_cycle < 20; ui_cycle++) {
+        Reboot();
+        CHECK(Param_Get(PARAM_ALT_KP) == ((ui_saves == 0) ? ALT_KP : f_value));
+        for (ui_save = 0; ui_save < STORE_RECORDS / 2; ui_save++) {
+            f_value = (f_value < 5.0f) ? f_value + 0.01f : 0.0f;
+            CHECK(Param_Set(PARAM_ALT_KP, f_value));
+            CHECK(Store_Save());
+            ui_saves++;
+        }
+    }
+    Reboot();
+    CHECK(Param_Get(PARAM_ALT_KP) == f_value);
+    CHECK(Erases() >= (uint32_t)(ui_saves / STORE_RECORDS));
+    CHECK(Erases() <= (uint32_t)(ui_saves / (STORE_RECORDS - PARAM_NUMBER)));
+    CHECK(Flash_Sim_Erases(0) + 1 >= Flash_Sim_Erases(1));
+    CHECK(Flash_Sim_Erases(1) + 1 >= Flash_Sim_Erases(0));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   power cuts
+/// \return  -
+/// \remarks power is cut at each flash operation of a save that appends a
+///          record and compacts: each parameter has either its old or its
+///          new value and the store works after restart. Power is cut too
+///          during the erase of the old page at start up.
+///
+///----------------------------------------------------------------------------
+static void Test_Power_Cut(void)
+{
+    uint32_t ul_cut;
+    float f_roll = 0.0f;
+    uint16_t ui_completed = 0;
+
+    for (ul_cut = 1; ul_cut <= CUT_OPERATIONS + 1; ul_cut++) {
+        Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+        Reboot();
+        f_roll = 0.0f;
+        while (Store_Free() > 1) {                  // one slot left
+            f_roll += 0.01f;
+            CHECK(Param_Set(PARAM_ROLL_KP, f_roll));
+            CHECK(Store_Save());
+        }
+        CHECK(Param_Set(PARAM_PITCH_KP, 4.0f));     // appended
+        CHECK(Param_Set(PARAM_ALT_KP, 5.0f));       // compaction
+        Flash_Sim_Cut(ul_cut);
+        if (Store_Save()) {
+            ui_completed++;
+        }
+
+        Reboot();
+        CHECK(Param_Get(PARAM_ROLL_KP) == f_roll);
+        CHECK((Param_Get(PARAM_PITCH_KP) == PITCH_KP) || (Param_Get(PARAM_PITCH_KP) == 4.0f));
+        CHECK((Param_Get(PARAM_ALT_KP) == ALT_KP) || (Param_Get(PARAM_ALT_KP) == 5.0f));
+        CHECK((Param_Get(PARAM_ALT_KP) == ALT_KP) || (Param_Get(PARAM_PITCH_KP) == 4.0f));
+        CHECK(Param_Get(PARAM_NAV_KP) == NAV_KP);
+
+        CHECK(Param_Set(PARAM_NAV_KP, 7.0f));       // store still works
+        CHECK(Store_Save());
+        Reboot();
+        CHECK(Param_Get(PARAM_NAV_KP) == 7.0f);
+        CHECK(Param_Get(PARAM_ROLL_KP) == f_roll);
+    }
+    CHECK(ui_completed == 1);                       // cut after last operation
+
+    Flash_Sim_Init(STORE_PAGE_ADDRESS, STORE_PAGES);
+    Reboot();
+    while (Store_Free() != 0) {
+        f_roll += 0.01f;
+        CHECK(Param_Set(PARAM_ROLL_KP, f_roll));
+        CHECK(Store_Save());
+    }
+    CHECK(Param_Set(PARAM_PITCH_KP, 4.0f));
+    CHECK(Store_Save());                            // compaction
+    Flash_Sim_Cut(1);                               // cut during erase of old page
+    Param_Init();
+    Store_Init();
+    CHECK(Flash_Sim_Erases(0) == 1);
+    Reboot();
+    CHECK(Flash_Sim_Erases(0) == 2);
+    CHECK(Param_Get(PARAM_ROLL_KP) == f_roll);
+    CHECK(Param_Get(PARAM_PITCH_KP) == 4.0f);
+    CHECK(Store_Free() == STORE_RECORDS - 2);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Keys();
+    Test_First_Use();
+    Test_Save_Load();
+    Test_Compaction();
+    Test_Wear();
+    Test_Power_Cut();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
@@ -0,0 +1,315 @@
+//============================================================================+
+//
+// $HeadURL: $
+// $Revision: $
+// $Date:  $
+// $Author: $
+//
+/// \brief test program
+///
+/// \file
+///  Host test of telemetry stream scheduler: requested rates under budget,
+///  priority under overload, link charge by replies, bulk transfer and load
+///  reporting.
+///  Build and run on PC:
+/// \code
+///   gcc -I../Host -I../../Source test_stream.c ../../Source/stream.c
+///   ./a.out
+/// \endcode
+///
+// Change
+//
+//============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stm32f10x.h"
+
+#include "stream.h"
+
+/** @addtogroup test
+  * @{
+  */
+
+/** @addtogroup stream
+  * @{
+  */
+
+/*--------------------------------- Definitions ------------------------------*/
+
+#ifdef VAR_STATIC
+#undef VAR_STATIC
+#endif
+#define VAR_STATIC static
+#ifdef VAR_GLOBAL
+#undef VAR_GLOBAL
+#endif
+#define VAR_GLOBAL
+
+#define LINK_BUDGET     103         //!< 90 % of 57600 baud at 50 Hz [bytes per tick]
+#define STREAMS         4           //!< number of streams under test
+#define BULK_RESERVE    (LINK_BUDGET / 4) //!< credit left by bulk sender [bytes]
+
+/*----------------------------------- Macros ---------------------------------*/
+
+#define CHECK(x)    if (!(x)) { printf("FAIL line %d: %s\n", __LINE__, #x); i_Errors++; }
+
+/*-------------------------------- Enumerations ------------------------------*/
+
+/*----------------------------------- Types ----------------------------------*/
+
+/*---------------------------------- Constants -------------------------------*/
+
+/*---------------------------------- Globals ---------------------------------*/
+
+/*----------------------------------- Locals ---------------------------------*/
+
+VAR_STATIC int i_Errors = 0;                        //!< number of failed checks
+VAR_STATIC uint32_t ul_Sent[STREAMS];               //!< messages sent by each stream
+VAR_STATIC uint32_t ul_Bytes = 0;                   //!< bytes sent by all streams
+VAR_STATIC uint16_t ui_Bulk = 0;                    //!< frames left to stream 1 as bulk sender
+
+/*--------------------------------- Prototypes -------------------------------*/
+
+static void Send_0(void);
+static void Send_1(void);
+static void Send_2(void);
+static void Send_3(void);
+
+VAR_STATIC xStream x_Stream[STREAMS] = {            //!< streams under test
+    { .pvSend = Send_0, .ucSize = 17, .ucRate = 0 },
+    { .pvSend = Send_1, .ucSize = 36, .ucRate = 0 },
+    { .pvSend = Send_2, .ucSize = 36, .ucRate = 0 },
+    { .pvSend = Send_3, .ucSize = 28, .ucRate = 0 }
+};
+
+/*---------------------------------- Functions -------------------------------*/
+
+///----------------------------------------------------------------------------
+///
+/// \brief   senders, charge link with expected size like Mavlink_End does
+/// \return  -
+/// \remarks while ui_Bulk isn't 0, stream 1 sends frames as long as credit
+///          exceeds BULK_RESERVE, like Mavlink_Param_Next
+///
+///----------------------------------------------------------------------------
+static void Send(uint8_t ucStream)
+{
+    ul_Sent[ucStream]++;
+    ul_Bytes += x_Stream[ucStream].ucSize;
+    Stream_Charge(x_Stream[ucStream].ucSize);
+}
+static void Send_0(void) { Send(0); }
+static void Send_1(void)
+{
+    bool b_first = TRUE;
+
+    if (ui_Bulk == 0) {
+        Send(1);
+    }
+    while ((ui_Bulk != 0) &&
+           (b_first || (Stream_Credit() >= x_Stream[1].ucSize + BULK_RESERVE))) {
+        Send(1);
+        ui_Bulk--;
+        b_first = FALSE;
+    }
+}
+static void Send_2(void) { Send(2); }
+static void Send_3(void) { Send(3); }
+
+///----------------------------------------------------------------------------
+///
+/// \brief   sets up streams
+/// \param   pucRate = requested rates
+/// \param   pucSize = frame sizes
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Setup(const uint8_t * pucRate, const uint8_t * pucSize)
+{
+    uint8_t j;
+
+    for (j = 0; j < STREAMS; j++) {
+        x_Stream[j].ucRate = pucRate[j];
+        x_Stream[j].ucSize = pucSize[j];
+        ul_Sent[j] = 0;
+    }
+    ul_Bytes = 0;
+    Stream_Init(x_Stream, STREAMS, LINK_BUDGET);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   runs scheduler
+/// \param   ulTicks = number of ticks
+/// \return  -
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+static void Run(uint32_t ulTicks)
+{
+    while (ulTicks-- != 0) {
+        Stream_Run();
+    }
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   rates under budget
+/// \return  -
+/// \remarks every stream gets exactly its rate, rates above scheduler
+///          frequency are clamped, streams off send nothing
+///
+///----------------------------------------------------------------------------
+static void Test_Under_Budget(void)
+{
+    const uint8_t uc_rate[STREAMS] = { 1, 5, 0, 200 };
+    const uint8_t uc_size[STREAMS] = { 17, 36, 36, 28 };
+
+    Setup(uc_rate, uc_size);
+    Run(10 * STREAM_TICK_HZ);
+    CHECK(ul_Sent[0] == 10);
+    CHECK(ul_Sent[1] == 50);
+    CHECK(ul_Sent[2] == 0);
+    CHECK(ul_Sent[3] == 10 * STREAM_TICK_HZ);       // clamped to 50 Hz
+    CHECK(x_Stream[0].ucAchieved == 1);
+    CHECK(x_Stream[1].ucAchieved == 5);
+    CHECK(x_Stream[3].ucAchieved == STREAM_TICK_HZ);
+    CHECK(x_Stream[0].ucLate == 0);
+    CHECK(x_Stream[3].ucLate == 0);
+                                                    // 17 + 180 + 1400 bytes/s
+    CHECK(Stream_Load() == (17 + 5 * 36 + 50 * 28) * 1000 / (LINK_BUDGET * STREAM_TICK_HZ));
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   overload
+/// \return  -
+/// \remarks twice as much as the link can carry is requested: high priority
+///          streams keep their rate, lowest ones slow down, link isn't
+///          charged more than its budget
+///
+///----------------------------------------------------------------------------
+static void Test_Overload(void)
+{
+    const uint8_t uc_rate[STREAMS] = { 1, 50, 50, 50 };
+    const uint8_t uc_size[STREAMS] = { 17, 60, 60, 60 };
+    uint32_t ul_bytes;
+
+    Setup(uc_rate, uc_size);
+    Run(STREAM_TICK_HZ);                            // settle
+    ul_bytes = ul_Bytes;
+    Run(10 * STREAM_TICK_HZ);
+    ul_bytes = ul_Bytes - ul_bytes;
+
+    CHECK(x_Stream[0].ucAchieved == 1);
+    CHECK(x_Stream[1].ucAchieved == STREAM_TICK_HZ);
+    CHECK(x_Stream[1].ucLate == 0);
+    CHECK(x_Stream[2].ucAchieved < STREAM_TICK_HZ);
+    CHECK(x_Stream[2].ucAchieved > x_Stream[3].ucAchieved);
+    CHECK(x_Stream[3].ucLate > 0);
+    CHECK(ul_bytes <= 10 * LINK_BUDGET * STREAM_TICK_HZ + LINK_BUDGET * STREAM_BURST);
+    CHECK(ul_bytes >= 9 * LINK_BUDGET * STREAM_TICK_HZ);  // link is used
+    CHECK(Stream_Load() > 900);
+    CHECK(Stream_Load() <= 1000);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   link charged by replies
+/// \return  -
+/// \remarks frames sent outside the scheduler (parameter and mission
+///          replies) slow down streams, which recover afterwards
+///
+///----------------------------------------------------------------------------
+static void Test_Charge(void)
+{
+    const uint8_t uc_rate[STREAMS] = { 1, 25, 0, 0 };
+    const uint8_t uc_size[STREAMS] = { 17, 36, 36, 28 };
+    uint32_t ul_tick;
+
+    Setup(uc_rate, uc_size);
+    Run(STREAM_TICK_HZ);
+    CHECK(x_Stream[1].ucAchieved == 25);
+
+    for (ul_tick = 0; ul_tick < STREAM_TICK_HZ; ul_tick++) {
+        Stream_Charge(LINK_BUDGET - 10);            // replies use most of link
+        Stream_Run();
+    }
+    CHECK(x_Stream[1].ucAchieved < 25);
+    CHECK(x_Stream[1].ucLate > 0);
+    CHECK(Stream_Load() > 900);
+
+    Run(2 * STREAM_TICK_HZ);                        // replies are over
+    CHECK(x_Stream[1].ucAchieved == 25);
+    CHECK(x_Stream[1].ucLate == 0);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   bulk transfer
+/// \return  -
+/// \remarks a sender using all credit above a reserve gets several frames
+///          per tick, higher priority streams keep their rate, lower ones
+///          are throttled but not stopped, link isn't overdrawn
+///
+///----------------------------------------------------------------------------
+static void Test_Bulk(void)
+{
+    const uint8_t uc_rate[STREAMS] = { 1, STREAM_TICK_HZ, 25, 0 };
+    const uint8_t uc_size[STREAMS] = { 17, 33, 36, 28 };
+    uint32_t ul_tick = 0, ul_bytes;
+
+    Setup(uc_rate, uc_size);
+    Run(STREAM_TICK_HZ);
+    CHECK(x_Stream[2].ucAchieved == 25);
+
+    ui_Bulk = 300;
+    ul_bytes = ul_Bytes;
+    while ((ui_Bulk != 0) && (ul_tick < 10 * STREAM_TICK_HZ)) {
+        Stream_Run();
+        ul_tick++;
+        CHECK(Stream_Credit() >= -(int16_t)LINK_BUDGET);
+    }
+    ul_bytes = ul_Bytes - ul_bytes;
+    CHECK(ui_Bulk == 0);                            // at link rate, not at 50 Hz
+    CHECK(ul_tick <= 300 * 33 / (LINK_BUDGET - BULK_RESERVE - 33) + 1);
+    CHECK(ul_bytes <= ul_tick * LINK_BUDGET + LINK_BUDGET * STREAM_BURST);
+    CHECK(x_Stream[0].ucAchieved == 1);
+    CHECK(x_Stream[2].ucAchieved < 25);             // throttled
+    CHECK(x_Stream[2].ucAchieved > 0);              // not stopped
+
+    x_Stream[1].ucRate = 0;                         // transfer over
+    Run(2 * STREAM_TICK_HZ);
+    CHECK(x_Stream[2].ucAchieved == 25);
+}
+
+///----------------------------------------------------------------------------
+///
+/// \brief   main
+/// \return  number of errors
+/// \remarks -
+///
+///----------------------------------------------------------------------------
+int main(void)
+{
+    Test_Under_Budget();
+    Test_Overload();
+    Test_Charge();
+    Test_Bulk();
+
+    printf("%s (%d errors)\n", (i_Errors == 0) ? "PASSED" : "FAILED", i_Errors);
+    return i_Errors;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*****END OF FILE****/
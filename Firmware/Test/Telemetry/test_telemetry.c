@@ -16,6 +16,7 @@
 #include "stm32f10x.h"
 
 #include "config.h"
+#include "ring.h"
 #include "usart1driver.h"
 #include "multiwii.h"
 
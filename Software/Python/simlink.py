@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+"""Simulator link of XPLANE and FLIGHTGEAR builds, reference implementation.
+
+Encodes and decodes the CRC-checked binary frames of Firmware/Source/
+simulator.c, and bridges a simulator still speaking the former ASCII
+protocol (ApSim: "$S" sensor and "$K" gain sentences up, wait code and raw
+floats down) to the autopilot:
+
+  python3 simlink.py --ap serial:COM6:115200 --sim udp:49005:49006
+
+Frame, both directions, multibyte fields little endian:
+
+  0xA5 0x5A length sequence type payload[length] crc_low crc_high
+
+CRC is X25 (MAVLink) of length, sequence, type and payload.
+
+  Type           Dir  Len  Payload
+  SIM_SERVO_POS  down   8  elevator, aileron, rudder, throttle   int16 [us]
+  SIM_WAYPOINT   down   7  index uint8, bearing [deg], altitude [m],
+                           distance [m] uint16
+  SIM_DCM        down  18  DCM by rows                           int16 * 16384
+  SIM_SENSORS    up    16  accel x, y, z, gyro x, y, z           int16 raw ADC
+                           true air speed uint16 [cm/s], altitude int16 [m]
+  SIM_GAINS      up    12  pitch kp, ki, roll kp, ki, nav kp, ki uint16 * 2000
+  SIM_LINK       down   4  lost, discarded uplink frames         uint16
+
+Without --sim, decoded downlink frames are printed, e.g. to check a link.
+Ports are serial:device:baud (needs pyserial), udp:port:peer_port on
+127.0.0.1, or tcp:host:port.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+
+SYNC = b'\xA5\x5A'
+HEADER = 5
+PAYLOAD_MAX = 18
+
+SIM_SERVO_POS = 0xF1
+SIM_WAYPOINT = 0xF2
+SIM_DCM = 0xF7
+SIM_SENSORS = 0xF8
+SIM_GAINS = 0xF9
+SIM_LINK = 0xFA
+
+# payload layout of each type
+LAYOUT = {
+    SIM_SERVO_POS: '<4h',
+    SIM_WAYPOINT: '<B3H',
+    SIM_DCM: '<9h',
+    SIM_SENSORS: '<6hHh',
+    SIM_GAINS: '<6H',
+    SIM_LINK: '<2H',
+}
+
+NAMES = {
+    SIM_SERVO_POS: 'SERVO_POS',
+    SIM_WAYPOINT: 'WAYPOINT',
+    SIM_DCM: 'DCM',
+    SIM_SENSORS: 'SENSORS',
+    SIM_GAINS: 'GAINS',
+    SIM_LINK: 'LINK',
+}
+
+
+def crc_x25(data, crc=0xFFFF):
+    """X25 CRC, as Crc_X25() in Firmware/Source/crc.c."""
+    for b in data:
+        t = (b ^ crc) & 0xFF
+        t = (t ^ (t << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (t << 8) ^ (t << 3) ^ (t >> 4)) & 0xFFFF
+    return crc
+
+
+def encode(msg_type, sequence, payload):
+    """Returns a frame of payload bytes."""
+    if len(payload) > PAYLOAD_MAX:
+        raise ValueError('payload longer than %d bytes' % PAYLOAD_MAX)
+    body = bytes([len(payload), sequence & 0xFF, msg_type]) + payload
+    return SYNC + body + struct.pack('<H', crc_x25(body))
+
+
+def pack(msg_type, sequence, *values):
+    """Returns a frame of values, laid out as in LAYOUT."""
+    return encode(msg_type, sequence, struct.pack(LAYOUT[msg_type], *values))
+
+
+def unpack(msg_type, payload):
+    """Returns values of a payload, None if type or length is unknown."""
+    layout = LAYOUT.get(msg_type)
+    if layout is None or struct.calcsize(layout) != len(payload):
+        return None
+    return struct.unpack(layout, payload)
+
+
+class Parser:
+    """Frame parser, resyncs on sync word after a bad frame.
+
+    Counts discarded frames and sequence gaps as the firmware does.
+    """
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.errors = 0
+        self.lost = 0
+        self.expected = None
+
+    def feed(self, data):
+        """Returns (type, sequence, payload) of each complete frame."""
+        self.buffer += data
+        frames = []
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                del self.buffer[:max(len(self.buffer) - 1, 0)]
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < HEADER:
+                return frames
+            length = self.buffer[2]
+            if length > PAYLOAD_MAX:
+                self.errors += 1
+                del self.buffer[:1]
+                continue
+            if len(self.buffer) < HEADER + length + 2:
+                return frames
+            body = bytes(self.buffer[2:HEADER + length])
+            crc, = struct.unpack_from('<H', self.buffer, HEADER + length)
+            if crc != crc_x25(body):
+                self.errors += 1
+                del self.buffer[:1]
+                continue
+            sequence = body[1]
+            if self.expected is not None:
+                self.lost += (sequence - self.expected) & 0xFF
+            self.expected = (sequence + 1) & 0xFF
+            frames.append((body[2], sequence, body[3:]))
+            del self.buffer[:HEADER + length + 2]
+
+
+def legacy_uplink(line):
+    """Converts a "$S" or "$K" sentence to (type, values), None if invalid.
+
+    "$S,a1,a2,a3,g1,g2,g3,speed,altitude": sensors sent as 32767 - raw,
+    speed [cm/s], altitude [m]. "$K,g1,...,g6": gains * 2000.
+    """
+    words = [w.strip() for w in line.strip().split(',')]
+    try:
+        values = [int(w) for w in words[1:]]
+    except ValueError:
+        return None
+    if words[0] == '$S' and len(values) == 8:
+        raw = [max(-32768, min(32767, 32767 - v)) for v in values[:6]]
+        return SIM_SENSORS, raw + [values[6] & 0xFFFF, values[7]]
+    if words[0] == '$K' and len(values) == 6:
+        return SIM_GAINS, [v & 0xFFFF for v in values]
+    return None
+
+
+def legacy_downlink(msg_type, values):
+    """Converts downlink values to the former raw format, None if it had none.
+
+    SERVO_POS and DCM were a wait code followed by floats, WAYPOINT a wait
+    code, the index and 16 bit words.
+    """
+    if msg_type == SIM_SERVO_POS:
+        return bytes([msg_type]) + struct.pack('<4f', *values)
+    if msg_type == SIM_DCM:
+        return bytes([msg_type]) + struct.pack('<9f', *[v / 16384.0 for v in values])
+    if msg_type == SIM_WAYPOINT:
+        return bytes([msg_type]) + struct.pack('<B3H', *values)
+    return None
+
+
+class Port:
+    """Serial port, UDP or TCP socket, with non blocking read."""
+
+    def __init__(self, spec):
+        kind, _, rest = spec.partition(':')
+        self.serial = None
+        self.sock = None
+        self.peer = None
+        if kind == 'serial':
+            import serial
+            device, _, baud = rest.rpartition(':')
+            self.serial = serial.Serial(device, int(baud), timeout=0.01)
+        elif kind == 'udp':
+            port, _, peer = rest.partition(':')
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.sock.bind(('127.0.0.1', int(port)))
+            self.sock.settimeout(0.01)
+            if peer:
+                self.peer = ('127.0.0.1', int(peer))
+        elif kind == 'tcp':
+            host, _, port = rest.rpartition(':')
+            self.sock = socket.create_connection((host, int(port)))
+            self.sock.settimeout(0.01)
+        else:
+            raise ValueError('unknown port ' + spec)
+
+    def read(self):
+        if self.serial is not None:
+            return self.serial.read(256)
+        try:
+            if self.sock.type == socket.SOCK_DGRAM:
+                data, sender = self.sock.recvfrom(4096)
+                if self.peer is None:
+                    self.peer = sender
+                return data
+            return self.sock.recv(4096)
+        except socket.timeout:
+            return b''
+
+    def write(self, data):
+        if self.serial is not None:
+            self.serial.write(data)
+        elif self.sock.type == socket.SOCK_DGRAM:
+            if self.peer is not None:
+                self.sock.sendto(data, self.peer)
+        else:
+            self.sock.sendall(data)
+
+
+def run(ap, sim, verbose):
+    """Bridges frames of the autopilot to a legacy simulator, forever."""
+    parser = Parser()
+    line = b''
+    sequence = 0
+    while True:
+        for msg_type, _, payload in parser.feed(ap.read()):
+            values = unpack(msg_type, payload)
+            if values is None:
+                continue
+            if msg_type == SIM_LINK or verbose or sim is None:
+                print('%-9s %s  [rx lost %d, discarded %d]' %
+                      (NAMES[msg_type], ' '.join(str(v) for v in values),
+                       parser.lost, parser.errors), flush=True)
+            if sim is not None:
+                data = legacy_downlink(msg_type, values)
+                if data is not None:
+                    sim.write(data)
+        if sim is None:
+            continue
+        line += sim.read()
+        while b'\n' in line or b'\r' in line:
+            end = min(i for i in (line.find(b'\n'), line.find(b'\r')) if i >= 0)
+            sentence, line = line[:end], line[end + 1:]
+            uplink = legacy_uplink(sentence.decode('ascii', 'replace'))
+            if uplink is not None:
+                ap.write(pack(uplink[0], sequence, *uplink[1]))
+                sequence += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--ap', required=True, help='autopilot telemetry port')
+    parser.add_argument('--sim', help='legacy simulator port')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print every downlink frame')
+    args = parser.parse_args()
+    try:
+        run(Port(args.ap), Port(args.sim) if args.sim else None, args.verbose)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Monte Carlo mission sweep on the software in the loop build.
+
+Runs many flights of Firmware/Sil cortex-ap with the flight model, each with
+gains and flight conditions drawn at random, in parallel, and prints a table
+of the metrics each flight reports (see Firmware/Sil/metrics.c), best first.
+
+Each flight is a process of its own, with a copy of the SD card directory,
+so firmware globals, parameter store and log files are never shared. A run
+is repeatable: its draws come from --seed and its index only, and the
+firmware runs in virtual time.
+
+  python3 sweep.py -b ../../Firmware/cortex-ap -d sd -p nav.ppm -n 64 \\
+      --csv sweep.csv --range ROL_ANG_P=0.5:2 --range wind=0:8
+"""
+
+import argparse
+import concurrent.futures
+import csv
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# parameters set with -g, [min, max]
+GAINS = {
+    'ROL_ANG_P': (0.6, 1.4),
+    'PCH_ANG_P': (0.6, 1.4),
+    'NAV_ANG_P': (2.0, 8.0),
+    'AHRS_RP_P': (0.01, 0.1),
+    'AHRS_YAW_P': (0.2, 1.0),
+}
+
+# flight model options set with -m, [min, max]
+CONDITIONS = {
+    'wind': (0.0, 6.0),
+    'wind_dir': (0.0, 360.0),
+    'gust': (0.0, 1.5),
+    'noise': (0.5, 2.0),
+    'heading': (0.0, 360.0),
+    'height': (1.0, 3.0),
+}
+
+# columns of the table, after the draws
+METRICS = ['xtrack_rms', 'xtrack_max', 'alt_rms', 'alt_max', 'sat_ail',
+           'sat_ele', 'wpts', 'flight', 'landed']
+
+
+def draw(index, seed, ranges):
+    """Values of a run, uniform in ranges."""
+    rng = random.Random(seed * 100003 + index)
+    values = {'seed': rng.randrange(1, 2 ** 31)}
+    for name in sorted(ranges):
+        low, high = ranges[name]
+        values[name] = round(rng.uniform(low, high), 4)
+    return values
+
+
+def fly(binary, sd, ppm, seconds, values):
+    """Runs a flight in a directory of its own, returns its metrics."""
+    model = ['seed=%d' % values['seed']]
+    model += ['%s=%g' % (k, v) for k, v in values.items() if k in CONDITIONS]
+    gains = ['%s=%g' % (k, v) for k, v in values.items() if k in GAINS]
+    with tempfile.TemporaryDirectory(prefix='sweep') as work:
+        disk = os.path.join(work, 'sd')
+        shutil.copytree(sd, disk)
+        command = [binary, '-v', '-t', str(seconds), '-1', 'none',
+                   '-p', ppm, '-d', disk, '-m', ','.join(model)]
+        if gains:
+            command += ['-g', ','.join(gains)]
+        result = subprocess.run(command, cwd=work, stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE,
+                                universal_newlines=True)
+    metrics = {}
+    if result.returncode == 0:
+        for line in result.stdout.splitlines():
+            if line.startswith('time='):
+                metrics = dict(pair.split('=') for pair in line.split())
+    if not metrics:
+        sys.stderr.write('run failed: %s\n%s' % (' '.join(command),
+                                                 result.stderr))
+    return {k: float(v) for k, v in metrics.items()}
+
+
+def parse_range(text):
+    """NAME=min:max, or NAME=value for a fixed value."""
+    name, _, limits = text.partition('=')
+    low, _, high = limits.partition(':')
+    return name, (float(low), float(high or low))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('-b', '--binary', default='./cortex-ap',
+                        help='SIL build of the firmware')
+    parser.add_argument('-d', '--sd', default='sd',
+                        help='SD card directory, holding the mission')
+    parser.add_argument('-p', '--ppm', required=True,
+                        help='PPM script selecting navigation mode')
+    parser.add_argument('-t', '--time', type=float, default=600.0,
+                        help='flight time limit [s]')
+    parser.add_argument('-n', '--runs', type=int, default=32)
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count())
+    parser.add_argument('-s', '--seed', type=int, default=1)
+    parser.add_argument('-r', '--range', action='append', default=[],
+                        type=parse_range, metavar='NAME=MIN:MAX',
+                        help='overrides a range of GAINS or CONDITIONS')
+    parser.add_argument('--csv', help='writes all runs to a CSV file')
+    args = parser.parse_args()
+
+    ranges = dict(GAINS)
+    ranges.update(CONDITIONS)
+    for name, limits in args.range:
+        if name not in ranges:
+            parser.error('unknown range %s' % name)
+        ranges[name] = limits
+
+    binary = os.path.abspath(args.binary)
+    sd = os.path.abspath(args.sd)
+    ppm = os.path.abspath(args.ppm)
+    draws = [draw(i, args.seed, ranges) for i in range(args.runs)]
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        results = list(pool.map(
+            lambda values: fly(binary, sd, ppm, args.time, values), draws))
+
+    rows = []
+    for index, (values, metrics) in enumerate(zip(draws, results)):
+        if metrics:
+            row = {'run': index}
+            row.update(values)
+            row.update({k: metrics[k] for k in METRICS})
+            rows.append(row)
+    rows.sort(key=lambda row: (row['landed'], row['xtrack_rms']))
+
+    columns = ['run', 'seed'] + sorted(ranges) + METRICS
+    print(' '.join('%10s' % c[:10] for c in columns))
+    for row in rows:
+        print(' '.join('%10s' % ('%.6g' % row[c]) if row[c] % 1 else
+                       '%10d' % row[c] for c in columns))
+    print('%d of %d runs, %d landed' % (
+        len(rows), args.runs, sum(1 for row in rows if row['landed'])))
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.DictWriter(out, fieldnames=columns)
+            writer.writeheader()
+            writer.writerows(rows)
+    return 0 if len(rows) == args.runs else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())